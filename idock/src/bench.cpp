@@ -0,0 +1,255 @@
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <chrono>
+#include <boost/filesystem/operations.hpp>
+#include "io_service_pool.hpp"
+#include "safe_counter.hpp"
+#include "receptor.hpp"
+#include "ligand.hpp"
+#include "grid_map_task.hpp"
+#include "monte_carlo_task.hpp"
+#include "cpu_dispatch.hpp"
+#include "synthetic.hpp"
+#include "kernel_self_test.hpp"
+
+using namespace std;
+
+/// Runs a batch repeatedly for at least min_seconds, three times, and returns the number of operations and the best nanoseconds per operation.
+/// The batch returns the number of operations it has performed.
+template <typename Batch>
+static pair<size_t, double> measure(Batch&& batch, const double min_seconds)
+{
+	using clock = std::chrono::steady_clock;
+	batch(); // Warm up caches and branch predictors.
+	size_t best_ops = 0;
+	double best_ns_per_op = 0;
+	for (size_t r = 0; r < 3; ++r)
+	{
+		size_t ops = 0;
+		double seconds;
+		const auto begin = clock::now();
+		do
+		{
+			ops += batch();
+			seconds = std::chrono::duration<double>(clock::now() - begin).count();
+		} while (seconds < min_seconds);
+		const double ns_per_op = 1e9 * seconds / ops;
+		if (!r || ns_per_op < best_ns_per_op)
+		{
+			best_ops = ops;
+			best_ns_per_op = ns_per_op;
+		}
+	}
+	return make_pair(best_ops, best_ns_per_op);
+}
+
+/// Writes a CSV row of a benchmark.
+static void report(const string& kernel, const size_t heavy_atoms, const size_t torsions, const fl box_size, const pair<size_t, double>& m)
+{
+	cout << kernel << ',' << isa_name(active_isa) << ',' << heavy_atoms << ',' << torsions << ',' << setprecision(0) << box_size << ',' << m.first << ',' << setprecision(2) << m.second << ',' << setprecision(0) << 1e9 / m.second << endl;
+}
+
+/// Times the hot kernels of idock on reproducible synthetic receptors, ligands and random forest, over a range of box sizes and ligand sizes,
+/// and writes one CSV row per kernel and input, i.e. nanoseconds per operation and operations per second, for tracking performance regressions.
+/// The kernel variants of the highest instruction set level that is requested by the IDOCK_ISA environment variable and agrees with the baseline are timed. All the kernels run on a single thread.
+int main(int argc, char* argv[])
+{
+	const double min_seconds = argc > 1 ? lexical_cast<double>(argv[1]) : 0.2;
+	const fl grid_granularity = 0.25; // Coarser than the daemon's, so that grid maps of the largest box are populated within seconds.
+	const std::array<fl, 3> box_sizes = {{ 16, 24, 30 }};
+	const std::array<size_t, 3> ligand_sizes = {{ 12, 24, 48 }};
+	const fl mc_box_size = 24;
+
+	// Precalculate the scoring function.
+	scoring_function sf;
+	{
+		vector<fl> rs(scoring_function::Num_Samples, 0);
+		for (size_t i = 0; i < scoring_function::Num_Samples; ++i)
+		{
+			rs[i] = sqrt(i * scoring_function::Factor_Inverse);
+		}
+		for (size_t t1 =  0; t1 < XS_TYPE_SIZE; ++t1)
+		for (size_t t2 = t1; t2 < XS_TYPE_SIZE; ++t2)
+		{
+			sf.precalculate(t1, t2, rs);
+		}
+	}
+
+	// Load the daemon's random forest if it is present in the working directory, or a synthetic one of similar shape otherwise.
+	forest f;
+	if (boost::filesystem::exists("pdbbind-refined-x42.rf"))
+	{
+		f.load("pdbbind-refined-x42.rf");
+	}
+	else
+	{
+		synthetic_forest(f, 500, 10, 2);
+	}
+
+	// Select the kernel variants as the daemon does, so that variants disagreeing with the baseline are never timed.
+	for (size_t i = ISA_SSE2 + 1; i <= requested_isa(); ++i)
+	{
+		const isa_t isa = static_cast<isa_t>(i);
+		if (kernel_self_test(isa, sf, f))
+		{
+			active_isa = isa;
+		}
+		else
+		{
+			cerr << "[warning] " << isa_name(isa) << " kernels disagree with " << isa_name(ISA_SSE2) << " ones" << endl;
+		}
+	}
+	cerr << "Using " << isa_name(active_isa) << " kernels" << endl;
+
+	std::array<fl, num_alphas> alphas;
+	alphas[0] = 1;
+	for (size_t i = 1; i < num_alphas; ++i)
+	{
+		alphas[i] = alphas[i - 1] * 0.1;
+	}
+
+	// Parse the synthetic ligands.
+	ptr_vector<ligand> ligands;
+	vector<size_t> atom_types;
+	for (const auto n : ligand_sizes)
+	{
+		istringstream iss(synthetic_ligand(n));
+		ligands.push_back(new ligand(iss));
+		for (const auto t : ligands.back().get_atom_types())
+		{
+			if (find(atom_types.cbegin(), atom_types.cend(), t) == atom_types.cend()) atom_types.push_back(t);
+		}
+	}
+
+	cout << "kernel,isa,heavy_atoms,torsions,box_size,ops,ns_per_op,ops_per_sec" << endl;
+	cout.setf(ios::fixed, ios::floatfield);
+
+	// Time the scoring function lookup on random type pairs and distances within the cutoff.
+	{
+		mt19937eng eng(1);
+		boost::random::uniform_int_distribution<size_t> type_pairs(0, XS_TYPE_SIZE * (XS_TYPE_SIZE + 1) / 2 - 1);
+		boost::random::uniform_real_distribution<fl> r2s(0, scoring_function::Cutoff_Sqr);
+		vector<pair<size_t, fl>> samples(4096);
+		for (auto& s : samples) s = make_pair(type_pairs(eng), r2s(eng));
+		volatile fl sink;
+		report("scoring_function::evaluate", 0, 0, 0, measure([&]()
+		{
+			fl e = 0;
+			for (const auto& s : samples) e += sf.evaluate(s.first, s.second).e;
+			sink = e;
+			return samples.size();
+		}, min_seconds));
+	}
+
+	// Time the random forest on random samples.
+	{
+		mt19937eng eng(3);
+		boost::random::uniform_int_distribution<int> counts(0, 200);
+		vector<vector<float>> samples(64, vector<float>(42));
+		for (auto& x : samples)
+		for (auto& xi : x)
+		{
+			xi = static_cast<float>(counts(eng));
+		}
+		volatile float sink;
+		report("forest::operator()", 0, 0, 0, measure([&]()
+		{
+			float y = 0;
+			for (const auto& x : samples) y += f(x);
+			sink = y;
+			return samples.size();
+		}, min_seconds));
+	}
+
+	io_service_pool io(thread::hardware_concurrency());
+	safe_counter<size_t> cnt;
+	for (const auto box_size : box_sizes)
+	{
+		const box b(zero3, vec3(box_size, box_size, box_size), grid_granularity);
+		istringstream rec_iss(synthetic_receptor(b, 4));
+		const receptor rec(rec_iss, b);
+		vector<array3d<fl>> grid_maps(XS_TYPE_SIZE);
+		for (const auto t : atom_types)
+		{
+			grid_maps[t].resize(b.num_probes);
+		}
+
+		// Time a slice of grid maps in the middle of the box, where the receptor is densest around the cavity. An operation is a probe of an atom type.
+		const size_t x = b.num_probes[0] >> 1;
+		report("grid_map_task", 0, 0, box_size, measure([&]()
+		{
+			grid_map_task(grid_maps, atom_types, x, sf, b, rec);
+			return b.num_probes[1] * b.num_probes[2] * atom_types.size();
+		}, min_seconds));
+
+		// Populate the rest of the grid maps in parallel for the other kernels.
+		cnt.init(b.num_probes[0]);
+		for (size_t x = 0; x < b.num_probes[0]; ++x)
+		{
+			io.post([&,x]()
+			{
+				grid_map_task(grid_maps, atom_types, x, sf, b, rec);
+				cnt.increment();
+			});
+		}
+		cnt.wait();
+
+		for (const auto& lig : ligands)
+		{
+			// Sample conformations whose heavy atoms are within the box, so that every evaluation computes energies and gradients.
+			mt19937eng eng(5);
+			boost::random::uniform_real_distribution<fl> u11(-1, 1);
+			boost::random::normal_distribution<fl> n01(0, 1);
+			vector<conformation> confs;
+			confs.reserve(256);
+			fl e, f;
+			change g(lig.num_active_torsions);
+			while (confs.size() < confs.capacity())
+			{
+				conformation conf(lig.num_active_torsions);
+				conf.position = vec3(0.2 * box_size * u11(eng), 0.2 * box_size * u11(eng), 0.2 * box_size * u11(eng));
+				conf.orientation = qtn4(n01(eng), n01(eng), n01(eng), n01(eng)).normalize();
+				for (auto& t : conf.torsions) t = static_cast<fl>(3.1415926535897932) * u11(eng);
+				if (lig.evaluate(conf, sf, b, grid_maps, 1e+9, e, f, g)) confs.push_back(conf);
+			}
+			report("ligand::evaluate", lig.num_heavy_atoms, lig.num_active_torsions, box_size, measure([&]()
+			{
+				for (const auto& conf : confs) lig.evaluate(conf, sf, b, grid_maps, 1e+9, e, f, g);
+				return confs.size();
+			}, min_seconds));
+
+			if (box_size != mc_box_size) continue;
+
+			// Time clustering of composed results into a result container of a Monte Carlo task and into the final one of a ligand.
+			vector<result> results;
+			results.reserve(confs.size());
+			for (const auto& conf : confs)
+			{
+				lig.evaluate(conf, sf, b, grid_maps, 1e+9, e, f, g);
+				results.push_back(lig.compose_result(e, f, conf));
+			}
+			for (const size_t capacity : { 1, 9 })
+			{
+				ptr_vector<result> rc;
+				rc.reserve(capacity);
+				report("add_to_result_container/" + to_string(capacity), lig.num_heavy_atoms, lig.num_active_torsions, box_size, measure([&]()
+				{
+					rc.clear();
+					for (const auto& r : results) add_to_result_container(rc, result(r), static_cast<fl>(1 * lig.num_heavy_atoms));
+					return results.size();
+				}, min_seconds));
+			}
+
+			// Time the Monte Carlo and BFGS loop with a fixed seed. An operation is an evaluation of the scoring function.
+			ptr_vector<result> rc;
+			rc.reserve(1);
+			report("monte_carlo_task", lig.num_heavy_atoms, lig.num_active_torsions, box_size, measure([&]()
+			{
+				rc.clear();
+				return monte_carlo_task(rc, lig, 6, 10 * lig.num_heavy_atoms, alphas, sf, b, grid_maps).evaluations;
+			}, min_seconds));
+		}
+	}
+	io.wait();
+}
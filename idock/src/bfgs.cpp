@@ -0,0 +1,116 @@
+#include "bfgs.hpp"
+
+bfgs::bfgs(const size_t num_active_torsions) : num_variables(6 + num_active_torsions), identity_hessian(num_variables, 0), h(num_variables, 0), c2(num_active_torsions), g2(num_active_torsions), p(num_active_torsions), y(num_active_torsions), mhy(num_active_torsions)
+{
+	// Initialize the inverse Hessian matrix to identity matrix.
+	// An easier option that works fine in practice is to use a scalar multiple of the identity matrix,
+	// where the scaling factor is chosen to be in the range of the eigenvalues of the true Hessian.
+	// See N&R for a recipe to find this initializer.
+	for (size_t i = 0; i < num_variables; ++i)
+		identity_hessian[triangular_matrix_restrictive_index(i, i)] = 1;
+}
+
+void bfgs::operator()(conformation& c1, fl& e1, fl& f1, change& g1, const ligand& lig, const array<fl, num_alphas>& alphas, const scoring_function& sf, const box& b, const vector<array3d<fl>>& grid_maps, mc_counters& counters)
+{
+	fl e2, f2;
+	fl alpha, pg1, pg2; // pg1 = p * g1. pg2 = p * g2.
+	size_t num_alpha_trials;
+	fl yhy, yp, ryp, pco;
+
+	// Initialize the Hessian matrix to identity.
+	h = identity_hessian;
+
+	// Find a local minimum of c1, whose conformation is saved to c1 and whose derivative is saved to g1.
+	// The loop breaks when an appropriate alpha cannot be found.
+	while (true)
+	{
+		// Calculate p = -h*g, where p is for descent direction, h for Hessian, and g for gradient.
+		for (size_t i = 0; i < num_variables; ++i)
+		{
+			fl sum = 0;
+			for (size_t j = 0; j < num_variables; ++j)
+				sum += h[triangular_matrix_permissive_index(i, j)] * g1[j];
+			p[i] = -sum;
+		}
+
+		// Calculate pg = p*g = -h*g^2 < 0
+		pg1 = 0;
+		for (size_t i = 0; i < num_variables; ++i)
+			pg1 += p[i] * g1[i];
+
+		// Perform a line search to find an appropriate alpha.
+		// Try different alpha values for num_alphas times.
+		// alpha starts with 1, and shrinks to alpha_factor of itself iteration by iteration.
+		for (num_alpha_trials = 0; num_alpha_trials < num_alphas; ++num_alpha_trials)
+		{
+			// Obtain alpha from the precalculated alpha values.
+			alpha = alphas[num_alpha_trials];
+
+			// Calculate c2 = c1 + ap.
+			c2.position = c1.position + alpha * vec3(p[0], p[1], p[2]);
+			BOOST_ASSERT(c1.orientation.is_normalized());
+			c2.orientation = qtn4(alpha * vec3(p[3], p[4], p[5])) * c1.orientation;
+			BOOST_ASSERT(c2.orientation.is_normalized());
+			for (size_t i = 0; i < lig.num_active_torsions; ++i)
+			{
+				c2.torsions[i] = c1.torsions[i] + alpha * p[6 + i];
+			}
+
+			// Evaluate c2, subject to Wolfe conditions http://en.wikipedia.org/wiki/Wolfe_conditions
+			// 1) Armijo rule ensures that the step length alpha decreases f sufficiently.
+			// 2) The curvature condition ensures that the slope has been reduced sufficiently.
+			++counters.alpha_trials;
+			++counters.evaluations;
+			if (lig.evaluate(c2, sf, b, grid_maps, e1 + 0.0001 * alpha * pg1, e2, f2, g2))
+			{
+				pg2 = 0;
+				for (size_t i = 0; i < num_variables; ++i)
+					pg2 += p[i] * g2[i];
+				if (pg2 >= 0.9 * pg1)
+					break; // An appropriate alpha is found.
+			}
+			else
+			{
+				++counters.rejected_poses;
+			}
+		}
+
+		// If an appropriate alpha cannot be found, exit the BFGS loop.
+		if (num_alpha_trials == num_alphas)
+		{
+			++counters.line_search_failures;
+			break;
+		}
+		++counters.bfgs_iterations;
+
+		// Update Hessian matrix h.
+		for (size_t i = 0; i < num_variables; ++i) // Calculate y = g2 - g1.
+			y[i] = g2[i] - g1[i];
+		for (size_t i = 0; i < num_variables; ++i) // Calculate mhy = -h * y.
+		{
+			fl sum = 0;
+			for (size_t j = 0; j < num_variables; ++j)
+				sum += h[triangular_matrix_permissive_index(i, j)] * y[j];
+			mhy[i] = -sum;
+		}
+		yhy = 0;
+		for (size_t i = 0; i < num_variables; ++i) // Calculate yhy = -y * mhy = -y * (-hy).
+			yhy -= y[i] * mhy[i];
+		yp = 0;
+		for (size_t i = 0; i < num_variables; ++i) // Calculate yp = y * p.
+			yp += y[i] * p[i];
+		ryp = 1 / yp;
+		pco = ryp * (ryp * yhy + alpha);
+		for (size_t i = 0; i < num_variables; ++i)
+		for (size_t j = i; j < num_variables; ++j) // includes i
+		{
+			h[triangular_matrix_restrictive_index(i, j)] += ryp * (mhy[i] * p[j] + mhy[j] * p[i]) + pco * p[i] * p[j];
+		}
+
+		// Move to the next iteration.
+		c1 = c2;
+		e1 = e2;
+		f1 = f2;
+		g1 = g2;
+	}
+}
@@ -0,0 +1,35 @@
+#pragma once
+#ifndef IDOCK_BFGS_HPP
+#define IDOCK_BFGS_HPP
+
+#include "ligand.hpp"
+#include "matrix.hpp"
+#include "profiler.hpp"
+
+const size_t num_alphas = 5; ///< Number of alpha values for determining step size in BFGS
+
+/// Performs BFGS local optimization of conformations of a ligand, reusing its working storage across optimizations.
+/// http://en.wikipedia.org/wiki/BFGS_method
+/// http://en.wikipedia.org/wiki/Quasi-Newton_method
+class bfgs
+{
+public:
+	/// Allocates the working storage for a ligand of a number of active torsions.
+	explicit bfgs(const size_t num_active_torsions);
+
+	/// Optimizes conformation c1 of free energy e1, inter-molecular free energy f1 and derivative g1 in place,
+	/// until an appropriate alpha satisfying the Wolfe conditions cannot be found, and counts the evaluations into counters.
+	void operator()(conformation& c1, fl& e1, fl& f1, change& g1, const ligand& lig, const array<fl, num_alphas>& alphas, const scoring_function& sf, const box& b, const vector<array3d<fl>>& grid_maps, mc_counters& counters);
+
+private:
+	const size_t num_variables; ///< Number of variables to optimize.
+	triangular_matrix<fl> identity_hessian; ///< Identity matrix.
+	triangular_matrix<fl> h; ///< Inverse Hessian matrix.
+	conformation c2; ///< c2 = c1 + ap.
+	change g2; ///< Derivative of c2.
+	change p; ///< Descent direction.
+	change y; ///< y = g2 - g1.
+	change mhy; ///< mhy = -h * y.
+};
+
+#endif
@@ -0,0 +1,163 @@
+#include <iostream>
+#include <iomanip>
+#include <boost/program_options.hpp>
+#include <boost/filesystem/fstream.hpp>
+#include "io_service_pool.hpp"
+#include "safe_counter.hpp"
+#include "receptor.hpp"
+#include "ligand.hpp"
+#include "grid_map_task.hpp"
+#include "monte_carlo_task.hpp"
+#include "cpu_dispatch.hpp"
+
+using namespace std;
+
+/// Docks a fixed set of ligands with independent and with cooperative Monte Carlo tasks,
+/// and reports the total number of free energy evaluations against the best free energy found.
+int main(int argc, char* argv[])
+{
+	if (argc < 5)
+	{
+		cout << "cooperative_benchmark receptor.pdbqt box.conf num_seeds ligand.pdbqt [ligand.pdbqt ...]" << endl;
+		return 0;
+	}
+
+	const size_t num_threads = thread::hardware_concurrency();
+	const size_t num_mc_tasks = 64;
+	const fl grid_granularity = 0.08;
+	const size_t num_seeds = lexical_cast<size_t>(argv[3]);
+
+	// Parse the box file.
+	std::array<double, 3> center, size;
+	using namespace boost::program_options;
+	options_description box_options("input (required)");
+	box_options.add_options()
+		("center_x", value<double>(&center[0])->required())
+		("center_y", value<double>(&center[1])->required())
+		("center_z", value<double>(&center[2])->required())
+		("size_x", value<double>(&size[0])->required())
+		("size_y", value<double>(&size[1])->required())
+		("size_z", value<double>(&size[2])->required())
+		;
+	variables_map vm;
+	{
+		boost::filesystem::ifstream ifs(argv[2]);
+		store(parse_config_file(ifs, box_options), vm);
+		vm.notify();
+	}
+	const box b(vec3(center[0], center[1], center[2]), vec3(size[0], size[1], size[2]), grid_granularity);
+
+	// Parse the receptor file.
+	boost::filesystem::ifstream rec_ifs(argv[1]);
+	const receptor rec(rec_ifs, b);
+
+	io_service_pool io(num_threads);
+	safe_counter<size_t> cnt;
+
+	// Precalculate the scoring function.
+	scoring_function sf;
+	{
+		vector<fl> rs(scoring_function::Num_Samples, 0);
+		for (size_t i = 0; i < scoring_function::Num_Samples; ++i)
+		{
+			rs[i] = sqrt(i * scoring_function::Factor_Inverse);
+		}
+		for (size_t t1 =  0; t1 < XS_TYPE_SIZE; ++t1)
+		for (size_t t2 = t1; t2 < XS_TYPE_SIZE; ++t2)
+		{
+			sf.precalculate(t1, t2, rs);
+		}
+	}
+
+	// Use the kernel variants of the same instruction set level as the daemon.
+	active_isa = requested_isa();
+	cerr << "Using " << isa_name(active_isa) << " kernels" << endl;
+
+	std::array<fl, num_alphas> alphas;
+	alphas[0] = 1;
+	for (size_t i = 1; i < num_alphas; ++i)
+	{
+		alphas[i] = alphas[i - 1] * 0.1;
+	}
+
+	vector<array3d<fl>> grid_maps(XS_TYPE_SIZE);
+	vector<size_t> atom_types_to_populate;
+	ptr_vector<ptr_vector<result>> result_containers;
+	result_containers.resize(num_mc_tasks);
+	for (auto& rc : result_containers) rc.reserve(1);
+	elite_pool pool(num_mc_tasks >> 3);
+	vector<size_t> num_evaluations(num_mc_tasks);
+
+	cout << "ligand,mode,seed,evaluations,energy" << endl;
+	cout.setf(ios::fixed, ios::floatfield);
+	std::array<size_t, 2> total_evaluations = {{ 0, 0 }};
+	std::array<fl, 2> total_energy = {{ 0, 0 }};
+	for (int l = 4; l < argc; ++l)
+	{
+		boost::filesystem::ifstream ifs(argv[l]);
+		const ligand lig(ifs);
+
+		// Create grid maps on the fly if necessary.
+		for (const auto t : lig.get_atom_types())
+		{
+			if (grid_maps[t].initialized()) continue;
+			grid_maps[t].resize(b.num_probes);
+			atom_types_to_populate.push_back(t);
+		}
+		if (atom_types_to_populate.size())
+		{
+			cnt.init(b.num_probes[0]);
+			for (size_t x = 0; x < b.num_probes[0]; ++x)
+			{
+				io.post([&,x]()
+				{
+					grid_map_task(grid_maps, atom_types_to_populate, x, sf, b, rec);
+					cnt.increment();
+				});
+			}
+			cnt.wait();
+			atom_types_to_populate.clear();
+		}
+
+		// Dock the ligand with the same seeds in both modes, so that only the search strategy differs.
+		for (size_t seed = 0; seed < num_seeds; ++seed)
+		for (size_t cooperative = 0; cooperative < 2; ++cooperative)
+		{
+			mt19937eng rng(seed);
+			pool.clear(num_mc_tasks >> 3);
+			cnt.init(num_mc_tasks);
+			for (size_t i = 0; i < num_mc_tasks; ++i)
+			{
+				const size_t s = rng();
+				io.post([&,i,s]()
+				{
+					num_evaluations[i] = monte_carlo_task(result_containers[i], lig, s, 100 * lig.num_heavy_atoms, alphas, sf, b, grid_maps, cooperative ? &pool : nullptr).evaluations;
+					cnt.increment();
+				});
+			}
+			cnt.wait();
+
+			// Find the best free energy across all the tasks.
+			size_t evaluations = 0;
+			fl energy = 0;
+			for (size_t i = 0; i < num_mc_tasks; ++i)
+			{
+				evaluations += num_evaluations[i];
+				auto& task_results = result_containers[i];
+				if (task_results.size() && task_results.front().e < energy) energy = task_results.front().e;
+				task_results.clear();
+			}
+			total_evaluations[cooperative] += evaluations;
+			total_energy[cooperative] += energy;
+			cout << argv[l] << ',' << (cooperative ? "cooperative" : "independent") << ',' << seed << ',' << evaluations << ',' << setprecision(3) << energy << endl;
+		}
+	}
+	io.wait();
+
+	// Summarize the evaluation count versus energy quality of both modes.
+	const size_t num_runs = (argc - 4) * num_seeds;
+	for (size_t cooperative = 0; cooperative < 2; ++cooperative)
+	{
+		cerr << (cooperative ? "cooperative" : "independent") << ": " << total_evaluations[cooperative] / num_runs << " evaluations and " << setprecision(3) << total_energy[cooperative] / num_runs << " kcal/mol per docking on average" << endl;
+	}
+}
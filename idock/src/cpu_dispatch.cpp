@@ -0,0 +1,45 @@
+#include <cstdlib>
+#include "cpu_dispatch.hpp"
+
+isa_t active_isa = ISA_SSE2;
+
+isa_t supported_isa()
+{
+#ifdef IDOCK_CPU_DISPATCH
+	// __builtin_cpu_supports() checks both the CPUID bits and whether the operating system saves the extended registers.
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512dq") && __builtin_cpu_supports("avx512vl")) return ISA_AVX512;
+	if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) return ISA_AVX2;
+#endif
+	return ISA_SSE2;
+}
+
+isa_t requested_isa()
+{
+	const isa_t supported = supported_isa();
+	const char* const name = getenv("IDOCK_ISA");
+	if (!name) return supported;
+	const isa_t requested = parse_isa(name);
+	return requested < supported ? requested : supported;
+}
+
+string isa_name(const isa_t isa)
+{
+	switch (isa)
+	{
+		case ISA_SSE2: return "sse2";
+		case ISA_AVX2: return "avx2";
+		case ISA_AVX512: return "avx512";
+		default: return "unknown";
+	}
+}
+
+isa_t parse_isa(const string& name)
+{
+	for (size_t i = 0; i < ISA_SIZE; ++i)
+	{
+		const isa_t isa = static_cast<isa_t>(i);
+		if (name == isa_name(isa)) return isa;
+	}
+	return ISA_SIZE;
+}
@@ -0,0 +1,43 @@
+#pragma once
+#ifndef IDOCK_CPU_DISPATCH_HPP
+#define IDOCK_CPU_DISPATCH_HPP
+
+#include <string>
+using namespace std;
+
+/// Instruction set levels for which the hot kernels are compiled.
+enum isa_t
+{
+	ISA_SSE2, ///< Baseline of x86-64, i.e. what plain g++ -O2 generates.
+	ISA_AVX2, ///< AVX2 with FMA, e.g. Haswell and later.
+	ISA_AVX512, ///< AVX-512 F/DQ/VL, e.g. Skylake-SP and later.
+	ISA_SIZE, ///< Number of supported instruction set levels.
+};
+
+// Kernel variants are compiled by wrapping the generic kernel body in functions targeting higher instruction set levels.
+// The flatten attribute inlines the body and its callees into the wrapper, so that they are compiled for the target as well.
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define IDOCK_CPU_DISPATCH
+#define IDOCK_TARGET_AVX2 __attribute__((target("avx2,fma"), flatten))
+#define IDOCK_TARGET_AVX512 __attribute__((target("avx512f,avx512dq,avx512vl,avx2,fma"), flatten))
+#else
+#define IDOCK_TARGET_AVX2
+#define IDOCK_TARGET_AVX512
+#endif
+
+/// Instruction set level of the kernel variants in use. It defaults to the baseline.
+extern isa_t active_isa;
+
+/// Returns the highest instruction set level supported by both the CPU and the operating system.
+isa_t supported_isa();
+
+/// Returns the instruction set level to use, i.e. the one given by the IDOCK_ISA environment variable if set and supported, or the highest supported one otherwise.
+isa_t requested_isa();
+
+/// Returns the name of an instruction set level, i.e. sse2, avx2 or avx512.
+string isa_name(const isa_t isa);
+
+/// Parses the name of an instruction set level. Returns ISA_SIZE if the name is not recognized.
+isa_t parse_isa(const string& name);
+
+#endif
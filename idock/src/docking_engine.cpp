@@ -0,0 +1,278 @@
+#include "grid_map_task.hpp"
+#include "docking_engine.hpp"
+
+using namespace std::chrono;
+
+docking_engine::docking_engine(io_service_pool& io, const size_t num_threads, const scoring_function& sf, const forest& f, tracer& trace) : tuner(num_threads), cooperative(false), max_grid_maps(XS_TYPE_SIZE), io(io), sf(sf), f(f), trace(trace), grid_maps(XS_TYPE_SIZE), epoch(0), results(1), task_counters(budget_tuner::Max_Num_MC_Tasks), pool(budget_tuner::Max_Num_MC_Tasks >> 3)
+{
+	atom_types_to_populate.reserve(XS_TYPE_SIZE);
+	alphas[0] = 1;
+	for (size_t i = 1; i < num_alphas; ++i)
+	{
+		alphas[i] = alphas[i - 1] * 0.1;
+	}
+	result_containers.resize(budget_tuner::Max_Num_MC_Tasks);
+	for (auto& rc : result_containers) rc.reserve(1);
+}
+
+void docking_engine::load(const box& b, receptor&& rec)
+{
+	lock_guard<mutex> guard(m);
+	this->b = b;
+	this->rec = static_cast<receptor&&>(rec);
+	epoch = 0;
+	last_used.fill(0);
+	grid_maps.clear();
+	grid_maps.resize(XS_TYPE_SIZE);
+}
+
+void docking_engine::populate(const ligand& lig, profile& p)
+{
+	BOOST_ASSERT(atom_types_to_populate.empty());
+	for (const auto t : lig.get_atom_types())
+	{
+		BOOST_ASSERT(t < XS_TYPE_SIZE);
+		last_used[t] = epoch;
+		if (grid_maps[t].initialized()) continue; // The grid map of XScore atom type t has already been populated.
+		atom_types_to_populate.push_back(t);  // The grid map of XScore atom type t has not been populated and should be populated now.
+	}
+	if (atom_types_to_populate.empty()) return;
+
+	// Evict the least recently used grid maps, so that the resident ones do not exceed max_grid_maps.
+	// Those used in the current epoch are kept even beyond max_grid_maps, e.g. for a ligand with more atom types than max_grid_maps.
+	size_t num_grid_maps = atom_types_to_populate.size();
+	for (const auto& grid_map : grid_maps)
+	{
+		if (grid_map.initialized()) ++num_grid_maps;
+	}
+	while (num_grid_maps > max_grid_maps)
+	{
+		size_t lru = XS_TYPE_SIZE;
+		for (size_t t = 0; t < XS_TYPE_SIZE; ++t)
+		{
+			if (grid_maps[t].initialized() && last_used[t] < epoch && (lru == XS_TYPE_SIZE || last_used[t] < last_used[lru])) lru = t;
+		}
+		if (lru == XS_TYPE_SIZE) break;
+		grid_maps[lru] = array3d<fl>(); // Release the memory rather than clearing the elements.
+		--num_grid_maps;
+		++p.grid_map_evictions;
+	}
+	try
+	{
+		for (const auto t : atom_types_to_populate)
+		{
+			grid_maps[t].resize(b.num_probes); // An exception may be thrown in case memory is exhausted.
+		}
+	}
+	catch (...)
+	{
+		// Release the grid maps just resized, so that they are not mistaken for populated ones, and leave the engine ready for the next call.
+		for (const auto t : atom_types_to_populate)
+		{
+			grid_maps[t] = array3d<fl>();
+		}
+		atom_types_to_populate.clear();
+		throw;
+	}
+	const scoped_timer timer(p, PHASE_GRID_POPULATION, trace);
+	const size_t num_gm_tasks = b.num_probes[0];
+	cnt.init(num_gm_tasks);
+	for (size_t x = 0; x < num_gm_tasks; ++x)
+	{
+		io.post([&,x]()
+		{
+			grid_map_task(grid_maps, atom_types_to_populate, x, sf, b, rec);
+			cnt.increment();
+		});
+	}
+	cnt.wait();
+	atom_types_to_populate.clear();
+}
+
+float docking_engine::rescore(const ligand& lig, const result& r) const
+{
+	vector<float> v(42);
+	for (size_t i = 0; i < lig.num_heavy_atoms; ++i)
+	{
+		const auto& la = lig.heavy_atoms[i];
+		if (la.rf == RF_TYPE_SIZE) continue;
+		for (const auto& ra : rec.atoms)
+		{
+			if (ra.rf == RF_TYPE_SIZE) continue;
+			const auto dist_sqr = distance_sqr(r.heavy_atoms[i], ra.coordinate);
+			if (dist_sqr >= 144) continue; // RF-Score cutoff 12A
+			++v[(la.rf << 2) + ra.rf];
+			if (dist_sqr >= 64) continue; // Vina score cutoff 8A
+			if (la.xs != XS_TYPE_SIZE && ra.xs != XS_TYPE_SIZE)
+			{
+				sf.score(v.data() + 36, la.xs, ra.xs, dist_sqr);
+			}
+		}
+	}
+	v.back() = lig.flexibility_penalty_factor;
+	return f(v);
+}
+
+docking_result docking_engine::dock(const ligand& lig, const size_t seed)
+{
+	lock_guard<mutex> guard(m);
+	docking_result dr(lig.num_active_torsions);
+	dr.prof.num_ligands = 1;
+
+	// Create grid maps on the fly if necessary.
+	++epoch;
+	populate(lig, dr.prof);
+
+	// Run Monte Carlo tasks in parallel. In cooperative mode, the tasks share an elite pool.
+	const search_budget sb = tuner(lig);
+	dr.num_mc_tasks = sb.num_mc_tasks;
+	dr.num_mc_iterations = sb.num_mc_iterations;
+	BOOST_ASSERT(sb.num_mc_tasks <= result_containers.size());
+	scoped_timer mc_timer(dr.prof, PHASE_MONTE_CARLO, trace);
+	const auto mc_start = steady_clock::now();
+	mt19937eng rng(seed);
+	pool.clear(sb.num_mc_tasks >> 3); // Keep the ratio of tasks to elites whatever number of tasks the tuner picks.
+	cnt.init(sb.num_mc_tasks);
+	for (size_t i = 0; i < sb.num_mc_tasks; ++i)
+	{
+		BOOST_ASSERT(result_containers[i].empty());
+		BOOST_ASSERT(result_containers[i].capacity() == 1);
+		const size_t s = rng();
+		io.post([&,i,s]()
+		{
+			const auto task_begin = steady_clock::now();
+			task_counters[i] = monte_carlo_task(result_containers[i], lig, s, sb.num_mc_iterations, alphas, sf, b, grid_maps, cooperative ? &pool : nullptr);
+			trace.record("monte_carlo_task", "task", task_begin, steady_clock::now());
+			cnt.increment();
+		});
+	}
+	cnt.wait();
+	tuner.record(lig, sb, duration_cast<duration<double>>(steady_clock::now() - mc_start).count());
+
+	// Aggregate the counters of all the tasks into the ligand.
+	for (size_t i = 0; i < sb.num_mc_tasks; ++i)
+	{
+		dr.prof.counters += task_counters[i];
+	}
+
+	// Merge results from all the tasks into one single result container.
+	BOOST_ASSERT(results.empty());
+	BOOST_ASSERT(results.capacity() == 1);
+	const fl required_square_error = static_cast<fl>(4 * lig.num_heavy_atoms); // Ligands with RMSD < 2.0 will be clustered into the same cluster.
+	for (size_t i = 0; i < sb.num_mc_tasks; ++i)
+	{
+		ptr_vector<result>& task_results = result_containers[i];
+		for (auto& task_result : task_results)
+		{
+			add_to_result_container(results, static_cast<result&&>(task_result), required_square_error);
+		}
+		task_results.clear();
+	}
+	mc_timer.stop();
+
+	// No conformation can be found if the search space is too small.
+	if (results.empty()) return dr;
+	const result& r = results.front();
+	dr.docked = true;
+	dr.energy = r.f * lig.flexibility_penalty_factor;
+	dr.conf = r.conf;
+
+	// Rescore the conformation with random forest.
+	if (f.size())
+	{
+		const scoped_timer rf_timer(dr.prof, PHASE_RF_RESCORING, trace);
+		dr.rfscore = rescore(lig, r);
+	}
+	results.clear();
+	return dr;
+}
+
+future<void> docking_engine::submit(vector<ligand>&& batch, const size_t seed, const callback_t callback)
+{
+	return async(launch::async, [this,seed,callback](const vector<ligand>& batch)
+	{
+		mt19937eng rng(seed);
+		for (size_t i = 0; i < batch.size(); ++i)
+		{
+			callback(i, dock(batch[i], rng()));
+		}
+	}, static_cast<vector<ligand>&&>(batch));
+}
+
+future<vector<docking_result>> docking_engine::submit(vector<ligand>&& batch, const size_t seed)
+{
+	return async(launch::async, [this,seed](const vector<ligand>& batch)
+	{
+		mt19937eng rng(seed);
+		vector<docking_result> drs;
+		drs.reserve(batch.size());
+		for (const auto& lig : batch)
+		{
+			drs.push_back(dock(lig, rng()));
+		}
+		return drs;
+	}, static_cast<vector<ligand>&&>(batch));
+}
+
+vector<docking_result> docking_engine::refine(const vector<ligand>& poses, const bool optimize)
+{
+	lock_guard<mutex> guard(m);
+	vector<docking_result> drs;
+	drs.reserve(poses.size());
+	++epoch;
+	for (const auto& lig : poses)
+	{
+		drs.emplace_back(lig.num_active_torsions);
+		drs.back().prof.num_ligands = 1;
+		populate(lig, drs.back().prof);
+	}
+	cnt.init(poses.size());
+	for (size_t i = 0; i < poses.size(); ++i)
+	{
+		io.post([&,i]()
+		{
+			const ligand& lig = poses[i];
+			docking_result& dr = drs[i];
+			scoped_timer refinement_timer(dr.prof, PHASE_POSE_REFINEMENT, trace);
+			conformation conf = lig.input_conformation();
+			fl e, f;
+			change g(lig.num_active_torsions);
+			++dr.prof.counters.evaluations;
+			if (lig.evaluate(conf, sf, b, grid_maps, numeric_limits<fl>::max(), e, f, g))
+			{
+				if (optimize)
+				{
+					bfgs local_search(lig.num_active_torsions);
+					local_search(conf, e, f, g, lig, alphas, sf, b, grid_maps, dr.prof.counters);
+				}
+				refinement_timer.stop();
+				dr.docked = true;
+				dr.energy = f * lig.flexibility_penalty_factor;
+				dr.conf = conf;
+				if (this->f.size()) // The forest member is shadowed by the inter-molecular free energy.
+				{
+					const scoped_timer rf_timer(dr.prof, PHASE_RF_RESCORING, trace);
+					dr.rfscore = rescore(lig, lig.compose_result(e, f, conf));
+				}
+			}
+			else
+			{
+				++dr.prof.counters.rejected_poses;
+			}
+			cnt.increment();
+		});
+	}
+	cnt.wait();
+	return drs;
+}
+
+result docking_engine::compose(const ligand& lig, const conformation& conf, profile& p)
+{
+	lock_guard<mutex> guard(m);
+	++epoch;
+	populate(lig, p);
+	fl e, f;
+	change g(lig.num_active_torsions);
+	lig.evaluate(conf, sf, b, grid_maps, -99, e, f, g);
+	return lig.compose_result(e, f, conf);
+}
@@ -0,0 +1,118 @@
+#pragma once
+#ifndef IDOCK_DOCKING_ENGINE_HPP
+#define IDOCK_DOCKING_ENGINE_HPP
+
+#include <functional>
+#include "io_service_pool.hpp"
+#include "safe_counter.hpp"
+#include "receptor.hpp"
+#include "ligand.hpp"
+#include "monte_carlo_task.hpp"
+#include "bfgs.hpp"
+#include "search_budget.hpp"
+#include "random_forest_test.hpp"
+#include "profiler.hpp"
+
+/// Represents the docking result of a ligand.
+class docking_result
+{
+public:
+	bool docked; ///< False if no conformation has been found, e.g. when the box is too small for the ligand.
+	fl energy; ///< Inter-molecular free energy normalized by the flexibility penalty, i.e. the idock score, in kcal/mol.
+	float rfscore; ///< Binding affinity predicted by RF-Score in pKd, or 0 without a random forest.
+	conformation conf; ///< Conformation of the best result.
+	size_t num_mc_tasks; ///< Number of Monte Carlo tasks spent on the ligand.
+	size_t num_mc_iterations; ///< Number of iterations per Monte Carlo task.
+	profile prof; ///< Counters and phase timings spent on the ligand.
+
+	/// Constructs an undocked result of a ligand with a number of active torsions.
+	explicit docking_result(const size_t num_active_torsions) : docked(false), energy(0), rfscore(0), conf(num_active_torsions), num_mc_tasks(0), num_mc_iterations(0) {}
+};
+
+/// Docks ligands against a receptor loaded once, reusing its grid maps across ligands and batches,
+/// with Monte Carlo tasks running on an io service pool that may be shared with other engines and other work.
+/// Ligands are docked one at a time, each using all the worker threads; concurrent calls are serialized.
+class docking_engine
+{
+public:
+	/// Receives the index of a ligand in its batch and its docking result.
+	typedef function<void(const size_t, docking_result&&)> callback_t;
+
+	/// Constructs an engine without a receptor. The scoring function, the random forest and the tracer must outlive the engine.
+	/// An empty forest disables RF-Score.
+	explicit docking_engine(io_service_pool& io, const size_t num_threads, const scoring_function& sf, const forest& f, tracer& trace);
+
+	/// Loads a receptor and its box, and discards the grid maps of the previous receptor.
+	void load(const box& b, receptor&& rec);
+
+	/// Docks a ligand with Monte Carlo tasks whose seeds derive from seed, and rescores the best conformation with random forest.
+	/// The calling thread blocks, so it must not be a worker thread of the pool.
+	docking_result dock(const ligand& lig, const size_t seed);
+
+	/// Docks a batch of ligands in order on a driver thread with seeds derived from seed, passing each result to callback on that thread as soon as it is ready.
+	/// Returns a future that becomes ready when the whole batch has been docked, and that propagates exceptions thrown by docking or by callback.
+	future<void> submit(vector<ligand>&& batch, const size_t seed, const callback_t callback);
+
+	/// Docks a batch of ligands in order on a driver thread, and returns a future of their results.
+	future<vector<docking_result>> submit(vector<ligand>&& batch, const size_t seed);
+
+	/// Scores poses, i.e. ligands parsed from docked coordinates such as the models of hits.pdbqt.gz, in their input conformations,
+	/// and rescores them with random forest, in tasks of one pose each on the pool. If optimize is true, each pose is first locally optimized by BFGS.
+	/// Poses with heavy atoms out of the box are reported undocked. The calling thread blocks, so it must not be a worker thread of the pool.
+	vector<docking_result> refine(const vector<ligand>& poses, const bool optimize);
+
+	/// Applies a conformation to a ligand, e.g. to write the model of a hit, populating the grid maps of its atom types if necessary.
+	/// Population time is added to p.
+	result compose(const ligand& lig, const conformation& conf, profile& p);
+
+	/// Returns the box of the loaded receptor.
+	const box& get_box() const
+	{
+		return b;
+	}
+
+	/// Returns the loaded receptor.
+	const receptor& get_receptor() const
+	{
+		return rec;
+	}
+
+	/// Returns the grid maps of the loaded receptor. Those of atom types not encountered yet or evicted are empty.
+	const vector<array3d<fl>>& get_grid_maps() const
+	{
+		return grid_maps;
+	}
+
+	budget_tuner tuner; ///< Tuner of the search budget of each ligand.
+	bool cooperative; ///< True if Monte Carlo tasks of a ligand share an elite pool.
+	size_t max_grid_maps; ///< Maximum number of grid maps resident at the same time, beyond which the least recently used ones are evicted.
+
+private:
+	/// Populates the grid maps of the atom types of a ligand that have not been populated yet, and adds the time and evictions to p.
+	/// The least recently used grid maps beyond max_grid_maps are evicted, except those used since epoch was last advanced, e.g. by other poses of the same batch.
+	/// If memory is exhausted, the grid maps being populated are released before bad_alloc propagates, so that the engine remains usable.
+	void populate(const ligand& lig, profile& p);
+
+	/// Predicts the binding affinity of a result of a ligand with random forest.
+	float rescore(const ligand& lig, const result& r) const;
+
+	io_service_pool& io; ///< Pool of worker threads.
+	const scoring_function& sf; ///< Precalculated scoring function.
+	const forest& f; ///< Random forest of RF-Score.
+	tracer& trace; ///< Tracer of phases and tasks.
+	box b; ///< Box of the loaded receptor.
+	receptor rec; ///< Loaded receptor.
+	vector<array3d<fl>> grid_maps; ///< Grid maps of the loaded receptor, populated on demand and reused by subsequent ligands.
+	vector<size_t> atom_types_to_populate; ///< Atom types whose grid maps are being populated.
+	size_t epoch; ///< Number of calls to dock(), refine() and compose(), used as the clock of last_used.
+	std::array<size_t, XS_TYPE_SIZE> last_used; ///< The epoch when the grid map of each atom type was last used.
+	std::array<fl, num_alphas> alphas; ///< Precalculated alpha values for determining step size in BFGS.
+	ptr_vector<ptr_vector<result>> result_containers; ///< Result containers of Monte Carlo tasks.
+	ptr_vector<result> results; ///< Result container of a ligand.
+	vector<mc_counters> task_counters; ///< Counters of Monte Carlo tasks.
+	elite_pool pool; ///< Elite pool of cooperative Monte Carlo tasks.
+	safe_counter<size_t> cnt; ///< Counter of finished tasks.
+	mutex m; ///< Serializes docking, because ligands share grid maps and result containers.
+};
+
+#endif
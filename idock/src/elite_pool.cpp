@@ -0,0 +1,56 @@
+#include "elite_pool.hpp"
+
+elite_pool::elite_pool(const size_t capacity) : capacity(capacity)
+{
+	elites.reserve(capacity + 1);
+}
+
+void elite_pool::clear(const size_t capacity)
+{
+	lock_guard<mutex> guard(m);
+	elites.clear();
+	this->capacity = max<size_t>(capacity, 1);
+	elites.reserve(this->capacity + 1);
+}
+
+void elite_pool::offer(const conformation& conf, const fl e)
+{
+	lock_guard<mutex> guard(m);
+
+	// Reject the conformation if it is no better than the worst elite of a full pool.
+	if (elites.size() == capacity && e >= elites.back().e) return;
+
+	// The same local minimum is usually offered repeatedly by the same task. Keep only one copy of it.
+	for (const auto& el : elites)
+	{
+		if (eq(el.e, e)) return;
+	}
+
+	// Insert the conformation in the ascending order of free energies, and drop the worst elite if overflowed.
+	auto i = elites.begin();
+	while (i != elites.end() && i->e <= e) ++i;
+	elites.insert(i, elite(conf, e));
+	if (elites.size() > capacity) elites.pop_back();
+}
+
+bool elite_pool::lagging(const fl e) const
+{
+	lock_guard<mutex> guard(m);
+	return elites.size() == capacity && e >= elites.back().e;
+}
+
+bool elite_pool::draw(mt19937eng& eng, conformation& conf, fl& e) const
+{
+	lock_guard<mutex> guard(m);
+	if (elites.empty()) return false;
+	const auto& el = elites[boost::random::uniform_int_distribution<size_t>(0, elites.size() - 1)(eng)];
+	conf = el.conf;
+	e = el.e;
+	return true;
+}
+
+fl elite_pool::best(const fl default_e) const
+{
+	lock_guard<mutex> guard(m);
+	return elites.empty() ? default_e : elites.front().e;
+}
@@ -0,0 +1,47 @@
+#pragma once
+#ifndef IDOCK_ELITE_POOL_HPP
+#define IDOCK_ELITE_POOL_HPP
+
+#include <mutex>
+#include "conformation.hpp"
+using namespace std;
+
+/// Represents a pool of elite conformations shared by the Monte Carlo tasks of the same ligand.
+/// Tasks periodically offer their best conformations to the pool, and lagging tasks restart from one of the elites.
+class elite_pool
+{
+public:
+	/// Constructs an empty pool that retains at most capacity elite conformations.
+	explicit elite_pool(const size_t capacity);
+
+	/// Removes all the elite conformations so that the pool can be reused for another ligand, which retains at most capacity elite conformations, e.g. 1/8 of its Monte Carlo tasks.
+	void clear(const size_t capacity);
+
+	/// Offers a conformation of free energy e to the pool. It is accepted if it is better than the worst elite or the pool is not yet full.
+	void offer(const conformation& conf, const fl e);
+
+	/// Returns true if a task whose best free energy is e lags behind the elites, i.e. the pool is full and e is no better than the worst elite.
+	bool lagging(const fl e) const;
+
+	/// Copies a randomly chosen elite conformation and its free energy to conf and e. Returns false if the pool is empty.
+	bool draw(mt19937eng& eng, conformation& conf, fl& e) const;
+
+	/// Returns the best free energy in the pool, or the given default value if the pool is empty.
+	fl best(const fl default_e) const;
+
+private:
+	/// Represents an elite conformation together with its free energy.
+	class elite
+	{
+	public:
+		conformation conf; ///< Conformation.
+		fl e; ///< Free energy.
+		explicit elite(const conformation& conf, const fl e) : conf(conf), e(e) {}
+	};
+
+	size_t capacity; ///< Maximum number of elites.
+	vector<elite> elites; ///< Elites sorted in the ascending order of free energies.
+	mutable mutex m; ///< Guards elites against concurrent access.
+};
+
+#endif
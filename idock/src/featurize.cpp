@@ -0,0 +1,45 @@
+#include <iostream>
+#include <boost/filesystem/operations.hpp>
+#include <boost/filesystem/fstream.hpp>
+#include "usrcat.hpp"
+
+using namespace std;
+using namespace boost::filesystem;
+
+/// Generates the USRCAT feature file 16_usrcat.f64 from the ligand file 16_ligand.pdbqt and the header file 16_header.bin in the current directory,
+/// by which the daemon ranks the library for jobs with a reference ligand.
+/// The features of the library are computed by the same usrcat_features() as those of reference ligands, so that both sides share the same atom subsets.
+int main()
+{
+	const path header_path = "16_header.bin";
+	const path ligand_path = "16_ligand.pdbqt";
+	const path usrcat_path = "16_usrcat.f64";
+
+	// Read header file.
+	const size_t total_ligands = file_size(header_path) / sizeof(size_t);
+	vector<size_t> headers(total_ligands);
+	{
+		boost::filesystem::ifstream ifs(header_path, ios::binary);
+		ifs.read(reinterpret_cast<char*>(headers.data()), sizeof(size_t) * total_ligands);
+	}
+	cout << "Generating " << usrcat_path << " of " << total_ligands << " ligands" << endl;
+
+	// Compute the features of the ligands in the order of the header file. A partial file is ignored by the daemon, because its size does not match.
+	boost::filesystem::ifstream ligands(ligand_path);
+	boost::filesystem::ofstream ofs(usrcat_path, ios::binary);
+	for (size_t idx = 0; idx < total_ligands; ++idx)
+	{
+		ligands.seekg(headers[idx]);
+		std::array<double, num_usrcat_features> l;
+		try
+		{
+			l = usrcat_features(ligand(ligands));
+		}
+		catch (const exception& e)
+		{
+			cerr << "Ligand " << idx << " at offset " << headers[idx] << ": " << e.what() << endl;
+			return 1;
+		}
+		ofs.write(reinterpret_cast<const char*>(l.data()), sizeof(l));
+	}
+}
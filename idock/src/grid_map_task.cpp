@@ -1,6 +1,8 @@
+#include "cpu_dispatch.hpp"
 #include "grid_map_task.hpp"
 
-void grid_map_task(vector<array3d<fl>>& grid_maps, const vector<size_t>& atom_types_to_populate, const size_t x, const scoring_function& sf, const box& b, const receptor& rec)
+/// Populates grid maps with the baseline instruction set. The variants for higher instruction set levels inline this body.
+static inline void grid_map_task_generic(vector<array3d<fl>>& grid_maps, const vector<size_t>& atom_types_to_populate, const size_t x, const scoring_function& sf, const box& b, const receptor& rec)
 {
 	const size_t num_atom_types_to_populate = atom_types_to_populate.size();
 	vector<fl> e(num_atom_types_to_populate);
@@ -44,3 +46,23 @@ void grid_map_task(vector<array3d<fl>>& grid_maps, const vector<size_t>& atom_ty
 		}
 	}
 }
+
+static IDOCK_TARGET_AVX2 void grid_map_task_avx2(vector<array3d<fl>>& grid_maps, const vector<size_t>& atom_types_to_populate, const size_t x, const scoring_function& sf, const box& b, const receptor& rec)
+{
+	grid_map_task_generic(grid_maps, atom_types_to_populate, x, sf, b, rec);
+}
+
+static IDOCK_TARGET_AVX512 void grid_map_task_avx512(vector<array3d<fl>>& grid_maps, const vector<size_t>& atom_types_to_populate, const size_t x, const scoring_function& sf, const box& b, const receptor& rec)
+{
+	grid_map_task_generic(grid_maps, atom_types_to_populate, x, sf, b, rec);
+}
+
+void grid_map_task(vector<array3d<fl>>& grid_maps, const vector<size_t>& atom_types_to_populate, const size_t x, const scoring_function& sf, const box& b, const receptor& rec)
+{
+	switch (active_isa)
+	{
+		case ISA_AVX512: return grid_map_task_avx512(grid_maps, atom_types_to_populate, x, sf, b, rec);
+		case ISA_AVX2: return grid_map_task_avx2(grid_maps, atom_types_to_populate, x, sf, b, rec);
+		default: return grid_map_task_generic(grid_maps, atom_types_to_populate, x, sf, b, rec);
+	}
+}
@@ -8,6 +8,7 @@
 #include "array3d.hpp"
 
 /// Task for populating grid maps for certain atom types along Y and Z dimensions for an X dimension value.
+/// The kernel variant of the active instruction set level is used.
 void grid_map_task(vector<array3d<fl>>& grid_maps, const vector<size_t>& atom_types_to_populate, const size_t x, const scoring_function& sf, const box& b, const receptor& rec);
 
 #endif
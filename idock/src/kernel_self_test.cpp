@@ -0,0 +1,126 @@
+#include <sstream>
+#include "receptor.hpp"
+#include "ligand.hpp"
+#include "grid_map_task.hpp"
+#include "monte_carlo_task.hpp"
+#include "synthetic.hpp"
+#include "kernel_self_test.hpp"
+
+/// Returns true if two values agree within the relative tolerance.
+static bool agree(const fl a, const fl b)
+{
+	return fabs(a - b) <= 1e-6 * max<fl>(1, fabs(a));
+}
+
+bool kernel_self_test(const isa_t isa, const scoring_function& sf, const forest& f)
+{
+	const isa_t saved_isa = active_isa;
+	bool passed = true;
+
+	// Surround the box center with receptor atoms of various types on shells of 4 to 7 A.
+	const box b(zero3, vec3(16, 16, 16), 0.5);
+	stringstream rec_ss;
+	{
+		const std::array<const char*, 6> ad_types = {{ "C", "A", "N", "NA", "OA", "SA" }};
+		mt19937eng eng(1);
+		boost::random::uniform_real_distribution<fl> u11(-1, 1);
+		for (size_t i = 0; i < 96; ++i)
+		{
+			const vec3 d = normalize(vec3(u11(eng), u11(eng), u11(eng)));
+			const fl r = 4 + 3 * (i & 3) / static_cast<fl>(3);
+			rec_ss << pdbqt_atom(i + 1, "X", i >> 2, vec3(d[0] * r, d[1] * r, d[2] * r), ad_types[i % ad_types.size()]) << '\n';
+		}
+	}
+	const receptor rec(rec_ss, b);
+
+	// A ligand of one active torsion with a pair of atoms separated by more than 3 bonds, so that the intra-ligand term is evaluated.
+	stringstream lig_ss;
+	lig_ss
+		<< "ROOT\n"
+		<< pdbqt_atom(1, "C1", 1, vec3( 0.0, 0.0, 0.0), "C") << '\n'
+		<< pdbqt_atom(2, "C2", 1, vec3( 1.5, 0.0, 0.0), "C") << '\n'
+		<< pdbqt_atom(3, "O1", 1, vec3(-0.5, 1.4, 0.0), "OA") << '\n'
+		<< "ENDROOT\n"
+		<< "BRANCH   2   4\n"
+		<< pdbqt_atom(4, "C3", 1, vec3( 2.0, 1.4, 0.0), "C") << '\n'
+		<< pdbqt_atom(5, "N1", 1, vec3( 3.5, 1.4, 0.0), "N") << '\n'
+		<< pdbqt_atom(6, "C4", 1, vec3( 4.0, 2.8, 0.0), "C") << '\n'
+		<< "ENDBRANCH   2   4\n"
+		<< "TORSDOF 1\n";
+	const ligand lig(lig_ss);
+
+	// Populate grid maps with the baseline and the tested variants.
+	const vector<size_t> atom_types = lig.get_atom_types();
+	std::array<vector<array3d<fl>>, 2> grid_maps;
+	for (size_t v = 0; v < 2; ++v)
+	{
+		active_isa = v ? isa : ISA_SSE2;
+		grid_maps[v].resize(XS_TYPE_SIZE);
+		for (const auto t : atom_types)
+		{
+			grid_maps[v][t].resize(b.num_probes);
+		}
+		for (size_t x = 0; x < b.num_probes[0]; ++x)
+		{
+			grid_map_task(grid_maps[v], atom_types, x, sf, b, rec);
+		}
+	}
+	for (const auto t : atom_types)
+	{
+		for (size_t x = 0; x < b.num_probes[0]; ++x)
+		for (size_t y = 0; y < b.num_probes[1]; ++y)
+		for (size_t z = 0; z < b.num_probes[2]; ++z)
+		{
+			if (!agree(grid_maps[0][t](x, y, z), grid_maps[1][t](x, y, z))) passed = false;
+		}
+	}
+
+	// Evaluate random conformations near the box center, whose heavy atoms are all within the box, against the same grid maps.
+	{
+		mt19937eng eng(2);
+		boost::random::uniform_real_distribution<fl> u11(-1, 1);
+		boost::random::normal_distribution<fl> n01(0, 1);
+		conformation conf(lig.num_active_torsions);
+		std::array<fl, 2> e, f;
+		std::array<change, 2> g = {{ change(lig.num_active_torsions), change(lig.num_active_torsions) }};
+		std::array<bool, 2> valid;
+		for (size_t i = 0; i < 100; ++i)
+		{
+			conf.position = vec3(2 * u11(eng), 2 * u11(eng), 2 * u11(eng));
+			conf.orientation = qtn4(n01(eng), n01(eng), n01(eng), n01(eng)).normalize();
+			conf.torsions[0] = 3.1415926535897932 * u11(eng);
+			for (size_t v = 0; v < 2; ++v)
+			{
+				active_isa = v ? isa : ISA_SSE2;
+				valid[v] = lig.evaluate(conf, sf, b, grid_maps[0], 1e+9, e[v], f[v], g[v]);
+			}
+			if (valid[0] != valid[1]) passed = false;
+			if (!valid[0] || !valid[1]) continue;
+			if (!agree(e[0], e[1]) || !agree(f[0], f[1])) passed = false;
+			for (size_t j = 0; j < g[0].size(); ++j)
+			{
+				if (!agree(g[0][j], g[1][j])) passed = false;
+			}
+		}
+	}
+
+	// Predict random samples with the random forest.
+	if (f.size())
+	{
+		mt19937eng eng(3);
+		boost::random::uniform_int_distribution<int> counts(0, 200);
+		vector<float> x(42);
+		for (size_t i = 0; i < 100; ++i)
+		{
+			for (auto& xi : x) xi = static_cast<float>(counts(eng));
+			active_isa = ISA_SSE2;
+			const float y0 = f(x);
+			active_isa = isa;
+			const float y1 = f(x);
+			if (!agree(y0, y1)) passed = false;
+		}
+	}
+
+	active_isa = saved_isa;
+	return passed;
+}
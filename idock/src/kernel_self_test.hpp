@@ -0,0 +1,15 @@
+#pragma once
+#ifndef IDOCK_KERNEL_SELF_TEST_HPP
+#define IDOCK_KERNEL_SELF_TEST_HPP
+
+#include "cpu_dispatch.hpp"
+#include "scoring_function.hpp"
+#include "random_forest_test.hpp"
+
+/// Checks the kernel variants of an instruction set level against the baseline ones,
+/// by populating grid maps for a synthetic receptor, evaluating random conformations of a synthetic ligand, and predicting random samples with the random forest.
+/// Returns true if all the results agree within a relative tolerance that allows for fused multiply-add.
+/// The active instruction set level is restored on return. It must not be called while kernels are running on other threads.
+bool kernel_self_test(const isa_t isa, const scoring_function& sf, const forest& f);
+
+#endif
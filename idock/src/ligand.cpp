@@ -3,12 +3,13 @@
 #include <boost/iostreams/filtering_stream.hpp>
 #include <boost/iostreams/filter/gzip.hpp>
 #include "parsing_error.hpp"
+#include "cpu_dispatch.hpp"
 #include "ligand.hpp"
 
 using boost::filesystem::ifstream;
 using boost::filesystem::ofstream;
 
-ligand::ligand(boost::filesystem::ifstream& ifs) : num_active_torsions(0)
+ligand::ligand(istream& ifs) : num_active_torsions(0)
 {
 	// Initialize necessary variables for constructing a ligand.
 	lines.reserve(200); // A ligand typically consists of <= 200 lines.
@@ -209,6 +210,7 @@ ligand::ligand(boost::filesystem::ifstream& ifs) : num_active_torsions(0)
 	BOOST_ASSERT(flexibility_penalty_factor <= 1);
 
 	// Update heavy_atoms[].coordinate and hydrogens[].coordinate relative to frame origin.
+	root_origin = heavy_atoms[frames.front().rotorYidx].coordinate;
 	for (size_t k = 0; k < num_frames; ++k)
 	{
 		const frame& f = frames[k];
@@ -294,7 +296,7 @@ vector<size_t> ligand::get_atom_types() const
 	return atom_types;
 }
 
-bool ligand::evaluate(const conformation& conf, const scoring_function& sf, const box& b, const vector<array3d<fl>>& grid_maps, const fl e_upper_bound, fl& e, fl& f, change& g) const
+inline bool ligand::evaluate_generic(const conformation& conf, const scoring_function& sf, const box& b, const vector<array3d<fl>>& grid_maps, const fl e_upper_bound, fl& e, fl& f, change& g) const
 {
 	if (!b.within(conf.position))
 		return false;
@@ -485,6 +487,33 @@ bool ligand::evaluate(const conformation& conf, const scoring_function& sf, cons
 	return true;
 }
 
+IDOCK_TARGET_AVX2 bool ligand::evaluate_avx2(const conformation& conf, const scoring_function& sf, const box& b, const vector<array3d<fl>>& grid_maps, const fl e_upper_bound, fl& e, fl& f, change& g) const
+{
+	return evaluate_generic(conf, sf, b, grid_maps, e_upper_bound, e, f, g);
+}
+
+IDOCK_TARGET_AVX512 bool ligand::evaluate_avx512(const conformation& conf, const scoring_function& sf, const box& b, const vector<array3d<fl>>& grid_maps, const fl e_upper_bound, fl& e, fl& f, change& g) const
+{
+	return evaluate_generic(conf, sf, b, grid_maps, e_upper_bound, e, f, g);
+}
+
+bool ligand::evaluate(const conformation& conf, const scoring_function& sf, const box& b, const vector<array3d<fl>>& grid_maps, const fl e_upper_bound, fl& e, fl& f, change& g) const
+{
+	switch (active_isa)
+	{
+		case ISA_AVX512: return evaluate_avx512(conf, sf, b, grid_maps, e_upper_bound, e, f, g);
+		case ISA_AVX2: return evaluate_avx2(conf, sf, b, grid_maps, e_upper_bound, e, f, g);
+		default: return evaluate_generic(conf, sf, b, grid_maps, e_upper_bound, e, f, g);
+	}
+}
+
+conformation ligand::input_conformation() const
+{
+	conformation conf(num_active_torsions);
+	conf.position = root_origin;
+	return conf;
+}
+
 result ligand::compose_result(const fl e, const fl f, const conformation& conf) const
 {
 	vector<vec3> origins(num_frames);
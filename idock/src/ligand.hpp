@@ -62,17 +62,21 @@ public:
 	size_t num_torsions; ///< Number of torsions.
 	size_t num_active_torsions; ///< Number of active torsions.
 	fl flexibility_penalty_factor; ///< A value in (0, 1] to penalize ligand flexibility.
+	vec3 root_origin; ///< Input coordinate of the ROOT frame origin.
 
-	/// Constructs a ligand by parsing a ligand file stream in pdbqt format.
+	/// Constructs a ligand by parsing a ligand stream in pdbqt format.
 	/// @exception parsing_error Thrown when an atom type is not recognized or an empty branch is detected.
-	ligand(boost::filesystem::ifstream& ifs);
+	ligand(istream& ifs);
 
 	/// Returns the XScore atom types presented in current ligand.
 	vector<size_t> get_atom_types() const;
 
-	/// Evaluates free energy e, force f, and change g. Returns true if the conformation is accepted.
+	/// Evaluates free energy e, force f, and change g with the kernel variant of the active instruction set level. Returns true if the conformation is accepted.
 	bool evaluate(const conformation& conf, const scoring_function& sf, const box& b, const vector<array3d<fl>>& grid_maps, const fl e_upper_bound, fl& e, fl& f, change& g) const;
 
+	/// Returns the conformation that reproduces the input coordinates, i.e. the ROOT frame origin as position, identity orientation and zero torsions.
+	conformation input_conformation() const;
+
 	/// Composes a result from free energy, inter-molecular free energy f, and conformation conf.
 	result compose_result(const fl e, const fl f, const conformation& conf) const;
 
@@ -91,6 +95,15 @@ private:
 	};
 
 	vector<interacting_pair> interacting_pairs; ///< Non 1-4 interacting pairs.
+
+	/// Evaluates free energy e, force f, and change g with the baseline instruction set. The variants for higher instruction set levels inline this body.
+	bool evaluate_generic(const conformation& conf, const scoring_function& sf, const box& b, const vector<array3d<fl>>& grid_maps, const fl e_upper_bound, fl& e, fl& f, change& g) const;
+
+	/// Evaluates free energy e, force f, and change g with AVX2.
+	bool evaluate_avx2(const conformation& conf, const scoring_function& sf, const box& b, const vector<array3d<fl>>& grid_maps, const fl e_upper_bound, fl& e, fl& f, change& g) const;
+
+	/// Evaluates free energy e, force f, and change g with AVX-512.
+	bool evaluate_avx512(const conformation& conf, const scoring_function& sf, const box& b, const vector<array3d<fl>>& grid_maps, const fl e_upper_bound, fl& e, fl& f, change& g) const;
 };
 
 #endif
@@ -0,0 +1,390 @@
+#include <iostream>
+#include <iomanip>
+#include <sys/resource.h>
+#include <boost/program_options.hpp>
+#include <boost/algorithm/string/split.hpp>
+#include <boost/algorithm/string/classification.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <boost/filesystem/fstream.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+#include <boost/iostreams/filter/gzip.hpp>
+#include "docking_engine.hpp"
+#include "summary.hpp"
+#include "kernel_self_test.hpp"
+#include "usrcat.hpp"
+#include "memory_governor.hpp"
+
+using namespace std;
+using namespace std::chrono;
+using namespace boost::filesystem;
+using namespace boost::iostreams;
+
+/// Returns the peak resident set size of the process in MB.
+static double peak_rss()
+{
+	rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_maxrss / 1024.0; // ru_maxrss is in KB on Linux.
+}
+
+/// Runs phase 1 and phase 2 of an idock job entirely on local files, i.e. without MongoDB, SSH SCP and SMTP,
+/// and reports the throughput in ligands per hour, the timings of each phase and the peak resident set size.
+/// With the same seed, thread count and input files, the same ligands are docked with the same random numbers.
+/// Given a reference ligand, the ligands are docked in the order of USRCAT similarity to it, up to the ligand budget, as the daemon does for jobs with a reference ligand.
+/// Alternatively, it scores or locally optimizes given poses, e.g. those of hits.pdbqt.gz of a previous job after decompression, and writes them out the same way.
+int main(int argc, char* argv[])
+{
+	path receptor_path, box_path, ligands_path, out_path, forest_path, reference_path;
+	size_t begin_lig, end_lig, budget, num_threads, seed, num_slices, max_hits;
+	string mode, tuning;
+	fl thoroughness, target_seconds, grid_granularity, memory_budget;
+	bool cooperative;
+
+	using namespace boost::program_options;
+	options_description options("options");
+	options.add_options()
+		("receptor", value<path>(&receptor_path)->required(), "receptor in PDBQT format")
+		("box", value<path>(&box_path)->required(), "box file of center_x/y/z and size_x/y/z")
+		("ligands", value<path>(&ligands_path)->required(), "ligand library of concatenated PDBQT ligands")
+		("out", value<path>(&out_path)->required(), "output folder of slice files, hits.csv.gz, hits.pdbqt.gz and profile.json")
+		("mode", value<string>(&mode)->default_value("dock"), "dock ligands, score given poses, or optimize given poses locally, i.e. dock, score or optimize")
+		("begin", value<size_t>(&begin_lig)->default_value(0), "index of the first ligand of the library to dock")
+		("end", value<size_t>(&end_lig)->default_value(numeric_limits<size_t>::max()), "index past the last ligand of the library to dock")
+		("reference", value<path>(&reference_path), "reference ligand in PDBQT format, by whose USRCAT similarity the ligands are ranked and docked")
+		("budget", value<size_t>(&budget)->default_value(numeric_limits<size_t>::max()), "maximum number of ligands to dock, the most similar ones if a reference ligand is given")
+		("threads", value<size_t>(&num_threads)->default_value(thread::hardware_concurrency()), "number of worker threads")
+		("seed", value<size_t>(&seed)->default_value(0), "seed of the random number generator")
+		("slices", value<size_t>(&num_slices)->default_value(10), "number of slices in phase 1")
+		("hits", value<size_t>(&max_hits)->default_value(1000), "maximum number of ligands written to hits.pdbqt.gz")
+		("cooperative", bool_switch(&cooperative), "dock with cooperative Monte Carlo tasks")
+		("tuning", value<string>(&tuning)->default_value("fixed"), "search budget policy, i.e. fixed, quality or time")
+		("thoroughness", value<fl>(&thoroughness)->default_value(1), "multiplier of the quality policy")
+		("target_seconds", value<fl>(&target_seconds)->default_value(60), "wall time per ligand of the time policy")
+		("granularity", value<fl>(&grid_granularity)->default_value(0.08), "grid granularity in A")
+		("memory_budget", value<fl>(&memory_budget)->default_value(memory_governor::default_budget() / (1 << 20)), "memory budget of the process in MB, within which grid maps are coarsened or evicted if necessary")
+		("forest", value<path>(&forest_path)->default_value("pdbbind-refined-x42.rf"), "random forest file, without which RF-Score is reported as 0")
+		;
+	positional_options_description positional;
+	positional.add("receptor", 1).add("box", 1).add("ligands", 1).add("out", 1);
+	variables_map vm;
+	try
+	{
+		store(command_line_parser(argc, argv).options(options).positional(positional).run(), vm);
+		vm.notify();
+	}
+	catch (const boost::program_options::error&)
+	{
+		cout << "idock_local receptor.pdbqt box.conf ligands.pdbqt out [options]" << endl << options;
+		return argc > 1;
+	}
+	if (mode != "dock" && mode != "score" && mode != "optimize")
+	{
+		cerr << "Unknown mode " << mode << endl;
+		return 1;
+	}
+	num_threads = max<size_t>(1, num_threads);
+	num_slices = max<size_t>(1, num_slices);
+
+	const auto wall_begin = steady_clock::now();
+	profile job_profile; // Counters and timings of the job, aggregated over its slices and phase 2.
+	tracer trace;
+	if (const char* const trace_path = getenv("IDOCK_TRACE")) trace.open(trace_path);
+	create_directories(out_path);
+
+	// Parse the box file.
+	std::array<double, 3> center, size;
+	{
+		options_description box_options("input (required)");
+		box_options.add_options()
+			("center_x", value<double>(&center[0])->required())
+			("center_y", value<double>(&center[1])->required())
+			("center_z", value<double>(&center[2])->required())
+			("size_x", value<double>(&size[0])->required())
+			("size_y", value<double>(&size[1])->required())
+			("size_z", value<double>(&size[2])->required())
+			;
+		boost::filesystem::ifstream ifs(box_path);
+		variables_map vm;
+		store(parse_config_file(ifs, box_options), vm);
+		vm.notify();
+	}
+
+	// Parse the receptor file.
+	scoped_timer parsing_timer(job_profile, PHASE_RECEPTOR_PARSING, trace);
+	const box b(vec3(center[0], center[1], center[2]), vec3(size[0], size[1], size[2]), grid_granularity);
+	boost::filesystem::ifstream rec_ifs(receptor_path);
+	receptor rec(rec_ifs, b);
+	parsing_timer.stop();
+
+	// Estimate the peak memory footprint, and parse the receptor again if grid maps have to be coarsened to fit in the budget.
+	const memory_governor governor(static_cast<size_t>(memory_budget * (1 << 20)));
+	const memory_plan plan = governor.plan(b, rec, memory_governor::resident_bytes());
+	cout << "Planning memory with " << plan.describe() << endl;
+	if (!plan.fits())
+	{
+		cerr << "Grid maps of the box exceed the memory budget" << endl;
+		return 1;
+	}
+	const box c(vec3(center[0], center[1], center[2]), vec3(size[0], size[1], size[2]), plan.grid_granularity);
+	if (plan.grid_granularity != b.grid_granularity)
+	{
+		const scoped_timer parsing_timer(job_profile, PHASE_RECEPTOR_PARSING, trace);
+		rec_ifs.clear();
+		rec_ifs.seekg(0);
+		rec = receptor(rec_ifs, c);
+	}
+
+	// Locate the ligands of the library, each of which ends with a TORSDOF line, as the daemon does with its header file.
+	vector<size_t> headers;
+	boost::filesystem::ifstream ligands(ligands_path);
+	{
+		string line;
+		bool pending = true;
+		for (size_t offset = 0; getline(ligands, line); offset = ligands.tellg())
+		{
+			if (pending && (starts_with(line, "ATOM") || starts_with(line, "HETATM") || starts_with(line, "ROOT")))
+			{
+				headers.push_back(offset);
+				pending = false;
+			}
+			if (starts_with(line, "TORSDOF")) pending = true;
+		}
+		ligands.clear();
+	}
+	end_lig = min(end_lig, headers.size());
+	begin_lig = min(begin_lig, end_lig);
+	cout << "Docking ligands [" << begin_lig << ", " << end_lig << ") out of " << headers.size() << " with " << num_threads << " threads and seed " << seed << endl;
+
+	// Determine the ligands to dock and their order, ranking them by USRCAT similarity to the reference ligand if it is given.
+	vector<size_t> order(end_lig - begin_lig);
+	iota(order.begin(), order.end(), begin_lig);
+	if (!reference_path.empty())
+	{
+		const scoped_timer ranking_timer(job_profile, PHASE_SIMILARITY_RANKING, trace);
+		boost::filesystem::ifstream ref_ifs(reference_path);
+		std::array<double, num_usrcat_features> q;
+		try
+		{
+			q = usrcat_features(ligand(ref_ifs));
+		}
+		catch (const exception& e)
+		{
+			cerr << "Reference ligand " << reference_path << ": " << e.what() << endl;
+			return 1;
+		}
+		vector<std::array<double, 2>> scores(headers.size());
+		for (const auto idx : order)
+		{
+			ligands.seekg(headers[idx]);
+			const auto l = usrcat_features(ligand(ligands));
+			usrcat_score(q.data(), l.data(), scores[idx][0], scores[idx][1]);
+		}
+		stable_sort(order.begin(), order.end(), [&](const size_t idx0, const size_t idx1)
+		{
+			return scores[idx0][1] < scores[idx1][1] || (scores[idx0][1] == scores[idx1][1] && scores[idx0][0] < scores[idx1][0]);
+		});
+		cout << "Ranked " << order.size() << " ligands by USRCAT similarity to " << reference_path << endl;
+	}
+	if (order.size() > budget) order.resize(budget);
+
+	// Precalculate the scoring function in parallel.
+	io_service_pool io(num_threads);
+	safe_counter<size_t> cnt;
+	scoring_function sf;
+	{
+		vector<fl> rs(scoring_function::Num_Samples, 0);
+		for (size_t i = 0; i < scoring_function::Num_Samples; ++i)
+		{
+			rs[i] = sqrt(i * scoring_function::Factor_Inverse);
+		}
+		cnt.init(XS_TYPE_SIZE * (XS_TYPE_SIZE + 1) >> 1);
+		for (size_t t1 =  0; t1 < XS_TYPE_SIZE; ++t1)
+		for (size_t t2 = t1; t2 < XS_TYPE_SIZE; ++t2)
+		{
+			io.post([&,t1,t2]()
+			{
+				sf.precalculate(t1, t2, rs);
+				cnt.increment();
+			});
+		}
+		cnt.wait();
+	}
+
+	// Load the random forest if it is present.
+	forest f;
+	if (exists(forest_path))
+	{
+		f.load(forest_path.string());
+	}
+	else
+	{
+		cerr << "[warning] " << forest_path << " is missing, so RF-Score is not computed" << endl;
+	}
+
+	// Select the kernel variants as the daemon does.
+	for (size_t i = ISA_SSE2 + 1; i <= requested_isa(); ++i)
+	{
+		const isa_t isa = static_cast<isa_t>(i);
+		if (kernel_self_test(isa, sf, f)) active_isa = isa;
+	}
+	cout << "Using " << isa_name(active_isa) << " kernels" << endl;
+
+	// Load the receptor into a docking engine whose Monte Carlo tasks run on the io service pool.
+	docking_engine engine(io, num_threads, sf, f, trace);
+	engine.load(c, static_cast<receptor&&>(rec));
+	engine.max_grid_maps = plan.max_grid_maps;
+	engine.cooperative = cooperative;
+	engine.tuner.configure(budget_tuner::parse_policy(tuning), thoroughness, target_seconds);
+	cout << "Tuning search budgets with " << engine.tuner.describe() << endl;
+
+	// Perform phase 1 slice by slice. Each slice is docked in batches, the next of which is parsed while the current one is being docked.
+	// In score and optimize modes, the ligands are poses, whose batches are refined with one task per pose.
+	const size_t num_ligands = order.size();
+	const size_t batch_size = 64;
+	mt19937eng rng(seed);
+	for (size_t slice = 0; slice < num_slices; ++slice)
+	{
+		profile slice_profile;
+		const auto slice_key = lexical_cast<string>(slice);
+		boost::filesystem::ofstream slice_csv(out_path / (slice_key + ".csv"));
+		slice_csv.setf(ios::fixed, ios::floatfield);
+		slice_csv << setprecision(12);
+		const size_t beg_idx = num_ligands * slice / num_slices;
+		const size_t end_idx = num_ligands * (slice + 1) / num_slices;
+		profile docked_profile; // Touched by the driver thread of the engine only, while ligands are parsed into slice_profile.
+		future<void> docked;
+		for (size_t batch_idx = beg_idx; batch_idx < end_idx; batch_idx += batch_size)
+		{
+			// Parse a batch of ligands.
+			vector<ligand> batch;
+			batch.reserve(batch_size);
+			{
+				const scoped_timer parsing_timer(slice_profile, PHASE_LIGAND_PARSING, trace);
+				for (size_t idx = batch_idx; idx < min(batch_idx + batch_size, end_idx); ++idx)
+				{
+					ligands.seekg(headers[order[idx]]);
+					batch.emplace_back(ligands);
+				}
+			}
+
+			// Writes the result of a ligand to the slice csv file in the order of ligands.
+			const auto write = [&,batch_idx](const size_t i, docking_result&& dr)
+			{
+				docked_profile += dr.prof;
+				if (!dr.docked) return;
+				const scoped_timer output_timer(docked_profile, PHASE_SLICE_OUTPUT, trace);
+				slice_csv << order[batch_idx + i] << ',' << dr.energy << ',' << dr.rfscore;
+				const auto& p = dr.conf.position;
+				const auto& q = dr.conf.orientation;
+				slice_csv << ',' << p[0] << ',' << p[1] << ',' << p[2] << ',' << q.a << ',' << q.b << ',' << q.c << ',' << q.d;
+				for (const auto t : dr.conf.torsions)
+				{
+					slice_csv << ',' << t;
+				}
+				slice_csv << '\n';
+			};
+
+			// Refine poses, or wait for the previous batch and submit the current one.
+			if (mode != "dock")
+			{
+				auto drs = engine.refine(batch, mode == "optimize");
+				for (size_t i = 0; i < drs.size(); ++i)
+				{
+					write(i, static_cast<docking_result&&>(drs[i]));
+				}
+				continue;
+			}
+			if (docked.valid()) docked.get();
+			docked = engine.submit(static_cast<vector<ligand>&&>(batch), rng(), write);
+		}
+		if (docked.valid()) docked.get();
+		slice_profile += docked_profile;
+		boost::filesystem::ofstream slice_json(out_path / (slice_key + ".json"));
+		slice_profile.write(slice_json);
+		job_profile += slice_profile;
+	}
+
+	// Combine slice csv files. Phase 2 starts here.
+	scoped_timer combining_timer(job_profile, PHASE_SLICE_COMBINING, trace);
+	ptr_vector<summary> summaries(num_ligands);
+	string line;
+	for (size_t s = 0; s < num_slices; ++s)
+	{
+		for (boost::filesystem::ifstream slice_csv(out_path / (lexical_cast<string>(s) + ".csv")); getline(slice_csv, line);)
+		{
+			vector<string> tokens;
+			boost::algorithm::split(tokens, line, boost::algorithm::is_any_of(","));
+			if (tokens.size() < 10) continue;
+			conformation conf(tokens.size() - 10);
+			conf.position = vec3(lexical_cast<fl>(tokens[3]), lexical_cast<fl>(tokens[4]), lexical_cast<fl>(tokens[5]));
+			conf.orientation = qtn4(lexical_cast<fl>(tokens[6]), lexical_cast<fl>(tokens[7]), lexical_cast<fl>(tokens[8]), lexical_cast<fl>(tokens[9]));
+			for (size_t i = 0; i < conf.torsions.size(); ++i)
+			{
+				conf.torsions[i] = lexical_cast<fl>(tokens[10 + i]);
+			}
+			summaries.push_back(new summary(lexical_cast<size_t>(tokens[0]), lexical_cast<fl>(tokens[1]), lexical_cast<fl>(tokens[2]), conf));
+		}
+	}
+	combining_timer.stop();
+
+	// Sort summaries.
+	scoped_timer sorting_timer(job_profile, PHASE_SORTING, trace);
+	summaries.sort();
+	sorting_timer.stop();
+	const size_t num_summaries = summaries.size();
+	const size_t num_hits = min(num_summaries, max_hits);
+
+	// Write hits.csv.gz and hits.pdbqt.gz, identifying ligands by their indexes in the library.
+	{
+		const scoped_timer timer(job_profile, PHASE_HIT_WRITING, trace);
+		boost::filesystem::ofstream log_gz(out_path / "hits.csv.gz", ios::binary);
+		boost::filesystem::ofstream lig_gz(out_path / "hits.pdbqt.gz", ios::binary);
+		filtering_ostream foslog;
+		filtering_ostream foslig;
+		foslog.push(gzip_compressor());
+		foslig.push(gzip_compressor());
+		foslog.push(log_gz);
+		foslig.push(lig_gz);
+		foslog.setf(ios::fixed, ios::floatfield);
+		foslig.setf(ios::fixed, ios::floatfield);
+		foslog << "Ligand index,idock score (kcal/mol),RF-Score (pKd)\n" << setprecision(3);
+		foslig << "REMARK 901 FILE VERSION: 1.0.0\n" << setprecision(3);
+		for (size_t idx = 0; idx < num_summaries; ++idx)
+		{
+			const auto& s = summaries[idx];
+			foslog << s.index << ',' << s.energy << ',' << s.rfscore << '\n';
+			if (idx >= num_hits) continue;
+			ligands.seekg(headers[s.index]);
+			ligand lig(ligands);
+			const auto r = engine.compose(lig, s.conf, job_profile);
+			foslig << "MODEL " << '\n' << "REMARK 911 LIGAND INDEX: " << s.index << '\n';
+			lig.write_model(foslig, s, r, engine.get_box(), engine.get_grid_maps());
+			foslig << "ENDMDL\n";
+		}
+	}
+	{
+		boost::filesystem::ofstream profile_json(out_path / "profile.json");
+		job_profile.write(profile_json);
+	}
+	trace.flush();
+
+	// Report the throughput, the phase timings and the peak memory usage.
+	const double wall_seconds = duration_cast<duration<double>>(steady_clock::now() - wall_begin).count();
+	cout.setf(ios::fixed, ios::floatfield);
+	cout << setprecision(3)
+		<< "Ligands docked: " << job_profile.num_ligands << '\n'
+		<< "Ligands with hits: " << num_summaries << '\n'
+		<< "Wall time: " << wall_seconds << " s\n"
+		<< "Throughput: " << job_profile.num_ligands * 3600 / wall_seconds << " ligands/hour\n"
+		<< "Evaluations: " << job_profile.counters.evaluations << '\n'
+		<< "Grid map evictions: " << job_profile.grid_map_evictions << '\n'
+		<< "Peak RSS: " << peak_rss() << " MB\n";
+	for (size_t i = 0; i < PHASE_SIZE; ++i)
+	{
+		const phase_t phase = static_cast<phase_t>(i);
+		if (job_profile.seconds[phase] == 0) continue;
+		cout << "Phase " << phase_name(phase) << ": " << job_profile.seconds[phase] << " s\n";
+	}
+	cout << flush;
+	io.wait();
+}
@@ -10,10 +10,11 @@
 #include "safe_counter.hpp"
 #include "receptor.hpp"
 #include "ligand.hpp"
-#include "grid_map_task.hpp"
-#include "monte_carlo_task.hpp"
+#include "docking_engine.hpp"
 #include "summary.hpp"
-#include "random_forest_test.hpp"
+#include "usrcat.hpp"
+#include "memory_governor.hpp"
+#include "kernel_self_test.hpp"
 
 using namespace std;
 using namespace std::chrono;
@@ -89,12 +90,12 @@ int main(int argc, char* argv[])
 	cout << local_time() << "Initializing constants and variables" << endl;
 	const auto collection = "istar.idock";
 	const auto jobid_fields = BSON("_id" << 1 << "scheduled" << 1);
-	const auto param_fields = BSON("_id" << 0 << "ligands" << 1 << "mwt_lb" << 1 << "mwt_ub" << 1 << "lgp_lb" << 1 << "lgp_ub" << 1 << "ads_lb" << 1 << "ads_ub" << 1 << "pds_lb" << 1 << "pds_ub" << 1 << "hbd_lb" << 1 << "hbd_ub" << 1 << "hba_lb" << 1 << "hba_ub" << 1 << "psa_lb" << 1 << "psa_ub" << 1 << "chg_lb" << 1 << "chg_ub" << 1 << "nrb_lb" << 1 << "nrb_ub" << 1);
+	const auto param_fields = BSON("_id" << 0 << "ligands" << 1 << "cooperative" << 1 << "tuning" << 1 << "thoroughness" << 1 << "target_seconds" << 1 << "reference" << 1 << "mwt_lb" << 1 << "mwt_ub" << 1 << "lgp_lb" << 1 << "lgp_ub" << 1 << "ads_lb" << 1 << "ads_ub" << 1 << "pds_lb" << 1 << "pds_ub" << 1 << "hbd_lb" << 1 << "hbd_ub" << 1 << "hba_lb" << 1 << "hba_ub" << 1 << "psa_lb" << 1 << "psa_ub" << 1 << "chg_lb" << 1 << "chg_ub" << 1 << "nrb_lb" << 1 << "nrb_ub" << 1);
 	const auto finis_fields = BSON("_id" << 0 << "finished" << 1);
 	const auto compt_fields = BSON("_id" << 0 << "email" << 1 << "submitted" << 1 << "description" << 1);
+	const auto grain_fields = BSON("_id" << 0 << "grid_granularity" << 1);
 	const size_t seed = system_clock::now().time_since_epoch().count();
 	const size_t num_threads = thread::hardware_concurrency();
-	const size_t num_mc_tasks = 64;
 	const fl grid_granularity = 0.08;
 	const fl max_ligands_per_job = 1e+6;
 	const auto epoch = boost::gregorian::date(1970, 1, 1);
@@ -119,10 +120,8 @@ int main(int argc, char* argv[])
 	double mwt_lb, mwt_ub, lgp_lb, lgp_ub, ads_lb, ads_ub, pds_lb, pds_ub;
 	int num_ligands, hbd_lb, hbd_ub, hba_lb, hba_ub, psa_lb, psa_ub, chg_lb, chg_ub, nrb_lb, nrb_ub;
 	fl filtering_probability;
-	box b;
-	receptor rec;
-	size_t num_gm_tasks;
-	vector<array3d<fl>> grid_maps(XS_TYPE_SIZE);
+	vector<size_t> prioritized; // Indexes of the filtered ligands most similar to the reference ligand of the job, in the order of decreasing similarity.
+	vector<size_t> slice_ligands; // Indexes of the ligands to dock in the current slice, in the order of docking.
 
 	// Initialize program options.
 	std::array<double, 3> center, size;
@@ -174,26 +173,28 @@ int main(int argc, char* argv[])
 	forest f;
 	f.load("pdbbind-refined-x42.rf");
 
+	// Select the kernel variants of the highest instruction set level that is supported, requested by the IDOCK_ISA environment variable, and agrees with the baseline.
+	const isa_t max_isa = requested_isa();
+	cout << local_time() << "Checking kernel variants up to " << isa_name(max_isa) << " out of " << isa_name(supported_isa()) << " supported" << endl;
+	for (size_t i = ISA_SSE2 + 1; i <= max_isa; ++i)
+	{
+		const isa_t isa = static_cast<isa_t>(i);
+		if (kernel_self_test(isa, sf, f))
+		{
+			active_isa = isa;
+		}
+		else
+		{
+			cerr << local_time() << "[warning] " << isa_name(isa) << " kernels disagree with " << isa_name(ISA_SSE2) << " ones" << endl;
+		}
+	}
+	cout << local_time() << "Using " << isa_name(active_isa) << " kernels" << endl;
+
 	// Initialize a MT19937 random number generator.
 	cout << local_time() << "Seeding a MT19937 RNG with " << seed << endl;
 	mt19937eng rng(seed);
 	boost::random::uniform_real_distribution<fl> u01(0, 1);
 
-	// Precalculate alpha values for determining step size in BFGS.
-	std::array<fl, num_alphas> alphas;
-	alphas[0] = 1;
-	for (size_t i = 1; i < num_alphas; ++i)
-	{
-		alphas[i] = alphas[i - 1] * 0.1;
-	}
-
-	// Reserve space for containers.
-	vector<size_t> atom_types_to_populate; atom_types_to_populate.reserve(XS_TYPE_SIZE);
-	ptr_vector<ptr_vector<result>> result_containers;
-	result_containers.resize(num_mc_tasks);
-	for (auto& rc : result_containers) rc.reserve(1);
-	ptr_vector<result> results(1);
-
 	// Read ID file.
 	string line;
 	cout << local_time() << "Reading ID file" << endl;
@@ -258,15 +259,59 @@ int main(int argc, char* argv[])
 	// Open ligand file for reading.
 	boost::filesystem::ifstream ligands("16_ligand.pdbqt");
 
+	// Check the USRCAT feature file generated by idock_featurize, which is streamed to rank the library for jobs with a reference ligand.
+	const path usrcat_path = "16_usrcat.f64";
+	const bool has_usrcat = exists(usrcat_path) && file_size(usrcat_path) == sizeof(double) * num_usrcat_features * total_ligands;
+	if (!has_usrcat) cout << local_time() << "[warning] " << usrcat_path << " is missing or incomplete, so jobs with a reference ligand are filtered randomly; generate it with idock_featurize" << endl;
+
+	// Returns true if a ligand satisfies the filtering conditions of the current job.
+	const auto satisfies = [&](const size_t idx)
+	{
+		const auto& zp = zproperties[idx];
+		return mwt_lb <= zp.mwt && zp.mwt <= mwt_ub
+		    && lgp_lb <= zp.lgp && zp.lgp <= lgp_ub
+		    && ads_lb <= zp.ads && zp.ads <= ads_ub
+		    && pds_lb <= zp.pds && zp.pds <= pds_ub
+		    && hbd_lb <= zp.hbd && zp.hbd <= hbd_ub
+		    && hba_lb <= zp.hba && zp.hba <= hba_ub
+		    && psa_lb <= zp.psa && zp.psa <= psa_ub
+		    && chg_lb <= zp.chg && zp.chg <= chg_ub
+		    && nrb_lb <= zp.nrb && zp.nrb <= nrb_ub;
+	};
+
 	// Initialize curl globally.
 	curl_global_init(CURL_GLOBAL_DEFAULT);
 
+	// Record a Chrome trace if the IDOCK_TRACE environment variable specifies a file path.
+	tracer trace;
+	if (const char* const trace_path = getenv("IDOCK_TRACE"))
+	{
+		cout << local_time() << "Recording trace events to " << trace_path << endl;
+		trace.open(trace_path);
+	}
+
+	// Create a docking engine whose Monte Carlo tasks run on the io service pool.
+	docking_engine engine(io, num_threads, sf, f, trace);
+
+	// Create a memory governor of the per-process budget, which the IDOCK_MEMORY_BUDGET environment variable may specify in MB.
+	const memory_governor governor(memory_governor::default_budget());
+	cout << local_time() << "Governing memory within " << governor.budget_bytes / (1 << 20) << " MB" << endl;
+
+	// Mark the current job failed, e.g. when its grid maps do not fit in the memory budget, so that none of its remaining slices is scheduled.
+	const auto fail_job = [&](const string& error)
+	{
+		cerr << local_time() << "[error] Job " << _id << " failed: " << error << endl;
+		const auto millis_since_epoch = duration_cast<chrono::milliseconds>(system_clock::now().time_since_epoch()).count();
+		conn.update(collection, BSON("_id" << _id), BSON("$set" << BSON("failed" << Date_t(millis_since_epoch) << "error" << error)));
+	};
+
 	cout << local_time() << "Entering event loop" << endl;
 	bool sleeping = false;
 	while (true)
 	{
 		int slice;
 		bool reload = false;
+		profile slice_profile; // Counters and timings of the current slice, including fetching and reloading the job.
 		if (phase2only)
 		{
 			cout << local_time() << "Running in phase 2 only mode" << endl;
@@ -278,7 +323,9 @@ int main(int argc, char* argv[])
 			// Fetch an incompleted job in a first-come-first-served manner.
 			if (!sleeping) cout << local_time() << "Fetching an incompleted job" << endl;
 			BSONObj info;
-			conn.runCommand("istar", BSON("findandmodify" << "idock" << "query" << BSON("completed" << BSON("$exists" << false) << "scheduled" << BSON("$lt" << static_cast<unsigned int>(num_slices))) << "sort" << BSON("submitted" << 1) << "update" << BSON("$inc" << BSON("scheduled" << 1)) << "fields" << jobid_fields), info); // conn.findAndModify() is available since MongoDB C++ Driver legacy-1.0.0
+			scoped_timer fetch_timer(slice_profile, PHASE_DATABASE, trace);
+			conn.runCommand("istar", BSON("findandmodify" << "idock" << "query" << BSON("completed" << BSON("$exists" << false) << "failed" << BSON("$exists" << false) << "scheduled" << BSON("$lt" << static_cast<unsigned int>(num_slices))) << "sort" << BSON("submitted" << 1) << "update" << BSON("$inc" << BSON("scheduled" << 1)) << "fields" << jobid_fields), info); // conn.findAndModify() is available since MongoDB C++ Driver legacy-1.0.0
+			fetch_timer.stop();
 			const auto value = info["value"];
 			if (value.isNull())
 			{
@@ -305,8 +352,11 @@ int main(int argc, char* argv[])
 		{
 			// Load job parameters from MongoDB.
 			cout << local_time() << "Reloading job parameters from database" << endl;
+			scoped_timer param_timer(slice_profile, PHASE_DATABASE, trace);
 			const auto param = conn.query(collection, QUERY("_id" << _id), 1, 0, &param_fields)->next();
+			param_timer.stop();
 			num_ligands = param["ligands"].Int();
+			engine.cooperative = param["cooperative"].trueValue(); // Old jobs do not have this field and are docked by independent Monte Carlo tasks.
 			mwt_lb = param["mwt_lb"].Number();
 			mwt_ub = param["mwt_ub"].Number();
 			lgp_lb = param["lgp_lb"].Number();
@@ -326,6 +376,10 @@ int main(int argc, char* argv[])
 			nrb_lb = param["nrb_lb"].Int();
 			nrb_ub = param["nrb_ub"].Int();
 
+			// Configure the search budget tuner. Old jobs do not have these fields and are docked with the fixed budget.
+			engine.tuner.configure(budget_tuner::parse_policy(param["tuning"].str()), param["thoroughness"].numberDouble(), param["target_seconds"].numberDouble());
+			cout << local_time() << "Tuning search budgets with " << engine.tuner.describe() << endl;
+
 			// Recalculate filtering_probability.
 			filtering_probability = max_ligands_per_job / num_ligands;
 
@@ -335,7 +389,9 @@ int main(int argc, char* argv[])
 			create_directory(lcl_job_path);
 
 			// Read input files remotely via SSH SCP.
-			stringstream ssbox, ssrec;
+			const bool has_reference = param["reference"].trueValue(); // Old jobs do not have this field and are filtered randomly.
+			stringstream ssbox, ssrec, ssref;
+			scoped_timer download_timer(slice_profile, PHASE_DOWNLOAD, trace);
 			const auto curl = curl_easy_init();
 //			curl_easy_setopt(curl, CURLOPT_VERBOSE, 1);
 			curl_easy_setopt(curl, CURLOPT_SSH_AUTH_TYPES, CURLSSH_AUTH_PUBLICKEY);
@@ -350,23 +406,100 @@ int main(int argc, char* argv[])
 			curl_easy_setopt(curl, CURLOPT_URL, (rmt_job_path / "receptor.pdbqt").c_str());
 			curl_easy_setopt(curl, CURLOPT_WRITEDATA, &ssrec);
 			curl_easy_perform(curl);
+			if (has_reference)
+			{
+				cout << local_time() << "Reloading the reference ligand file" << endl;
+				curl_easy_setopt(curl, CURLOPT_URL, (rmt_job_path / "reference.pdbqt").c_str());
+				curl_easy_setopt(curl, CURLOPT_WRITEDATA, &ssref);
+				curl_easy_perform(curl);
+			}
 			curl_easy_cleanup(curl);
+			download_timer.stop();
 
 			// Parse the box file.
+			scoped_timer parsing_timer(slice_profile, PHASE_RECEPTOR_PARSING, trace);
 			variables_map vm;
 			store(parse_config_file(ssbox, box_options), vm);
 			vm.notify();
-			b = box(vec3(center[0], center[1], center[2]), vec3(size[0], size[1], size[2]), grid_granularity);
-
-			// Parse the receptor file.
-			rec = receptor(ssrec, b);
+			const box b(vec3(center[0], center[1], center[2]), vec3(size[0], size[1], size[2]), grid_granularity);
+
+			// Parse the receptor file, and load it into the docking engine, which discards the grid maps of the previous job.
+			engine.load(b, receptor(ssrec, b));
+
+			// Estimate the peak memory footprint of the job now that the grid maps of the previous job are released, and store grid maps accordingly.
+			// The slices and phase 2 of a job may run on machines of different budgets, but must dock and compose conformations against grid maps of the same granularity.
+			// The first of them to plan records its granularity alongside the job, and the others follow it.
+			memory_plan plan = governor.plan(b, engine.get_receptor(), memory_governor::resident_bytes());
+			conn.update(collection, BSON("_id" << _id << "grid_granularity" << BSON("$exists" << false)), BSON("$set" << BSON("grid_granularity" << plan.grid_granularity)));
+			const fl job_granularity = conn.query(collection, QUERY("_id" << _id), 1, 0, &grain_fields)->next()["grid_granularity"].Number();
+			if (job_granularity != plan.grid_granularity)
+			{
+				plan = governor.plan(b, engine.get_receptor(), memory_governor::resident_bytes(), job_granularity);
+			}
+			cout << local_time() << "Planning memory with " << plan.describe() << endl;
+			if (!plan.fits())
+			{
+				parsing_timer.stop();
+				fail_job("grid maps of the box exceed the memory budget");
+				if (phase2only) return 1;
+				continue;
+			}
 
-			// Reserve storage for grid map task container.
-			num_gm_tasks = b.num_probes[0];
+			// Coarser grid maps need the receptor to be parsed again, because the partitions depend on the expanded box.
+			if (plan.grid_granularity != b.grid_granularity)
+			{
+				const box c(vec3(center[0], center[1], center[2]), vec3(size[0], size[1], size[2]), plan.grid_granularity);
+				ssrec.clear();
+				ssrec.seekg(0);
+				engine.load(c, receptor(ssrec, c));
+			}
+			engine.max_grid_maps = plan.max_grid_maps;
+			parsing_timer.stop();
 
-			// Clear grid maps.
-			grid_maps.clear();
-			grid_maps.resize(XS_TYPE_SIZE);
+			// Rank the filtered ligands of the entire library by USRCAT similarity to the reference ligand, and keep the top ones within the ligand budget of the job.
+			// The ranking is deterministic, so that every slice, no matter on which machine it runs, docks its own share of the same prioritized ligands.
+			prioritized.clear();
+			if (has_reference && has_usrcat)
+			{
+				cout << local_time() << "Ranking the library by USRCAT similarity to the reference ligand" << endl;
+				scoped_timer ranking_timer(slice_profile, PHASE_SIMILARITY_RANKING, trace);
+				std::array<double, num_usrcat_features> q;
+				try
+				{
+					q = usrcat_features(ligand(ssref));
+				}
+				catch (const exception& e)
+				{
+					ranking_timer.stop();
+					fail_job(string("reference ligand ") + e.what());
+					if (phase2only) return 1;
+					continue;
+				}
+				const size_t max_prioritized = static_cast<size_t>(max_ligands_per_job);
+				vector<tuple<double, double, size_t>> heap; // Max heap of the USRCAT score, the USR score and the index of the most similar ligands so far.
+				heap.reserve(max_prioritized + 1);
+				std::array<double, num_usrcat_features> l;
+				boost::filesystem::ifstream ifs(usrcat_path, ios::binary);
+				for (size_t idx = 0; idx < total_ligands; ++idx)
+				{
+					ifs.read(reinterpret_cast<char*>(l.data()), sizeof(l));
+					if (!satisfies(idx)) continue;
+					double s0, s1;
+					usrcat_score(q.data(), l.data(), s0, s1);
+					heap.emplace_back(s1, s0, idx);
+					push_heap(heap.begin(), heap.end());
+					if (heap.size() <= max_prioritized) continue;
+					pop_heap(heap.begin(), heap.end());
+					heap.pop_back();
+				}
+				sort_heap(heap.begin(), heap.end());
+				prioritized.reserve(heap.size());
+				for (const auto& h : heap)
+				{
+					prioritized.push_back(get<2>(h));
+				}
+				cout << local_time() << "Prioritized " << prioritized.size() << " ligands" << endl;
+			}
 		}
 
 		if (!phase2only)
@@ -379,135 +512,98 @@ int main(int argc, char* argv[])
 			boost::filesystem::ofstream slice_csv(lcl_job_path / (slice_key + ".csv"));
 			slice_csv.setf(ios::fixed, ios::floatfield);
 			slice_csv << setprecision(12); // Dump as many digits as possible in order to recover accurate conformations in summaries.
-			for (auto idx = beg_lig; idx < end_lig; ++idx)
-			{
-				// Check if the ligand satisfies the filtering conditions.
-				const auto zp = zproperties[idx];
-				if (!(mwt_lb <= zp.mwt && zp.mwt <= mwt_ub
-				   && lgp_lb <= zp.lgp && zp.lgp <= lgp_ub
-				   && ads_lb <= zp.ads && zp.ads <= ads_ub
-				   && pds_lb <= zp.pds && zp.pds <= pds_ub
-				   && hbd_lb <= zp.hbd && zp.hbd <= hbd_ub
-				   && hba_lb <= zp.hba && zp.hba <= hba_ub
-				   && psa_lb <= zp.psa && zp.psa <= psa_ub
-				   && chg_lb <= zp.chg && zp.chg <= chg_ub
-				   && nrb_lb <= zp.nrb && zp.nrb <= nrb_ub)) continue;
-
-				// Filtering out the ligand randomly according to the maximum number of ligands per job.
-				if (u01(rng) > filtering_probability) continue;
-
-				// Locate a ligand.
-				ligands.seekg(headers[idx]);
-
-				// Parse the ligand.
-				ligand lig(ligands);
+			size_t sum_mc_tasks = 0, sum_mc_iterations = 0;
 
-				// Create grid maps on the fly if necessary.
-				BOOST_ASSERT(atom_types_to_populate.empty());
-				const vector<size_t> ligand_atom_types = lig.get_atom_types();
-				for (const auto t : ligand_atom_types)
-				{
-					BOOST_ASSERT(t < XS_TYPE_SIZE);
-					array3d<fl>& grid_map = grid_maps[t];
-					if (grid_map.initialized()) continue; // The grid map of XScore atom type t has already been populated.
-					grid_map.resize(b.num_probes); // An exception may be thrown in case memory is exhausted.
-					atom_types_to_populate.push_back(t);  // The grid map of XScore atom type t has not been populated and should be populated now.
-				}
-				if (atom_types_to_populate.size())
-				{
-					cnt.init(num_gm_tasks);
-					for (size_t x = 0; x < num_gm_tasks; ++x)
-					{
-						io.post([&,x]()
-						{
-							grid_map_task(grid_maps, atom_types_to_populate, x, sf, b, rec);
-							cnt.increment();
-						});
-					}
-					cnt.wait();
-					atom_types_to_populate.clear();
-				}
-
-				// Run Monte Carlo tasks in parallel.
-				cnt.init(num_mc_tasks);
-				for (size_t i = 0; i < num_mc_tasks; ++i)
+			// Select the ligands of the slice, either the prioritized ones in the order of similarity, or the filtered ones subsampled randomly according to the maximum number of ligands per job.
+			slice_ligands.clear();
+			if (prioritized.size())
+			{
+				for (const auto idx : prioritized)
 				{
-					BOOST_ASSERT(result_containers[i].empty());
-					BOOST_ASSERT(result_containers[i].capacity() == 1);
-					const size_t s = rng();
-					io.post([&,i,s]()
-					{
-						monte_carlo_task(result_containers[i], lig, s, alphas, sf, b, grid_maps);
-						cnt.increment();
-					});
+					if (beg_lig <= idx && idx < end_lig) slice_ligands.push_back(idx);
 				}
-				cnt.wait();
-
-				// Merge results from all the tasks into one single result container.
-				BOOST_ASSERT(results.empty());
-				BOOST_ASSERT(results.capacity() == 1);
-				const fl required_square_error = static_cast<fl>(4 * lig.num_heavy_atoms); // Ligands with RMSD < 2.0 will be clustered into the same cluster.
-				for (size_t i = 0; i < num_mc_tasks; ++i)
+			}
+			else
+			{
+				for (auto idx = beg_lig; idx < end_lig; ++idx)
 				{
-					ptr_vector<result>& task_results = result_containers[i];
-					BOOST_ASSERT(task_results.capacity() == 1);
-					for (auto& task_result : task_results)
-					{
-						add_to_result_container(results, static_cast<result&&>(task_result), required_square_error);
-					}
-					task_results.clear();
+					if (satisfies(idx) && u01(rng) <= filtering_probability) slice_ligands.push_back(idx);
 				}
+			}
 
-				// No conformation can be found if the search space is too small.
-				if (results.size())
+			// Population may still exhaust memory, e.g. when other processes take more than expected, in which case the job fails rather than the daemon.
+			try
+			{
+				for (const auto idx : slice_ligands)
 				{
-					BOOST_ASSERT(results.size() == 1);
-					const result& r = results.front();
-
-					// Rescore conformations with random forest.
-					vector<float> v(42);
-					for (size_t i = 0; i < lig.num_heavy_atoms; ++i)
+					// Locate a ligand.
+					const auto ligand_begin = steady_clock::now();
+					scoped_timer parsing_timer(slice_profile, PHASE_LIGAND_PARSING, trace);
+					ligands.seekg(headers[idx]);
+
+					// Parse the ligand.
+					ligand lig(ligands);
+					parsing_timer.stop();
+
+					// Dock the ligand with Monte Carlo tasks in parallel, and rescore it with random forest.
+					const docking_result dr = engine.dock(lig, rng());
+					slice_profile += dr.prof;
+					sum_mc_tasks += dr.num_mc_tasks;
+					sum_mc_iterations += dr.num_mc_iterations;
+
+					// Dump ligand result to the slice csv file. No conformation can be found if the search space is too small.
+					if (dr.docked)
 					{
-						const auto& la = lig.heavy_atoms[i];
-						if (la.rf == RF_TYPE_SIZE) continue;
-						for (const auto& ra : rec.atoms)
+						const scoped_timer output_timer(slice_profile, PHASE_SLICE_OUTPUT, trace);
+						slice_csv << idx << ',' << dr.energy << ',' << dr.rfscore;
+						const auto& p = dr.conf.position;
+						const auto& q = dr.conf.orientation;
+						slice_csv << ',' << p[0] << ',' << p[1] << ',' << p[2] << ',' << q.a << ',' << q.b << ',' << q.c << ',' << q.d;
+						for (const auto t : dr.conf.torsions)
 						{
-							if (ra.rf == RF_TYPE_SIZE) continue;
-							const auto dist_sqr = distance_sqr(r.heavy_atoms[i], ra.coordinate);
-							if (dist_sqr >= 144) continue; // RF-Score cutoff 12A
-							++v[(la.rf << 2) + ra.rf];
-							if (dist_sqr >= 64) continue; // Vina score cutoff 8A
-							if (la.xs != XS_TYPE_SIZE && ra.xs != XS_TYPE_SIZE)
-							{
-								sf.score(v.data() + 36, la.xs, ra.xs, dist_sqr);
-							}
+							slice_csv << ',' << t;
 						}
+						slice_csv << '\n';
 					}
-					v.back() = lig.flexibility_penalty_factor;
-					const auto rfscore = f(v);
-
-					// Dump ligand result to the slice csv file.
-					slice_csv << idx << ',' << (r.f * lig.flexibility_penalty_factor) << ',' << rfscore;
-					const auto& p = r.conf.position;
-					const auto& q = r.conf.orientation;
-					slice_csv << ',' << p[0] << ',' << p[1] << ',' << p[2] << ',' << q.a << ',' << q.b << ',' << q.c << ',' << q.d;
-					for (const auto t : r.conf.torsions)
+
+					// Report progress.
 					{
-						slice_csv << ',' << t;
+						const scoped_timer timer(slice_profile, PHASE_DATABASE, trace);
+						conn.update(collection, BSON("_id" << _id), BSON("$inc" << BSON(slice_key << 1)));
 					}
-					slice_csv << '\n';
 
-					// Clear the results of the current ligand.
-					results.clear();
+					// Record the ligand with its aggregated counters as a trace event.
+					if (trace.enabled())
+					{
+						const mc_counters& ligand_counters = dr.prof.counters;
+						ostringstream args;
+						args << "{\"index\":" << idx << ",\"heavy_atoms\":" << lig.num_heavy_atoms << ",\"active_torsions\":" << lig.num_active_torsions << ",\"mc_tasks\":" << dr.num_mc_tasks << ",\"mc_iterations\":" << ligand_counters.mc_iterations << ",\"evaluations\":" << ligand_counters.evaluations << ",\"rejected_poses\":" << ligand_counters.rejected_poses << ",\"bfgs_iterations\":" << ligand_counters.bfgs_iterations << ",\"alpha_trials\":" << ligand_counters.alpha_trials << ",\"line_search_failures\":" << ligand_counters.line_search_failures << '}';
+						trace.record("ligand", "ligand", ligand_begin, steady_clock::now(), args.str());
+					}
 				}
-
-				// Report progress.
-				conn.update(collection, BSON("_id" << _id), BSON("$inc" << BSON(slice_key << 1)));
+			}
+			catch (const bad_alloc&)
+			{
+				fail_job("memory is exhausted in docking");
+				continue;
 			}
 
+			const auto num_docked_ligands = slice_profile.num_ligands;
+			if (num_docked_ligands)
+			{
+				cout << local_time() << "Docked " << num_docked_ligands << " ligands with " << sum_mc_tasks / num_docked_ligands << " tasks of " << sum_mc_iterations / num_docked_ligands << " iterations in " << slice_profile.seconds[PHASE_MONTE_CARLO] / num_docked_ligands << " seconds per ligand on average, " << engine.tuner.describe() << endl;
+			}
 			cout << local_time() << "Closing slice csv" << endl;
 			slice_csv.close();
 
+			// Write the counters and timings of the slice, which phase 2 aggregates into those of the job.
+			cout << local_time() << "Writing slice json" << endl;
+			{
+				boost::filesystem::ofstream slice_json(lcl_job_path / (slice_key + ".json"));
+				slice_profile.write(slice_json);
+			}
+			trace.flush();
+
 			// Increment the finished slice counter.
 			cout << local_time() << "Incrementing the finished slice counter" << endl;
 			BSONObj finis_obj;
@@ -517,9 +613,27 @@ int main(int argc, char* argv[])
 
 		// Combine slice csv files. Phase 2 starts here.
 		cout << local_time() << "Combining slice csv files" << endl;
+		profile job_profile; // Counters and timings of the job, aggregated over its slices and phase 2.
+		scoped_timer combining_timer(job_profile, PHASE_SLICE_COMBINING, trace);
 		ptr_vector<summary> summaries(num_ligands);
 		for (size_t s = 0; s < num_slices; ++s)
 		{
+			// Aggregate slice json.
+			const auto slice_json_path = lcl_job_path / (lexical_cast<string>(s) + ".json");
+			if (exists(slice_json_path))
+			{
+				boost::filesystem::ifstream slice_json(slice_json_path);
+				profile p;
+				try
+				{
+					p.read(slice_json);
+					job_profile += p;
+				}
+				catch (...)
+				{
+				}
+			}
+
 			// Parse slice csv.
 			const auto slice_csv_path = lcl_job_path / (lexical_cast<string>(s) + ".csv");
 			for (boost::filesystem::ifstream slice_csv(slice_csv_path); getline(slice_csv, line);)
@@ -556,17 +670,23 @@ int main(int argc, char* argv[])
 			}
 		}
 
+		combining_timer.stop();
+
 		// Sort summaries.
 		const auto num_summaries = summaries.size(); // Number of ligands to be written to hits.csv.gz
 		cout << local_time() << "Sorting " << num_summaries << " ligands" << endl;
+		scoped_timer sorting_timer(job_profile, PHASE_SORTING, trace);
 		summaries.sort();
+		sorting_timer.stop();
 		const auto num_hits = min<size_t>(num_summaries, 1000); // Number of ligands to be written to hits.pdbqt.gz
 		BOOST_ASSERT(num_hits <= num_ligands);
 
 		// Write results for successfully docked ligands.
 		cout << local_time() << "Writing output streams" << endl;
 		stringstream sslog, sslig;
+		try
 		{
+			const scoped_timer timer(job_profile, PHASE_HIT_WRITING, trace);
 			filtering_ostream foslog;
 			filtering_ostream foslig;
 			foslog.push(gzip_compressor());
@@ -620,37 +740,8 @@ int main(int argc, char* argv[])
 					continue;
 				}
 
-				// Create grid maps on the fly if necessary.
-				BOOST_ASSERT(atom_types_to_populate.empty());
-				const vector<size_t> ligand_atom_types = lig.get_atom_types();
-				for (const auto t : ligand_atom_types)
-				{
-					BOOST_ASSERT(t < XS_TYPE_SIZE);
-					array3d<fl>& grid_map = grid_maps[t];
-					if (grid_map.initialized()) continue; // The grid map of XScore atom type t has already been populated.
-					grid_map.resize(b.num_probes); // An exception may be thrown in case memory is exhausted.
-					atom_types_to_populate.push_back(t);  // The grid map of XScore atom type t has not been populated and should be populated now.
-				}
-				if (atom_types_to_populate.size())
-				{
-					cnt.init(num_gm_tasks);
-					for (size_t x = 0; x < num_gm_tasks; ++x)
-					{
-						io.post([&,x]()
-						{
-							grid_map_task(grid_maps, atom_types_to_populate, x, sf, b, rec);
-							cnt.increment();
-						});
-					}
-					cnt.wait();
-					atom_types_to_populate.clear();
-				}
-
 				// Apply conformation.
-				fl e, f;
-				change g(lig.num_active_torsions);
-				lig.evaluate(s.conf, sf, b, grid_maps, -99, e, f, g);
-				const auto r = lig.compose_result(e, f, s.conf);
+				const auto r = engine.compose(lig, s.conf, job_profile);
 
 				// Write models to ligand stream.
 				foslig
@@ -697,12 +788,19 @@ int main(int argc, char* argv[])
 					<< '\n'
 					<< "REMARK 918 IDOCK PROPERTIES:" << setw(8) << xp.mwt << '\n'
 				;
-				lig.write_model(foslig, s, r, b, grid_maps);
+				lig.write_model(foslig, s, r, engine.get_box(), engine.get_grid_maps());
 				foslig << "ENDMDL\n";
 			}
 		}
+		catch (const bad_alloc&)
+		{
+			fail_job("memory is exhausted in writing hits");
+			if (phase2only) return 1;
+			continue;
+		}
 
 		// Write output files remotely via SSH SCP.
+		scoped_timer upload_timer(job_profile, PHASE_UPLOAD, trace);
 		auto curl = curl_easy_init();
 //		curl_easy_setopt(curl, CURLOPT_VERBOSE, 1);
 		curl_easy_setopt(curl, CURLOPT_SSH_AUTH_TYPES, CURLSSH_AUTH_PUBLICKEY);
@@ -721,13 +819,17 @@ int main(int argc, char* argv[])
 		curl_easy_setopt(curl, CURLOPT_READDATA, &sslig);
 		curl_easy_perform(curl);
 		curl_easy_cleanup(curl);
+		upload_timer.stop();
 
 		// Set completed time.
 		cout << local_time() << "Setting completed time" << endl;
+		scoped_timer completed_timer(job_profile, PHASE_DATABASE, trace);
 		const auto millis_since_epoch = duration_cast<chrono::milliseconds>(system_clock::now().time_since_epoch()).count();
 		conn.update(collection, BSON("_id" << _id), BSON("$set" << BSON("completed" << Date_t(millis_since_epoch))));
+		completed_timer.stop();
 
 		// Send a completion notification email.
+		scoped_timer notification_timer(job_profile, PHASE_NOTIFICATION, trace);
 		const auto compt_cursor = conn.query(collection, QUERY("_id" << _id), 1, 0, &compt_fields);
 		const auto compt = compt_cursor->next();
 		const auto email = compt["email"].String();
@@ -749,6 +851,24 @@ int main(int argc, char* argv[])
 		curl_easy_perform(curl);
 		curl_easy_cleanup(curl);
 		curl_slist_free_all(recipients);
+		notification_timer.stop();
+
+		// Write the counters and timings of the job remotely via SSH SCP.
+		cout << local_time() << "Writing profile.json" << endl;
+		stringstream ssprf;
+		job_profile.write(ssprf);
+		curl = curl_easy_init();
+		curl_easy_setopt(curl, CURLOPT_SSH_AUTH_TYPES, CURLSSH_AUTH_PUBLICKEY);
+		curl_easy_setopt(curl, CURLOPT_SSH_PRIVATE_KEYFILE, private_keyfile.c_str());
+		curl_easy_setopt(curl, CURLOPT_SSH_PUBLIC_KEYFILE, public_keyfile.c_str());
+		curl_easy_setopt(curl, CURLOPT_UPLOAD, 1);
+		curl_easy_setopt(curl, CURLOPT_READFUNCTION, read_from_stringstream);
+		curl_easy_setopt(curl, CURLOPT_URL, (rmt_job_path / "profile.json").c_str());
+		curl_easy_setopt(curl, CURLOPT_INFILESIZE, ssprf.tellp());
+		curl_easy_setopt(curl, CURLOPT_READDATA, &ssprf);
+		curl_easy_perform(curl);
+		curl_easy_cleanup(curl);
+		trace.flush();
 
 		// Remove slice csv files.
 		if (summaries.size())
@@ -0,0 +1,99 @@
+#include <sstream>
+#include <fstream>
+#include <iomanip>
+#include <unistd.h>
+#include "memory_governor.hpp"
+
+const fl memory_governor::Max_Grid_Granularity = static_cast<fl>(0.375);
+const size_t memory_governor::Min_Grid_Maps = 6;
+const size_t memory_governor::Headroom_Bytes = 128 << 20;
+
+string memory_plan::strategy_name(const strategy_t s)
+{
+	switch (s)
+	{
+		case coarse: return "coarse";
+		case evicted: return "evicted";
+		default: return "full";
+	}
+}
+
+string memory_plan::describe() const
+{
+	const double mb = 1.0 / (1 << 20);
+	ostringstream oss;
+	oss.setf(ios::fixed, ios::floatfield);
+	oss << strategy_name(strategy) << " strategy of " << max_grid_maps << " grid maps of " << setprecision(1) << grid_map_bytes * mb << " MB at " << setprecision(3) << grid_granularity << " A granularity, "
+		<< setprecision(1) << receptor_bytes * mb << " MB of receptor, " << baseline_bytes * mb << " MB of baseline, " << peak_bytes * mb << " MB of estimated peak out of " << budget_bytes * mb << " MB of budget";
+	if (!fits()) oss << ", over budget";
+	return oss.str();
+}
+
+memory_governor::memory_governor(const size_t budget_bytes) : budget_bytes(budget_bytes)
+{
+}
+
+size_t memory_governor::default_budget()
+{
+	if (const char* const budget_mb = getenv("IDOCK_MEMORY_BUDGET"))
+	{
+		return static_cast<size_t>(atof(budget_mb) * (1 << 20));
+	}
+	return static_cast<size_t>(sysconf(_SC_PHYS_PAGES)) * static_cast<size_t>(sysconf(_SC_PAGESIZE)) / 4 * 3;
+}
+
+size_t memory_governor::resident_bytes()
+{
+	// The second field of /proc/self/statm is the number of resident pages.
+	size_t size = 0, resident = 0;
+	std::ifstream ifs("/proc/self/statm");
+	ifs >> size >> resident;
+	return resident * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+}
+
+size_t memory_governor::footprint(const receptor& rec)
+{
+	size_t bytes = rec.atoms.capacity() * sizeof(atom) + rec.partitions.capacity() * sizeof(vector<size_t>);
+	for (const auto& p : rec.partitions)
+	{
+		bytes += p.capacity() * sizeof(size_t);
+	}
+	return bytes;
+}
+
+memory_plan memory_governor::plan(const box& b, const receptor& rec, const size_t resident_bytes) const
+{
+	// Prefer grid maps of all the atom types at the requested granularity, and coarsen it step by step, each of which halves the number of probes, until all the atom types fit.
+	memory_plan p = plan(b, rec, resident_bytes, b.grid_granularity);
+	for (fl granularity = b.grid_granularity; p.strategy == memory_plan::evicted && granularity < Max_Grid_Granularity;)
+	{
+		granularity = min(granularity * static_cast<fl>(1.26), Max_Grid_Granularity);
+		p = plan(b, rec, resident_bytes, granularity);
+	}
+	return p;
+}
+
+memory_plan memory_governor::plan(const box& b, const receptor& rec, const size_t resident_bytes, const fl grid_granularity) const
+{
+	memory_plan p;
+	p.budget_bytes = budget_bytes;
+	p.receptor_bytes = footprint(rec);
+	p.baseline_bytes = resident_bytes > p.receptor_bytes ? resident_bytes - p.receptor_bytes : 0;
+	const size_t fixed_bytes = p.baseline_bytes + p.receptor_bytes + Headroom_Bytes;
+	const box c(b.center, b.span, grid_granularity);
+	p.grid_granularity = grid_granularity;
+	p.grid_map_bytes = c.num_probes[0] * c.num_probes[1] * c.num_probes[2] * sizeof(fl);
+
+	// Keep grid maps of all the atom types if they fit.
+	p.strategy = grid_granularity == b.grid_granularity ? memory_plan::full : memory_plan::coarse;
+	p.max_grid_maps = XS_TYPE_SIZE;
+	p.peak_bytes = fixed_bytes + p.max_grid_maps * p.grid_map_bytes;
+	if (p.fits()) return p;
+
+	// Keep as many grid maps as fit, but no fewer than Min_Grid_Maps, in which case the plan is over budget and the job must not be docked.
+	p.strategy = memory_plan::evicted;
+	p.max_grid_maps = budget_bytes > fixed_bytes ? (budget_bytes - fixed_bytes) / p.grid_map_bytes : 0;
+	p.max_grid_maps = min<size_t>(max<size_t>(p.max_grid_maps, Min_Grid_Maps), XS_TYPE_SIZE);
+	p.peak_bytes = fixed_bytes + p.max_grid_maps * p.grid_map_bytes;
+	return p;
+}
@@ -0,0 +1,74 @@
+#pragma once
+#ifndef IDOCK_MEMORY_GOVERNOR_HPP
+#define IDOCK_MEMORY_GOVERNOR_HPP
+
+#include <string>
+#include "receptor.hpp"
+
+/// Represents how the grid maps of a job are stored, and the estimated peak memory footprint of the process when docking the job.
+class memory_plan
+{
+public:
+	/// Represents the strategy of storing grid maps, in the order of preference.
+	enum strategy_t
+	{
+		full,    ///< Grid maps of all the XScore atom types at the requested granularity.
+		coarse,  ///< Grid maps of all the XScore atom types at a coarser granularity, at the cost of accuracy.
+		evicted, ///< A limited number of grid maps at the coarsest granularity, or at the granularity fixed for the job, the least recently used of which are evicted and repopulated on demand, at the cost of time.
+	};
+
+	strategy_t strategy; ///< Strategy of storing grid maps.
+	fl grid_granularity; ///< Granularity of grid maps, which is coarser than requested unless the strategy is full.
+	size_t max_grid_maps; ///< Maximum number of grid maps resident at the same time.
+	size_t grid_map_bytes; ///< Size of a grid map in bytes at grid_granularity.
+	size_t receptor_bytes; ///< Size of the receptor atoms and partitions in bytes.
+	size_t baseline_bytes; ///< Resident size of the rest of the process in bytes, e.g. ligand metadata and the precalculated scoring function.
+	size_t peak_bytes; ///< Estimated peak resident size of the process in bytes.
+	size_t budget_bytes; ///< Memory budget of the process in bytes.
+
+	/// Returns the name of a strategy.
+	static string strategy_name(const strategy_t s);
+
+	/// Returns true if the estimated peak footprint is within the budget.
+	bool fits() const
+	{
+		return peak_bytes <= budget_bytes;
+	}
+
+	/// Returns a one-line description of the plan for logging.
+	string describe() const;
+};
+
+/// Estimates the peak memory footprint of a job at load time, and picks the strategy of storing grid maps that fits a per-process memory budget,
+/// so that grid map population does not exhaust memory in the middle of a slice.
+class memory_governor
+{
+public:
+	static const fl Max_Grid_Granularity; ///< Coarsest granularity that grid maps may be coarsened to.
+	static const size_t Min_Grid_Maps; ///< Minimum number of resident grid maps of the evicted strategy, which covers the XScore atom types of almost every ligand.
+	static const size_t Headroom_Bytes; ///< Memory reserved for ligands, Monte Carlo tasks, random forest features and output streams.
+
+	/// Constructs a governor of a memory budget in bytes.
+	explicit memory_governor(const size_t budget_bytes);
+
+	/// Returns the memory budget in MB specified by the IDOCK_MEMORY_BUDGET environment variable, or 3/4 of the physical memory by default, in bytes.
+	static size_t default_budget();
+
+	/// Returns the current resident size of the process in bytes.
+	static size_t resident_bytes();
+
+	/// Returns the size of the atoms and partitions of a receptor in bytes.
+	static size_t footprint(const receptor& rec);
+
+	/// Plans the storage of grid maps of a box, given a receptor parsed for the box and the current resident size of the process, which includes the receptor but no grid maps.
+	/// If the plan coarsens the granularity, the receptor must be parsed again for the coarser box, whose partitions differ. A plan that does not fit must not be docked, because grid map population would exhaust memory.
+	memory_plan plan(const box& b, const receptor& rec, const size_t resident_bytes) const;
+
+	/// Plans the storage of grid maps of a box at a granularity fixed beforehand, e.g. the one recorded by the first slice of a job, so that all the slices dock against grid maps of the same granularity.
+	/// Grid maps of all the atom types are kept if they fit, or as many as fit otherwise.
+	memory_plan plan(const box& b, const receptor& rec, const size_t resident_bytes, const fl grid_granularity) const;
+
+	const size_t budget_bytes; ///< Memory budget of the process in bytes.
+};
+
+#endif
@@ -1,15 +1,15 @@
 #include "monte_carlo_task.hpp"
 
-void monte_carlo_task(ptr_vector<result>& results, const ligand& lig, const size_t seed, const array<fl, num_alphas>& alphas, const scoring_function& sf, const box& b, const vector<array3d<fl>>& grid_maps)
+mc_counters monte_carlo_task(ptr_vector<result>& results, const ligand& lig, const size_t seed, const size_t num_mc_iterations, const array<fl, num_alphas>& alphas, const scoring_function& sf, const box& b, const vector<array3d<fl>>& grid_maps, elite_pool* const pool)
 {
 	// Define constants.
-	const size_t num_mc_iterations = 100 * lig.num_heavy_atoms; ///< The number of iterations correlates to the complexity of ligand.
 	const size_t num_entities  = 2 + lig.num_active_torsions; // Number of entities to mutate.
-	const size_t num_variables = 6 + lig.num_active_torsions; // Number of variables to optimize.
-	const size_t num_alphas = alphas.size(); // Number of precalculated alpha values for determining step size in BFGS.
 	const fl e_upper_bound = static_cast<fl>(4 * lig.num_heavy_atoms); // A conformation will be droped if its free energy is not better than e_upper_bound.
 	const fl required_square_error = static_cast<fl>(1 * lig.num_heavy_atoms); // Ligands with RMSD < 1.0 will be clustered into the same cluster.
 	const fl pi = static_cast<fl>(3.1415926535897932); ///< Pi.
+	const size_t num_exchange_epochs = 8; // Number of times a cooperative task exchanges conformations with the elite pool.
+	const size_t exchange_interval = max<size_t>(1, num_mc_iterations / num_exchange_epochs); // Number of iterations between two consecutive exchanges.
+	const size_t max_stale_epochs = 2; // A cooperative task stops early if neither itself nor the elite pool improves for this number of consecutive epochs.
 
 	// On Linux, the std namespace contains std::mt19937 and std::normal_distribution.
 	// In order to avoid ambiguity, use the complete scope.
@@ -32,6 +32,7 @@ void monte_carlo_task(ptr_vector<result>& results, const ligand& lig, const size
 	fl e0, f0;
 	change g0(lig.num_active_torsions);
 	bool valid_conformation = false;
+	mc_counters counters; // Hot-path counters of this task.
 	for (size_t i = 0; (i < 1000) && (!valid_conformation); ++i)
 	{
 		// Randomize conformation c0.
@@ -42,39 +43,49 @@ void monte_carlo_task(ptr_vector<result>& results, const ligand& lig, const size
 			c0.torsions[i] = uniform_pi_gen();
 		}
 		valid_conformation = lig.evaluate(c0, sf, b, grid_maps, e_upper_bound, e0, f0, g0);
+		++counters.evaluations;
+		if (!valid_conformation) ++counters.rejected_poses;
 	}
-	if (!valid_conformation) return;
+	if (!valid_conformation) return counters;
 	fl best_e = e0; // The best free energy so far.
 
-	// Initialize necessary variables for BFGS.
-	conformation c1(lig.num_active_torsions), c2(lig.num_active_torsions); // c2 = c1 + ap.
-	fl e1, f1, e2, f2;
-	change g1(lig.num_active_torsions), g2(lig.num_active_torsions);
-	change p(lig.num_active_torsions); // Descent direction.
-	fl alpha, pg1, pg2; // pg1 = p * g1. pg2 = p * g2.
-	size_t num_alpha_trials;
-
-	// Initialize the inverse Hessian matrix to identity matrix.
-	// An easier option that works fine in practice is to use a scalar multiple of the identity matrix,
-	// where the scaling factor is chosen to be in the range of the eigenvalues of the true Hessian.
-	// See N&R for a recipe to find this initializer.
-	triangular_matrix<fl> identity_hessian(num_variables, 0); // Symmetric triangular matrix.
-	for (size_t i = 0; i < num_variables; ++i)
-		identity_hessian[triangular_matrix_restrictive_index(i, i)] = 1;
+	// Initialize necessary variables for exchanging conformations with the elite pool.
+	fl last_task_e = e0; // The best free energy of this task at the previous exchange.
+	fl last_pool_e = pool ? pool->best(e0) : e0; // The best free energy of the elite pool at the previous exchange.
+	size_t num_stale_epochs = 0;
 
-	// Initialize necessary variables for updating the Hessian matrix h.
-	triangular_matrix<fl> h(identity_hessian);
-	change y(lig.num_active_torsions); // y = g2 - g1.
-	change mhy(lig.num_active_torsions); // mhy = -h * y.
-	fl yhy, yp, ryp, pco;
+	// Initialize necessary variables for BFGS.
+	conformation c1(lig.num_active_torsions);
+	fl e1, f1;
+	change g1(lig.num_active_torsions);
+	bfgs local_search(lig.num_active_torsions);
 
 	for (size_t mc_i = 0; mc_i < num_mc_iterations; ++mc_i)
 	{
+		++counters.mc_iterations;
+
+		// In cooperative mode, periodically share the best conformation found so far,
+		// and restart from an elite conformation if this task lags behind the others.
+		if (pool && mc_i && (mc_i % exchange_interval == 0))
+		{
+			const fl task_e = results.empty() ? e0 : results.front().e;
+			if (results.size()) pool->offer(results.front().conf, results.front().e);
+			const fl pool_e = pool->best(task_e);
+
+			// Stop early if the search has stagnated both locally and globally.
+			num_stale_epochs = (task_e < last_task_e - epsilon || pool_e < last_pool_e - epsilon) ? 0 : num_stale_epochs + 1;
+			if (num_stale_epochs == max_stale_epochs) break;
+			last_task_e = task_e;
+			last_pool_e = pool_e;
+
+			if (pool->lagging(task_e)) pool->draw(eng, c0, e0);
+		}
+
 		size_t num_mutations = 0;
 		size_t mutation_entity;
 
 		// Mutate c0 into c1, and evaluate c1.
-		do
+		while (true)
 		{
 			// Make a copy, so the previous conformation is retained.
 			c1 = c0;
@@ -96,97 +107,14 @@ void monte_carlo_task(ptr_vector<result>& results, const ligand& lig, const size
 				BOOST_ASSERT(c1.orientation.is_normalized());
 			}
 			++num_mutations;
-		} while (!lig.evaluate(c1, sf, b, grid_maps, e_upper_bound, e1, f1, g1));
-
-		// Initialize the Hessian matrix to identity.
-		h = identity_hessian;
-
-		// Given the mutated conformation c1, use BFGS to find a local minimum.
-		// The conformation of the local minimum is saved to c2, and its derivative is saved to g2.
-		// http://en.wikipedia.org/wiki/BFGS_method
-		// http://en.wikipedia.org/wiki/Quasi-Newton_method
-		// The loop breaks when an appropriate alpha cannot be found.
-		while (true)
-		{
-			// Calculate p = -h*g, where p is for descent direction, h for Hessian, and g for gradient.
-			for (size_t i = 0; i < num_variables; ++i)
-			{
-				fl sum = 0;
-				for (size_t j = 0; j < num_variables; ++j)
-					sum += h[triangular_matrix_permissive_index(i, j)] * g1[j];
-				p[i] = -sum;
-			}
-
-			// Calculate pg = p*g = -h*g^2 < 0
-			pg1 = 0;
-			for (size_t i = 0; i < num_variables; ++i)
-				pg1 += p[i] * g1[i];
-
-			// Perform a line search to find an appropriate alpha.
-			// Try different alpha values for num_alphas times.
-			// alpha starts with 1, and shrinks to alpha_factor of itself iteration by iteration.
-			for (num_alpha_trials = 0; num_alpha_trials < num_alphas; ++num_alpha_trials)
-			{
-				// Obtain alpha from the precalculated alpha values.
-				alpha = alphas[num_alpha_trials];
-
-				// Calculate c2 = c1 + ap.
-				c2.position = c1.position + alpha * vec3(p[0], p[1], p[2]);
-				BOOST_ASSERT(c1.orientation.is_normalized());
-				c2.orientation = qtn4(alpha * vec3(p[3], p[4], p[5])) * c1.orientation;
-				BOOST_ASSERT(c2.orientation.is_normalized());
-				for (size_t i = 0; i < lig.num_active_torsions; ++i)
-				{
-					c2.torsions[i] = c1.torsions[i] + alpha * p[6 + i];
-				}
-
-				// Evaluate c2, subject to Wolfe conditions http://en.wikipedia.org/wiki/Wolfe_conditions
-				// 1) Armijo rule ensures that the step length alpha decreases f sufficiently.
-				// 2) The curvature condition ensures that the slope has been reduced sufficiently.
-				if (lig.evaluate(c2, sf, b, grid_maps, e1 + 0.0001 * alpha * pg1, e2, f2, g2))
-				{
-					pg2 = 0;
-					for (size_t i = 0; i < num_variables; ++i)
-						pg2 += p[i] * g2[i];
-					if (pg2 >= 0.9 * pg1)
-						break; // An appropriate alpha is found.
-				}
-			}
-
-			// If an appropriate alpha cannot be found, exit the BFGS loop.
-			if (num_alpha_trials == num_alphas) break;
-
-			// Update Hessian matrix h.
-			for (size_t i = 0; i < num_variables; ++i) // Calculate y = g2 - g1.
-				y[i] = g2[i] - g1[i];
-			for (size_t i = 0; i < num_variables; ++i) // Calculate mhy = -h * y.
-			{
-				fl sum = 0;
-				for (size_t j = 0; j < num_variables; ++j)
-					sum += h[triangular_matrix_permissive_index(i, j)] * y[j];
-				mhy[i] = -sum;
-			}
-			yhy = 0;
-			for (size_t i = 0; i < num_variables; ++i) // Calculate yhy = -y * mhy = -y * (-hy).
-				yhy -= y[i] * mhy[i];
-			yp = 0;
-			for (size_t i = 0; i < num_variables; ++i) // Calculate yp = y * p.
-				yp += y[i] * p[i];
-			ryp = 1 / yp;
-			pco = ryp * (ryp * yhy + alpha);
-			for (size_t i = 0; i < num_variables; ++i)
-			for (size_t j = i; j < num_variables; ++j) // includes i
-			{
-				h[triangular_matrix_restrictive_index(i, j)] += ryp * (mhy[i] * p[j] + mhy[j] * p[i]) + pco * p[i] * p[j];
-			}
-
-			// Move to the next iteration.
-			c1 = c2;
-			e1 = e2;
-			f1 = f2;
-			g1 = g2;
+			++counters.evaluations;
+			if (lig.evaluate(c1, sf, b, grid_maps, e_upper_bound, e1, f1, g1)) break;
+			++counters.rejected_poses;
 		}
 
+		// Given the mutated conformation c1, use BFGS to find a local minimum, which is saved to c1.
+		local_search(c1, e1, f1, g1, lig, alphas, sf, b, grid_maps, counters);
+
 		// Accept c1 according to Metropolis critera.
 		const fl delta = e0 - e1;
 		if ((delta > 0) || (uniform_01_gen() < exp(delta)))
@@ -204,4 +132,5 @@ void monte_carlo_task(ptr_vector<result>& results, const ligand& lig, const size
 			e0 = e1;
 		}
 	}
+	return counters;
 }
@@ -4,6 +4,9 @@
 
 #include <boost/random.hpp>
 #include "ligand.hpp"
+#include "elite_pool.hpp"
+#include "bfgs.hpp"
+#include "profiler.hpp"
 
 // Choose the appropriate Mersenne Twister engine for random number generation on 32-bit or 64-bit platform.
 #if defined(__x86_64) || defined(__x86_64__) || defined(__amd64) || defined(__amd64__) || defined(_M_X64) || defined(_M_AMD64)
@@ -12,8 +15,6 @@ typedef boost::random::mt19937_64 mt19937eng;
 typedef boost::random::mt19937 mt19937eng;
 #endif
 
-const size_t num_alphas = 5; ///< Number of alpha values for determining step size in BFGS
-
 /// Task for running Monte Carlo Simulated Annealing algorithm to find local minimums of the scoring function.
 /// A Monte Carlo task uses a seed to initialize its own random number generator.
 /// It starts from a random initial conformation,
@@ -21,6 +22,10 @@ const size_t num_alphas = 5; ///< Number of alpha values for determining step si
 /// uses precalculated alpha values for line search during BFGS local search,
 /// clusters free energies and heavy atom coordinate vectors of the best conformations into results,
 /// and sorts the results in the ascending order of free energies.
-void monte_carlo_task(ptr_vector<result>& results, const ligand& lig, const size_t seed, const array<fl, num_alphas>& alphas, const scoring_function& sf, const box& b, const vector<array3d<fl>>& grid_maps);
+/// If an elite pool is given, the task cooperates with the other tasks of the same ligand by periodically
+/// offering its best conformation to the pool and restarting from an elite one whenever it lags behind,
+/// and it stops early once the search has stagnated.
+/// Returns the hot-path counters of the task.
+mc_counters monte_carlo_task(ptr_vector<result>& results, const ligand& lig, const size_t seed, const size_t num_mc_iterations, const array<fl, num_alphas>& alphas, const scoring_function& sf, const box& b, const vector<array3d<fl>>& grid_maps, elite_pool* const pool = nullptr);
 
 #endif
@@ -0,0 +1,148 @@
+#include <atomic>
+#include <boost/property_tree/ptree.hpp>
+#include <boost/property_tree/json_parser.hpp>
+#include "profiler.hpp"
+
+mc_counters& mc_counters::operator+=(const mc_counters& c)
+{
+	mc_iterations += c.mc_iterations;
+	evaluations += c.evaluations;
+	rejected_poses += c.rejected_poses;
+	bfgs_iterations += c.bfgs_iterations;
+	alpha_trials += c.alpha_trials;
+	line_search_failures += c.line_search_failures;
+	return *this;
+}
+
+const char* phase_name(const phase_t phase)
+{
+	static const std::array<const char*, PHASE_SIZE> names =
+	{{
+		"database",
+		"download",
+		"receptor_parsing",
+		"similarity_ranking",
+		"ligand_parsing",
+		"grid_population",
+		"monte_carlo",
+		"pose_refinement",
+		"rf_rescoring",
+		"slice_output",
+		"slice_combining",
+		"sorting",
+		"hit_writing",
+		"upload",
+		"notification",
+	}};
+	return names[phase];
+}
+
+profile::profile()
+{
+	clear();
+}
+
+void profile::clear()
+{
+	num_ligands = 0;
+	grid_map_evictions = 0;
+	counters = mc_counters();
+	seconds.fill(0);
+}
+
+profile& profile::operator+=(const profile& p)
+{
+	num_ligands += p.num_ligands;
+	grid_map_evictions += p.grid_map_evictions;
+	counters += p.counters;
+	for (size_t i = 0; i < PHASE_SIZE; ++i)
+	{
+		seconds[i] += p.seconds[i];
+	}
+	return *this;
+}
+
+void profile::write(ostream& os) const
+{
+	os
+		<< "{\n"
+		<< "\t\"ligands\": " << num_ligands << ",\n"
+		<< "\t\"grid_map_evictions\": " << grid_map_evictions << ",\n"
+		<< "\t\"counters\": {\n"
+		<< "\t\t\"mc_iterations\": " << counters.mc_iterations << ",\n"
+		<< "\t\t\"evaluations\": " << counters.evaluations << ",\n"
+		<< "\t\t\"rejected_poses\": " << counters.rejected_poses << ",\n"
+		<< "\t\t\"bfgs_iterations\": " << counters.bfgs_iterations << ",\n"
+		<< "\t\t\"alpha_trials\": " << counters.alpha_trials << ",\n"
+		<< "\t\t\"line_search_failures\": " << counters.line_search_failures << "\n"
+		<< "\t},\n"
+		<< "\t\"seconds\": {\n";
+	for (size_t i = 0; i < PHASE_SIZE; ++i)
+	{
+		os << "\t\t\"" << phase_name(static_cast<phase_t>(i)) << "\": " << seconds[i] << (i + 1 < PHASE_SIZE ? ",\n" : "\n");
+	}
+	os
+		<< "\t}\n"
+		<< "}\n";
+}
+
+void profile::read(istream& is)
+{
+	using boost::property_tree::ptree;
+	ptree pt;
+	read_json(is, pt);
+	num_ligands = pt.get<size_t>("ligands", 0);
+	grid_map_evictions = pt.get<size_t>("grid_map_evictions", 0);
+	counters.mc_iterations = pt.get<size_t>("counters.mc_iterations", 0);
+	counters.evaluations = pt.get<size_t>("counters.evaluations", 0);
+	counters.rejected_poses = pt.get<size_t>("counters.rejected_poses", 0);
+	counters.bfgs_iterations = pt.get<size_t>("counters.bfgs_iterations", 0);
+	counters.alpha_trials = pt.get<size_t>("counters.alpha_trials", 0);
+	counters.line_search_failures = pt.get<size_t>("counters.line_search_failures", 0);
+	for (size_t i = 0; i < PHASE_SIZE; ++i)
+	{
+		seconds[i] = pt.get<double>(string("seconds.") + phase_name(static_cast<phase_t>(i)), 0);
+	}
+}
+
+tracer::tracer() : enabled_(false), epoch(std::chrono::steady_clock::now())
+{
+}
+
+void tracer::open(const string& path)
+{
+	ofs.open(path);
+	ofs << "[\n";
+	enabled_ = true;
+}
+
+void tracer::record(const char* name, const char* cat, const std::chrono::steady_clock::time_point begin, const std::chrono::steady_clock::time_point end, const string& args)
+{
+	if (!enabled_) return;
+
+	// Number threads in the order of their first events, which is more readable than native thread ids.
+	static atomic<size_t> num_threads(0);
+	thread_local const size_t tid = num_threads++;
+
+	const auto ts = std::chrono::duration_cast<std::chrono::microseconds>(begin - epoch).count();
+	const auto dur = std::chrono::duration_cast<std::chrono::microseconds>(end - begin).count();
+	lock_guard<std::mutex> guard(m);
+	ofs << "{\"name\":\"" << name << "\",\"cat\":\"" << cat << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << tid << ",\"ts\":" << ts << ",\"dur\":" << dur;
+	if (args.size()) ofs << ",\"args\":" << args;
+	ofs << "},\n";
+}
+
+void tracer::flush()
+{
+	if (!enabled_) return;
+	lock_guard<std::mutex> guard(m);
+	ofs.flush();
+}
+
+void scoped_timer::stop()
+{
+	stopped = true;
+	const auto end = std::chrono::steady_clock::now();
+	p.seconds[phase] += std::chrono::duration_cast<std::chrono::duration<double>>(end - begin).count();
+	t.record(phase_name(phase), "phase", begin, end);
+}
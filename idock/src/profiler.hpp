@@ -0,0 +1,133 @@
+#pragma once
+#ifndef IDOCK_PROFILER_HPP
+#define IDOCK_PROFILER_HPP
+
+#include <array>
+#include <string>
+#include <chrono>
+#include <mutex>
+#include <boost/filesystem/fstream.hpp>
+using namespace std;
+
+/// Represents the hot-path counters of Monte Carlo tasks. Each task counts into its own instance, so counting needs no synchronization.
+class mc_counters
+{
+public:
+	size_t mc_iterations; ///< Number of Monte Carlo iterations.
+	size_t evaluations; ///< Number of calls to ligand::evaluate().
+	size_t rejected_poses; ///< Number of conformations refused by ligand::evaluate(), i.e. out of the box or not better than the upper bound.
+	size_t bfgs_iterations; ///< Number of BFGS iterations that found an appropriate alpha and updated the Hessian.
+	size_t alpha_trials; ///< Number of alpha values tried in line searches.
+	size_t line_search_failures; ///< Number of line searches in which no alpha satisfied the Wolfe conditions, each of which ends a local optimization.
+
+	/// Constructs zero counters.
+	mc_counters() : mc_iterations(0), evaluations(0), rejected_poses(0), bfgs_iterations(0), alpha_trials(0), line_search_failures(0) {}
+
+	/// Accumulates the counters of another task.
+	mc_counters& operator+=(const mc_counters& c);
+};
+
+/// Phases of the main loop whose wall time is measured.
+enum phase_t
+{
+	PHASE_DATABASE, ///< MongoDB queries and updates.
+	PHASE_DOWNLOAD, ///< SCP downloads of the box and receptor files.
+	PHASE_RECEPTOR_PARSING, ///< Parsing of the box and receptor files.
+	PHASE_SIMILARITY_RANKING, ///< Ranking of the library by USRCAT similarity to a reference ligand.
+	PHASE_LIGAND_PARSING, ///< Parsing of ligands.
+	PHASE_GRID_POPULATION, ///< Population of grid maps.
+	PHASE_MONTE_CARLO, ///< Monte Carlo tasks and merging of their results.
+	PHASE_POSE_REFINEMENT, ///< Scoring and local optimization of given poses.
+	PHASE_RF_RESCORING, ///< Random forest rescoring.
+	PHASE_SLICE_OUTPUT, ///< Writing of slice csv files.
+	PHASE_SLICE_COMBINING, ///< Parsing of slice csv files in phase 2.
+	PHASE_SORTING, ///< Sorting of ligand summaries in phase 2.
+	PHASE_HIT_WRITING, ///< Writing of hits.csv.gz and hits.pdbqt.gz streams in phase 2.
+	PHASE_UPLOAD, ///< SCP uploads of output files in phase 2.
+	PHASE_NOTIFICATION, ///< Completion notification email.
+	PHASE_SIZE ///< Number of phases.
+};
+
+/// Returns the name of a phase as used in JSON summaries and traces.
+const char* phase_name(const phase_t phase);
+
+/// Represents the counters and phase timings aggregated over ligands, a slice, or a job.
+class profile
+{
+public:
+	size_t num_ligands; ///< Number of ligands docked.
+	size_t grid_map_evictions; ///< Number of grid maps evicted to stay within the memory budget, each of which is repopulated when used again.
+	mc_counters counters; ///< Aggregated Monte Carlo counters.
+	std::array<double, PHASE_SIZE> seconds; ///< Wall time of each phase in seconds.
+
+	/// Constructs an empty profile.
+	profile();
+
+	/// Resets the profile to empty.
+	void clear();
+
+	/// Accumulates another profile.
+	profile& operator+=(const profile& p);
+
+	/// Writes the profile as a JSON object.
+	void write(ostream& os) const;
+
+	/// Reads a profile previously written as a JSON object. Missing entries are taken as zero.
+	void read(istream& is);
+};
+
+/// Writes Chrome trace events, viewable in chrome://tracing, to a file. Tracing is disabled unless a file is opened.
+/// Events are written in the JSON array format, which tolerates an unterminated array, so that a trace of a daemon that never exits remains readable.
+class tracer
+{
+public:
+	/// Constructs a disabled tracer.
+	tracer();
+
+	/// Opens a trace file and enables tracing.
+	void open(const string& path);
+
+	/// Returns true if tracing is enabled.
+	bool enabled() const
+	{
+		return enabled_;
+	}
+
+	/// Records a complete event named name of category cat from begin to end on the calling thread. args is either empty or a JSON object.
+	void record(const char* name, const char* cat, const std::chrono::steady_clock::time_point begin, const std::chrono::steady_clock::time_point end, const string& args = string());
+
+	/// Flushes recorded events to the file.
+	void flush();
+
+private:
+	bool enabled_; ///< True if a trace file is open.
+	std::chrono::steady_clock::time_point epoch; ///< Time origin of event timestamps.
+	boost::filesystem::ofstream ofs; ///< Trace file.
+	std::mutex m; ///< Guards ofs against concurrent recording.
+};
+
+/// Measures the wall time of a scope, adds it to a phase of a profile, and records it as a trace event if tracing is enabled.
+class scoped_timer
+{
+public:
+	/// Starts timing a phase.
+	explicit scoped_timer(profile& p, const phase_t phase, tracer& t) : p(p), phase(phase), t(t), begin(std::chrono::steady_clock::now()), stopped(false) {}
+
+	/// Stops timing the phase if it has not been stopped yet.
+	~scoped_timer()
+	{
+		if (!stopped) stop();
+	}
+
+	/// Stops timing the phase before the end of the scope, e.g. when the timed statements declare variables used afterwards.
+	void stop();
+
+private:
+	profile& p;
+	const phase_t phase;
+	tracer& t;
+	const std::chrono::steady_clock::time_point begin;
+	bool stopped;
+};
+
+#endif
@@ -1,3 +1,4 @@
+#include "cpu_dispatch.hpp"
 #include "random_forest_test.hpp"
 
 void node::load(ifstream& ifs)
@@ -50,12 +51,33 @@ void forest::load(ifstream& ifs)
 	}
 }
 
-float forest::operator()(const vector<float>& x) const
+/// Predicts the y value of the given sample x with the baseline instruction set. The variants for higher instruction set levels inline this body.
+static inline float predict_generic(const forest& f, const vector<float>& x)
 {
 	float y = 0;
-	for (const tree& t : *this)
+	for (const tree& t : f)
 	{
 		y += t(x);
 	}
-	return y /= size();
+	return y /= f.size();
+}
+
+static IDOCK_TARGET_AVX2 float predict_avx2(const forest& f, const vector<float>& x)
+{
+	return predict_generic(f, x);
+}
+
+static IDOCK_TARGET_AVX512 float predict_avx512(const forest& f, const vector<float>& x)
+{
+	return predict_generic(f, x);
+}
+
+float forest::operator()(const vector<float>& x) const
+{
+	switch (active_isa)
+	{
+		case ISA_AVX512: return predict_avx512(*this, x);
+		case ISA_AVX2: return predict_avx2(*this, x);
+		default: return predict_generic(*this, x);
+	}
 }
@@ -0,0 +1,95 @@
+#include <sstream>
+#include "search_budget.hpp"
+
+const size_t budget_tuner::Default_Num_MC_Tasks = 64;
+const size_t budget_tuner::Max_Num_MC_Tasks = 256;
+
+budget_tuner::budget_tuner(const size_t num_threads) : policy(fixed), thoroughness(1), target_seconds(0), num_threads(max<size_t>(1, num_threads)), seconds_per_cost(2e-7)
+{
+}
+
+budget_tuner::policy_t budget_tuner::parse_policy(const string& name)
+{
+	if (name == "quality") return quality;
+	if (name == "time") return time;
+	return fixed;
+}
+
+string budget_tuner::policy_name(const policy_t p)
+{
+	switch (p)
+	{
+		case quality: return "quality";
+		case time: return "time";
+		default: return "fixed";
+	}
+}
+
+void budget_tuner::configure(const policy_t policy, const fl thoroughness, const fl target_seconds)
+{
+	this->policy = policy;
+	this->thoroughness = thoroughness > 0 ? thoroughness : 1;
+	this->target_seconds = target_seconds > 0 ? target_seconds : 0;
+
+	// Without a target wall time, the time policy is meaningless.
+	if (this->policy == time && this->target_seconds == 0) this->policy = fixed;
+}
+
+fl budget_tuner::iteration_cost(const ligand& lig)
+{
+	// An iteration mutates and locally optimizes a conformation with BFGS, whose number of line searches grows with the number of variables,
+	// and each evaluation of which loops over the heavy atoms.
+	return static_cast<fl>(lig.num_heavy_atoms * (6 + lig.num_active_torsions));
+}
+
+size_t budget_tuner::num_waves(const size_t num_mc_tasks) const
+{
+	return (num_mc_tasks + num_threads - 1) / num_threads;
+}
+
+search_budget budget_tuner::operator()(const ligand& lig) const
+{
+	// The number of iterations of the fixed policy correlates to the complexity of ligand.
+	const size_t fixed_iterations = 100 * lig.num_heavy_atoms;
+	if (policy == fixed) return search_budget(Default_Num_MC_Tasks, fixed_iterations);
+
+	// Round the number of tasks to whole waves of worker threads, so that no thread idles while the last wave of a ligand is running.
+	const size_t max_waves = max<size_t>(1, Max_Num_MC_Tasks / num_threads);
+	const size_t min_iterations = 10 * lig.num_heavy_atoms;
+	const size_t max_iterations = 1000 * lig.num_heavy_atoms;
+	if (policy == quality)
+	{
+		const size_t waves = min(max_waves, max<size_t>(1, static_cast<size_t>(Default_Num_MC_Tasks * thoroughness / num_threads + 0.5)));
+		const size_t iterations = static_cast<size_t>(fixed_iterations * thoroughness * (1 + static_cast<fl>(lig.num_active_torsions) / 10));
+		return search_budget(waves * num_threads, min(max_iterations, max(min_iterations, iterations)));
+	}
+
+	// Keep the default breadth of search, and spend the target wall time on as many iterations per task as possible.
+	// If that leaves too few iterations per task, trade breadth for depth by dropping waves.
+	const fl wave_seconds_per_iteration = seconds_per_cost * iteration_cost(lig);
+	size_t waves = min(max_waves, max<size_t>(1, (Default_Num_MC_Tasks + num_threads / 2) / num_threads));
+	size_t iterations = static_cast<size_t>(target_seconds / (waves * wave_seconds_per_iteration));
+	while (waves > 1 && iterations < fixed_iterations)
+	{
+		iterations = static_cast<size_t>(target_seconds / (--waves * wave_seconds_per_iteration));
+	}
+	return search_budget(waves * num_threads, min(max_iterations, max(min_iterations, iterations)));
+}
+
+void budget_tuner::record(const ligand& lig, const search_budget& sb, const fl seconds)
+{
+	// The moving average smooths out ligands whose tasks stop early or fail to find a valid initial conformation.
+	if (seconds <= 0 || !sb.num_mc_iterations) return;
+	const fl sample = seconds / (num_waves(sb.num_mc_tasks) * sb.num_mc_iterations * iteration_cost(lig));
+	seconds_per_cost = 0.9 * seconds_per_cost + 0.1 * sample;
+}
+
+string budget_tuner::describe() const
+{
+	ostringstream oss;
+	oss << "policy = " << policy_name(policy) << ", threads = " << num_threads;
+	if (policy == quality) oss << ", thoroughness = " << thoroughness;
+	if (policy == time) oss << ", target = " << target_seconds << " s/ligand";
+	oss << ", cost model = " << seconds_per_cost << " s/unit";
+	return oss.str();
+}
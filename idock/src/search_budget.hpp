@@ -0,0 +1,69 @@
+#pragma once
+#ifndef IDOCK_SEARCH_BUDGET_HPP
+#define IDOCK_SEARCH_BUDGET_HPP
+
+#include "ligand.hpp"
+
+/// Represents the number of Monte Carlo tasks and the number of iterations per task spent on docking a ligand.
+class search_budget
+{
+public:
+	size_t num_mc_tasks; ///< Number of Monte Carlo tasks.
+	size_t num_mc_iterations; ///< Number of iterations per Monte Carlo task.
+
+	/// Constructs a search budget.
+	explicit search_budget(const size_t num_mc_tasks, const size_t num_mc_iterations) : num_mc_tasks(num_mc_tasks), num_mc_iterations(num_mc_iterations) {}
+};
+
+/// Picks search budgets from hardware concurrency and ligand complexity according to a per-job tuning policy.
+class budget_tuner
+{
+public:
+	/// Represents the policy of tuning search budgets.
+	enum policy_t
+	{
+		fixed,   ///< 64 tasks of 100 iterations per heavy atom, regardless of the machine and of the ligand flexibility.
+		quality, ///< Whole waves of tasks and iterations scaled by ligand flexibility, both multiplied by a thoroughness factor.
+		time,    ///< Whole waves of tasks and as many iterations as fit into a target wall time per ligand.
+	};
+
+	static const size_t Default_Num_MC_Tasks; ///< Number of tasks of the fixed policy.
+	static const size_t Max_Num_MC_Tasks; ///< Upper bound of the number of tasks of any policy.
+
+	/// Constructs a tuner for a machine of num_threads worker threads with the fixed policy.
+	explicit budget_tuner(const size_t num_threads);
+
+	/// Parses a policy name, i.e. "fixed", "quality" or "time". Unknown names fall back to the fixed policy.
+	static policy_t parse_policy(const string& name);
+
+	/// Returns the name of a policy.
+	static string policy_name(const policy_t p);
+
+	/// Sets the tuning policy of the current job. The target wall time is in seconds per ligand.
+	void configure(const policy_t policy, const fl thoroughness, const fl target_seconds);
+
+	/// Returns the search budget of a ligand under the current policy.
+	search_budget operator()(const ligand& lig) const;
+
+	/// Records the measured wall time of docking a ligand with a given budget, so as to refine the cost model of the time policy.
+	void record(const ligand& lig, const search_budget& sb, const fl seconds);
+
+	/// Returns a one-line description of the current policy and cost model for logging.
+	string describe() const;
+
+	policy_t policy; ///< Tuning policy of the current job.
+	fl thoroughness; ///< Multiplier of the quality policy.
+	fl target_seconds; ///< Target wall time per ligand of the time policy.
+
+private:
+	/// Returns the cost units of one iteration of a Monte Carlo task, which grows with both the number of heavy atoms and the number of variables to optimize.
+	static fl iteration_cost(const ligand& lig);
+
+	/// Returns the number of waves needed to run a number of tasks on the worker threads.
+	size_t num_waves(const size_t num_mc_tasks) const;
+
+	const size_t num_threads; ///< Number of worker threads.
+	fl seconds_per_cost; ///< Exponential moving average of the wall time per cost unit of one iteration, measured per wave.
+};
+
+#endif
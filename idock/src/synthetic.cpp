@@ -0,0 +1,100 @@
+#include <sstream>
+#include <cstdio>
+#include "monte_carlo_task.hpp"
+#include "synthetic.hpp"
+
+string pdbqt_atom(const size_t serial, const string& name, const size_t residue, const vec3& coordinate, const string& ad_type)
+{
+	char line[81];
+	snprintf(line, sizeof(line), "ATOM  %5zu %-4s LIG A%4zu    %8.3f%8.3f%8.3f  1.00  0.00     0.000 %-2s", serial, name.c_str(), residue, coordinate[0], coordinate[1], coordinate[2], ad_type.c_str());
+	return line;
+}
+
+string synthetic_receptor(const box& b, const size_t seed)
+{
+	// Grid map probes are affected by receptor atoms within the cutoff of the scoring function, i.e. 8 A.
+	const fl margin = 8;
+	const fl density = 0.05; // Heavy atoms per cubic A in a typical protein.
+	const fl cavity_radius = 0.25 * min(min(b.span[0], b.span[1]), b.span[2]);
+	const vec3 lower(b.corner1[0] - margin, b.corner1[1] - margin, b.corner1[2] - margin);
+	const vec3 upper(b.corner2[0] + margin, b.corner2[1] + margin, b.corner2[2] + margin);
+	const size_t num_atoms = static_cast<size_t>(density * (upper[0] - lower[0]) * (upper[1] - lower[1]) * (upper[2] - lower[2]));
+
+	// Mimic the composition of protein heavy atoms.
+	const std::array<const char*, 10> ad_types = {{ "C", "C", "C", "C", "C", "A", "N", "NA", "OA", "SA" }};
+	mt19937eng eng(seed);
+	boost::random::uniform_real_distribution<fl> u01(0, 1);
+	ostringstream oss;
+	for (size_t i = 0; i < num_atoms;)
+	{
+		const vec3 c(lower[0] + (upper[0] - lower[0]) * u01(eng), lower[1] + (upper[1] - lower[1]) * u01(eng), lower[2] + (upper[2] - lower[2]) * u01(eng));
+		if (distance_sqr(c, b.center) < cavity_radius * cavity_radius) continue;
+		oss << pdbqt_atom(i + 1, "X", i >> 3, c, ad_types[i % ad_types.size()]) << '\n';
+		++i;
+	}
+	return oss.str();
+}
+
+string synthetic_ligand(const size_t num_heavy_atoms)
+{
+	// Consecutive atoms on a helix of radius 2.4 A, 36 degrees and 0.22 A apart are bonded at 1.5 A, and turns are 2.2 A apart, so no other atom pair is bonded.
+	const size_t frame_size = 4;
+	const fl radius = 2.4;
+	const fl theta = static_cast<fl>(3.1415926535897932 / 5);
+	const fl rise = 0.22;
+	const fl half_height = 0.5 * rise * (num_heavy_atoms - 1);
+	const size_t num_torsions = (num_heavy_atoms - 1) / frame_size;
+	ostringstream oss;
+	oss << "ROOT\n";
+	for (size_t i = 0; i < num_heavy_atoms; ++i)
+	{
+		if (i && i % frame_size == 0)
+		{
+			if (i == frame_size) oss << "ENDROOT\n";
+			char line[16];
+			snprintf(line, sizeof(line), "BRANCH %3zu %3zu", i, i + 1);
+			oss << line << '\n';
+		}
+		const char* const ad_type = i % 7 == 3 ? "N" : i % 5 == 2 ? "OA" : "C";
+		oss << pdbqt_atom(i + 1, ad_type + to_string(i + 1), 1, vec3(radius * cos(theta * i), radius * sin(theta * i), rise * i - half_height), ad_type) << '\n';
+	}
+	if (!num_torsions) oss << "ENDROOT\n";
+	for (size_t k = num_torsions; k; --k)
+	{
+		char line[19];
+		snprintf(line, sizeof(line), "ENDBRANCH %3zu %3zu", k * frame_size, k * frame_size + 1);
+		oss << line << '\n';
+	}
+	oss << "TORSDOF " << num_torsions << '\n';
+	return oss.str();
+}
+
+void synthetic_forest(forest& f, const size_t num_trees, const size_t depth, const size_t seed)
+{
+	mt19937eng eng(seed);
+	boost::random::uniform_int_distribution<size_t> vars(0, 41);
+	boost::random::uniform_int_distribution<int> vals(0, 200);
+	boost::random::uniform_real_distribution<float> ys(2, 12);
+	const size_t num_internal_nodes = (static_cast<size_t>(1) << depth) - 1;
+	f.resize(num_trees);
+	for (auto& t : f)
+	{
+		t.resize(2 * num_internal_nodes + 1);
+		for (size_t k = 0; k < t.size(); ++k)
+		{
+			node& n = t[k];
+			if (k < num_internal_nodes)
+			{
+				n.var = vars(eng);
+				n.val = static_cast<float>(vals(eng));
+				n.children[0] = 2 * k + 1;
+				n.children[1] = 2 * k + 2;
+			}
+			else
+			{
+				n.y = ys(eng);
+				n.children[0] = n.children[1] = 0;
+			}
+		}
+	}
+}
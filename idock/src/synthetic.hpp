@@ -0,0 +1,22 @@
+#pragma once
+#ifndef IDOCK_SYNTHETIC_HPP
+#define IDOCK_SYNTHETIC_HPP
+
+#include "box.hpp"
+#include "random_forest_test.hpp"
+
+/// Returns a PDBQT ATOM line.
+string pdbqt_atom(const size_t serial, const string& name, const size_t residue, const vec3& coordinate, const string& ad_type);
+
+/// Returns a reproducible PDBQT receptor whose atoms of mixed AutoDock types fill the box and its 8 A margin at protein-like density,
+/// except for a spherical cavity at the box center whose diameter is half of the shortest box dimension.
+string synthetic_receptor(const box& b, const size_t seed);
+
+/// Returns a reproducible PDBQT ligand of num_heavy_atoms heavy atoms along a compact helix centered at the origin,
+/// with a rotatable bond after every 4 heavy atoms, i.e. about num_heavy_atoms / 4 active torsions.
+string synthetic_ligand(const size_t num_heavy_atoms);
+
+/// Fills a forest with complete binary trees of the given depth, with random splits over the 42 RF-Score features and random leaf values.
+void synthetic_forest(forest& f, const size_t num_trees, const size_t depth, const size_t seed);
+
+#endif
@@ -0,0 +1,110 @@
+#include "usrcat.hpp"
+
+std::array<double, num_usrcat_features> usrcat_features(const ligand& lig)
+{
+	const size_t num_subsets = 5;
+	const size_t num_references = 4;
+
+	// Obtain the heavy atom coordinates of the input conformation.
+	const result r = lig.compose_result(0, 0, lig.input_conformation());
+	const vector<vec3>& coordinates = r.heavy_atoms;
+
+	// Classify heavy atoms into subsets.
+	std::array<vector<size_t>, num_subsets> subsets;
+	for (size_t i = 0; i < lig.num_heavy_atoms; ++i)
+	{
+		const atom& a = lig.heavy_atoms[i];
+		subsets[0].push_back(i);
+		if (a.xs == XS_TYPE_C_H || a.xs == XS_TYPE_S_P || a.xs == XS_TYPE_Cl_H || a.xs == XS_TYPE_Br_H || a.xs == XS_TYPE_I_H) subsets[1].push_back(i);
+		if (a.ad == AD_TYPE_A) subsets[2].push_back(i);
+		if (xs_is_acceptor(a.xs) || a.xs == XS_TYPE_F_H) subsets[3].push_back(i);
+		if (xs_is_donor(a.xs) && a.xs != XS_TYPE_Met_D) subsets[4].push_back(i);
+	}
+
+	// Calculate the four reference points, i.e. the centroid, the closest atom to centroid, the farthest atom to centroid, and the farthest atom to the farthest atom.
+	std::array<vec3, num_references> references;
+	vec3 ctd = zero3;
+	for (const auto& c : coordinates) ctd += c;
+	ctd = (static_cast<fl>(1) / coordinates.size()) * ctd;
+	references[0] = ctd;
+	fl cst_dist = numeric_limits<fl>::max(), fct_dist = numeric_limits<fl>::lowest(), ftf_dist = numeric_limits<fl>::lowest();
+	for (const auto& c : coordinates)
+	{
+		const fl d = distance_sqr(c, ctd);
+		if (d < cst_dist)
+		{
+			references[1] = c;
+			cst_dist = d;
+		}
+		if (d > fct_dist)
+		{
+			references[2] = c;
+			fct_dist = d;
+		}
+	}
+	for (const auto& c : coordinates)
+	{
+		const fl d = distance_sqr(c, references[2]);
+		if (d > ftf_dist)
+		{
+			references[3] = c;
+			ftf_dist = d;
+		}
+	}
+
+	// Calculate the mean, the standard deviation and the cube root of the third central moment of the distances of each subset to each reference point.
+	std::array<double, num_usrcat_features> features;
+	size_t o = 0;
+	for (const auto& subset : subsets)
+	{
+		const size_t n = subset.size();
+		for (const auto& reference : references)
+		{
+			vector<double> dists(n);
+			for (size_t i = 0; i < n; ++i)
+			{
+				dists[i] = sqrt(distance_sqr(coordinates[subset[i]], reference));
+			}
+			std::array<double, 3> m = {{ 0, 0, 0 }};
+			if (n > 2)
+			{
+				const double v = 1.0 / n;
+				for (const auto d : dists) m[0] += d;
+				m[0] *= v;
+				for (const auto d : dists) m[1] += (d - m[0]) * (d - m[0]);
+				m[1] = sqrt(m[1] * v);
+				for (const auto d : dists) m[2] += (d - m[0]) * (d - m[0]) * (d - m[0]);
+				m[2] = cbrt(m[2] * v);
+			}
+			else if (n == 2)
+			{
+				m[0] = 0.5 *     (dists[0] + dists[1]);
+				m[1] = 0.5 * fabs(dists[0] - dists[1]);
+			}
+			else if (n == 1)
+			{
+				m[0] = dists[0];
+			}
+			for (const auto e : m)
+			{
+				features[o++] = e;
+			}
+		}
+	}
+	BOOST_ASSERT(o == num_usrcat_features);
+	return features;
+}
+
+void usrcat_score(const double* const q, const double* const l, double& s0, double& s1)
+{
+	s0 = 0;
+	for (size_t i = 0; i < 12; ++i)
+	{
+		s0 += fabs(q[i] - l[i]);
+	}
+	s1 = s0;
+	for (size_t i = 12; i < num_usrcat_features; ++i)
+	{
+		s1 += fabs(q[i] - l[i]);
+	}
+}
@@ -0,0 +1,19 @@
+#pragma once
+#ifndef IDOCK_USRCAT_HPP
+#define IDOCK_USRCAT_HPP
+
+#include "ligand.hpp"
+
+const size_t num_usrcat_features = 60; ///< Number of USRCAT features, i.e. 3 moments of the distances of 5 atom subsets to 4 reference points.
+
+/// Computes the USRCAT features of a ligand in its input conformation, in the layout of the usrcat.f64 files of the usr daemon.
+/// The pharmacophoric subsets, i.e. heavy, hydrophobic, aromatic, acceptor and donor atoms, are derived from AutoDock and XScore atom types
+/// instead of SMARTS patterns, so they approximate those of the usr daemon. The first 12 features, i.e. USR, depend on heavy atoms only and are exact.
+/// The 16_usrcat.f64 file of the library must therefore be generated by idock_featurize with this function too, so that reference and library features agree.
+std::array<double, num_usrcat_features> usrcat_features(const ligand& lig);
+
+/// Computes the USR score s0 over the first 12 features and the USRCAT score s1 over all the 60 features, i.e. the Manhattan distances between query q and ligand l.
+/// The smaller, the more similar.
+void usrcat_score(const double* const q, const double* const l, double& s0, double& s1);
+
+#endif
@@ -0,0 +1,216 @@
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include "alignment.hpp"
+
+/// The distance of the cells outside the band or beyond the sequence.
+static const unsigned int infinity = 0x7fffffff;
+
+/// Represents a run of matching ending positions of the same occurrence.
+struct cluster
+{
+	size_t first;	/**< Index of the first position of the run into the valid positions. */
+	size_t last;	/**< Index one beyond the last position of the run. */
+	unsigned int alignment_begin;	/**< Index of the first character that alignments of the run may cover, i.e. the first character of its sequence, or the one after the gap preceding it. */
+};
+
+/// Returns true if character i of a pattern matches a 2-bit character.
+static inline bool matches_character(const agrep_pattern& p, const unsigned int i, const unsigned int c)
+{
+	const unsigned long long mask = p.word_mask_arrays.empty() ? p.mask_array[c] : p.word_mask_arrays[i >> 6][c];
+	return !((mask >> (i & 63)) & 1);
+}
+
+/// Aligns a pattern to the genome characters ending at a position by dynamic programming in a band of diagonals, anchored at the position and free at the beginning.
+class banded_aligner
+{
+public:
+	/**
+	 * Constructs an aligner of a pattern.
+	 * @param[in] g The genome.
+	 * @param[in] p The pattern.
+	 * @param[in] band Number of diagonals on either side of the main diagonal.
+	 */
+	explicit banded_aligner(const genome& g, const agrep_pattern& p, const unsigned int band) : g(g), p(p), band(band), width(2 * band + 1), text(p.m + band + 1)
+	{
+	}
+
+	/**
+	 * Align the pattern to the genome characters ending at a position, and keep the matrix for traceback.
+	 * @param[in] end The ending position.
+	 * @param[in] alignment_begin The first character that the alignment may cover, so that it covers neither the previous sequence nor a gap.
+	 * @return The distance of the best alignment.
+	 */
+	unsigned int align(const unsigned int end, const unsigned int alignment_begin)
+	{
+		const unsigned int m = p.m;
+		this->end = end;
+		max_j = min(end - alignment_begin + 1, m + band);
+		for (unsigned int j = 1; j <= max_j; ++j) text[j] = g.character(end - j + 1);
+
+		// Row i holds the distances of the last i pattern characters to the last j genome characters up to the ending position, for j within band of i.
+		d.assign(static_cast<size_t>(m + 1) * width, infinity);
+		for (unsigned int j = 0; j <= min(band, max_j); ++j) cell(0, j) = j;
+		for (unsigned int i = 1; i <= m; ++i)
+		{
+			const unsigned int x = m - i;	// The pattern character of row i.
+			for (unsigned int j = i > band ? i - band : 0; j <= min(i + band, max_j); ++j)
+			{
+				unsigned int distance = infinity;
+				if (j && cell(i - 1, j - 1) != infinity) distance = cell(i - 1, j - 1) + !matches_character(p, x, text[j]);
+				if (j < i + band) distance = min(distance, cell(i - 1, j) + 1);
+				if (j && j - 1 + band >= i) distance = min(distance, cell(i, j - 1) + 1);
+				cell(i, j) = distance;
+			}
+		}
+
+		// Choose the number of genome characters of the least distance, preferring the fewest insertions and deletions.
+		best_j = infinity;
+		for (unsigned int j = m > band ? m - band : 0; j <= min(m + band, max_j); ++j)
+		{
+			if (best_j == infinity || cell(m, j) < cell(m, best_j) || (cell(m, j) == cell(m, best_j) && (j > m ? j - m : m - j) < (best_j > m ? best_j - m : m - best_j))) best_j = j;
+		}
+		return cell(m, best_j);
+	}
+
+	/// Returns the occurrence of the last alignment, whose CIGAR string is traced back from its matrix.
+	occurrence trace() const
+	{
+		occurrence o;
+		o.begin = end - best_j + 1;
+		o.end = end;
+		o.distance = cell(p.m, best_j);
+		char run_op = 0;
+		unsigned int run_length = 0;
+		const auto emit = [&](const char op)
+		{
+			if (op != run_op && run_length)
+			{
+				o.cigar += to_string(run_length) + run_op;
+				run_length = 0;
+			}
+			run_op = op;
+			++run_length;
+		};
+		unsigned int i = p.m, j = best_j;
+		while (i || j)
+		{
+			const bool match = i && j && matches_character(p, p.m - i, text[j]);
+			if (i && j && cell(i - 1, j - 1) != infinity && cell(i - 1, j - 1) + !match == cell(i, j))
+			{
+				emit(match ? '=' : 'X');
+				--i;
+				--j;
+			}
+			else if (i && j < i + band && cell(i - 1, j) + 1 == cell(i, j))
+			{
+				emit('I');
+				--i;
+			}
+			else
+			{
+				emit('D');
+				--j;
+			}
+		}
+		if (run_length) o.cigar += to_string(run_length) + run_op;
+		return o;
+	}
+
+private:
+	const genome& g;	/**< The genome. */
+	const agrep_pattern& p;	/**< The pattern. */
+	const unsigned int band;	/**< Number of diagonals on either side of the main diagonal. */
+	const unsigned int width;	/**< Number of cells of a row. */
+	vector<unsigned int> text;	/**< The genome characters backwards from the ending position, from index 1 onwards. */
+	vector<unsigned int> d;	/**< The band of the dynamic programming matrix. */
+	unsigned int end;	/**< The ending position of the last alignment. */
+	unsigned int max_j;	/**< Number of genome characters available to the last alignment. */
+	unsigned int best_j;	/**< Number of genome characters of the last alignment. */
+
+	/// Returns the cell of row i and column j, which must be within the band.
+	unsigned int& cell(const unsigned int i, const unsigned int j)
+	{
+		return d[static_cast<size_t>(i) * width + j + band - i];
+	}
+
+	/// Returns the cell of row i and column j, which must be within the band.
+	unsigned int cell(const unsigned int i, const unsigned int j) const
+	{
+		return d[static_cast<size_t>(i) * width + j + band - i];
+	}
+};
+
+vector<occurrence> align_matches(const genome& g, const agrep_pattern& p, const vector<unsigned int>& matches, const unsigned int num_threads)
+{
+	unsigned int begin = 0;
+	return align_matches(g, p, matches, num_threads, begin, MAX_UNSIGNED_INT);
+}
+
+vector<occurrence> align_matches(const genome& g, const agrep_pattern& p, const vector<unsigned int>& matches, const unsigned int num_threads, unsigned int& begin, const unsigned int end)
+{
+	const unsigned int m = p.m;
+	const unsigned int band = p.hamming ? 0 : p.k;
+	const unsigned int min_span = p.hamming ? m : max(m - p.k, 1u);	// Every alignment of a match covers at least the last min_span characters up to its ending position.
+
+	// Discard the invalid matches, and group the rest into clusters. The matches are in ascending order, so the sequence index only moves forward.
+	vector<unsigned int> valid;
+	vector<cluster> clusters;
+	unsigned int sequence = 0;
+	for (const auto match : matches)
+	{
+		if (match < begin) continue; // The current match belongs to a run of the previous chunk.
+		if (match >= g.character_count) break; // The kernel may report the position right after the last character, which reads padding.
+		while (match >= g.sequence_cumulative_length[sequence + 1]) ++sequence; // Now sequence is the sequence index of match.
+		const unsigned int sequence_begin = g.sequence_cumulative_length[sequence];
+		if (match + 1 < sequence_begin + min_span) continue; // The current match must be across two consecutive sequences. It is thus an invalid matching.
+		if (g.overlaps_gap(match + 1 - min_span, match + 1)) continue; // The current match overlaps a run of N, which is stored as G. It is thus an invalid matching too.
+		const unsigned int alignment_begin = max(sequence_begin, g.gap_end(match + 1 - min_span)); // Alignments must not extend into a preceding run of N either, as N is stored as G and would match as such.
+		if (clusters.empty() || clusters.back().alignment_begin != alignment_begin || match != valid.back() + 1 || match - valid[clusters.back().first] > 2 * band)
+		{
+			if (match >= end) break; // The current match begins a run of the next chunk.
+			clusters.push_back({ valid.size(), valid.size() + 1, alignment_begin });
+		}
+		else
+		{
+			++clusters.back().last;
+		}
+		valid.push_back(match);
+	}
+	if (!clusters.empty()) begin = valid.back() + 1;
+
+	// Align the clusters in parallel, each at the position of the least distance.
+	vector<occurrence> occurrences(clusters.size());
+	atomic<size_t> next_cluster(0);
+	const auto align_clusters = [&]()
+	{
+		banded_aligner aligners[2] = { banded_aligner(g, p, band), banded_aligner(g, p, band) };
+		banded_aligner *aligner = &aligners[0], *best = &aligners[1];
+		for (size_t c; (c = next_cluster++) < clusters.size();)
+		{
+			unsigned int best_distance = 0;
+			for (size_t i = clusters[c].first; i < clusters[c].last; ++i)
+			{
+				const unsigned int distance = aligner->align(valid[i], clusters[c].alignment_begin);
+				if (i == clusters[c].first || distance < best_distance)
+				{
+					best_distance = distance;
+					swap(aligner, best); // Keep the matrix of the best position for traceback.
+				}
+			}
+			occurrences[c] = best->trace();
+		}
+	};
+	const unsigned int thread_count = clusters.size() < 1024 ? 1 : min<size_t>(max(num_threads, 1u), clusters.size() >> 10);
+	vector<thread> threads;
+	for (unsigned int i = 1; i < thread_count; ++i) threads.emplace_back(align_clusters);
+	align_clusters();
+	for (auto& t : threads) t.join();
+
+	// Discard the runs that matched only by aligning to the G characters of a preceding gap.
+	occurrences.erase(remove_if(occurrences.begin(), occurrences.end(), [&](const occurrence& o)
+	{
+		return o.distance > p.k;
+	}), occurrences.end());
+	return occurrences;
+}
@@ -0,0 +1,44 @@
+#pragma once
+#ifndef IGREP_ALIGNMENT_HPP
+#define IGREP_ALIGNMENT_HPP
+
+#include "genome.hpp"
+#include "backend.hpp"
+
+/// Represents an occurrence of a pattern in a genome, i.e. the best alignment among a cluster of overlapping matching ending positions.
+struct occurrence
+{
+	unsigned int begin;	/**< Index of the first aligned character of the genome. */
+	unsigned int end;	/**< Index of the last aligned character of the genome, i.e. the matching ending position. */
+	unsigned int distance;	/**< Edit distance of the alignment, or the number of mismatches for Hamming distance. */
+	string cigar;	/**< The alignment in the extended CIGAR format of SAM with the genome as the reference, i.e. = for matches, X for mismatches, I for pattern characters missing from the genome, and D for genome characters missing from the pattern. */
+};
+
+/**
+ * Verify the matching ending positions of a pattern, and collapse those of the same occurrence into its best alignment.
+ * Matches ending beyond the genome, across two consecutive sequences or over a gap are discarded first.
+ * Alignments extend into neither the previous sequence nor the preceding gap, whose N characters are stored as G, so a run whose alignments all exceed distance k without them is discarded too.
+ * The ending positions of an occurrence are adjacent and at most 2k apart, as its distance changes by at most one per character, so each run of such positions is collapsed into the one of the least distance.
+ * The distance at a position is computed by dynamic programming anchored at the position, in a band of k diagonals on either side, as no alignment within distance k leaves it. For Hamming distance the band is the main diagonal only, and positions are not collapsed, since every one of them is a distinct alignment of m characters.
+ * @param[in] g The genome.
+ * @param[in] p The pattern.
+ * @param[in] matches The matching ending positions in ascending order.
+ * @param[in] num_threads Number of threads that align the clusters.
+ * @return The occurrences in ascending order of their ending positions.
+ */
+vector<occurrence> align_matches(const genome& g, const agrep_pattern& p, const vector<unsigned int>& matches, const unsigned int num_threads);
+
+/**
+ * Verify and collapse the matches of a pattern in a chunk of a genome, in the same way as for a whole genome, so that consecutive overlapping chunks together yield the occurrences of the whole genome.
+ * A run of ending positions belongs to the chunk in which it begins, and is completed there even if it extends beyond the chunk's own positions.
+ * @param[in] g The chunk, which must extend 2k characters beyond end, and whose own positions must be preceded by m + k - 1 characters unless they begin its sequence.
+ * @param[in] p The pattern.
+ * @param[in] matches The matching ending positions in the chunk in ascending order.
+ * @param[in] num_threads Number of threads that align the clusters.
+ * @param[in,out] begin Matches ending before begin are ignored, as they belong to the runs of the previous chunk. It is advanced beyond the runs collapsed in this chunk.
+ * @param[in] end Runs beginning at or after end are left to the next chunk.
+ * @return The occurrences in ascending order of their ending positions.
+ */
+vector<occurrence> align_matches(const genome& g, const agrep_pattern& p, const vector<unsigned int>& matches, const unsigned int num_threads, unsigned int& begin, const unsigned int end);
+
+#endif
@@ -0,0 +1,59 @@
+#pragma once
+#ifndef IGREP_BACKEND_HPP
+#define IGREP_BACKEND_HPP
+
+#include <array>
+#include <string>
+#include <vector>
+#include "kernel.hpp"
+using namespace std;
+
+/// Represents a query pattern and its edit distance.
+/// Patterns of up to 64 characters are searched with the bit-parallel agrep recurrence, and longer ones with the multi-word bit-vector algorithm of Myers, or the agrep recurrence carried across words for Hamming distance, on the CPU.
+struct agrep_pattern
+{
+	unsigned int m;	/**< Pattern length. */
+	unsigned int k;	/**< Edit distance, or the number of mismatches if hamming is true. */
+	bool hamming;	/**< Whether substitutions are the only edits, i.e. k bounds the Hamming distance, which is searched with a cheaper recurrence. */
+	unsigned long long mask_array[CHARACTER_CARDINALITY];	/**< The mask array of the first 64 characters of the pattern, in which bit i is cleared for the characters that character i of the pattern matches, and bits from m onwards are set. */
+	vector<array<unsigned long long, CHARACTER_CARDINALITY>> word_mask_arrays;	/**< The mask arrays of every 64 characters of a pattern longer than 64 characters, in the same convention as mask_array. Empty for shorter patterns. */
+};
+
+/// Maximum number of matches of a pattern, i.e. 16 MB of ending positions, beyond which a backend stops collecting them,
+/// so that a pattern that matches almost everywhere, e.g. one whose edit distance is close to its length, fails its job rather than exhausting memory.
+const size_t match_limit = 1 << 22;
+
+/// Represents a device that runs the agrep kernel over the special codon array of a genome, i.e. a CUDA device or the CPU.
+/// A genome is loaded once, and then searched for batches of patterns.
+class agrep_backend
+{
+public:
+	/// Destroys the backend.
+	virtual ~agrep_backend() {}
+
+	/// Returns the name of the backend for logging.
+	virtual string name() const = 0;
+
+	/**
+	 * Load the special codon array of a genome, which must outlive the subsequent searches until unload() is called.
+	 * @param[in] scodon The special codon array, shuffled so that the thread index occupies the lowest B bits.
+	 * @param[in] scodon_size Number of special codons, including the padding of the last block.
+	 * @param[in] character_count Actual number of characters.
+	 * @param[in] block_count Number of thread blocks.
+	 * @param[in] gap_blocks Whether each thread block lies within a gap, in which case it is not scanned, as the caller rejects the matches overlapping gaps.
+	 */
+	virtual void load(const unsigned int *scodon, const size_t scodon_size, const unsigned int character_count, const unsigned int block_count, const unsigned char *gap_blocks) = 0;
+
+	/**
+	 * Search the loaded genome for a batch of patterns. All the matches are returned, unless there are more than match_limit.
+	 * @param[in] patterns The patterns.
+	 * @param[out] matches The ending positions of the matches of each pattern in ascending order, or none if the pattern overflowed.
+	 * @param[out] overflows Whether each pattern has more than match_limit matches, which are not returned.
+	 */
+	virtual void search(const vector<agrep_pattern>& patterns, vector<vector<unsigned int>>& matches, vector<bool>& overflows) = 0;
+
+	/// Release the resources of the loaded genome.
+	virtual void unload() = 0;
+};
+
+#endif
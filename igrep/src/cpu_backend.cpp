@@ -0,0 +1,683 @@
+#include <cstdlib>
+#include <algorithm>
+#include <atomic>
+#include <random>
+#include <thread>
+#include "cpu_backend.hpp"
+
+// Kernel variants are compiled by wrapping the generic kernel body in functions targeting higher instruction set levels.
+// The flatten attribute inlines the body and its callees into the wrapper, so that they are compiled for the target as well.
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define IGREP_CPU_DISPATCH
+#define IGREP_TARGET_AVX2 __attribute__((target("avx2"), flatten))
+#define IGREP_TARGET_AVX512 __attribute__((target("avx512f,avx512bw,avx2"), flatten))
+#else
+#define IGREP_TARGET_AVX2
+#define IGREP_TARGET_AVX512
+#endif
+
+isa_t supported_isa()
+{
+#ifdef IGREP_CPU_DISPATCH
+	// __builtin_cpu_supports() checks both the CPUID bits and whether the operating system saves the extended registers.
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")) return ISA_AVX512;
+	if (__builtin_cpu_supports("avx2")) return ISA_AVX2;
+#endif
+	return ISA_SSE2;
+}
+
+isa_t requested_isa()
+{
+	const isa_t supported = supported_isa();
+	const char* const name = getenv("IGREP_ISA");
+	if (!name) return supported;
+	for (unsigned int i = 0; i < supported; ++i)
+	{
+		const isa_t isa = static_cast<isa_t>(i);
+		if (name == isa_name(isa)) return isa;
+	}
+	return supported;
+}
+
+string isa_name(const isa_t isa)
+{
+	switch (isa)
+	{
+		case ISA_SSE2: return "sse2";
+		case ISA_AVX2: return "avx2";
+		case ISA_AVX512: return "avx512";
+		default: return "unknown";
+	}
+}
+
+/// Represents patterns of the same edit distance and distance type packed into the bits of one word, in which each pattern occupies m consecutive bits.
+template <typename T>
+struct pattern_group
+{
+	unsigned int k;	/**< Edit distance. */
+	bool hamming;	/**< Whether the patterns count substitutions only. */
+	unsigned int overlapping_character_count;	/**< Number of overlapping characters between two consecutive threads, i.e. the maximum m + k - 1 of the patterns. */
+	T mask_array[CHARACTER_CARDINALITY];	/**< The mask arrays of the patterns. */
+	T start_bits;	/**< The lowest bit of each pattern, which is cleared after every shift so that no state is carried over from the pattern below. */
+	T test_bits;	/**< The highest bit of each pattern, i.e. the test bits for determining matches. */
+	vector<unsigned int> patterns;	/**< Indices of the patterns into the batch, in the order of their bits. */
+	vector<T> segment_test_bits;	/**< The test bit of each pattern. */
+	vector<unsigned int> segment_overlapping_character_counts;	/**< m + k - 1 of each pattern. */
+	unsigned char segment_of_bit[sizeof(T) << 3];	/**< The index of the pattern that each test bit belongs to. */
+};
+
+/// Returns the index of the lowest set bit.
+static inline unsigned int lowestBit(const unsigned int x)
+{
+	return __builtin_ctz(x);
+}
+
+/// Returns the index of the lowest set bit.
+static inline unsigned int lowestBit(const unsigned long long x)
+{
+	return __builtin_ctzll(x);
+}
+
+/**
+ * Advance the K+1 matching tables of all the lanes by one character.
+ * The mask word is selected from the 2-bit character without branches or gathers, so that the loop over lanes is vectorized.
+ * With H, i.e. by Hamming distance, a table advances from the previous column of the table below only, which takes half the operations of insertions and deletions.
+ * @param[in,out] r The most recent columns of K+1 matching tables of each lane.
+ * @param[in] s The special codon currently being processed by each lane, widened to T.
+ * @param[in] character_index Index of the character within the special codons.
+ * @param[in] g The packed patterns.
+ */
+template <typename T, unsigned int KI, unsigned int W, bool H>
+static inline void agrepStep(T (&r)[KI + 1][W], const T (&s)[W], const unsigned int character_index, const pattern_group<T>& g)
+{
+	// Each loop runs over lanes only, so that it is vectorized regardless of the edit distance.
+	const T m0 = g.mask_array[0], m1 = g.mask_array[1], m2 = g.mask_array[2], m3 = g.mask_array[3];
+	const T carry_mask = ~g.start_bits;
+	T mask_word[W], r2[W], r3[W];
+	for (unsigned int w = 0; w < W; ++w)
+	{
+		const T c = s[w] >> (character_index << 1);
+		const T b0 = static_cast<T>(0) - (c & 1);
+		const T b1 = static_cast<T>(0) - ((c >> 1) & 1);
+		mask_word[w] = (((m0 & ~b0) | (m1 & b0)) & ~b1) | (((m2 & ~b0) | (m3 & b0)) & b1);
+		r2[w] = r[0][w];
+		r3[w] = ((r2[w] << 1) & carry_mask) | mask_word[w];
+		r[0][w] = r3[w];
+	}
+	for (unsigned int k = 1; k <= KI; ++k)
+	{
+		for (unsigned int w = 0; w < W; ++w)
+		{
+			const T r0 = r2[w];
+			const T r1 = r3[w];
+			r2[w] = r[k][w];
+			if (H)
+				r3[w] = (((r2[w] << 1) & carry_mask) | mask_word[w]) & ((r0 << 1) & carry_mask);
+			else
+				r3[w] = (((r2[w] << 1) & carry_mask) | mask_word[w]) & (((r0 & r1) << 1) & carry_mask) & r0;
+			r[k][w] = r3[w];
+		}
+	}
+}
+
+/**
+ * Record the matches of all the lanes at the current character into the match vectors of the patterns.
+ * The lanes are tested together first, as matches are rare.
+ * @param[in] r The most recent columns of K+1 matching tables of each lane.
+ * @param[in] g The packed patterns.
+ * @param[in] outputting_scodon_base_index The base index into outputting special codon of the first lane, in the original order of corpus.
+ * @param[in] character_offset The offset of the current character from the outputting special codon of each lane.
+ * @param[in] character_count Number of characters.
+ * @param[out] matches The matching ending positions of each pattern of the group.
+ */
+template <typename T, unsigned int KI, unsigned int W>
+static inline void agrepReport(const T (&r)[KI + 1][W], const pattern_group<T>& g, const unsigned int outputting_scodon_base_index, const unsigned int character_offset, const unsigned int character_count, vector<unsigned int> *matches)
+{
+	T any = 0;
+	for (unsigned int w = 0; w < W; ++w) any |= ~r[KI][w];
+	if (!(any & g.test_bits)) return;
+	for (unsigned int w = 0; w < W; ++w)
+	{
+		const unsigned int matching_character_index = ((outputting_scodon_base_index + (w << L)) << 4) + character_offset;
+		if (matching_character_index > character_count) continue;
+		for (T hits = ~r[KI][w] & g.test_bits; hits; hits &= hits - 1)
+		{
+			matches[g.segment_of_bit[lowestBit(hits)]].push_back(matching_character_index);
+		}
+	}
+}
+
+/**
+ * The CPU agrep kernel for one thread block, which processes W threads of the CUDA kernel at a time as SIMD lanes.
+ * Like the CUDA kernel, each lane skips its first overlapping_character_count characters, which are reported by the previous lane instead,
+ * and continues into the first overlapping_character_count characters of the next lane, i.e. thread 0 of the next block for the last lane of a block.
+ * Special codons beyond the array are read as 0.
+ * As the group skips the maximum overlap of its patterns, the first lane of the genome reports each pattern from its own overlap onwards, so that packed patterns match exactly as if searched alone.
+ */
+template <typename T, unsigned int KI, bool H>
+static inline void agrepBlock(const unsigned int *scodon, const unsigned int scodon_size, const unsigned int character_count, const pattern_group<T>& g, const unsigned int block, vector<unsigned int> *matches)
+{
+	const unsigned int W = 64 / sizeof(T);	// Number of lanes, which fill a 512-bit vector.
+	const unsigned int overlapping_character_count = g.overlapping_character_count;
+	const unsigned int overlapping_scodon_count = (overlapping_character_count + 16 - 1) >> 4;
+	const unsigned int block_base_index = block << (L + B);
+	T r[KI + 1][W];
+	T s[W];
+	for (unsigned int t = 0; t < (1 << B); t += W)
+	{
+		const unsigned int outputting_scodon_base_index = block_base_index + (t << L);
+		for (unsigned int w = 0; w < W; ++w)
+		{
+			r[0][w] = ~static_cast<T>(0);
+			for (unsigned int k = 1; k <= KI; ++k) r[k][w] = (r[k - 1][w] << 1) & ~g.start_bits;
+		}
+		for (unsigned int scodon_index = 0; scodon_index < (1 << L); ++scodon_index)
+		{
+			const unsigned int *const scodon_row = scodon + block_base_index + (scodon_index << B) + t;
+			for (unsigned int w = 0; w < W; ++w) s[w] = scodon_row[w];
+			for (unsigned int character_index = 0; character_index < 16; ++character_index)
+			{
+				const unsigned int character_offset = (scodon_index << 4) + character_index;
+				agrepStep<T, KI, W, H>(r, s, character_index, g);
+				if (character_offset >= overlapping_character_count)
+				{
+					agrepReport<T, KI, W>(r, g, outputting_scodon_base_index, character_offset, character_count, matches);
+				}
+				else if (!outputting_scodon_base_index)
+				{
+					for (unsigned int i = 0; i < g.patterns.size(); ++i)
+					{
+						if (character_offset >= g.segment_overlapping_character_counts[i] && !(r[KI][0] & g.segment_test_bits[i])) matches[i].push_back(character_offset);
+					}
+				}
+			}
+		}
+		for (unsigned int scodon_index = 0; scodon_index < overlapping_scodon_count; ++scodon_index)
+		{
+			for (unsigned int w = 0; w < W; ++w)
+			{
+				const unsigned int next = t + w + 1;
+				const unsigned int index = block_base_index + (scodon_index << B) + (next < (1 << B) ? next : (1 << (L + B)));
+				s[w] = index < scodon_size ? scodon[index] : 0;
+			}
+			for (unsigned int character_index = 0; character_index < 16 && (scodon_index << 4) + character_index < overlapping_character_count; ++character_index)
+			{
+				agrepStep<T, KI, W, H>(r, s, character_index, g);
+				agrepReport<T, KI, W>(r, g, outputting_scodon_base_index, (((1 << L) + scodon_index) << 4) + character_index, character_count, matches);
+			}
+		}
+	}
+}
+
+template <typename T>
+using block_kernel = void (*)(const unsigned int *, const unsigned int, const unsigned int, const pattern_group<T>&, const unsigned int, vector<unsigned int> *);
+
+template <typename T, unsigned int KI, bool H>
+static void agrepBlockSse2(const unsigned int *scodon, const unsigned int scodon_size, const unsigned int character_count, const pattern_group<T>& g, const unsigned int block, vector<unsigned int> *matches)
+{
+	agrepBlock<T, KI, H>(scodon, scodon_size, character_count, g, block, matches);
+}
+
+template <typename T, unsigned int KI, bool H>
+IGREP_TARGET_AVX2 static void agrepBlockAvx2(const unsigned int *scodon, const unsigned int scodon_size, const unsigned int character_count, const pattern_group<T>& g, const unsigned int block, vector<unsigned int> *matches)
+{
+	agrepBlock<T, KI, H>(scodon, scodon_size, character_count, g, block, matches);
+}
+
+template <typename T, unsigned int KI, bool H>
+IGREP_TARGET_AVX512 static void agrepBlockAvx512(const unsigned int *scodon, const unsigned int scodon_size, const unsigned int character_count, const pattern_group<T>& g, const unsigned int block, vector<unsigned int> *matches)
+{
+	agrepBlock<T, KI, H>(scodon, scodon_size, character_count, g, block, matches);
+}
+
+/// Returns the block kernel of the given instruction set level, distance type and edit distance.
+template <typename T>
+static block_kernel<T> selectBlockKernel(const isa_t isa, const bool hamming, const unsigned int k)
+{
+	static const block_kernel<T> kernels[ISA_SIZE][2][10] =
+	{
+		{
+			{ agrepBlockSse2<T, 0, false>, agrepBlockSse2<T, 1, false>, agrepBlockSse2<T, 2, false>, agrepBlockSse2<T, 3, false>, agrepBlockSse2<T, 4, false>, agrepBlockSse2<T, 5, false>, agrepBlockSse2<T, 6, false>, agrepBlockSse2<T, 7, false>, agrepBlockSse2<T, 8, false>, agrepBlockSse2<T, 9, false> },
+			{ agrepBlockSse2<T, 0, true>, agrepBlockSse2<T, 1, true>, agrepBlockSse2<T, 2, true>, agrepBlockSse2<T, 3, true>, agrepBlockSse2<T, 4, true>, agrepBlockSse2<T, 5, true>, agrepBlockSse2<T, 6, true>, agrepBlockSse2<T, 7, true>, agrepBlockSse2<T, 8, true>, agrepBlockSse2<T, 9, true> },
+		},
+		{
+			{ agrepBlockAvx2<T, 0, false>, agrepBlockAvx2<T, 1, false>, agrepBlockAvx2<T, 2, false>, agrepBlockAvx2<T, 3, false>, agrepBlockAvx2<T, 4, false>, agrepBlockAvx2<T, 5, false>, agrepBlockAvx2<T, 6, false>, agrepBlockAvx2<T, 7, false>, agrepBlockAvx2<T, 8, false>, agrepBlockAvx2<T, 9, false> },
+			{ agrepBlockAvx2<T, 0, true>, agrepBlockAvx2<T, 1, true>, agrepBlockAvx2<T, 2, true>, agrepBlockAvx2<T, 3, true>, agrepBlockAvx2<T, 4, true>, agrepBlockAvx2<T, 5, true>, agrepBlockAvx2<T, 6, true>, agrepBlockAvx2<T, 7, true>, agrepBlockAvx2<T, 8, true>, agrepBlockAvx2<T, 9, true> },
+		},
+		{
+			{ agrepBlockAvx512<T, 0, false>, agrepBlockAvx512<T, 1, false>, agrepBlockAvx512<T, 2, false>, agrepBlockAvx512<T, 3, false>, agrepBlockAvx512<T, 4, false>, agrepBlockAvx512<T, 5, false>, agrepBlockAvx512<T, 6, false>, agrepBlockAvx512<T, 7, false>, agrepBlockAvx512<T, 8, false>, agrepBlockAvx512<T, 9, false> },
+			{ agrepBlockAvx512<T, 0, true>, agrepBlockAvx512<T, 1, true>, agrepBlockAvx512<T, 2, true>, agrepBlockAvx512<T, 3, true>, agrepBlockAvx512<T, 4, true>, agrepBlockAvx512<T, 5, true>, agrepBlockAvx512<T, 6, true>, agrepBlockAvx512<T, 7, true>, agrepBlockAvx512<T, 8, true>, agrepBlockAvx512<T, 9, true> },
+		},
+	};
+	return kernels[isa][hamming][k];
+}
+
+/**
+ * Advance one 64-bit word of the dynamic programming column of Myers' bit-vector algorithm by one character, as formulated by Hyyrö.
+ * @param[in,out] pv The positive vertical deltas of the word.
+ * @param[in,out] mv The negative vertical deltas of the word.
+ * @param[in] eq The rows of the word whose pattern characters match the text character.
+ * @param[in] hin The horizontal delta into the first row of the word, i.e. -1, 0 or +1.
+ * @return The horizontal delta out of the last row of the word.
+ */
+static inline int myersStep(unsigned long long& pv, unsigned long long& mv, unsigned long long eq, const int hin)
+{
+	const unsigned long long xv = eq | mv;
+	if (hin < 0) eq |= 1;
+	const unsigned long long xh = (((eq & pv) + pv) ^ pv) | eq;
+	unsigned long long ph = mv | ~(xh | pv);
+	unsigned long long mh = pv & xh;
+	const int hout = static_cast<int>(ph >> 63) - static_cast<int>(mh >> 63);
+	ph <<= 1;
+	mh <<= 1;
+	if (hin < 0) mh |= 1;
+	else if (hin > 0) ph |= 1;
+	pv = mh | ~(xv | ph);
+	mv = ph & xv;
+	return hout;
+}
+
+/**
+ * Search a thread block of the genome for a pattern longer than 64 characters with the multi-word bit-vector algorithm of Myers, which computes the same edit distances as the dynamic programming of Sellers.
+ * The column is split into 64-bit words, and only the words up to the last one that may hold a distance within k are advanced, following the cut-off of Ukkonen, so that the cost per character grows with the number of words in this band rather than with m.
+ * The recurrence starts m + k - 1 characters before the block, which is as far back as a match ending within the block can begin, so that the matches are exactly those of a linear scan.
+ * Like the agrep kernel, the position right after the last character is searched too, and special codons beyond the array are read as 0.
+ * @param[in] scodon The shuffled special codon array.
+ * @param[in] scodon_size Number of special codons.
+ * @param[in] character_count Actual number of characters.
+ * @param[in] p The pattern.
+ * @param[in] block The thread block.
+ * @param[out] matches The matching ending positions within the block.
+ */
+static void myersBlock(const unsigned int *scodon, const unsigned int scodon_size, const unsigned int character_count, const agrep_pattern& p, const unsigned int block, vector<unsigned int>& matches)
+{
+	const unsigned int m = p.m;
+	const int k = p.k;
+	const unsigned int word_count = p.word_mask_arrays.size();
+	const unsigned int block_begin = block << (L + B + 4);
+	const unsigned int block_end = min(character_count + 1, block_begin + (1 << (L + B + 4)));
+	const unsigned int begin = block_begin > m + k - 1 ? block_begin - (m + k - 1) : 0;
+
+	// Derive the match vectors from the mask arrays. The rows beyond m match nothing.
+	vector<unsigned long long> peq(CHARACTER_CARDINALITY * word_count);
+	for (unsigned int c = 0; c < CHARACTER_CARDINALITY; ++c)
+	{
+		for (unsigned int w = 0; w < word_count; ++w) peq[c * word_count + w] = ~p.word_mask_arrays[w][c];
+	}
+	const unsigned long long rows_below_m = ((m - 1) & 63) == 63 ? 0 : MAX_UNSIGNED_LONG_LONG << (((m - 1) & 63) + 1);	// The rows of the last word beyond the last pattern character.
+
+	// Initialize the words up to the one containing row k, where the distances of the first column are at most k.
+	vector<unsigned long long> pv(word_count, MAX_UNSIGNED_LONG_LONG), mv(word_count, 0);
+	vector<int> score(word_count);	// The distance at the last row of each word.
+	unsigned int last = min(word_count - 1, static_cast<unsigned int>(k) >> 6);
+	for (unsigned int w = 0; w <= last; ++w) score[w] = (w + 1) << 6;
+
+	unsigned int s = 0;
+	for (unsigned int position = begin; position < block_end; ++position)
+	{
+		if (position == begin || !(position & 15))
+		{
+			const unsigned int scodon_index = position >> 4;
+			const unsigned int shuffled_index = ((scodon_index >> (L + B)) << (L + B)) | ((scodon_index & ((1 << L) - 1)) << B) | ((scodon_index >> L) & ((1 << B) - 1));
+			s = shuffled_index < scodon_size ? scodon[shuffled_index] : 0;
+		}
+		const unsigned long long *const eq = &peq[((s >> ((position & 15) << 1)) & 3) * word_count];
+
+		// Advance the words in the band.
+		int hout = 0;	// The top row is all zeros, as a match may begin anywhere.
+		for (unsigned int w = 0; w <= last; ++w)
+		{
+			hout = myersStep(pv[w], mv[w], eq[w], hout);
+			score[w] += hout;
+		}
+
+		// Extend the band by one word if its last row may be within k, or shrink it while its last word exceeds k everywhere. The first word is always advanced.
+		if (last + 1 < word_count && score[last] - hout <= k && ((eq[last + 1] & 1) || hout < 0))
+		{
+			++last;
+			pv[last] = MAX_UNSIGNED_LONG_LONG;
+			mv[last] = 0;
+			score[last] = score[last - 1] - hout + 64 + myersStep(pv[last], mv[last], eq[last], hout);
+		}
+		else
+		{
+			while (last && score[last] >= k + 64) --last;
+		}
+
+		// Report a match if the distance at row m is within k. It is derived from the last row of the last word by undoing the vertical deltas of the rows beyond m.
+		if (last == word_count - 1 && position >= block_begin && position + 1 >= m + k)
+		{
+			const int distance = score[last] - __builtin_popcountll(pv[last] & rows_below_m) + __builtin_popcountll(mv[last] & rows_below_m);
+			if (distance <= k) matches.push_back(position);
+		}
+	}
+}
+
+/**
+ * Search a thread block of the genome for a pattern longer than 64 characters by Hamming distance.
+ * A substring within Hamming distance k is within edit distance k too, so the matches are filtered from those of myersBlock() by counting the mismatches of the m characters up to each of them.
+ * @param[in] scodon The shuffled special codon array.
+ * @param[in] scodon_size Number of special codons.
+ * @param[in] character_count Actual number of characters.
+ * @param[in] p The pattern.
+ * @param[in] block The thread block.
+ * @param[out] matches The matching ending positions within the block.
+ */
+static void hammingBlock(const unsigned int *scodon, const unsigned int scodon_size, const unsigned int character_count, const agrep_pattern& p, const unsigned int block, vector<unsigned int>& matches)
+{
+	myersBlock(scodon, scodon_size, character_count, p, block, matches);
+	const auto is_match = [&](const unsigned int position)
+	{
+		unsigned int mismatches = 0;
+		for (unsigned int i = position + 1 - p.m, j = 0; j < p.m; ++i, ++j)
+		{
+			const unsigned int scodon_index = i >> 4;
+			const unsigned int shuffled_index = ((scodon_index >> (L + B)) << (L + B)) | ((scodon_index & ((1 << L) - 1)) << B) | ((scodon_index >> L) & ((1 << B) - 1));
+			const unsigned int c = ((shuffled_index < scodon_size ? scodon[shuffled_index] : 0) >> ((i & 15) << 1)) & 3;
+			if (((p.word_mask_arrays[j >> 6][c] >> (j & 63)) & 1) && ++mismatches > p.k) return false;
+		}
+		return true;
+	};
+	matches.erase(remove_if(matches.begin(), matches.end(), [&](const unsigned int position) { return !is_match(position); }), matches.end());
+}
+
+/**
+ * Pack patterns of the same edit distance and distance type into one word.
+ * @param[in] patterns The batch of patterns.
+ * @param[in] indices Indices of the patterns to pack, whose lengths sum to at most the number of bits of T.
+ * @return The packed patterns.
+ */
+template <typename T>
+static pattern_group<T> packPatterns(const vector<agrep_pattern>& patterns, const vector<unsigned int>& indices)
+{
+	pattern_group<T> g;
+	g.k = patterns[indices.front()].k;
+	g.hamming = patterns[indices.front()].hamming;
+	g.overlapping_character_count = 0;
+	fill(g.mask_array, g.mask_array + CHARACTER_CARDINALITY, ~static_cast<T>(0));
+	g.start_bits = 0;
+	g.test_bits = 0;
+	g.patterns = indices;
+	unsigned int offset = 0;
+	for (unsigned int i = 0; i < indices.size(); ++i)
+	{
+		const agrep_pattern& p = patterns[indices[i]];
+		const T bits = (p.m == (sizeof(T) << 3) ? ~static_cast<T>(0) : (static_cast<T>(1) << p.m) - 1) << offset;
+		for (unsigned int c = 0; c < CHARACTER_CARDINALITY; ++c)
+		{
+			g.mask_array[c] &= ~bits | (static_cast<T>(p.mask_array[c]) << offset);
+		}
+		g.start_bits |= static_cast<T>(1) << offset;
+		const T test_bit = static_cast<T>(1) << (offset + p.m - 1);
+		g.test_bits |= test_bit;
+		g.segment_test_bits.push_back(test_bit);
+		g.segment_overlapping_character_counts.push_back(p.m + p.k - 1);
+		g.segment_of_bit[offset + p.m - 1] = i;
+		g.overlapping_character_count = max(g.overlapping_character_count, p.m + p.k - 1);
+		offset += p.m;
+	}
+	return g;
+}
+
+cpu_backend::cpu_backend(const unsigned int num_threads, const isa_t isa) : num_threads(max(num_threads, 1u)), isa(isa), scodon(nullptr), scodon_size(0), character_count(0), block_count(0), gap_blocks(nullptr)
+{
+}
+
+string cpu_backend::name() const
+{
+	return "cpu/" + isa_name(isa) + "/" + to_string(num_threads);
+}
+
+void cpu_backend::load(const unsigned int *scodon, const size_t scodon_size, const unsigned int character_count, const unsigned int block_count, const unsigned char *gap_blocks)
+{
+	this->scodon = scodon;
+	this->scodon_size = scodon_size;
+	this->character_count = character_count;
+	this->block_count = block_count;
+	this->gap_blocks = gap_blocks;
+}
+
+void cpu_backend::search(const vector<agrep_pattern>& patterns, vector<vector<unsigned int>>& matches, vector<bool>& overflows)
+{
+	// Pack patterns of the same edit distance and distance type into 64-bit words by first fit decreasing of their lengths, and use 32-bit words, which have twice as many lanes, for those that fit.
+	vector<unsigned int> order(patterns.size());
+	for (unsigned int i = 0; i < order.size(); ++i) order[i] = i;
+	sort(order.begin(), order.end(), [&](const unsigned int a, const unsigned int b)
+	{
+		if (patterns[a].hamming != patterns[b].hamming) return patterns[b].hamming;
+		return patterns[a].k < patterns[b].k || (patterns[a].k == patterns[b].k && patterns[a].m > patterns[b].m);
+	});
+	vector<vector<unsigned int>> bins;
+	vector<unsigned int> bin_bits;
+	vector<unsigned int> long_patterns;	// Indices of the patterns longer than 64 characters, which are searched one by one.
+	size_t first_bin = 0;
+	for (const auto i : order)
+	{
+		const agrep_pattern& p = patterns[i];
+		if (p.m > 64)
+		{
+			long_patterns.push_back(i);
+			continue;
+		}
+		if (first_bin < bins.size() && (patterns[bins[first_bin].front()].k != p.k || patterns[bins[first_bin].front()].hamming != p.hamming)) first_bin = bins.size();
+		size_t b;
+		for (b = first_bin; b < bins.size() && bin_bits[b] + p.m > 64; ++b);
+		if (b == bins.size())
+		{
+			bins.push_back(vector<unsigned int>());
+			bin_bits.push_back(0);
+		}
+		bins[b].push_back(i);
+		bin_bits[b] += p.m;
+	}
+	vector<pattern_group<unsigned int>> groups32;
+	vector<pattern_group<unsigned long long>> groups64;
+	for (size_t b = 0; b < bins.size(); ++b)
+	{
+		if (bin_bits[b] <= 32)
+			groups32.push_back(packPatterns<unsigned int>(patterns, bins[b]));
+		else
+			groups64.push_back(packPatterns<unsigned long long>(patterns, bins[b]));
+	}
+
+	// Distribute blocks to threads dynamically, and run all the groups over a block while it is cache-resident.
+	// Each thread collects the matches of its blocks as pairs of pattern index and ending position into its own buffer, so that threads never contend,
+	// and the buffers are scattered into the matches of each pattern and sorted afterwards, so that the results do not depend on scheduling.
+	// A flat buffer per thread costs memory in proportion to the matches only, rather than to the product of patterns and blocks.
+	// The matches of each pattern are counted across threads, and no longer collected once they exceed match_limit.
+	const unsigned int thread_count = min(num_threads, block_count);
+	vector<vector<pair<unsigned int, unsigned int>>> thread_matches(thread_count);
+	vector<atomic<size_t>> match_counts(patterns.size());
+	atomic<unsigned int> next_block(0);
+	vector<thread> threads;
+	threads.reserve(thread_count);
+	for (unsigned int i = 0; i < thread_count; ++i)
+	{
+		threads.emplace_back([&, i]()
+		{
+			vector<pair<unsigned int, unsigned int>>& tm = thread_matches[i];
+			vector<vector<unsigned int>> group_matches(64);
+			vector<unsigned int> long_matches;
+			const auto collect = [&](const unsigned int pattern, vector<unsigned int>& m)
+			{
+				if (m.size() && match_counts[pattern].fetch_add(m.size(), memory_order_relaxed) + m.size() <= match_limit)
+				{
+					for (const auto position : m) tm.emplace_back(pattern, position);
+				}
+				m.clear();
+			};
+			for (unsigned int block; (block = next_block++) < block_count;)
+			{
+				if (gap_blocks[block]) continue;
+				for (const auto& g : groups32)
+				{
+					selectBlockKernel<unsigned int>(isa, g.hamming, g.k)(scodon, scodon_size, character_count, g, block, group_matches.data());
+					for (unsigned int j = 0; j < g.patterns.size(); ++j) collect(g.patterns[j], group_matches[j]);
+				}
+				for (const auto& g : groups64)
+				{
+					selectBlockKernel<unsigned long long>(isa, g.hamming, g.k)(scodon, scodon_size, character_count, g, block, group_matches.data());
+					for (unsigned int j = 0; j < g.patterns.size(); ++j) collect(g.patterns[j], group_matches[j]);
+				}
+				for (const auto p : long_patterns)
+				{
+					if (patterns[p].hamming)
+						hammingBlock(scodon, scodon_size, character_count, patterns[p], block, long_matches);
+					else
+						myersBlock(scodon, scodon_size, character_count, patterns[p], block, long_matches);
+					collect(p, long_matches);
+				}
+			}
+		});
+	}
+	for (auto& t : threads) t.join();
+
+	// Scatter the matches of the threads into those of each pattern that has not overflowed, releasing the thread buffers as they are consumed, and sort them, as blocks are distributed to threads dynamically.
+	matches.resize(patterns.size());
+	overflows.assign(patterns.size(), false);
+	for (size_t i = 0; i < patterns.size(); ++i)
+	{
+		matches[i].clear();
+		overflows[i] = match_counts[i] > match_limit;
+		if (!overflows[i]) matches[i].reserve(match_counts[i]);
+	}
+	for (auto& tm : thread_matches)
+	{
+		for (const auto& pm : tm)
+		{
+			if (!overflows[pm.first]) matches[pm.first].push_back(pm.second);
+		}
+		vector<pair<unsigned int, unsigned int>>().swap(tm);
+	}
+	for (auto& m : matches) sort(m.begin(), m.end());
+}
+
+void cpu_backend::unload()
+{
+	scodon = nullptr;
+	scodon_size = 0;
+	gap_blocks = nullptr;
+}
+
+/**
+ * Scan a text with the dynamic programming algorithm of Sellers for substrings within edit distance k of a pattern, or by counting the mismatches of every window of m characters for Hamming distance.
+ * @param[in] text The characters of the text, i.e. 0 to 3.
+ * @param[in] pattern The set of characters that each pattern position matches, as a bit mask.
+ * @param[in] k Edit distance.
+ * @param[in] hamming Whether substitutions are the only edits.
+ * @param[in] begin The first ending position to report.
+ * @return The ending positions of matching substrings, from begin onwards.
+ */
+static vector<unsigned int> naiveScan(const vector<unsigned char>& text, const vector<unsigned char>& pattern, const unsigned int k, const bool hamming, const unsigned int begin)
+{
+	const unsigned int m = pattern.size();
+	if (hamming)
+	{
+		vector<unsigned int> matches;
+		for (unsigned int position = max(begin, m - 1); position < text.size(); ++position)
+		{
+			unsigned int mismatches = 0;
+			for (unsigned int i = 0; i < m; ++i) mismatches += !((pattern[i] >> text[position + 1 - m + i]) & 1);
+			if (mismatches <= k) matches.push_back(position);
+		}
+		return matches;
+	}
+	vector<unsigned int> d(m + 1);
+	for (unsigned int i = 0; i <= m; ++i) d[i] = i;
+	vector<unsigned int> matches;
+	for (unsigned int position = 0; position < text.size(); ++position)
+	{
+		const unsigned int c = text[position];
+		unsigned int diagonal = d[0];
+		for (unsigned int i = 1; i <= m; ++i)
+		{
+			const unsigned int above = d[i];
+			d[i] = min(diagonal + !((pattern[i - 1] >> c) & 1), min(above, d[i - 1]) + 1);
+			diagonal = above;
+		}
+		if (d[m] <= k && position >= begin) matches.push_back(position);
+	}
+	return matches;
+}
+
+bool cpu_backend::self_test(const isa_t isa, const unsigned int num_threads)
+{
+	// Genomes have one and a half blocks, whose last block is partially filled as genome::genome() does.
+	const unsigned int character_count = (3 << (L + B + 3)) + 7;
+	const unsigned int block_count = ((character_count + 15) >> 4 >> (L + B)) + 1;
+	vector<unsigned char> text(character_count + 1);	// The position at character_count is reported by the kernel too, and reads padding, i.e. character 0.
+	vector<unsigned int> scodon(block_count << (L + B));
+	const vector<unsigned char> gap_blocks(block_count, 0);	// The synthetic genomes have no gaps.
+	cpu_backend backend(num_threads, isa);
+
+	// The tests cover both the 32-bit and the 64-bit kernels and the multi-word engines, with and without errors, a pattern with N, and patterns of the same edit distance that are packed together, by edit distance and by Hamming distance.
+	const unsigned int tests[][3] = { { 12, 0, 0 }, { 20, 2, 0 }, { 10, 2, 0 }, { 32, 3, 0 }, { 33, 1, 0 }, { 25, 1, 0 }, { 50, 4, 0 }, { 64, 9, 0 }, { 65, 3, 0 }, { 128, 0, 0 }, { 200, 9, 0 }, { 20, 2, 1 }, { 12, 2, 1 }, { 40, 5, 1 }, { 64, 9, 1 }, { 150, 4, 1 } };
+	mt19937 eng(2);
+	vector<vector<unsigned char>> sets;	// The set of characters that each position matches, as a bit mask.
+	vector<agrep_pattern> patterns;
+	for (const auto& test : tests)
+	{
+		agrep_pattern p;
+		p.m = test[0];
+		p.k = test[1];
+		p.hamming = test[2];
+		vector<unsigned char> set(p.m);
+		for (auto& c : set) c = 1 << (eng() & 3);
+		if (p.m == 20) set[7] = 15;
+		if (p.m > 64) p.word_mask_arrays.resize((p.m + 63) >> 6);
+		for (unsigned int c = 0; c < CHARACTER_CARDINALITY; ++c)
+		{
+			p.mask_array[c] = MAX_UNSIGNED_LONG_LONG;
+			for (auto& word_mask_array : p.word_mask_arrays) word_mask_array[c] = MAX_UNSIGNED_LONG_LONG;
+			for (unsigned int j = 0; j < p.m; ++j)
+			{
+				if (!((set[j] >> c) & 1)) continue;
+				if (j < 64) p.mask_array[c] ^= 1ULL << j;
+				if (p.m > 64) p.word_mask_arrays[j >> 6][c] ^= 1ULL << (j & 63);
+			}
+		}
+		sets.push_back(set);
+		patterns.push_back(p);
+	}
+
+	// Search a genome with copies of each pattern planted in turn, both in a batch and alone.
+	vector<vector<unsigned int>> batch_matches, single_matches;
+	vector<bool> batch_overflows, single_overflows;
+	for (unsigned int i = 0; i < patterns.size(); ++i)
+	{
+		// Generate a random genome, and plant copies of the pattern with up to k substitutions at its beginning and across the boundaries of threads and of blocks.
+		const unsigned int m = patterns[i].m, k = patterns[i].k;
+		const bool hamming = patterns[i].hamming;
+		for (unsigned int j = 0; j < character_count; ++j) text[j] = eng() & 3;
+		text[character_count] = 0;
+		for (unsigned int boundary = 0; boundary < character_count - m; boundary += 1 << (L + 4))
+		{
+			const unsigned int position = boundary ? boundary - (eng() % (m + k)) : k + eng() % m;
+			for (unsigned int j = 0; j < m; ++j) text[position + j] = __builtin_ctz(sets[i][j]);
+			for (unsigned int e = 0; e < k; ++e) text[position + eng() % m] = eng() & 3;
+		}
+
+		// Encode the genome into shuffled special codons as genome::genome() does.
+		fill(scodon.begin(), scodon.end(), 0);
+		for (unsigned int j = 0; j < character_count; ++j)
+		{
+			const unsigned int scodon_index = j >> 4;
+			const unsigned int shuffled_index = ((scodon_index >> (L + B)) << (L + B)) | ((scodon_index & ((1 << L) - 1)) << B) | ((scodon_index >> L) & ((1 << B) - 1));
+			scodon[shuffled_index] |= text[j] << ((j & 15) << 1);
+		}
+		backend.load(scodon.data(), scodon.size(), character_count, block_count, gap_blocks.data());
+
+		// The planted pattern must match exactly what the naive scanner finds, and all the patterns must match the same in a batch as alone.
+		const vector<unsigned int> expected = naiveScan(text, sets[i], k, hamming, m + k - 1);
+		backend.search(patterns, batch_matches, batch_overflows);
+		if (expected.empty() || batch_matches[i] != expected || batch_overflows[i]) return false;
+		for (unsigned int j = 0; j < patterns.size(); ++j)
+		{
+			backend.search(vector<agrep_pattern>(1, patterns[j]), single_matches, single_overflows);
+			if (single_matches[0] != batch_matches[j] || single_overflows[0] != batch_overflows[j]) return false;
+		}
+		backend.unload();
+	}
+	return true;
+}
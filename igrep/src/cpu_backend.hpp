@@ -0,0 +1,54 @@
+#pragma once
+#ifndef IGREP_CPU_BACKEND_HPP
+#define IGREP_CPU_BACKEND_HPP
+
+#include "backend.hpp"
+
+/// Instruction set levels for which the CPU agrep kernel is compiled.
+enum isa_t
+{
+	ISA_SSE2,	/**< Baseline of x86-64, i.e. what plain g++ -O2 generates. */
+	ISA_AVX2,	/**< AVX2, e.g. Haswell and later. */
+	ISA_AVX512,	/**< AVX-512 F/BW, e.g. Skylake-SP and later. */
+	ISA_SIZE,	/**< Number of supported instruction set levels. */
+};
+
+/// Returns the highest instruction set level supported by both the CPU and the operating system.
+isa_t supported_isa();
+
+/// Returns the instruction set level to use, i.e. the one given by the IGREP_ISA environment variable if set and supported, or the highest supported one otherwise.
+isa_t requested_isa();
+
+/// Returns the name of an instruction set level, i.e. sse2, avx2 or avx512.
+string isa_name(const isa_t isa);
+
+/// Runs the bit-parallel agrep recurrence of the CUDA kernel on the CPU.
+/// The 128 threads of a CUDA block are processed as SIMD lanes, i.e. consecutive lanes read consecutive words of the shuffled special codon array, and blocks are distributed over CPU threads.
+/// The overlap between threads and blocks is handled exactly as the CUDA kernel does, so that both backends report the same matches.
+/// Patterns of the same edit distance are packed into the bits of one word, and all the packed words of a batch are run over a block while it is cache-resident,
+/// so that the genome is streamed once per batch rather than once per pattern.
+class cpu_backend : public agrep_backend
+{
+public:
+	/// Constructs a backend that runs the kernel variants of the given instruction set level on num_threads threads.
+	cpu_backend(const unsigned int num_threads, const isa_t isa);
+
+	/// Returns true if the kernel variants of the given instruction set level report the same matches as a naive dynamic programming scanner on synthetic genomes with planted matches across thread and block boundaries, both for patterns searched alone and packed in a batch.
+	static bool self_test(const isa_t isa, const unsigned int num_threads);
+
+	virtual string name() const;
+	virtual void load(const unsigned int *scodon, const size_t scodon_size, const unsigned int character_count, const unsigned int block_count, const unsigned char *gap_blocks);
+	virtual void search(const vector<agrep_pattern>& patterns, vector<vector<unsigned int>>& matches, vector<bool>& overflows);
+	virtual void unload();
+
+private:
+	const unsigned int num_threads;	/**< Number of CPU threads. */
+	const isa_t isa;	/**< Instruction set level of the kernel variants. */
+	const unsigned int *scodon;	/**< The special codon array of the loaded genome. */
+	unsigned int scodon_size;	/**< Number of special codons, including the padding of the last block. */
+	unsigned int character_count;	/**< Actual number of characters. */
+	unsigned int block_count;	/**< Number of thread blocks. */
+	const unsigned char *gap_blocks;	/**< Whether each thread block lies within a gap. */
+};
+
+#endif
@@ -0,0 +1,383 @@
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <memory>
+#include <stdexcept>
+#include <boost/filesystem/operations.hpp>
+#include <boost/filesystem/fstream.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+#include <boost/iostreams/filter/gzip.hpp>
+#include "genome.hpp"
+
+using boost::iostreams::filtering_istream;
+using boost::iostreams::gzip_decompressor;
+
+/// Magic bytes at the beginning of a packed genome file.
+static const char packed_magic[8] = { 'I', 'G', 'R', 'E', 'P', 'P', 'K', 'D' };
+
+/// Version of the packed genome file format.
+static const unsigned int packed_version = 3;
+
+/// Alignment of the special codon array within a packed genome file, so that it can be mapped at page boundaries.
+static const size_t packed_alignment = 4096;
+
+/// Header of a packed genome file, which is followed by sequence_length, sequence_cumulative_length, block_to_sequence and the gaps, and then by the special codon array at the next multiple of packed_alignment.
+struct packed_header
+{
+	char magic[8];	/**< Magic bytes, i.e. IGREPPKD. */
+	unsigned int version;	/**< Version of the file format. */
+	unsigned int l_plus_b;	/**< L + B of the shuffle, which must match kernel.hpp. */
+	unsigned int taxid;	/**< taxidomy ID. */
+	unsigned int sequence_count;	/**< Actual number of sequences. */
+	unsigned int character_count;	/**< Actual number of characters. */
+	unsigned int block_count;	/**< Actual number of thread blocks. */
+	unsigned int gap_count;	/**< Number of gaps. */
+	unsigned long long build;	/**< Fingerprint of the genome. */
+};
+
+/// Returns the offset of the special codon array within a packed genome file.
+static size_t scodon_offset(const unsigned int sequence_count, const unsigned int block_count, const unsigned int gap_count)
+{
+	const size_t size = sizeof(packed_header) + sizeof(unsigned int) * (sequence_count + (sequence_count + 1) + block_count + 2 * static_cast<size_t>(gap_count));
+	return (size + packed_alignment - 1) / packed_alignment * packed_alignment;
+}
+
+/**
+ * Shuffle the index of a special codon for coalesced global memory access.
+ * scodon_index can be splitted into 3 parts:
+ * scodon_index = block_index << (L + B) | thread_index << L | scodon_index;
+ * because 1) each thread block processes 1 << (L + B) special codons,
+ *     and 2) each thread processes 1 << L special codons.
+ * The scodon_index is accommodated in the lowest L bits.
+ * The thread_index is accommodated in the middle B bits.
+ * The block_index  is accommodated in the highest 32 - (L + B) bits.
+ * This program uses 1D CUDA thread organization, so at most 65,536 threads can be specified, i.e. at least 16 bits should be reserved for block_index.
+ * Therefore, the inequation 32 - (L + B) >= 16 must hold. ==> L + B <= 16.
+ * In order to satisfy coalesced global memory access, thread_index should be rearranged to the lowest B bits.
+ * To achieve this goal,
+ *         1) block_index remains at the highest 32 - (L + B) bits,
+ *   while 2) thread_index should be rearranged to the lowest B bits,
+ *     and 3) scodon_index should be rearranged to the middle L bits.
+ * Finally, scodon_index = block_index << (L + B) | scodon_index << B | thread_index;
+ * @param[in] scodon_index The index of a special codon in the original order of corpus.
+ * @return The shuffled index.
+ */
+static inline unsigned int shuffle(const unsigned int scodon_index)
+{
+	return (scodon_index & (MAX_UNSIGNED_INT ^ ((1 << (L + B)) - 1)))
+		 | ((scodon_index & ((1 << L) - 1)) << B)
+		 | ((scodon_index >> L) & ((1 << B) - 1));
+}
+
+/// Represents a FASTA file encoded into special codons in the original order of corpus.
+class encoded_file
+{
+public:
+	unsigned int character_count;	/**< Number of characters. */
+	vector<unsigned int> scodon;	/**< Special codons, the last of which has zeros in its unused bits. */
+	vector<unsigned int> headers;	/**< Character indexes of the header lines, i.e. where sequences begin. */
+	vector<pair<unsigned int, unsigned int>> gaps;	/**< Runs of N, which are encoded as G. */
+
+	/// Decompresses and encodes a gzipped FASTA file.
+	explicit encoded_file(const path& file) : character_count(0)
+	{
+		boost::filesystem::ifstream ifs(file);
+		filtering_istream fis;
+		fis.push(gzip_decompressor());
+		fis.push(ifs);
+		unsigned int scodon_buffer = 0;	// 16 consecutive characters will be accommodated into one 32-bit unsigned int.
+		string line;
+		line.reserve(1000);
+		while (getline(fis, line))
+		{
+			if (line.front() == '>') // Header line.
+			{
+				headers.push_back(character_count);
+				continue;
+			}
+			for (const auto c : line)
+			{
+				if (c == 'N' || c == 'n')
+				{
+					if (gaps.size() && gaps.back().second == character_count) ++gaps.back().second;
+					else gaps.emplace_back(character_count, character_count + 1);
+				}
+				const unsigned int character_index_lowest_four_bits = character_count & 15;
+				scodon_buffer |= encode(c) << (character_index_lowest_four_bits << 1); // Earlier characters reside in lower bits, while later characters reside in higher bits.
+				if (character_index_lowest_four_bits == 15) // The buffer is full. Flush it.
+				{
+					scodon.push_back(scodon_buffer);
+					scodon_buffer = 0;
+				}
+				++character_count;
+			}
+		}
+		if (character_count & 15) scodon.push_back(scodon_buffer);
+	}
+};
+
+path genome_source::packed_path() const
+{
+	return path(name) / (to_string(taxid) + ".pkd");
+}
+
+path genome_source::index_path() const
+{
+	return path(name) / (to_string(taxid) + ".fmi");
+}
+
+vector<genome_source> genome_sources()
+{
+	return
+	{
+		genome_source(13616, "Monodelphis domestica (opossum)", 3502390117, { "mdm_ref_MonDom5_chr1.fa.gz", "mdm_ref_MonDom5_chr2.fa.gz", "mdm_ref_MonDom5_chr3.fa.gz", "mdm_ref_MonDom5_chr4.fa.gz", "mdm_ref_MonDom5_chr5.fa.gz", "mdm_ref_MonDom5_chr6.fa.gz", "mdm_ref_MonDom5_chr7.fa.gz", "mdm_ref_MonDom5_chr8.fa.gz", "mdm_ref_MonDom5_chrX.fa.gz", "mdm_ref_MonDom5_chrMT.fa.gz" }),
+		genome_source(9598, "Pan troglodytes (chimpanzee)", 3160370125, { "ptr_ref_Pan_troglodytes-2.1.4_chr1.fa.gz", "ptr_ref_Pan_troglodytes-2.1.4_chr2A.fa.gz", "ptr_ref_Pan_troglodytes-2.1.4_chr2B.fa.gz", "ptr_ref_Pan_troglodytes-2.1.4_chr3.fa.gz", "ptr_ref_Pan_troglodytes-2.1.4_chr4.fa.gz", "ptr_ref_Pan_troglodytes-2.1.4_chr5.fa.gz", "ptr_ref_Pan_troglodytes-2.1.4_chr6.fa.gz", "ptr_ref_Pan_troglodytes-2.1.4_chr7.fa.gz", "ptr_ref_Pan_troglodytes-2.1.4_chr8.fa.gz", "ptr_ref_Pan_troglodytes-2.1.4_chr9.fa.gz", "ptr_ref_Pan_troglodytes-2.1.4_chr10.fa.gz", "ptr_ref_Pan_troglodytes-2.1.4_chr11.fa.gz", "ptr_ref_Pan_troglodytes-2.1.4_chr12.fa.gz", "ptr_ref_Pan_troglodytes-2.1.4_chr13.fa.gz", "ptr_ref_Pan_troglodytes-2.1.4_chr14.fa.gz", "ptr_ref_Pan_troglodytes-2.1.4_chr15.fa.gz", "ptr_ref_Pan_troglodytes-2.1.4_chr16.fa.gz", "ptr_ref_Pan_troglodytes-2.1.4_chr17.fa.gz", "ptr_ref_Pan_troglodytes-2.1.4_chr18.fa.gz", "ptr_ref_Pan_troglodytes-2.1.4_chr19.fa.gz", "ptr_ref_Pan_troglodytes-2.1.4_chr20.fa.gz", "ptr_ref_Pan_troglodytes-2.1.4_chr21.fa.gz", "ptr_ref_Pan_troglodytes-2.1.4_chr22.fa.gz", "ptr_ref_Pan_troglodytes-2.1.4_chrX.fa.gz", "ptr_ref_Pan_troglodytes-2.1.4_chrY.fa.gz", "ptr_ref_Pan_troglodytes-2.1.4_chrMT.fa.gz" }),
+		genome_source(9606, "Homo sapiens (human)", 3095693981, { "hs_ref_GRCh37.p5_chr1.fa.gz", "hs_ref_GRCh37.p5_chr2.fa.gz", "hs_ref_GRCh37.p5_chr3.fa.gz", "hs_ref_GRCh37.p5_chr4.fa.gz", "hs_ref_GRCh37.p5_chr5.fa.gz", "hs_ref_GRCh37.p5_chr6.fa.gz", "hs_ref_GRCh37.p5_chr7.fa.gz", "hs_ref_GRCh37.p5_chr8.fa.gz", "hs_ref_GRCh37.p5_chr9.fa.gz", "hs_ref_GRCh37.p5_chr10.fa.gz", "hs_ref_GRCh37.p5_chr11.fa.gz", "hs_ref_GRCh37.p5_chr12.fa.gz", "hs_ref_GRCh37.p5_chr13.fa.gz", "hs_ref_GRCh37.p5_chr14.fa.gz", "hs_ref_GRCh37.p5_chr15.fa.gz", "hs_ref_GRCh37.p5_chr16.fa.gz", "hs_ref_GRCh37.p5_chr17.fa.gz", "hs_ref_GRCh37.p5_chr18.fa.gz", "hs_ref_GRCh37.p5_chr19.fa.gz", "hs_ref_GRCh37.p5_chr20.fa.gz", "hs_ref_GRCh37.p5_chr21.fa.gz", "hs_ref_GRCh37.p5_chr22.fa.gz", "hs_ref_GRCh37.p5_chrX.fa.gz", "hs_ref_GRCh37.p5_chrY.fa.gz", "hs_ref_GRCh37.p5_chrMT.fa.gz" }),
+		genome_source(9601, "Pongo abelii (Sumatran orangutan)", 3029507528, { "pab_ref_P_pygmaeus_2.0.2_chr1.fa.gz", "pab_ref_P_pygmaeus_2.0.2_chr2A.fa.gz", "pab_ref_P_pygmaeus_2.0.2_chr2B.fa.gz", "pab_ref_P_pygmaeus_2.0.2_chr3.fa.gz", "pab_ref_P_pygmaeus_2.0.2_chr4.fa.gz", "pab_ref_P_pygmaeus_2.0.2_chr5.fa.gz", "pab_ref_P_pygmaeus_2.0.2_chr6.fa.gz", "pab_ref_P_pygmaeus_2.0.2_chr7.fa.gz", "pab_ref_P_pygmaeus_2.0.2_chr8.fa.gz", "pab_ref_P_pygmaeus_2.0.2_chr9.fa.gz", "pab_ref_P_pygmaeus_2.0.2_chr10.fa.gz", "pab_ref_P_pygmaeus_2.0.2_chr11.fa.gz", "pab_ref_P_pygmaeus_2.0.2_chr12.fa.gz", "pab_ref_P_pygmaeus_2.0.2_chr13.fa.gz", "pab_ref_P_pygmaeus_2.0.2_chr14.fa.gz", "pab_ref_P_pygmaeus_2.0.2_chr15.fa.gz", "pab_ref_P_pygmaeus_2.0.2_chr16.fa.gz", "pab_ref_P_pygmaeus_2.0.2_chr17.fa.gz", "pab_ref_P_pygmaeus_2.0.2_chr18.fa.gz", "pab_ref_P_pygmaeus_2.0.2_chr19.fa.gz", "pab_ref_P_pygmaeus_2.0.2_chr20.fa.gz", "pab_ref_P_pygmaeus_2.0.2_chr21.fa.gz", "pab_ref_P_pygmaeus_2.0.2_chr22.fa.gz", "pab_ref_P_pygmaeus_2.0.2_chrX.fa.gz", "pab_ref_P_pygmaeus_2.0.2_chrMT.fa.gz" }),
+		genome_source(10116, "Rattus norvegicus (rat)", 2902605281, { "rn_ref_Rnor_5.0_chr1.fa.gz", "rn_ref_Rnor_5.0_chr2.fa.gz", "rn_ref_Rnor_5.0_chr3.fa.gz", "rn_ref_Rnor_5.0_chr4.fa.gz", "rn_ref_Rnor_5.0_chr5.fa.gz", "rn_ref_Rnor_5.0_chr6.fa.gz", "rn_ref_Rnor_5.0_chr7.fa.gz", "rn_ref_Rnor_5.0_chr8.fa.gz", "rn_ref_Rnor_5.0_chr9.fa.gz", "rn_ref_Rnor_5.0_chr10.fa.gz", "rn_ref_Rnor_5.0_chr11.fa.gz", "rn_ref_Rnor_5.0_chr12.fa.gz", "rn_ref_Rnor_5.0_chr13.fa.gz", "rn_ref_Rnor_5.0_chr14.fa.gz", "rn_ref_Rnor_5.0_chr15.fa.gz", "rn_ref_Rnor_5.0_chr16.fa.gz", "rn_ref_Rnor_5.0_chr17.fa.gz", "rn_ref_Rnor_5.0_chr18.fa.gz", "rn_ref_Rnor_5.0_chr19.fa.gz", "rn_ref_Rnor_5.0_chr20.fa.gz", "rn_ref_Rnor_5.0_chrX.fa.gz", "rn_ref_Rnor_5.0_chrMT.fa.gz" }),
+		genome_source(9544, "Macaca mulatta (rhesus monkey)", 2863681749, { "mmu_ref_Mmul_051212_chr1.fa.gz", "mmu_ref_Mmul_051212_chr2.fa.gz", "mmu_ref_Mmul_051212_chr3.fa.gz", "mmu_ref_Mmul_051212_chr4.fa.gz", "mmu_ref_Mmul_051212_chr5.fa.gz", "mmu_ref_Mmul_051212_chr6.fa.gz", "mmu_ref_Mmul_051212_chr7.fa.gz", "mmu_ref_Mmul_051212_chr8.fa.gz", "mmu_ref_Mmul_051212_chr9.fa.gz", "mmu_ref_Mmul_051212_chr10.fa.gz", "mmu_ref_Mmul_051212_chr11.fa.gz", "mmu_ref_Mmul_051212_chr12.fa.gz", "mmu_ref_Mmul_051212_chr13.fa.gz", "mmu_ref_Mmul_051212_chr14.fa.gz", "mmu_ref_Mmul_051212_chr15.fa.gz", "mmu_ref_Mmul_051212_chr16.fa.gz", "mmu_ref_Mmul_051212_chr17.fa.gz", "mmu_ref_Mmul_051212_chr18.fa.gz", "mmu_ref_Mmul_051212_chr19.fa.gz", "mmu_ref_Mmul_051212_chr20.fa.gz", "mmu_ref_Mmul_051212_chrX.fa.gz", "mmu_chrMT.fa.gz" }),
+		genome_source(9483, "Callithrix jacchus (marmoset)", 2770219215, { "cja_ref_Callithrix_jacchus-3.2_chr1.fa.gz", "cja_ref_Callithrix_jacchus-3.2_chr2.fa.gz", "cja_ref_Callithrix_jacchus-3.2_chr3.fa.gz", "cja_ref_Callithrix_jacchus-3.2_chr4.fa.gz", "cja_ref_Callithrix_jacchus-3.2_chr5.fa.gz", "cja_ref_Callithrix_jacchus-3.2_chr6.fa.gz", "cja_ref_Callithrix_jacchus-3.2_chr7.fa.gz", "cja_ref_Callithrix_jacchus-3.2_chr8.fa.gz", "cja_ref_Callithrix_jacchus-3.2_chr9.fa.gz", "cja_ref_Callithrix_jacchus-3.2_chr10.fa.gz", "cja_ref_Callithrix_jacchus-3.2_chr11.fa.gz", "cja_ref_Callithrix_jacchus-3.2_chr12.fa.gz", "cja_ref_Callithrix_jacchus-3.2_chr13.fa.gz", "cja_ref_Callithrix_jacchus-3.2_chr14.fa.gz", "cja_ref_Callithrix_jacchus-3.2_chr15.fa.gz", "cja_ref_Callithrix_jacchus-3.2_chr16.fa.gz", "cja_ref_Callithrix_jacchus-3.2_chr17.fa.gz", "cja_ref_Callithrix_jacchus-3.2_chr18.fa.gz", "cja_ref_Callithrix_jacchus-3.2_chr19.fa.gz", "cja_ref_Callithrix_jacchus-3.2_chr20.fa.gz", "cja_ref_Callithrix_jacchus-3.2_chr21.fa.gz", "cja_ref_Callithrix_jacchus-3.2_chr22.fa.gz", "cja_ref_Callithrix_jacchus-3.2_chrX.fa.gz", "cja_ref_Callithrix_jacchus-3.2_chrY.fa.gz" }),
+		genome_source(10090, "Mus musculus (mouse)", 2725537669, { "mm_ref_GRCm38_chr1.fa.gz", "mm_ref_GRCm38_chr2.fa.gz", "mm_ref_GRCm38_chr3.fa.gz", "mm_ref_GRCm38_chr4.fa.gz", "mm_ref_GRCm38_chr5.fa.gz", "mm_ref_GRCm38_chr6.fa.gz", "mm_ref_GRCm38_chr7.fa.gz", "mm_ref_GRCm38_chr8.fa.gz", "mm_ref_GRCm38_chr9.fa.gz", "mm_ref_GRCm38_chr10.fa.gz", "mm_ref_GRCm38_chr11.fa.gz", "mm_ref_GRCm38_chr12.fa.gz", "mm_ref_GRCm38_chr13.fa.gz", "mm_ref_GRCm38_chr14.fa.gz", "mm_ref_GRCm38_chr15.fa.gz", "mm_ref_GRCm38_chr16.fa.gz", "mm_ref_GRCm38_chr17.fa.gz", "mm_ref_GRCm38_chr18.fa.gz", "mm_ref_GRCm38_chr19.fa.gz", "mm_ref_GRCm38_chrX.fa.gz", "mm_ref_GRCm38_chrY.fa.gz", "mm_ref_GRCm38_chrMT.fa.gz" }),
+		genome_source(9913, "Bos taurus (cow)", 2660922743, { "bt_ref_Bos_taurus_UMD_3.1_chr1.fa.gz", "bt_ref_Bos_taurus_UMD_3.1_chr2.fa.gz", "bt_ref_Bos_taurus_UMD_3.1_chr3.fa.gz", "bt_ref_Bos_taurus_UMD_3.1_chr4.fa.gz", "bt_ref_Bos_taurus_UMD_3.1_chr5.fa.gz", "bt_ref_Bos_taurus_UMD_3.1_chr6.fa.gz", "bt_ref_Bos_taurus_UMD_3.1_chr7.fa.gz", "bt_ref_Bos_taurus_UMD_3.1_chr8.fa.gz", "bt_ref_Bos_taurus_UMD_3.1_chr9.fa.gz", "bt_ref_Bos_taurus_UMD_3.1_chr10.fa.gz", "bt_ref_Bos_taurus_UMD_3.1_chr11.fa.gz", "bt_ref_Bos_taurus_UMD_3.1_chr12.fa.gz", "bt_ref_Bos_taurus_UMD_3.1_chr13.fa.gz", "bt_ref_Bos_taurus_UMD_3.1_chr14.fa.gz", "bt_ref_Bos_taurus_UMD_3.1_chr15.fa.gz", "bt_ref_Bos_taurus_UMD_3.1_chr16.fa.gz", "bt_ref_Bos_taurus_UMD_3.1_chr17.fa.gz", "bt_ref_Bos_taurus_UMD_3.1_chr18.fa.gz", "bt_ref_Bos_taurus_UMD_3.1_chr19.fa.gz", "bt_ref_Bos_taurus_UMD_3.1_chr20.fa.gz", "bt_ref_Bos_taurus_UMD_3.1_chr21.fa.gz", "bt_ref_Bos_taurus_UMD_3.1_chr22.fa.gz", "bt_ref_Bos_taurus_UMD_3.1_chr23.fa.gz", "bt_ref_Bos_taurus_UMD_3.1_chr24.fa.gz", "bt_ref_Bos_taurus_UMD_3.1_chr25.fa.gz", "bt_ref_Bos_taurus_UMD_3.1_chr26.fa.gz", "bt_ref_Bos_taurus_UMD_3.1_chr27.fa.gz", "bt_ref_Bos_taurus_UMD_3.1_chr28.fa.gz", "bt_ref_Bos_taurus_UMD_3.1_chr29.fa.gz", "bt_ref_Bos_taurus_UMD_3.1_chrX.fa.gz", "bt_ref_Bos_taurus_UMD_3.1_chrMT.fa.gz" }),
+		genome_source(9823, "Sus scrofa (pig)", 2596656069, { "ssc_ref_Sscrofa10.2_chr1.fa.gz", "ssc_ref_Sscrofa10.2_chr2.fa.gz", "ssc_ref_Sscrofa10.2_chr3.fa.gz", "ssc_ref_Sscrofa10.2_chr4.fa.gz", "ssc_ref_Sscrofa10.2_chr5.fa.gz", "ssc_ref_Sscrofa10.2_chr6.fa.gz", "ssc_ref_Sscrofa10.2_chr7.fa.gz", "ssc_ref_Sscrofa10.2_chr8.fa.gz", "ssc_ref_Sscrofa10.2_chr9.fa.gz", "ssc_ref_Sscrofa10.2_chr10.fa.gz", "ssc_ref_Sscrofa10.2_chr11.fa.gz", "ssc_ref_Sscrofa10.2_chr12.fa.gz", "ssc_ref_Sscrofa10.2_chr13.fa.gz", "ssc_ref_Sscrofa10.2_chr14.fa.gz", "ssc_ref_Sscrofa10.2_chr15.fa.gz", "ssc_ref_Sscrofa10.2_chr16.fa.gz", "ssc_ref_Sscrofa10.2_chr17.fa.gz", "ssc_ref_Sscrofa10.2_chr18.fa.gz", "ssc_ref_Sscrofa10.2_chrX.fa.gz", "ssc_ref_Sscrofa10.2_chrY.fa.gz", "ssc_ref_Sscrofa10.2_chrMT.fa.gz" }),
+		genome_source(9796, "Equus caballus (horse)", 2367070107, { "eca_ref_EquCab2.0_chr1.fa.gz", "eca_ref_EquCab2.0_chr2.fa.gz", "eca_ref_EquCab2.0_chr3.fa.gz", "eca_ref_EquCab2.0_chr4.fa.gz", "eca_ref_EquCab2.0_chr5.fa.gz", "eca_ref_EquCab2.0_chr6.fa.gz", "eca_ref_EquCab2.0_chr7.fa.gz", "eca_ref_EquCab2.0_chr8.fa.gz", "eca_ref_EquCab2.0_chr9.fa.gz", "eca_ref_EquCab2.0_chr10.fa.gz", "eca_ref_EquCab2.0_chr11.fa.gz", "eca_ref_EquCab2.0_chr12.fa.gz", "eca_ref_EquCab2.0_chr13.fa.gz", "eca_ref_EquCab2.0_chr14.fa.gz", "eca_ref_EquCab2.0_chr15.fa.gz", "eca_ref_EquCab2.0_chr16.fa.gz", "eca_ref_EquCab2.0_chr17.fa.gz", "eca_ref_EquCab2.0_chr18.fa.gz", "eca_ref_EquCab2.0_chr19.fa.gz", "eca_ref_EquCab2.0_chr20.fa.gz", "eca_ref_EquCab2.0_chr21.fa.gz", "eca_ref_EquCab2.0_chr22.fa.gz", "eca_ref_EquCab2.0_chr23.fa.gz", "eca_ref_EquCab2.0_chr24.fa.gz", "eca_ref_EquCab2.0_chr25.fa.gz", "eca_ref_EquCab2.0_chr26.fa.gz", "eca_ref_EquCab2.0_chr27.fa.gz", "eca_ref_EquCab2.0_chr28.fa.gz", "eca_ref_EquCab2.0_chr29.fa.gz", "eca_ref_EquCab2.0_chr30.fa.gz", "eca_ref_EquCab2.0_chr31.fa.gz", "eca_ref_EquCab2.0_chrX.fa.gz", "eca_ref_EquCab2.0_chrMT.fa.gz" }),
+		genome_source(9615, "Canis lupus familiaris (dog)", 2327650711, { "cfa_ref_CanFam3.1_chr1.fa.gz", "cfa_ref_CanFam3.1_chr2.fa.gz", "cfa_ref_CanFam3.1_chr3.fa.gz", "cfa_ref_CanFam3.1_chr4.fa.gz", "cfa_ref_CanFam3.1_chr5.fa.gz", "cfa_ref_CanFam3.1_chr6.fa.gz", "cfa_ref_CanFam3.1_chr7.fa.gz", "cfa_ref_CanFam3.1_chr8.fa.gz", "cfa_ref_CanFam3.1_chr9.fa.gz", "cfa_ref_CanFam3.1_chr10.fa.gz", "cfa_ref_CanFam3.1_chr11.fa.gz", "cfa_ref_CanFam3.1_chr12.fa.gz", "cfa_ref_CanFam3.1_chr13.fa.gz", "cfa_ref_CanFam3.1_chr14.fa.gz", "cfa_ref_CanFam3.1_chr15.fa.gz", "cfa_ref_CanFam3.1_chr16.fa.gz", "cfa_ref_CanFam3.1_chr17.fa.gz", "cfa_ref_CanFam3.1_chr18.fa.gz", "cfa_ref_CanFam3.1_chr19.fa.gz", "cfa_ref_CanFam3.1_chr20.fa.gz", "cfa_ref_CanFam3.1_chr21.fa.gz", "cfa_ref_CanFam3.1_chr22.fa.gz", "cfa_ref_CanFam3.1_chr23.fa.gz", "cfa_ref_CanFam3.1_chr24.fa.gz", "cfa_ref_CanFam3.1_chr25.fa.gz", "cfa_ref_CanFam3.1_chr26.fa.gz", "cfa_ref_CanFam3.1_chr27.fa.gz", "cfa_ref_CanFam3.1_chr28.fa.gz", "cfa_ref_CanFam3.1_chr29.fa.gz", "cfa_ref_CanFam3.1_chr30.fa.gz", "cfa_ref_CanFam3.1_chr31.fa.gz", "cfa_ref_CanFam3.1_chr32.fa.gz", "cfa_ref_CanFam3.1_chr33.fa.gz", "cfa_ref_CanFam3.1_chr34.fa.gz", "cfa_ref_CanFam3.1_chr35.fa.gz", "cfa_ref_CanFam3.1_chr36.fa.gz", "cfa_ref_CanFam3.1_chr37.fa.gz", "cfa_ref_CanFam3.1_chr38.fa.gz", "cfa_ref_CanFam3.1_chrX.fa.gz", "cfa_ref_CanFam3.1_chrMT.fa.gz" }),
+		genome_source(9986, "Oryctolagus cuniculus (rabbit)", 2247769349, { "ocu_ref_OryCun2.0_chr1.fa.gz", "ocu_ref_OryCun2.0_chr2.fa.gz", "ocu_ref_OryCun2.0_chr3.fa.gz", "ocu_ref_OryCun2.0_chr4.fa.gz", "ocu_ref_OryCun2.0_chr5.fa.gz", "ocu_ref_OryCun2.0_chr6.fa.gz", "ocu_ref_OryCun2.0_chr7.fa.gz", "ocu_ref_OryCun2.0_chr8.fa.gz", "ocu_ref_OryCun2.0_chr9.fa.gz", "ocu_ref_OryCun2.0_chr10.fa.gz", "ocu_ref_OryCun2.0_chr11.fa.gz", "ocu_ref_OryCun2.0_chr12.fa.gz", "ocu_ref_OryCun2.0_chr13.fa.gz", "ocu_ref_OryCun2.0_chr14.fa.gz", "ocu_ref_OryCun2.0_chr15.fa.gz", "ocu_ref_OryCun2.0_chr16.fa.gz", "ocu_ref_OryCun2.0_chr17.fa.gz", "ocu_ref_OryCun2.0_chr18.fa.gz", "ocu_ref_OryCun2.0_chr19.fa.gz", "ocu_ref_OryCun2.0_chr20.fa.gz", "ocu_ref_OryCun2.0_chr21.fa.gz", "ocu_ref_OryCun2.0_chrX.fa.gz", "ocu_chrMT.fa.gz" }),
+		genome_source(7955, "Danio rerio (zebrafish)", 1357051643, { "dr_ref_Zv9_chr1.fa.gz", "dr_ref_Zv9_chr2.fa.gz", "dr_ref_Zv9_chr3.fa.gz", "dr_ref_Zv9_chr4.fa.gz", "dr_ref_Zv9_chr5.fa.gz", "dr_ref_Zv9_chr6.fa.gz", "dr_ref_Zv9_chr7.fa.gz", "dr_ref_Zv9_chr8.fa.gz", "dr_ref_Zv9_chr9.fa.gz", "dr_ref_Zv9_chr10.fa.gz", "dr_ref_Zv9_chr11.fa.gz", "dr_ref_Zv9_chr12.fa.gz", "dr_ref_Zv9_chr13.fa.gz", "dr_ref_Zv9_chr14.fa.gz", "dr_ref_Zv9_chr15.fa.gz", "dr_ref_Zv9_chr16.fa.gz", "dr_ref_Zv9_chr17.fa.gz", "dr_ref_Zv9_chr18.fa.gz", "dr_ref_Zv9_chr19.fa.gz", "dr_ref_Zv9_chr20.fa.gz", "dr_ref_Zv9_chr21.fa.gz", "dr_ref_Zv9_chr22.fa.gz", "dr_ref_Zv9_chr23.fa.gz", "dr_ref_Zv9_chr24.fa.gz", "dr_ref_Zv9_chr25.fa.gz", "dr_ref_Zv9_chrMT.fa.gz" }),
+		genome_source(28377, "Anolis carolinensis (green anole)", 1081661814, { "acr_ref_AnoCar2.0_chr1.fa.gz", "acr_ref_AnoCar2.0_chr2.fa.gz", "acr_ref_AnoCar2.0_chr3.fa.gz", "acr_ref_AnoCar2.0_chr4.fa.gz", "acr_ref_AnoCar2.0_chr5.fa.gz", "acr_ref_AnoCar2.0_chr6.fa.gz", "acr_ref_AnoCar2.0_chra.fa.gz", "acr_ref_AnoCar2.0_chrb.fa.gz", "acr_ref_AnoCar2.0_chrc.fa.gz", "acr_ref_AnoCar2.0_chrd.fa.gz", "acr_ref_AnoCar2.0_chrf.fa.gz", "acr_ref_AnoCar2.0_chrg.fa.gz", "acr_ref_AnoCar2.0_chrh.fa.gz", "acr_ref_AnoCar2.0_chrMT.fa.gz" }),
+		genome_source(9103, "Meleagris gallopavo (turkey)", 1040303789, { "mga_ref_Turkey_2.01_chr1.fa.gz", "mga_ref_Turkey_2.01_chr2.fa.gz", "mga_ref_Turkey_2.01_chr3.fa.gz", "mga_ref_Turkey_2.01_chr4.fa.gz", "mga_ref_Turkey_2.01_chr5.fa.gz", "mga_ref_Turkey_2.01_chr6.fa.gz", "mga_ref_Turkey_2.01_chr7.fa.gz", "mga_ref_Turkey_2.01_chr8.fa.gz", "mga_ref_Turkey_2.01_chr9.fa.gz", "mga_ref_Turkey_2.01_chr10.fa.gz", "mga_ref_Turkey_2.01_chr11.fa.gz", "mga_ref_Turkey_2.01_chr12.fa.gz", "mga_ref_Turkey_2.01_chr13.fa.gz", "mga_ref_Turkey_2.01_chr14.fa.gz", "mga_ref_Turkey_2.01_chr15.fa.gz", "mga_ref_Turkey_2.01_chr16.fa.gz", "mga_ref_Turkey_2.01_chr17.fa.gz", "mga_ref_Turkey_2.01_chr18.fa.gz", "mga_ref_Turkey_2.01_chr19.fa.gz", "mga_ref_Turkey_2.01_chr20.fa.gz", "mga_ref_Turkey_2.01_chr21.fa.gz", "mga_ref_Turkey_2.01_chr22.fa.gz", "mga_ref_Turkey_2.01_chr23.fa.gz", "mga_ref_Turkey_2.01_chr24.fa.gz", "mga_ref_Turkey_2.01_chr25.fa.gz", "mga_ref_Turkey_2.01_chr26.fa.gz", "mga_ref_Turkey_2.01_chr27.fa.gz", "mga_ref_Turkey_2.01_chr28.fa.gz", "mga_ref_Turkey_2.01_chr29.fa.gz", "mga_ref_Turkey_2.01_chr30.fa.gz", "mga_ref_Turkey_2.01_chrW.fa.gz", "mga_ref_Turkey_2.01_chrZ.fa.gz", "mga_ref_Turkey_2.01_chrMT.fa.gz" }),
+		genome_source(59729, "Taeniopygia guttata (Zebra finch)", 1021462940, { "tgu_ref_chr1.fa.gz", "tgu_ref_chr1A.fa.gz", "tgu_ref_chr1B.fa.gz", "tgu_ref_chr2.fa.gz", "tgu_ref_chr3.fa.gz", "tgu_ref_chr4.fa.gz", "tgu_ref_chr4A.fa.gz", "tgu_ref_chr5.fa.gz", "tgu_ref_chr6.fa.gz", "tgu_ref_chr7.fa.gz", "tgu_ref_chr8.fa.gz", "tgu_ref_chr9.fa.gz", "tgu_ref_chr10.fa.gz", "tgu_ref_chr11.fa.gz", "tgu_ref_chr12.fa.gz", "tgu_ref_chr13.fa.gz", "tgu_ref_chr14.fa.gz", "tgu_ref_chr15.fa.gz", "tgu_ref_chr16.fa.gz", "tgu_ref_chr17.fa.gz", "tgu_ref_chr18.fa.gz", "tgu_ref_chr19.fa.gz", "tgu_ref_chr20.fa.gz", "tgu_ref_chr21.fa.gz", "tgu_ref_chr22.fa.gz", "tgu_ref_chr23.fa.gz", "tgu_ref_chr24.fa.gz", "tgu_ref_chr25.fa.gz", "tgu_ref_chr26.fa.gz", "tgu_ref_chr27.fa.gz", "tgu_ref_chr28.fa.gz", "tgu_ref_chrZ.fa.gz", "tgu_ref_chrLG2.fa.gz", "tgu_ref_chrLG5.fa.gz", "tgu_ref_chrLGE22.fa.gz" }),
+		genome_source(9031, "Gallus gallus (chicken)", 1004818361, { "gga_ref_Gallus_gallus-4.0_chr1.fa.gz", "gga_ref_Gallus_gallus-4.0_chr2.fa.gz", "gga_ref_Gallus_gallus-4.0_chr3.fa.gz", "gga_ref_Gallus_gallus-4.0_chr4.fa.gz", "gga_ref_Gallus_gallus-4.0_chr5.fa.gz", "gga_ref_Gallus_gallus-4.0_chr6.fa.gz", "gga_ref_Gallus_gallus-4.0_chr7.fa.gz", "gga_ref_Gallus_gallus-4.0_chr8.fa.gz", "gga_ref_Gallus_gallus-4.0_chr9.fa.gz", "gga_ref_Gallus_gallus-4.0_chr10.fa.gz", "gga_ref_Gallus_gallus-4.0_chr11.fa.gz", "gga_ref_Gallus_gallus-4.0_chr12.fa.gz", "gga_ref_Gallus_gallus-4.0_chr13.fa.gz", "gga_ref_Gallus_gallus-4.0_chr14.fa.gz", "gga_ref_Gallus_gallus-4.0_chr15.fa.gz", "gga_ref_Gallus_gallus-4.0_chr16.fa.gz", "gga_ref_Gallus_gallus-4.0_chr17.fa.gz", "gga_ref_Gallus_gallus-4.0_chr18.fa.gz", "gga_ref_Gallus_gallus-4.0_chr19.fa.gz", "gga_ref_Gallus_gallus-4.0_chr20.fa.gz", "gga_ref_Gallus_gallus-4.0_chr21.fa.gz", "gga_ref_Gallus_gallus-4.0_chr22.fa.gz", "gga_ref_Gallus_gallus-4.0_chr23.fa.gz", "gga_ref_Gallus_gallus-4.0_chr24.fa.gz", "gga_ref_Gallus_gallus-4.0_chr25.fa.gz", "gga_ref_Gallus_gallus-4.0_chr26.fa.gz", "gga_ref_Gallus_gallus-4.0_chr27.fa.gz", "gga_ref_Gallus_gallus-4.0_chr28.fa.gz", "gga_ref_Gallus_gallus-4.0_chr32.fa.gz", "gga_ref_Gallus_gallus-4.0_chrW.fa.gz", "gga_ref_Gallus_gallus-4.0_chrZ.fa.gz", "gga_ref_Gallus_gallus-4.0_chrLGE22C19W28_E50C23.fa.gz", "gga_ref_Gallus_gallus-4.0_chrLGE64.fa.gz", "gga_ref_Gallus_gallus-4.0_chrMT.fa.gz" }),
+		genome_source(3847, "Glycine max (soybean)", 950221025, { "gma_ref_V1.0_chr1.fa.gz", "gma_ref_V1.0_chr2.fa.gz", "gma_ref_V1.0_chr3.fa.gz", "gma_ref_V1.0_chr4.fa.gz", "gma_ref_V1.0_chr5.fa.gz", "gma_ref_V1.0_chr6.fa.gz", "gma_ref_V1.0_chr7.fa.gz", "gma_ref_V1.0_chr8.fa.gz", "gma_ref_V1.0_chr9.fa.gz", "gma_ref_V1.0_chr10.fa.gz", "gma_ref_V1.0_chr11.fa.gz", "gma_ref_V1.0_chr12.fa.gz", "gma_ref_V1.0_chr13.fa.gz", "gma_ref_V1.0_chr14.fa.gz", "gma_ref_V1.0_chr15.fa.gz", "gma_ref_V1.0_chr16.fa.gz", "gma_ref_V1.0_chr17.fa.gz", "gma_ref_V1.0_chr18.fa.gz", "gma_ref_V1.0_chr19.fa.gz", "gma_ref_V1.0_chr20.fa.gz", "gma_ref_V1.0_chrPltd.fa.gz" }),
+		genome_source(9258, "Ornithorhynchus anatinus (platypus)", 437097043, { "oan_ref_Ornithorhynchus_anatinus_5.0.1_chr1.fa.gz", "oan_ref_Ornithorhynchus_anatinus_5.0.1_chr2.fa.gz", "oan_ref_Ornithorhynchus_anatinus_5.0.1_chr3.fa.gz", "oan_ref_Ornithorhynchus_anatinus_5.0.1_chr4.fa.gz", "oan_ref_Ornithorhynchus_anatinus_5.0.1_chr5.fa.gz", "oan_ref_Ornithorhynchus_anatinus_5.0.1_chr6.fa.gz", "oan_ref_Ornithorhynchus_anatinus_5.0.1_chr7.fa.gz", "oan_ref_Ornithorhynchus_anatinus_5.0.1_chr10.fa.gz", "oan_ref_Ornithorhynchus_anatinus_5.0.1_chr11.fa.gz", "oan_ref_Ornithorhynchus_anatinus_5.0.1_chr12.fa.gz", "oan_ref_Ornithorhynchus_anatinus_5.0.1_chr14.fa.gz", "oan_ref_Ornithorhynchus_anatinus_5.0.1_chr15.fa.gz", "oan_ref_Ornithorhynchus_anatinus_5.0.1_chr17.fa.gz", "oan_ref_Ornithorhynchus_anatinus_5.0.1_chr18.fa.gz", "oan_ref_Ornithorhynchus_anatinus_5.0.1_chr20.fa.gz", "oan_ref_Ornithorhynchus_anatinus_5.0.1_chrX1.fa.gz", "oan_ref_Ornithorhynchus_anatinus_5.0.1_chrX2.fa.gz", "oan_ref_Ornithorhynchus_anatinus_5.0.1_chrX3.fa.gz", "oan_ref_Ornithorhynchus_anatinus_5.0.1_chrX5.fa.gz", "oan_ref_Ornithorhynchus_anatinus_5.0.1_chrMT.fa.gz" }),
+		genome_source(29760, "Vitis vinifera (wine grape)", 427110216, { "vvi_ref_12X_chr1.fa.gz", "vvi_ref_12X_chr2.fa.gz", "vvi_ref_12X_chr3.fa.gz", "vvi_ref_12X_chr4.fa.gz", "vvi_ref_12X_chr5.fa.gz", "vvi_ref_12X_chr6.fa.gz", "vvi_ref_12X_chr7.fa.gz", "vvi_ref_12X_chr8.fa.gz", "vvi_ref_12X_chr9.fa.gz", "vvi_ref_12X_chr10.fa.gz", "vvi_ref_12X_chr11.fa.gz", "vvi_ref_12X_chr12.fa.gz", "vvi_ref_12X_chr13.fa.gz", "vvi_ref_12X_chr14.fa.gz", "vvi_ref_12X_chr15.fa.gz", "vvi_ref_12X_chr16.fa.gz", "vvi_ref_12X_chr17.fa.gz", "vvi_ref_12X_chr18.fa.gz", "vvi_ref_12X_chr19.fa.gz", "vvi_ref_12X_chrMT.fa.gz", "vvi_ref_12X_chrPltd.fa.gz" }),
+		genome_source(15368, "Brachypodium distachyon", 271283624, { "bdi_ref_v1.0_chr1.fa.gz", "bdi_ref_v1.0_chr2.fa.gz", "bdi_ref_v1.0_chr3.fa.gz", "bdi_ref_v1.0_chr4.fa.gz", "bdi_ref_v1.0_chr5.fa.gz", "bdi_ref_v1.0_chrPltd.fa.gz" }),
+		genome_source(7460, "Apis mellifera (honey bee)", 219645955, { "ame_ref_Amel_4.5_chrLG1.fa.gz", "ame_ref_Amel_4.5_chrLG2.fa.gz", "ame_ref_Amel_4.5_chrLG3.fa.gz", "ame_ref_Amel_4.5_chrLG4.fa.gz", "ame_ref_Amel_4.5_chrLG5.fa.gz", "ame_ref_Amel_4.5_chrLG6.fa.gz", "ame_ref_Amel_4.5_chrLG7.fa.gz", "ame_ref_Amel_4.5_chrLG8.fa.gz", "ame_ref_Amel_4.5_chrLG9.fa.gz", "ame_ref_Amel_4.5_chrLG10.fa.gz", "ame_ref_Amel_4.5_chrLG11.fa.gz", "ame_ref_Amel_4.5_chrLG12.fa.gz", "ame_ref_Amel_4.5_chrLG13.fa.gz", "ame_ref_Amel_4.5_chrLG14.fa.gz", "ame_ref_Amel_4.5_chrLG15.fa.gz", "ame_ref_Amel_4.5_chrLG16.fa.gz", "ame_ref_Amel_4.5_chrMT.fa.gz" }),
+		genome_source(30195, "Bombus terrestris (buff-tailed bumblebee)", 216849342, { "bte_ref_Bter_1.0_chrLG_B01.fa.gz", "bte_ref_Bter_1.0_chrLG_B02.fa.gz", "bte_ref_Bter_1.0_chrLG_B03.fa.gz", "bte_ref_Bter_1.0_chrLG_B04.fa.gz", "bte_ref_Bter_1.0_chrLG_B05.fa.gz", "bte_ref_Bter_1.0_chrLG_B06.fa.gz", "bte_ref_Bter_1.0_chrLG_B07.fa.gz", "bte_ref_Bter_1.0_chrLG_B08.fa.gz", "bte_ref_Bter_1.0_chrLG_B09.fa.gz", "bte_ref_Bter_1.0_chrLG_B10.fa.gz", "bte_ref_Bter_1.0_chrLG_B11.fa.gz", "bte_ref_Bter_1.0_chrLG_B12.fa.gz", "bte_ref_Bter_1.0_chrLG_B13.fa.gz", "bte_ref_Bter_1.0_chrLG_B14.fa.gz", "bte_ref_Bter_1.0_chrLG_B15.fa.gz", "bte_ref_Bter_1.0_chrLG_B16.fa.gz", "bte_ref_Bter_1.0_chrLG_B17.fa.gz", "bte_ref_Bter_1.0_chrLG_B18.fa.gz" }),
+		genome_source(7425, "Nasonia vitripennis (jewel wasp)", 191717756, { "nvi_ref_Nvit_2.0_chr1.fa.gz", "nvi_ref_Nvit_2.0_chr2.fa.gz", "nvi_ref_Nvit_2.0_chr3.fa.gz", "nvi_ref_Nvit_2.0_chr4.fa.gz", "nvi_ref_Nvit_2.0_chr5.fa.gz" }),
+		genome_source(7070, "Tribolium castaneum (red flour beetle)", 187494969, { "tca_ref_chrLG1=X.fa.gz", "tca_ref_chrLG2.fa.gz", "tca_ref_chrLG3.fa.gz", "tca_ref_chrLG4.fa.gz", "tca_ref_chrLG5.fa.gz", "tca_ref_chrLG6.fa.gz", "tca_ref_chrLG7.fa.gz", "tca_ref_chrLG8.fa.gz", "tca_ref_chrLG9.fa.gz", "tca_ref_chrLG10.fa.gz" })
+	};
+}
+
+genome::genome(const genome_source& source, const unsigned int num_threads) :
+	taxid(source.taxid),
+	name(source.name),
+	sequence_count(source.files.size()),
+	character_count(source.character_count),
+	sequence_length(sequence_count),
+	sequence_cumulative_length(sequence_count + 1),
+	scodon_count((character_count + 16 - 1) >> 4),
+	block_count((scodon_count + (1 << (L + B)) - 1) >> (L + B)),
+	block_to_sequence(block_count),
+	gap_blocks(block_count),
+	scodon_buffer(scodon_size())
+{
+	scodon = scodon_buffer.data();
+	sequence_cumulative_length[0] = 0;
+
+	// Decompress and encode the files in parallel.
+	const path genome_path = name;
+	vector<unique_ptr<encoded_file>> encoded_files(source.files.size());
+	atomic<size_t> next_file(0);
+	vector<thread> threads;
+	for (unsigned int i = 0; i < min<size_t>(max(num_threads, 1u), source.files.size()); ++i)
+	{
+		threads.emplace_back([&]()
+		{
+			for (size_t f; (f = next_file++) < source.files.size();)
+			{
+				encoded_files[f].reset(new encoded_file(genome_path / source.files[f]));
+			}
+		});
+	}
+	for (auto& t : threads) t.join();
+
+	// Concatenate the files into the shuffled special codon array. A file that does not begin at a multiple of 16 characters straddles special codons.
+	int sequence_index = -1;	// Index of the current sequence.
+	unsigned int character_index = 0;	// Index of the current character across all the sequences of the entire genome.
+	for (auto& f : encoded_files)
+	{
+		for (const auto header : f->headers)
+		{
+			if (++sequence_index) sequence_cumulative_length[sequence_index] = character_index + header; // Not the first sequence.
+		}
+		for (const auto& gap : f->gaps)
+		{
+			if (gaps.size() && gaps.back().second == character_index + gap.first) gaps.back().second = character_index + gap.second; // The gap continues from the previous file.
+			else gaps.emplace_back(character_index + gap.first, character_index + gap.second);
+		}
+		BOOST_ASSERT(character_index + f->character_count <= character_count);
+		const unsigned int scodon_base_index = character_index >> 4;
+		const unsigned int shift = (character_index & 15) << 1;
+		for (unsigned int i = 0; i < f->scodon.size(); ++i)
+		{
+			scodon_buffer[shuffle(scodon_base_index + i)] |= f->scodon[i] << shift;
+			if (shift && (f->scodon[i] >> (32 - shift))) scodon_buffer[shuffle(scodon_base_index + i + 1)] |= f->scodon[i] >> (32 - shift);
+		}
+		character_index += f->character_count;
+		f.reset();
+	}
+	BOOST_ASSERT(character_count == character_index);
+	BOOST_ASSERT(sequence_count == sequence_index + 1);
+	sequence_cumulative_length[sequence_count] = character_count;
+	index_sequences();
+	index_gaps();
+	fingerprint();
+}
+
+genome::genome(const genome_source& source, const path& packed_path) : name(source.name), scodon(nullptr), packed_file(packed_path.string())
+{
+	const char* const data = packed_file.data();
+	if (packed_file.size() < sizeof(packed_header)) throw runtime_error(packed_path.string() + " is truncated");
+	const packed_header& header = *reinterpret_cast<const packed_header*>(data);
+	if (!equal(packed_magic, packed_magic + sizeof(packed_magic), header.magic) || header.version != packed_version) throw runtime_error(packed_path.string() + " is not a packed genome file of version " + to_string(packed_version));
+	if (header.l_plus_b != L + B) throw runtime_error(packed_path.string() + " was packed for L + B = " + to_string(header.l_plus_b));
+	if (header.taxid != source.taxid || header.character_count != source.character_count) throw runtime_error(packed_path.string() + " does not match the genome of taxid " + to_string(source.taxid));
+	taxid = header.taxid;
+	build = header.build;
+	sequence_count = header.sequence_count;
+	character_count = header.character_count;
+	scodon_count = (character_count + 16 - 1) >> 4;
+	block_count = header.block_count;
+	if (block_count != (scodon_count + (1 << (L + B)) - 1) >> (L + B) || packed_file.size() != scodon_offset(sequence_count, block_count, header.gap_count) + sizeof(unsigned int) * scodon_size()) throw runtime_error(packed_path.string() + " is truncated");
+	const unsigned int* const arrays = reinterpret_cast<const unsigned int*>(data + sizeof(packed_header));
+	sequence_length.assign(arrays, arrays + sequence_count);
+	sequence_cumulative_length.assign(arrays + sequence_count, arrays + sequence_count + sequence_count + 1);
+	block_to_sequence.assign(arrays + sequence_count + sequence_count + 1, arrays + sequence_count + sequence_count + 1 + block_count);
+	const unsigned int* const gap_array = arrays + sequence_count + sequence_count + 1 + block_count;
+	gaps.resize(header.gap_count);
+	for (unsigned int i = 0; i < header.gap_count; ++i) gaps[i] = make_pair(gap_array[i << 1], gap_array[(i << 1) + 1]);
+	scodon = reinterpret_cast<const unsigned int*>(data + scodon_offset(sequence_count, block_count, header.gap_count));
+	gap_blocks.resize(block_count);
+	index_gaps();
+}
+
+genome::genome(const string& name, const string& characters, vector<unsigned int>&& sequence_cumulative_length) :
+	taxid(0),
+	build(0),
+	name(name),
+	sequence_count(sequence_cumulative_length.size() - 1),
+	character_count(characters.size()),
+	sequence_length(sequence_count),
+	sequence_cumulative_length(move(sequence_cumulative_length)),
+	scodon_count((character_count + 16 - 1) >> 4),
+	block_count((scodon_count + (1 << (L + B)) - 1) >> (L + B)),
+	block_to_sequence(block_count),
+	gap_blocks(block_count),
+	scodon_buffer(scodon_size())
+{
+	BOOST_ASSERT(this->sequence_cumulative_length.front() == 0 && this->sequence_cumulative_length.back() == character_count);
+	scodon = scodon_buffer.data();
+	for (unsigned int character_index = 0; character_index < character_count; ++character_index)
+	{
+		const char c = characters[character_index];
+		if (c == 'N' || c == 'n')
+		{
+			if (gaps.size() && gaps.back().second == character_index) ++gaps.back().second;
+			else gaps.emplace_back(character_index, character_index + 1);
+		}
+		scodon_buffer[shuffle(character_index >> 4)] |= encode(c) << ((character_index & 15) << 1);
+	}
+	index_sequences();
+	index_gaps();
+}
+
+void genome::save(const path& packed_path) const
+{
+	// Write into a temporary file first, and then rename it, so that the daemon never maps a partially written file.
+	const path tmp_path = packed_path.string() + ".tmp";
+	{
+		boost::filesystem::ofstream ofs(tmp_path, ios::binary);
+		packed_header header;
+		copy(packed_magic, packed_magic + sizeof(packed_magic), header.magic);
+		header.version = packed_version;
+		header.l_plus_b = L + B;
+		header.taxid = taxid;
+		header.sequence_count = sequence_count;
+		header.character_count = character_count;
+		header.block_count = block_count;
+		header.gap_count = gaps.size();
+		header.build = build;
+		ofs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		ofs.write(reinterpret_cast<const char*>(sequence_length.data()), sizeof(unsigned int) * sequence_length.size());
+		ofs.write(reinterpret_cast<const char*>(sequence_cumulative_length.data()), sizeof(unsigned int) * sequence_cumulative_length.size());
+		ofs.write(reinterpret_cast<const char*>(block_to_sequence.data()), sizeof(unsigned int) * block_to_sequence.size());
+		for (const auto& gap : gaps)
+		{
+			ofs.write(reinterpret_cast<const char*>(&gap.first), sizeof(unsigned int));
+			ofs.write(reinterpret_cast<const char*>(&gap.second), sizeof(unsigned int));
+		}
+		const vector<char> padding(scodon_offset(sequence_count, block_count, gaps.size()) - static_cast<size_t>(ofs.tellp()), 0);
+		ofs.write(padding.data(), padding.size());
+		ofs.write(reinterpret_cast<const char*>(scodon), sizeof(unsigned int) * scodon_size());
+		if (!ofs) throw runtime_error("Failed to write " + tmp_path.string());
+	}
+	rename(tmp_path, packed_path);
+}
+
+void genome::fingerprint()
+{
+	// Mix the sequence boundaries, the gaps and the special codons 32 bits at a time by FNV-1a, which is fast enough to run once per load.
+	build = 14695981039346656037ULL;
+	const auto mix = [&](const unsigned int word)
+	{
+		build ^= word;
+		build *= 1099511628211ULL;
+	};
+	for (const auto length : sequence_cumulative_length) mix(length);
+	for (const auto& gap : gaps)
+	{
+		mix(gap.first);
+		mix(gap.second);
+	}
+	for (size_t i = 0; i < scodon_size(); ++i) mix(scodon[i]);
+}
+
+unsigned int genome::character(const unsigned int character_index) const
+{
+	return (scodon[shuffle(character_index >> 4)] >> ((character_index & 15) << 1)) & 3;
+}
+
+void genome::index_sequences()
+{
+	for (unsigned int sequence = 0; sequence < sequence_count; ++sequence)
+	{
+		sequence_length[sequence] = sequence_cumulative_length[sequence + 1] - sequence_cumulative_length[sequence];
+	}
+
+	// Calculate thread block to sequence index mapping.
+	for (unsigned int block = 0, character = 0, sequence = 0; block < block_count; ++block)
+	{
+		while (character >= sequence_cumulative_length[sequence + 1]) ++sequence;
+		block_to_sequence[block] = sequence;
+		character += (1 << (L + B + 4)); // One thread block processes 1 << (L + B) special codons, and each special codon encodes 1 << 4 characters.
+	}
+}
+
+void genome::index_gaps()
+{
+	// A thread block reports the matches ending within its characters and within the overlapping zone of its last thread, which is shorter than a thread.
+	// It is a gap block if all of them lie within a single gap.
+	for (unsigned int block = 0; block < block_count; ++block)
+	{
+		const unsigned int begin = block << (L + B + 4);
+		const unsigned int end = min<size_t>(character_count, (static_cast<size_t>(block + 1) << (L + B + 4)) + (1 << (L + 4)));
+		const auto gap = upper_bound(gaps.begin(), gaps.end(), make_pair(begin, ~0u));
+		gap_blocks[block] = gap != gaps.begin() && prev(gap)->second >= end;
+	}
+}
+
+bool genome::overlaps_gap(const unsigned int begin, const unsigned int end) const
+{
+	const auto gap = lower_bound(gaps.begin(), gaps.end(), make_pair(end, 0u));
+	return gap != gaps.begin() && prev(gap)->second > begin;
+}
+
+unsigned int genome::gap_end(const unsigned int character_index) const
+{
+	const auto gap = upper_bound(gaps.begin(), gaps.end(), character_index, [](const unsigned int i, const pair<unsigned int, unsigned int>& g)
+	{
+		return i < g.second;
+	});
+	return gap == gaps.begin() ? 0 : prev(gap)->second;
+}
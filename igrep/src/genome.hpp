@@ -0,0 +1,140 @@
+#pragma once
+#ifndef IGREP_GENOME_HPP
+#define IGREP_GENOME_HPP
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <memory>
+#include <boost/filesystem/path.hpp>
+#include <boost/iostreams/device/mapped_file.hpp>
+#include "kernel.hpp"
+using namespace std;
+using boost::filesystem::path;
+
+/**
+ * Encode a character to its 2-bit binary representation.
+ * The last two but one bits are different for A, C, G, and T respectively.
+ * Note that some genomes contain 'N', which will be treated as 'G' in this encoding function.
+ *
+ * 'A' = 65 = 01000<b>00</b>1
+ *
+ * 'C' = 67 = 01000<b>01</b>1
+ *
+ * 'G' = 71 = 01000<b>11</b>1
+ *
+ * 'N' = 78 = 01001<b>11</b>0
+ *
+ * 'T' = 84 = 01010<b>10</b>0
+ * @param[in] character The character to be encoded.
+ * @return The 2-bit binary representation of given character.
+ */
+inline unsigned int encode(char character)
+{
+	return (toupper(character) >> 1) & 3;
+}
+
+/// Describes a genome in FASTA format, whose gzipped files reside in the directory named after the genome.
+class genome_source
+{
+public:
+	unsigned int taxid;	/**< taxidomy ID. */
+	string name;	/**< Scientific name followed by common name in brackets, e.g. Homo sapiens (Human). */
+	unsigned int character_count;	/**< Number of characters. */
+	vector<string> files;	/**< FASTA files. For assembled genomes, each file is one sequence. */
+
+	/// Constructs a genome source.
+	explicit genome_source(const unsigned int taxid, const string& name, const unsigned int character_count, vector<string>&& files) : taxid(taxid), name(name), character_count(character_count), files(move(files)) {}
+
+	/// Returns the path to the packed file of the genome, i.e. <name>/<taxid>.pkd.
+	path packed_path() const;
+
+	/// Returns the path to the index file of the genome, i.e. <name>/<taxid>.fmi.
+	path index_path() const;
+};
+
+class genome_index;
+
+/// Returns the genomes that igrep searches.
+vector<genome_source> genome_sources();
+
+/// Represents a genome packed into shuffled special codons.
+class genome
+{
+public:
+	unsigned int taxid;	/**< taxidomy ID. */
+	unsigned long long build;	/**< Fingerprint of the sequences, gaps and special codons, which identifies the build of the genome, e.g. to key cached matches, and is written into its packed file by igrep_pack. It is 0 for a genome constructed from characters in memory. */
+	string name;	/**< Genome name. */
+	unsigned int sequence_count;	/**< Actual number of sequences. */
+	unsigned int character_count;	/**< Actual number of characters. */
+	vector<unsigned int> sequence_length;	/**< Lengthes of sequences. */
+	vector<unsigned int> sequence_cumulative_length;	/**< Cumulative lengths of sequences, i.e. 1) sequence_cumulative_length[0] = 0; 2) sequence_cumulative_length[sequence_index + 1] = sequence_cumulative_length[sequence_index] + sequence_length[sequence_index]; */
+	unsigned int scodon_count;	/**< Actual number of special codons. */
+	unsigned int block_count;	/**< Actual number of thread blocks. */
+	const unsigned int *scodon;	/**< The entire genomic nucleotides are stored into this array of block_count << (L + B) elements, one element of which, i.e. one 32-bit unsigned int, can store up to 16 nucleotides because one nucleotide can be uniquely represented by two bits since it must be either A, C, G, or T. One unsigned int is called a special codon, or scodon for short, because it is similar to codon, in which three consecutive characters of mRNA determine one amino acid of resulting protein. */
+	vector<unsigned int> block_to_sequence;	/**< Mapping of thread blocks to sequences. */
+	vector<pair<unsigned int, unsigned int>> gaps;	/**< The runs of N, e.g. assembly gaps, as ascending and disjoint character intervals [begin, end). N is encoded as G, so the special codons alone do not tell them apart. */
+	vector<unsigned char> gap_blocks;	/**< Whether each thread block lies within a gap, in which case it cannot report valid matches and is not scanned. */
+	shared_ptr<const genome_index> index;	/**< The FM-index of the genome if it has been built by igrep_index, or nullptr. */
+
+	/**
+	 * Construct a genome by loading its gzipped FASTA files, which are decompressed and encoded in parallel.
+	 * @param[in] source The genome source.
+	 * @param[in] num_threads Number of files to decompress concurrently.
+	 */
+	explicit genome(const genome_source& source, const unsigned int num_threads);
+
+	/**
+	 * Construct a genome by mapping its packed file into memory. The special codons are paged in on demand.
+	 * Throws runtime_error if the file is not a packed file of the genome.
+	 * @param[in] source The genome source.
+	 * @param[in] packed_path The packed file.
+	 */
+	explicit genome(const genome_source& source, const path& packed_path);
+
+	/**
+	 * Construct a genome from characters in memory, e.g. a chunk of a FASTA file that is searched without being packed beforehand.
+	 * @param[in] name The genome name.
+	 * @param[in] characters The characters of all the sequences, concatenated.
+	 * @param[in] sequence_cumulative_length Cumulative lengths of the sequences, beginning with 0 and ending with the number of characters.
+	 */
+	explicit genome(const string& name, const string& characters, vector<unsigned int>&& sequence_cumulative_length);
+
+	/// Writes the genome into a packed file.
+	void save(const path& packed_path) const;
+
+	/// Returns the 2-bit representation of a character, which is read from its shuffled special codon.
+	unsigned int character(const unsigned int character_index) const;
+
+	/// Returns true if any of the characters [begin, end) lies within a gap.
+	bool overlaps_gap(const unsigned int begin, const unsigned int end) const;
+
+	/// Returns the end of the last gap that ends at or before a character index, or 0 if there is none.
+	unsigned int gap_end(const unsigned int character_index) const;
+
+	/// Returns the number of special codons including the padding of the last block.
+	size_t scodon_size() const
+	{
+		return static_cast<size_t>(block_count) << (L + B);
+	}
+
+	/// Default move constructor, which keeps the special codon array in place.
+	genome(genome&&) = default;
+	/// Default move assignment operator, which keeps the special codon array in place.
+	genome& operator=(genome&&) = default;
+
+private:
+	vector<unsigned int> scodon_buffer;	/**< The special codon array of a genome loaded from FASTA files. */
+	boost::iostreams::mapped_file_source packed_file;	/**< The mapped packed file of a genome loaded from it. */
+
+	/// Calculates the sequence lengths and the mapping of thread blocks to sequences from the cumulative lengths of sequences.
+	void index_sequences();
+
+	/// Flags the thread blocks that lie within gaps.
+	void index_gaps();
+
+	/// Calculates the fingerprint of the genome.
+	void fingerprint();
+};
+
+#endif
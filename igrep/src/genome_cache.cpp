@@ -0,0 +1,107 @@
+#include <cstdlib>
+#include <sstream>
+#include <iomanip>
+#include <unistd.h>
+#include <boost/filesystem/operations.hpp>
+#include "genome_cache.hpp"
+#include "genome_index.hpp"
+
+size_t genome_cache::default_budget()
+{
+	if (const char* const budget_mb = getenv("IGREP_MEMORY_BUDGET"))
+	{
+		return static_cast<size_t>(atof(budget_mb) * (1 << 20));
+	}
+	return static_cast<size_t>(sysconf(_SC_PHYS_PAGES)) * static_cast<size_t>(sysconf(_SC_PAGESIZE)) / 4 * 3;
+}
+
+size_t genome_cache::footprint(const genome_source& source)
+{
+	const size_t scodon_count = (static_cast<size_t>(source.character_count) + 16 - 1) >> 4;
+	const size_t block_count = (scodon_count + (1 << (L + B)) - 1) >> (L + B);
+	const path index_path = source.index_path();
+	return sizeof(unsigned int) * ((block_count << (L + B)) + (source.files.size() << 1) + 1 + block_count) + (exists(index_path) ? file_size(index_path) : 0);
+}
+
+genome_cache::genome_cache(vector<genome_source>&& sources, const size_t budget_bytes, const unsigned int num_threads, const function<void(const string&)>& log) : sources(move(sources)), budget_bytes(budget_bytes), num_threads(num_threads), log(log), resident(0)
+{
+}
+
+const genome_source* genome_cache::find(const unsigned int taxid) const
+{
+	for (const auto& source : sources)
+	{
+		if (source.taxid == taxid) return &source;
+	}
+	return nullptr;
+}
+
+shared_ptr<const genome> genome_cache::acquire(const unsigned int taxid)
+{
+	const genome_source* const source = find(taxid);
+	BOOST_ASSERT(source);
+
+	// Move a resident genome to the front.
+	for (auto it = lru.begin(); it != lru.end(); ++it)
+	{
+		if (get<0>(*it) != source) continue;
+		lru.splice(lru.begin(), lru, it);
+		return get<1>(lru.front());
+	}
+
+	// Evict the least recently used genomes until the new one fits. A genome still held by a caller is released when the caller drops it.
+	const double mb = 1.0 / (1 << 20);
+	const size_t bytes = footprint(*source);
+	while (!lru.empty() && resident + bytes > budget_bytes)
+	{
+		ostringstream oss;
+		oss.setf(ios::fixed, ios::floatfield);
+		oss << "Evicting the genome of " << get<0>(lru.back())->name << " of " << setprecision(1) << get<2>(lru.back()) * mb << " MB";
+		log(oss.str());
+		resident -= get<2>(lru.back());
+		lru.pop_back();
+	}
+
+	// Map the packed file of the genome, or load its FASTA files if it has not been packed by igrep_pack.
+	shared_ptr<genome> g;
+	const path packed_path = source->packed_path();
+	if (exists(packed_path))
+	{
+		try
+		{
+			log("Mapping the genome of " + source->name);
+			g = make_shared<genome>(*source, packed_path);
+		}
+		catch (const exception& e)
+		{
+			log(e.what());
+		}
+	}
+	if (!g)
+	{
+		log("Loading the genome of " + source->name);
+		g = make_shared<genome>(*source, num_threads);
+	}
+
+	// Map the index file of the genome if it has been built by igrep_index.
+	const path index_path = source->index_path();
+	if (exists(index_path))
+	{
+		try
+		{
+			log("Mapping the index of " + source->name);
+			g->index = make_shared<const genome_index>(*g, index_path);
+		}
+		catch (const exception& e)
+		{
+			log(e.what());
+		}
+	}
+	lru.emplace_front(source, g, bytes);
+	resident += bytes;
+	ostringstream oss;
+	oss.setf(ios::fixed, ios::floatfield);
+	oss << lru.size() << " genomes of " << setprecision(1) << resident * mb << " MB are resident out of " << budget_bytes * mb << " MB of budget";
+	log(oss.str());
+	return g;
+}
@@ -0,0 +1,60 @@
+#pragma once
+#ifndef IGREP_GENOME_CACHE_HPP
+#define IGREP_GENOME_CACHE_HPP
+
+#include <list>
+#include <tuple>
+#include <memory>
+#include <functional>
+#include "genome.hpp"
+
+/// Keeps recently searched genomes resident in memory within a memory budget.
+/// A genome is loaded on its first use, by mapping its packed file or by loading its FASTA files, together with its index file if there is one, and the least recently used genomes are evicted to make room for it.
+class genome_cache
+{
+public:
+	/// Returns the default memory budget, i.e. the IGREP_MEMORY_BUDGET environment variable in MB if set, or 3/4 of the physical memory otherwise.
+	static size_t default_budget();
+
+	/**
+	 * Constructs a cache without resident genomes.
+	 * @param[in] sources The genomes that can be loaded.
+	 * @param[in] budget_bytes Memory budget of resident genomes in bytes.
+	 * @param[in] num_threads Number of FASTA files to decompress concurrently.
+	 * @param[in] log Receives a line for every genome loaded or evicted.
+	 */
+	explicit genome_cache(vector<genome_source>&& sources, const size_t budget_bytes, const unsigned int num_threads, const function<void(const string&)>& log);
+
+	/// Returns the source of the genome of a taxid, or nullptr if there is no such genome.
+	const genome_source* find(const unsigned int taxid) const;
+
+	/// Returns the genome of a taxid, loading it if it is not resident, and marks it as the most recently used.
+	/// The genome remains valid while the returned pointer is held, even after it has been evicted from the cache.
+	/// A genome larger than the whole budget is still loaded, after evicting all the others.
+	shared_ptr<const genome> acquire(const unsigned int taxid);
+
+	/// Returns the total footprint of the resident genomes in bytes.
+	size_t resident_bytes() const
+	{
+		return resident;
+	}
+
+	/// Returns the memory budget in bytes.
+	size_t budget() const
+	{
+		return budget_bytes;
+	}
+
+	/// Returns the footprint of a genome in bytes, i.e. its special codons and sequence indexes, and its FM-index if it has been built.
+	static size_t footprint(const genome_source& source);
+
+private:
+	const vector<genome_source> sources;	/**< The genomes that can be loaded. */
+	const size_t budget_bytes;	/**< Memory budget of resident genomes in bytes. */
+	const unsigned int num_threads;	/**< Number of FASTA files to decompress concurrently. */
+	const function<void(const string&)> log;	/**< Receives a line for every genome loaded or evicted. */
+	list<tuple<const genome_source*, shared_ptr<const genome>, size_t>> lru;	/**< Resident genomes and their footprints when they were loaded, the most recently used first. */
+	size_t resident;	/**< Total footprint of the resident genomes in bytes. */
+};
+
+#endif
@@ -0,0 +1,397 @@
+#include <algorithm>
+#include <stdexcept>
+#include <boost/filesystem/operations.hpp>
+#include <boost/filesystem/fstream.hpp>
+#include "genome_index.hpp"
+
+const unsigned int genome_index::max_k;
+const unsigned int genome_index::min_seed_length;
+const unsigned int genome_index::sa_sample_rate;
+
+/// Magic bytes at the beginning of an index file.
+static const char index_magic[8] = { 'I', 'G', 'R', 'E', 'P', 'F', 'M', 'I' };
+
+/// Version of the index file format.
+static const unsigned int index_version = 2;
+
+/// Alignment of the blocks within an index file, so that they can be mapped at page boundaries.
+static const size_t index_alignment = 4096;
+
+/// Header of an index file, which is followed by the blocks at index_alignment, and then by the sampled suffix array entries.
+struct index_header
+{
+	char magic[8];	/**< Magic bytes, i.e. IGREPFMI. */
+	unsigned int version;	/**< Version of the file format. */
+	unsigned int sa_sample_rate;	/**< Sampling rate of the suffix array, which must match genome_index. */
+	unsigned int taxid;	/**< taxidomy ID. */
+	unsigned int character_count;	/**< Actual number of characters. */
+	unsigned int primary;	/**< The row of the whole genome. */
+	unsigned int C[CHARACTER_CARDINALITY];	/**< The first row of the suffixes beginning with each character. */
+	unsigned long long build;	/**< Fingerprint of the genome build, which must match that of the genome the index is mapped along with. */
+};
+
+/// Marks the empty slots of a suffix array under construction.
+static const unsigned int empty_slot = MAX_UNSIGNED_INT;
+
+/// Calculates the beginning or the end of the bucket of each character in a suffix array.
+template <typename C>
+static void getBuckets(const C *s, const unsigned int n, vector<unsigned int>& bkt, const bool end)
+{
+	fill(bkt.begin(), bkt.end(), 0);
+	for (unsigned int i = 0; i < n; ++i) ++bkt[s[i]];
+	unsigned int sum = 0;
+	for (auto& b : bkt)
+	{
+		sum += b;
+		b = end ? sum : sum - b;
+	}
+}
+
+/// Induces the order of L-type suffixes from the sorted LMS suffixes, and then the order of S-type suffixes from the L-type ones.
+template <typename C>
+static void induceSA(const C *s, unsigned int *SA, const unsigned int n, const vector<bool>& t, vector<unsigned int>& bkt)
+{
+	getBuckets(s, n, bkt, false);
+	for (unsigned int i = 0; i < n; ++i)
+	{
+		const unsigned int j = SA[i];
+		if (j != empty_slot && j && !t[j - 1]) SA[bkt[s[j - 1]]++] = j - 1;
+	}
+	getBuckets(s, n, bkt, true);
+	for (unsigned int i = n; i--;)
+	{
+		const unsigned int j = SA[i];
+		if (j != empty_slot && j && t[j - 1]) SA[--bkt[s[j - 1]]] = j - 1;
+	}
+}
+
+/**
+ * Sort the suffixes of a string with the SA-IS algorithm of Nong, Zhang and Chan, which runs in linear time and recurses into the reduced string within the suffix array itself.
+ * @param[in] s The string, whose last character must be the unique smallest one.
+ * @param[out] SA The suffix array.
+ * @param[in] n Length of the string.
+ * @param[in] K The largest character.
+ */
+template <typename C>
+static void sais(const C *s, unsigned int *SA, const unsigned int n, const unsigned int K)
+{
+	if (n == 1)
+	{
+		SA[0] = 0;
+		return;
+	}
+
+	// Classify the suffixes into S-type, i.e. true, and L-type, i.e. false.
+	vector<bool> t(n);
+	t[n - 1] = true;
+	t[n - 2] = false;
+	for (unsigned int i = n - 2; i--;) t[i] = s[i] < s[i + 1] || (s[i] == s[i + 1] && t[i + 1]);
+	const auto isLMS = [&](const unsigned int i)
+	{
+		return i && i != empty_slot && t[i] && !t[i - 1];
+	};
+
+	// Sort the LMS substrings by induction from their bucket ends.
+	vector<unsigned int> bkt(K + 1);
+	getBuckets(s, n, bkt, true);
+	fill(SA, SA + n, empty_slot);
+	for (unsigned int i = 1; i < n; ++i)
+	{
+		if (isLMS(i)) SA[--bkt[s[i]]] = i;
+	}
+	induceSA(s, SA, n, t, bkt);
+
+	// Compact the sorted LMS substrings into the first n1 slots, and name them by their ranks, equal substrings sharing a name.
+	unsigned int n1 = 0;
+	for (unsigned int i = 0; i < n; ++i)
+	{
+		if (isLMS(SA[i])) SA[n1++] = SA[i];
+	}
+	fill(SA + n1, SA + n, empty_slot);
+	unsigned int name = 0, prev = empty_slot;
+	for (unsigned int i = 0; i < n1; ++i)
+	{
+		const unsigned int pos = SA[i];
+		bool diff = false;
+		for (unsigned int d = 0; d < n; ++d)
+		{
+			if (prev == empty_slot || s[pos + d] != s[prev + d] || t[pos + d] != t[prev + d])
+			{
+				diff = true;
+				break;
+			}
+			if (d && (isLMS(pos + d) || isLMS(prev + d))) break;
+		}
+		if (diff)
+		{
+			++name;
+			prev = pos;
+		}
+		SA[n1 + (pos >> 1)] = name - 1;
+	}
+	for (unsigned int i = n, j = n; i-- > n1;)
+	{
+		if (SA[i] != empty_slot) SA[--j] = SA[i];
+	}
+
+	// Sort the LMS suffixes by recursing into the reduced string unless the names are already unique.
+	unsigned int *const SA1 = SA;
+	unsigned int *const s1 = SA + n - n1;
+	if (name < n1)
+	{
+		sais(s1, SA1, n1, name - 1);
+	}
+	else
+	{
+		for (unsigned int i = 0; i < n1; ++i) SA1[s1[i]] = i;
+	}
+
+	// Induce the suffix array from the sorted LMS suffixes.
+	getBuckets(s, n, bkt, true);
+	for (unsigned int i = 1, j = 0; i < n; ++i)
+	{
+		if (isLMS(i)) s1[j++] = i;
+	}
+	for (unsigned int i = 0; i < n1; ++i) SA1[i] = s1[SA1[i]];
+	fill(SA + n1, SA + n, empty_slot);
+	for (unsigned int i = n1; i--;)
+	{
+		const unsigned int j = SA[i];
+		SA[i] = empty_slot;
+		SA[--bkt[s[j]]] = j;
+	}
+	induceSA(s, SA, n, t, bkt);
+}
+
+/// Returns the number of 2-bit fields that are zero among the lowest n fields of a word.
+static inline unsigned int countZeroFields(const unsigned long long x, const unsigned int n)
+{
+	const unsigned long long zeros = ~(x | (x >> 1)) & 0x5555555555555555ULL;
+	return __builtin_popcountll(n == 32 ? zeros : zeros & ((1ULL << (n << 1)) - 1));
+}
+
+/// Returns the offset of the blocks within an index file.
+static size_t blocks_offset()
+{
+	return (sizeof(index_header) + index_alignment - 1) / index_alignment * index_alignment;
+}
+
+genome_index::genome_index(const genome& g) : taxid(g.taxid), character_count(g.character_count), build(g.build), row_count(g.character_count + 1), primary(0)
+{
+	// Sort the suffixes of the characters, which are shifted by one so that the sentinel is the unique smallest character.
+	vector<unsigned int> sa(row_count);
+	{
+		vector<unsigned char> text(row_count);
+		for (unsigned int i = 0; i < character_count; ++i) text[i] = g.character(i) + 1;
+		text[character_count] = 0;
+		sais(text.data(), sa.data(), row_count, CHARACTER_CARDINALITY);
+	}
+
+	// Derive the Burrows-Wheeler transform and the occurrence counts from the suffix array, and sample the entries of every sa_sample_rate-th character.
+	block_buffer.resize(block_count());
+	sample_buffer.reserve(sample_count());
+	unsigned int occ[CHARACTER_CARDINALITY] = {};
+	for (size_t row = 0; row <= row_count; ++row)
+	{
+		occ_block& b = block_buffer[row >> 6];
+		if (!(row & 63))
+		{
+			copy(occ, occ + CHARACTER_CARDINALITY, b.occ);
+			b.sampled = sample_buffer.size();
+		}
+		if (row == row_count) break;
+		const unsigned int pos = sa[row];
+		unsigned int c = 0;
+		if (pos)
+		{
+			c = g.character(pos - 1);
+			++occ[c];
+		}
+		else
+		{
+			primary = row;
+		}
+		b.bwt[(row >> 5) & 1] |= static_cast<unsigned long long>(c) << ((row & 31) << 1);
+		if (!(pos % sa_sample_rate))
+		{
+			b.sampled_rows |= 1ULL << (row & 63);
+			sample_buffer.push_back(pos);
+		}
+	}
+	BOOST_ASSERT(sample_buffer.size() == sample_count());
+	C[0] = 1;
+	for (unsigned int c = 1; c < CHARACTER_CARDINALITY; ++c) C[c] = C[c - 1] + occ[c - 1];
+	blocks = block_buffer.data();
+	samples = sample_buffer.data();
+}
+
+genome_index::genome_index(const genome& g, const path& index_path) : index_file(index_path.string())
+{
+	const char* const data = index_file.data();
+	if (index_file.size() < sizeof(index_header)) throw runtime_error(index_path.string() + " is truncated");
+	const index_header& header = *reinterpret_cast<const index_header*>(data);
+	if (!equal(index_magic, index_magic + sizeof(index_magic), header.magic) || header.version != index_version) throw runtime_error(index_path.string() + " is not an index file of version " + to_string(index_version));
+	if (header.sa_sample_rate != sa_sample_rate) throw runtime_error(index_path.string() + " was built for a suffix array sampling rate of " + to_string(header.sa_sample_rate));
+	if (header.taxid != g.taxid || header.character_count != g.character_count) throw runtime_error(index_path.string() + " does not match the genome of taxid " + to_string(g.taxid));
+	if (header.build != g.build) throw runtime_error(index_path.string() + " was built for another build of the genome of taxid " + to_string(g.taxid));
+	taxid = header.taxid;
+	character_count = header.character_count;
+	build = header.build;
+	row_count = character_count + 1;
+	primary = header.primary;
+	copy(header.C, header.C + CHARACTER_CARDINALITY, C);
+	if (index_file.size() != blocks_offset() + sizeof(occ_block) * block_count() + sizeof(unsigned int) * sample_count()) throw runtime_error(index_path.string() + " is truncated");
+	blocks = reinterpret_cast<const occ_block*>(data + blocks_offset());
+	samples = reinterpret_cast<const unsigned int*>(data + blocks_offset() + sizeof(occ_block) * block_count());
+}
+
+void genome_index::save(const path& index_path) const
+{
+	// Write into a temporary file first, and then rename it, so that the daemon never maps a partially written file.
+	const path tmp_path = index_path.string() + ".tmp";
+	{
+		boost::filesystem::ofstream ofs(tmp_path, ios::binary);
+		index_header header;
+		copy(index_magic, index_magic + sizeof(index_magic), header.magic);
+		header.version = index_version;
+		header.sa_sample_rate = sa_sample_rate;
+		header.taxid = taxid;
+		header.character_count = character_count;
+		header.build = build;
+		header.primary = primary;
+		copy(C, C + CHARACTER_CARDINALITY, header.C);
+		ofs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		const vector<char> padding(blocks_offset() - sizeof(header), 0);
+		ofs.write(padding.data(), padding.size());
+		ofs.write(reinterpret_cast<const char*>(blocks), sizeof(occ_block) * block_count());
+		ofs.write(reinterpret_cast<const char*>(samples), sizeof(unsigned int) * sample_count());
+		if (!ofs) throw runtime_error("Failed to write " + tmp_path.string());
+	}
+	rename(tmp_path, index_path);
+}
+
+unsigned int genome_index::occ(const unsigned int c, const unsigned int row) const
+{
+	const occ_block& b = blocks[row >> 6];
+	const unsigned int offset = row & 63;
+	const unsigned long long pattern = c * 0x5555555555555555ULL;
+	unsigned int count = b.occ[c] + countZeroFields(b.bwt[0] ^ pattern, min(offset, 32u));
+	if (offset > 32) count += countZeroFields(b.bwt[1] ^ pattern, offset - 32);
+	if (!c && primary < row && (primary >> 6) == (row >> 6)) --count; // The sentinel is stored as A.
+	return count;
+}
+
+unsigned int genome_index::lf(const unsigned int row) const
+{
+	const unsigned int c = (blocks[row >> 6].bwt[(row >> 5) & 1] >> ((row & 31) << 1)) & 3;
+	return C[c] + occ(c, row);
+}
+
+pair<unsigned int, unsigned int> genome_index::find(const unsigned char* characters, const size_t length) const
+{
+	unsigned int lo = 0, hi = row_count;
+	for (size_t i = length; i-- && lo < hi;)
+	{
+		const unsigned int c = characters[i];
+		lo = C[c] + occ(c, lo);
+		hi = C[c] + occ(c, hi);
+	}
+	return make_pair(lo, hi);
+}
+
+unsigned int genome_index::locate(unsigned int row) const
+{
+	// Walk backwards along the genome until a sampled character. The row of the whole genome is always sampled, so the walk never passes the sentinel.
+	unsigned int steps = 0;
+	while (!((blocks[row >> 6].sampled_rows >> (row & 63)) & 1))
+	{
+		row = lf(row);
+		++steps;
+	}
+	const occ_block& b = blocks[row >> 6];
+	return samples[b.sampled + __builtin_popcountll(b.sampled_rows & ((1ULL << (row & 63)) - 1))] + steps;
+}
+
+bool genome_index::plan(const agrep_pattern& p)
+{
+	if (p.m > 64 || p.k > max_k || p.m / (p.k + 1) < min_seed_length) return false;
+	for (unsigned int i = 0; i < p.m; ++i)
+	{
+		unsigned int matching_character_count = 0;
+		for (unsigned int c = 0; c < CHARACTER_CARDINALITY; ++c)
+		{
+			if (!((p.mask_array[c] >> i) & 1)) ++matching_character_count;
+		}
+		if (matching_character_count != 1) return false;
+	}
+	return true;
+}
+
+bool genome_index::search(const genome& g, const agrep_pattern& p, vector<unsigned int>& matches) const
+{
+	BOOST_ASSERT(plan(p));
+	const unsigned int m = p.m;
+	const unsigned int k = p.k;
+
+	// Recover the characters of the pattern from its mask array.
+	unsigned char characters[64];
+	for (unsigned int i = 0; i < m; ++i)
+	{
+		for (unsigned int c = 0; c < CHARACTER_CARDINALITY; ++c)
+		{
+			if (!((p.mask_array[c] >> i) & 1)) characters[i] = c;
+		}
+	}
+
+	// Split the pattern into k + 1 seeds, the last of which takes the remainder, and count their occurrences.
+	const unsigned int seed_length = m / (k + 1);
+	vector<pair<unsigned int, unsigned int>> intervals(k + 1);
+	size_t candidate_count = 0;
+	for (unsigned int j = 0; j <= k; ++j)
+	{
+		const unsigned int begin = j * seed_length;
+		const unsigned int end = j == k ? m : begin + seed_length;
+		intervals[j] = find(characters + begin, end - begin);
+		candidate_count += intervals[j].second - intervals[j].first;
+	}
+
+	// Decline the search if locating and verifying the candidates would take longer than scanning the genome, at a rough cost of a thousand characters of scan per candidate.
+	if (candidate_count > max<size_t>(1 << 16, character_count >> 10)) return false;
+
+	// Verify the neighbourhood of each seed occurrence, where a match containing it must begin and end, with the same recurrence as the agrep kernel, i.e. without insertions and deletions for Hamming distance.
+	// The first m + k - 1 characters of the genome do not end a match, as in a linear scan.
+	const unsigned long long test_bit = 1ULL << (m - 1);
+	unsigned long long r[max_k + 1];
+	vector<unsigned int> ends;
+	for (unsigned int j = 0; j <= k; ++j)
+	{
+		const unsigned int begin = j * seed_length;
+		for (unsigned int row = intervals[j].first; row < intervals[j].second; ++row)
+		{
+			const unsigned int seed_position = locate(row);
+			const unsigned int first = seed_position > begin + k ? seed_position - begin - k : 0;
+			const unsigned int last = min<size_t>(static_cast<size_t>(seed_position) - begin + m + k, character_count);
+			r[0] = MAX_UNSIGNED_LONG_LONG;
+			for (unsigned int i = 1; i <= k; ++i) r[i] = r[i - 1] << 1;
+			for (unsigned int position = first; position < last; ++position)
+			{
+				const unsigned long long mask_word = p.mask_array[g.character(position)];
+				unsigned long long r0 = r[0];
+				r[0] = (r0 << 1) | mask_word;
+				for (unsigned int i = 1; i <= k; ++i)
+				{
+					const unsigned long long r2 = r[i];
+					r[i] = p.hamming ? ((r2 << 1) | mask_word) & (r0 << 1) : ((r2 << 1) | mask_word) & (((r0 & r[i - 1]) << 1)) & r0;
+					r0 = r2;
+				}
+				if (!(r[k] & test_bit) && position + 1 >= m + k) ends.push_back(position);
+			}
+		}
+	}
+
+	// Deduplicate the matches found from different seeds.
+	sort(ends.begin(), ends.end());
+	ends.erase(unique(ends.begin(), ends.end()), ends.end());
+	matches = move(ends);
+	return true;
+}
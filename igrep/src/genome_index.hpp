@@ -0,0 +1,112 @@
+#pragma once
+#ifndef IGREP_GENOME_INDEX_HPP
+#define IGREP_GENOME_INDEX_HPP
+
+#include <utility>
+#include "genome.hpp"
+#include "backend.hpp"
+
+/// Represents an FM-index of a genome, i.e. the Burrows-Wheeler transform of its characters interleaved with occurrence counts, and its suffix array sampled at every sa_sample_rate-th character.
+/// The exact occurrences of a string are counted in time proportional to its length regardless of the genome size, and located in at most sa_sample_rate - 1 steps each.
+class genome_index
+{
+public:
+	/// Maximum edit distance of the patterns searched with the index. Larger edit distances split patterns into seeds too short to be selective.
+	static const unsigned int max_k = 3;
+
+	/// Minimum length of the seeds of the patterns searched with the index.
+	static const unsigned int min_seed_length = 10;
+
+	/// Every sa_sample_rate-th character of the genome has its suffix array entry sampled.
+	static const unsigned int sa_sample_rate = 32;
+
+	unsigned int taxid;	/**< taxidomy ID. */
+	unsigned int character_count;	/**< Actual number of characters. */
+	unsigned long long build;	/**< Fingerprint of the genome build that the index was built for. */
+
+	/**
+	 * Construct the index of a genome by sorting its suffixes with the SA-IS algorithm. This takes 5 bytes of memory per character.
+	 * @param[in] g The genome.
+	 */
+	explicit genome_index(const genome& g);
+
+	/**
+	 * Construct the index of a genome by mapping its index file into memory.
+	 * Throws runtime_error if the file is not an index file of the genome, e.g. one built for another build of the genome, whose characters differ.
+	 * @param[in] g The genome.
+	 * @param[in] index_path The index file.
+	 */
+	explicit genome_index(const genome& g, const path& index_path);
+
+	/// Writes the index into an index file.
+	void save(const path& index_path) const;
+
+	/**
+	 * Plan the search of a pattern, i.e. whether it is searched with the index or by a linear scan of the genome.
+	 * A pattern is searched with the index if it has at most 64 characters, its edit distance is at most max_k, it contains no N, and each of its k + 1 seeds has at least min_seed_length characters.
+	 * @param[in] p The pattern.
+	 * @return True if the pattern is searched with the index.
+	 */
+	static bool plan(const agrep_pattern& p);
+
+	/**
+	 * Search the genome for a pattern by pigeonhole seeding, i.e. splitting the pattern into k + 1 seeds, at least one of which occurs exactly in every match, and verifying the neighbourhood of each seed occurrence with the bit-parallel recurrence of the agrep kernel.
+	 * The matches are the same as those of a linear scan. The search is declined if the seeds occur so often that verifying them would be slower than a linear scan.
+	 * @param[in] g The genome, whose characters are read for verification.
+	 * @param[in] p The pattern, which must have been planned for the index.
+	 * @param[out] matches The ending positions of all the matches in ascending order.
+	 * @return False if the search is declined, in which case the pattern should be searched by a linear scan.
+	 */
+	bool search(const genome& g, const agrep_pattern& p, vector<unsigned int>& matches) const;
+
+	/// Returns the rows of the suffix array whose suffixes begin with a string of 2-bit characters.
+	pair<unsigned int, unsigned int> find(const unsigned char* characters, const size_t length) const;
+
+	/// Returns the position in the genome of the suffix of a row.
+	unsigned int locate(unsigned int row) const;
+
+	/// Default move constructor, which keeps the index arrays in place.
+	genome_index(genome_index&&) = default;
+	/// Default move assignment operator, which keeps the index arrays in place.
+	genome_index& operator=(genome_index&&) = default;
+
+private:
+	/// Represents 64 consecutive rows of the Burrows-Wheeler transform, i.e. half a cache line, together with the occurrence counts of the preceding rows.
+	struct occ_block
+	{
+		unsigned int occ[CHARACTER_CARDINALITY];	/**< Number of occurrences of each character in the preceding rows. */
+		unsigned int sampled;	/**< Number of sampled rows preceding the block. */
+		unsigned int padding;	/**< Unused. */
+		unsigned long long bwt[2];	/**< The 2-bit characters of the rows, earlier rows in lower bits. The sentinel is stored as A. */
+		unsigned long long sampled_rows;	/**< Bit i is set if row i of the block has its suffix array entry sampled. */
+	};
+
+	unsigned int row_count;	/**< Number of rows, i.e. the number of characters plus one for the sentinel. */
+	unsigned int primary;	/**< The row of the whole genome, whose Burrows-Wheeler transform is the sentinel. */
+	unsigned int C[CHARACTER_CARDINALITY];	/**< The first row of the suffixes beginning with each character. */
+	const occ_block *blocks;	/**< The Burrows-Wheeler transform with occurrence counts. */
+	const unsigned int *samples;	/**< The sampled suffix array entries, in the order of their rows. */
+	vector<occ_block> block_buffer;	/**< The blocks of an index built in memory. */
+	vector<unsigned int> sample_buffer;	/**< The samples of an index built in memory. */
+	boost::iostreams::mapped_file_source index_file;	/**< The mapped index file of an index loaded from it. */
+
+	/// Returns the number of blocks of row_count rows. There is always a block beyond the last row, so that occ() works for row_count.
+	size_t block_count() const
+	{
+		return (static_cast<size_t>(row_count) >> 6) + 1;
+	}
+
+	/// Returns the number of sampled suffix array entries.
+	size_t sample_count() const
+	{
+		return character_count / sa_sample_rate + 1;
+	}
+
+	/// Returns the number of occurrences of a character in the rows preceding a row.
+	unsigned int occ(const unsigned int c, const unsigned int row) const;
+
+	/// Returns the row of the suffix that begins one character before the suffix of a row, i.e. the LF mapping.
+	unsigned int lf(const unsigned int row) const;
+};
+
+#endif
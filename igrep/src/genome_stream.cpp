@@ -0,0 +1,226 @@
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <exception>
+#include <stdexcept>
+#include <condition_variable>
+#include <boost/filesystem/fstream.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+#include <boost/iostreams/filter/gzip.hpp>
+#include "genome_stream.hpp"
+
+using boost::iostreams::filtering_istream;
+using boost::iostreams::gzip_decompressor;
+
+/// Represents a chunk of a FASTA file, i.e. the characters it shares with the previous chunk, followed by its own characters, followed by the characters it shares with the next chunk.
+struct fasta_chunk
+{
+	unsigned int offset;	/**< Character index in the whole genome of the first character of the chunk. */
+	unsigned int begin;	/**< Index of the first own character of the chunk. */
+	unsigned int end;	/**< Index one beyond the last own character of the chunk. */
+	string characters;	/**< The characters. */
+	vector<unsigned int> sequence_cumulative_length;	/**< Cumulative lengths of the pieces of sequences within the chunk. */
+	unique_ptr<genome> g;	/**< The characters packed into special codons. */
+};
+
+/// Passes chunks from one stage of the pipeline to the next, blocking the producer while it is full and the consumer while it is empty.
+class chunk_queue
+{
+public:
+	/// Constructs an empty queue.
+	explicit chunk_queue(const size_t capacity) : capacity(capacity), closed(false) {}
+
+	/// Pushes a chunk, waiting while the queue is full. Returns false if the queue has been closed, in which case the chunk is discarded.
+	bool push(unique_ptr<fasta_chunk>&& chunk)
+	{
+		unique_lock<mutex> lock(m);
+		not_full.wait(lock, [&]() { return closed || chunks.size() < capacity; });
+		if (closed) return false;
+		chunks.push_back(move(chunk));
+		not_empty.notify_one();
+		return true;
+	}
+
+	/// Pops a chunk, waiting while the queue is empty. Returns false if the queue has been closed and emptied.
+	bool pop(unique_ptr<fasta_chunk>& chunk)
+	{
+		unique_lock<mutex> lock(m);
+		not_empty.wait(lock, [&]() { return closed || !chunks.empty(); });
+		if (chunks.empty()) return false;
+		chunk = move(chunks.front());
+		chunks.pop_front();
+		not_full.notify_one();
+		return true;
+	}
+
+	/// Closes the queue, either by the producer after its last chunk, or by the consumer to stop the producer.
+	void close()
+	{
+		lock_guard<mutex> lock(m);
+		closed = true;
+		not_full.notify_all();
+		not_empty.notify_all();
+	}
+
+private:
+	const size_t capacity;	/**< Maximum number of chunks waiting in the queue. */
+	bool closed;	/**< Whether the queue has been closed. */
+	deque<unique_ptr<fasta_chunk>> chunks;	/**< The waiting chunks. */
+	mutex m;	/**< Guards the queue. */
+	condition_variable not_full;	/**< Notified when a chunk is popped or the queue is closed. */
+	condition_variable not_empty;	/**< Notified when a chunk is pushed or the queue is closed. */
+};
+
+genome_stream::genome_stream(const string& name, const path& fasta_path) : name(name), sequence_count(0), character_count(0), fasta_path(fasta_path)
+{
+}
+
+void genome_stream::search(const vector<agrep_pattern>& patterns, agrep_backend& backend, const unsigned int num_threads, vector<vector<occurrence>>& occurrences)
+{
+	// A chunk shares with the previous chunk the m + k - 1 characters that precede its own characters, within which every alignment ending at them begins,
+	// and with the next chunk the 2k characters that follow them, within which every run of ending positions beginning at them ends.
+	unsigned int before = 0, after = 0;
+	for (const auto& p : patterns)
+	{
+		before = max(before, p.m + p.k - 1);
+		after = max(after, 2 * p.k);
+	}
+
+	chunk_queue parsed(queue_capacity), packed(queue_capacity);
+	exception_ptr error;
+	mutex error_mutex;
+	const auto fail = [&]()
+	{
+		lock_guard<mutex> lock(error_mutex);
+		if (!error) error = current_exception();
+	};
+
+	// Stage 1: decompress and parse the file into chunks, carrying the shared characters and the pieces of sequences within them from each chunk to the next.
+	sequence_cumulative_length.assign(1, 0);
+	thread reader([&]()
+	{
+		try
+		{
+			boost::filesystem::ifstream ifs(fasta_path, ios::binary);
+			if (!ifs) throw runtime_error("Failed to open " + fasta_path.string());
+			filtering_istream fis;
+			if (fasta_path.extension() == ".gz") fis.push(gzip_decompressor());
+			fis.push(ifs);
+			unique_ptr<fasta_chunk> chunk(new fasta_chunk { 0, 0, 0, string(), vector<unsigned int>(1, 0), nullptr });
+			chunk->characters.reserve(before + chunk_size + after);
+			size_t count = 0;	// Number of characters so far across all the chunks.
+			bool headed = false;	// Whether a header line has been read.
+			string line;
+			line.reserve(1000);
+			while (getline(fis, line))
+			{
+				if (!line.empty() && line.front() == '>') // Header line. The first sequence begins at 0 whether or not it has one.
+				{
+					if (count || headed)
+					{
+						sequence_cumulative_length.push_back(count);
+						chunk->sequence_cumulative_length.push_back(chunk->characters.size());
+					}
+					headed = true;
+					continue;
+				}
+				for (const auto c : line)
+				{
+					if (isspace(c)) continue; // Line breaks of either convention.
+					if (++count >= MAX_UNSIGNED_INT) throw runtime_error(fasta_path.string() + " has more than 4G characters");
+					chunk->characters.push_back(c);
+					if (chunk->characters.size() < chunk->begin + chunk_size + after) continue;
+
+					// The chunk is full. The next chunk begins with its last before + after characters.
+					unique_ptr<fasta_chunk> next(new fasta_chunk { 0, before, 0, string(), vector<unsigned int>(1, 0), nullptr });
+					chunk->end = chunk->characters.size() - after;
+					const unsigned int shared = chunk->end - before;
+					next->offset = chunk->offset + shared;
+					next->characters.reserve(before + chunk_size + after);
+					next->characters.assign(chunk->characters, shared, string::npos);
+					for (const auto length : chunk->sequence_cumulative_length)
+					{
+						if (length > shared) next->sequence_cumulative_length.push_back(length - shared);
+					}
+					chunk->sequence_cumulative_length.push_back(chunk->characters.size());
+					if (!parsed.push(move(chunk))) return;
+					chunk = move(next);
+				}
+			}
+			if (fis.bad()) throw runtime_error("Failed to decompress " + fasta_path.string());
+			chunk->end = chunk->characters.size();
+			chunk->sequence_cumulative_length.push_back(chunk->characters.size());
+			parsed.push(move(chunk));
+			sequence_cumulative_length.push_back(count);
+			sequence_count = sequence_cumulative_length.size() - 1;
+			character_count = count;
+		}
+		catch (...)
+		{
+			fail();
+		}
+		parsed.close();
+	});
+
+	// Stage 2: pack the characters of each chunk into special codons.
+	thread packer([&]()
+	{
+		try
+		{
+			for (unique_ptr<fasta_chunk> chunk; parsed.pop(chunk);)
+			{
+				chunk->g.reset(new genome(name, chunk->characters, move(chunk->sequence_cumulative_length)));
+				string().swap(chunk->characters);
+				if (!packed.push(move(chunk))) break;
+			}
+		}
+		catch (...)
+		{
+			fail();
+		}
+		parsed.close();
+		packed.close();
+	});
+
+	// Stage 3: scan each chunk, and align the matches ending at its own characters.
+	// The runs of ending positions of each pattern are collapsed as if the whole genome were scanned, continuing after the runs of the previous chunk.
+	occurrences.assign(patterns.size(), vector<occurrence>());
+	vector<unsigned int> next_begin(patterns.size(), 0);	// The character index in the whole genome after the last run of each pattern so far.
+	try
+	{
+		vector<vector<unsigned int>> matches;
+		vector<bool> overflows;
+		for (unique_ptr<fasta_chunk> chunk; packed.pop(chunk);)
+		{
+			if (chunk->begin == chunk->end) continue;
+			const genome& g = *chunk->g;
+			backend.load(g.scodon, g.scodon_size(), g.character_count, g.block_count, g.gap_blocks.data());
+			backend.search(patterns, matches, overflows);
+			backend.unload();
+			for (size_t i = 0; i < patterns.size(); ++i)
+			{
+				if (overflows[i]) throw runtime_error("A pattern has more than " + to_string(match_limit) + " matches");
+				unsigned int begin = max(next_begin[i], chunk->offset + chunk->begin) - chunk->offset;
+				auto chunk_occurrences = align_matches(g, patterns[i], matches[i], num_threads, begin, chunk->end);
+				next_begin[i] = chunk->offset + begin;
+				for (auto& o : chunk_occurrences)
+				{
+					o.begin += chunk->offset;
+					o.end += chunk->offset;
+					occurrences[i].push_back(move(o));
+				}
+				if (occurrences[i].size() > match_limit) throw runtime_error("A pattern has more than " + to_string(match_limit) + " matches");
+			}
+		}
+	}
+	catch (...)
+	{
+		fail();
+	}
+	packed.close();
+	parsed.close();
+	reader.join();
+	packer.join();
+	if (error) rethrow_exception(error);
+}
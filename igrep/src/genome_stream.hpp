@@ -0,0 +1,47 @@
+#pragma once
+#ifndef IGREP_GENOME_STREAM_HPP
+#define IGREP_GENOME_STREAM_HPP
+
+#include "genome.hpp"
+#include "backend.hpp"
+#include "alignment.hpp"
+
+/// Represents a genome in a FASTA file, optionally gzipped, e.g. one uploaded by a user, which is searched without being packed beforehand.
+/// The file is searched in a pipeline of three stages running concurrently, i.e. decompressing and parsing it into chunks, packing each chunk into special codons, and scanning each chunk with the agrep backend and aligning its matches.
+/// Consecutive chunks overlap, so that every occurrence is found and aligned in exactly one chunk, and memory is bounded by a few chunks regardless of the genome size.
+class genome_stream
+{
+public:
+	/// Number of characters that a chunk adds to its overlap with the previous chunk.
+	static const unsigned int chunk_size = 1 << 25;
+
+	/// Number of chunks that may wait between two stages.
+	static const unsigned int queue_capacity = 2;
+
+	string name;	/**< Genome name. */
+	unsigned int sequence_count;	/**< Number of sequences, which is known once the file has been searched. */
+	unsigned int character_count;	/**< Number of characters, which is known once the file has been searched. */
+	vector<unsigned int> sequence_cumulative_length;	/**< Cumulative lengths of sequences, which are known once the file has been searched. */
+
+	/**
+	 * Construct a stream of a FASTA file. The file is not read until it is searched.
+	 * @param[in] name The genome name.
+	 * @param[in] fasta_path The FASTA file, which is gzipped if its extension is .gz. Characters before the first header line belong to the first sequence.
+	 */
+	explicit genome_stream(const string& name, const path& fasta_path);
+
+	/**
+	 * Search the genome for patterns in a single pass over the file.
+	 * Throws runtime_error if the file cannot be read, has more characters than positions can address, or a pattern has more than match_limit matches.
+	 * @param[in] patterns The patterns.
+	 * @param[in] backend The backend that scans each chunk.
+	 * @param[in] num_threads Number of threads that align the matches of a chunk.
+	 * @param[out] occurrences The occurrences of each pattern in ascending order of their ending positions, which are character indexes of the whole genome, the same as those of align_matches() on the whole genome.
+	 */
+	void search(const vector<agrep_pattern>& patterns, agrep_backend& backend, const unsigned int num_threads, vector<vector<occurrence>>& occurrences);
+
+private:
+	const path fasta_path;	/**< The FASTA file. */
+};
+
+#endif
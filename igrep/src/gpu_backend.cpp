@@ -0,0 +1,124 @@
+#include <algorithm>
+#include <cuda_runtime_api.h>
+#include <helper_cuda.h>
+#include "gpu_backend.hpp"
+
+bool gpu_backend::available()
+{
+	int device_count = 0;
+	return cudaGetDeviceCount(&device_count) == cudaSuccess && device_count > 0;
+}
+
+gpu_backend::gpu_backend(const unsigned int num_threads) : scodon_device(nullptr), gap_block_device(nullptr), match_device(nullptr), character_count(0), block_count(0), max_match_count(0), host_backend(num_threads, requested_isa())
+{
+}
+
+string gpu_backend::name() const
+{
+	return "gpu";
+}
+
+void gpu_backend::load(const unsigned int *scodon, const size_t scodon_size, const unsigned int character_count, const unsigned int block_count, const unsigned char *gap_blocks)
+{
+	this->character_count = character_count;
+	this->block_count = block_count;
+	checkCudaErrors(cudaMalloc((void**)&scodon_device, sizeof(unsigned int) * scodon_size));
+	checkCudaErrors(cudaMemcpy(scodon_device, scodon, sizeof(unsigned int) * scodon_size, cudaMemcpyHostToDevice));
+	checkCudaErrors(cudaMalloc((void**)&gap_block_device, sizeof(unsigned char) * block_count));
+	checkCudaErrors(cudaMemcpy(gap_block_device, gap_blocks, sizeof(unsigned char) * block_count, cudaMemcpyHostToDevice));
+	reserve(initial_match_count);
+	host_backend.load(scodon, scodon_size, character_count, block_count, gap_blocks);
+}
+
+void gpu_backend::reserve(const unsigned int match_count)
+{
+	if (match_device) checkCudaErrors(cudaFree(match_device));
+	max_match_count = match_count;
+	checkCudaErrors(cudaMalloc((void**)&match_device, sizeof(unsigned int) * max_match_count));
+	initAgrepKernel(scodon_device, character_count, gap_block_device, match_device, max_match_count);
+}
+
+void gpu_backend::search(const vector<agrep_pattern>& patterns, vector<vector<unsigned int>>& matches, vector<bool>& overflows)
+{
+	// Search a large batch entirely on the CPU, as the kernel is launched once per pattern.
+	if (static_cast<size_t>(count_if(patterns.begin(), patterns.end(), [](const agrep_pattern& p) { return p.m <= 64; })) > max_kernel_patterns)
+	{
+		host_backend.search(patterns, matches, overflows);
+		return;
+	}
+	matches.resize(patterns.size());
+	overflows.assign(patterns.size(), false);
+
+	// Search the patterns longer than 64 characters on the CPU in one batch.
+	vector<agrep_pattern> long_patterns;
+	vector<size_t> long_pattern_indices;
+	for (size_t i = 0; i < patterns.size(); ++i)
+	{
+		if (patterns[i].m <= 64) continue;
+		long_patterns.push_back(patterns[i]);
+		long_pattern_indices.push_back(i);
+	}
+	if (long_patterns.size())
+	{
+		vector<vector<unsigned int>> long_matches;
+		vector<bool> long_overflows;
+		host_backend.search(long_patterns, long_matches, long_overflows);
+		for (size_t j = 0; j < long_patterns.size(); ++j)
+		{
+			matches[long_pattern_indices[j]] = move(long_matches[j]);
+			overflows[long_pattern_indices[j]] = long_overflows[j];
+		}
+	}
+
+	for (size_t i = 0; i < patterns.size(); ++i)
+	{
+		const agrep_pattern& p = patterns[i];
+		if (p.m > 64) continue;
+		if (p.m <= 32)
+		{
+			unsigned int mask_array_32[CHARACTER_CARDINALITY];
+			for (unsigned int c = 0; c < CHARACTER_CARDINALITY; ++c) mask_array_32[c] = static_cast<unsigned int>(p.mask_array[c]);
+			transferMaskArray32(mask_array_32, 1U << (p.m - 1));
+		}
+		else
+		{
+			transferMaskArray64(p.mask_array, 1ULL << (p.m - 1));
+		}
+
+		// Run the kernel, and run it again with an enlarged match array if the matches overflowed it, as the kernel counts all of them.
+		// The match array is never enlarged beyond match_limit, so a pattern with more matches is reported as overflowed instead.
+		unsigned int match_count;
+		while (true)
+		{
+			invokeAgrepKernel(p.m, p.k, p.hamming, block_count);
+			checkCudaErrors(cudaGetLastError());
+			checkCudaErrors(cudaDeviceSynchronize());	// Block until the CUDA agrep kernel completes.
+			getMatchCount(&match_count);
+			if (match_count <= max_match_count || match_count > match_limit) break;
+			reserve(min<size_t>(max(match_count, max_match_count << 1), match_limit));
+		}
+		if (match_count > match_limit)
+		{
+			matches[i].clear();
+			overflows[i] = true;
+			continue;
+		}
+
+		// Retrieve matches from device, and sort them, as threads save them in no particular order.
+		matches[i].resize(match_count);
+		if (match_count) checkCudaErrors(cudaMemcpy(matches[i].data(), match_device, sizeof(unsigned int) * match_count, cudaMemcpyDeviceToHost));
+		sort(matches[i].begin(), matches[i].end());
+	}
+}
+
+void gpu_backend::unload()
+{
+	host_backend.unload();
+	checkCudaErrors(cudaFree(match_device));
+	checkCudaErrors(cudaFree(gap_block_device));
+	checkCudaErrors(cudaFree(scodon_device));
+	checkCudaErrors(cudaDeviceReset());
+	match_device = nullptr;
+	gap_block_device = nullptr;
+	scodon_device = nullptr;
+}
@@ -0,0 +1,42 @@
+#pragma once
+#ifndef IGREP_GPU_BACKEND_HPP
+#define IGREP_GPU_BACKEND_HPP
+
+#include "cpu_backend.hpp"
+
+/// Runs the CUDA agrep kernel on the default CUDA device, once per pattern. Patterns longer than 64 characters, which exceed the kernel registers, are searched by the CPU backend,
+/// and so are batches of more than max_kernel_patterns patterns, which the CPU backend packs into SIMD lanes and scans in one pass over the genome rather than one pass per pattern.
+class gpu_backend : public agrep_backend
+{
+public:
+	/// Returns true if there is at least one CUDA device.
+	static bool available();
+
+	/// Constructs a backend without a genome, which searches the patterns longer than 64 characters and large batches on num_threads CPU threads.
+	explicit gpu_backend(const unsigned int num_threads);
+
+	virtual string name() const;
+	virtual void load(const unsigned int *scodon, const size_t scodon_size, const unsigned int character_count, const unsigned int block_count, const unsigned char *gap_blocks);
+	virtual void search(const vector<agrep_pattern>& patterns, vector<vector<unsigned int>>& matches, vector<bool>& overflows);
+	virtual void unload();
+
+private:
+	/// Initial capacity of the match array, which is enlarged whenever a pattern has more matches, up to match_limit.
+	static const unsigned int initial_match_count = 1 << 20;
+
+	/// Maximum number of patterns of up to 64 characters in a batch searched by the kernel, beyond which the kernel launches cost more than a packed scan on the CPU.
+	static const size_t max_kernel_patterns = 32;
+
+	unsigned int *scodon_device;	/**< CUDA global memory pointer pointing to the special codon array. */
+	unsigned char *gap_block_device;	/**< CUDA global memory pointer pointing to the gap flags of thread blocks. */
+	unsigned int *match_device;	/**< CUDA global memory pointer pointing to the match array. */
+	unsigned int character_count;	/**< Actual number of characters of the loaded genome. */
+	unsigned int block_count;	/**< Number of thread blocks of the loaded genome. */
+	unsigned int max_match_count;	/**< Capacity of the match array. */
+	cpu_backend host_backend;	/**< The backend of the patterns longer than 64 characters and of large batches. */
+
+	/// Reallocates the match array with a capacity of match_count matches, and passes it to the kernel.
+	void reserve(const unsigned int match_count);
+};
+
+#endif
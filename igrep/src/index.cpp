@@ -0,0 +1,23 @@
+#include <iostream>
+#include <thread>
+#include <chrono>
+#include <boost/filesystem/operations.hpp>
+#include "genome_index.hpp"
+
+/// Builds the FM-indexes of the genomes that igrep searches into files that the daemon maps along with the genomes, so that patterns with few errors are searched without scanning the genomes.
+/// A genome is mapped from its packed file if it has been packed by igrep_pack, or loaded from its FASTA files otherwise. Only the genomes of the given taxids are indexed if any are given.
+int main(int argc, char* argv[])
+{
+	using std::chrono::steady_clock;
+	const unsigned int num_threads = thread::hardware_concurrency();
+	for (const auto& source : genome_sources())
+	{
+		if (argc > 1 && find_if(argv + 1, argv + argc, [&](const char* taxid) { return to_string(source.taxid) == taxid; }) == argv + argc) continue;
+		cout << "Indexing the genome of " << source.name << " into " << source.index_path() << endl;
+		const auto begin = steady_clock::now();
+		const genome g = exists(source.packed_path()) ? genome(source, source.packed_path()) : genome(source, num_threads);
+		const genome_index index(g);
+		index.save(source.index_path());
+		cout << "Indexed " << g.character_count << " characters in " << std::chrono::duration<double>(steady_clock::now() - begin).count() << " seconds" << endl;
+	}
+}
@@ -5,6 +5,7 @@ __constant__ unsigned int *scodon;	/**< The special codon array. */
 __constant__ unsigned int character_count;	/**< Number of characters. */
 __constant__ unsigned int overlapping_character_count;	/**< Number of overlapping characters between two consecutive threads. */
 __constant__ unsigned int overlapping_scodon_count;	/**< Number of overlapping special codons between two consecutive threads. */
+__constant__ unsigned char *gap_block;	/**< Whether each thread block lies within a gap of N. */
 
 // About agrep algorithm.
 __constant__ unsigned int       mask_array_32[CHARACTER_CARDINALITY];	/**< The 32-bit mask array of pattern. */
@@ -13,15 +14,41 @@ __constant__ unsigned int       test_bit_32;	/**< The test bit for determining m
 __constant__ unsigned long long test_bit_64;	/**< The test bit for determining matches of patterns of length 64. */
 
 // About result.
-__constant__ unsigned int max_match_count;	/**< Maximum number of matches of one single query. */
+__constant__ unsigned int max_match_count;	/**< Capacity of the match array. */
 __constant__ unsigned int *match;	/**< The match array. */
-__device__ volatile unsigned int match_count;	/**< Number of matches. */
+__device__ volatile unsigned int match_count;	/**< Number of matches, which may exceed the capacity of the match array. */
+
+/**
+ * Count a match, and save it into the match array if the array has room.
+ * Matches are counted even when the array is full, so that the host can enlarge the array and run the kernel again.
+ * @param[in] matching_character_index The ending position of the match.
+ */
+__device__ inline void saveMatch(const unsigned int matching_character_index)
+{
+	const unsigned int match_index = atomicAdd((unsigned int *)&match_count, 1);
+	if (match_index < max_match_count) match[match_index] = matching_character_index;
+}
+
+/**
+ * Advance a matching table by one character from its previous column and the previous and current columns of the table below.
+ * With H, i.e. by Hamming distance, a mismatch is the only edit, so the current column of the table below and insertions are not involved.
+ * @param[in] r0 The previous column of the table below.
+ * @param[in] r1 The current column of the table below.
+ * @param[in] r2 The previous column of the table.
+ * @param[in] mask_word The mask word of the character.
+ * @return The current column of the table.
+ */
+template<bool H, typename T>
+__device__ inline T advanceTable(const T r0, const T r1, const T r2, const T mask_word)
+{
+	return H ? ((r2 << 1) | mask_word) & (r0 << 1) : ((r2 << 1) | mask_word) & ((r0 & r1) << 1) & r0;
+}
 
 /**
  * The CUDA agrep kernel for matching tables of 32 bits.
  * All the necessary parameters are stored in constant memory.
  */
-template<unsigned int KI>
+template<unsigned int KI, bool H>
 __global__ void agrepKernel32()
 {
 	// About CUDA implementation.
@@ -45,6 +72,7 @@ __global__ void agrepKernel32()
 	unsigned int outputting_scodon_base_index;	// The base index into outputting special codon of current thread.
 	unsigned int matching_character_index;	// The output of the kernel. It stores the matching ending position.
 
+	if (gap_block[blockIdx.x]) return;	// The thread block cannot report valid matches. All its threads return before __syncthreads().
 	block_base_index = blockIdx.x << (L + B);	// The base index of current thread block.
 	inputting_scodon_base_index  = block_base_index + threadIdx.x;	// Coalesced global memory access is ensured.
 	outputting_scodon_base_index = block_base_index + (threadIdx.x << L);	// Original order of corpus.
@@ -65,7 +93,7 @@ __global__ void agrepKernel32()
 				r0 = r2;
 				r1 = r3;
 				r2 = r[k];
-				r3 = ((r2 << 1) | mask_word) & ((r0 & r1) << 1) & r0;
+				r3 = advanceTable<H>(r0, r1, r2, mask_word);
 				r[k] = r3;
 			}
 		}
@@ -83,7 +111,7 @@ __global__ void agrepKernel32()
 			r0 = r2;
 			r1 = r3;
 			r2 = r[k];
-			r3 = ((r2 << 1) | mask_word) & ((r0 & r1) << 1) & r0;
+			r3 = advanceTable<H>(r0, r1, r2, mask_word);
 			r[k] = r3;
 		}
 	}
@@ -98,19 +126,19 @@ __global__ void agrepKernel32()
 			r0 = r2;
 			r1 = r3;
 			r2 = r[k];
-			r3 = ((r2 << 1) | mask_word) & ((r0 & r1) << 1) & r0;
+			r3 = advanceTable<H>(r0, r1, r2, mask_word);
 			r[k] = r3;
 		}
-		if (!(r3 & test_bit_32) && (match_count < max_match_count))
+		if (!(r3 & test_bit_32))
 		{
 			/* A possible match is found.
 			 *   1) Calculate the matching character index, and ensure it does not exceed the corpus boundary.
 			 *   2) Atomically increase match_count by 1, whose original value points to the index that the current match should be saved at.
-			 *   3) Save the matching character index to the match array, if the max number of matches has not yet been exceeded.
+			 *   3) Save the matching character index to the match array, if the match array has room.
 			 */
 			matching_character_index = ((outputting_scodon_base_index + scodon_index) << 4) + character_index;
 			if (matching_character_index <= character_count)
-				match[atomicAdd((unsigned int *)&match_count, 1)] = matching_character_index;
+				saveMatch(matching_character_index);
 		}
 	}
 	scodon_header[scodon_index][threadIdx.x] = scodon_buffer;
@@ -127,14 +155,14 @@ __global__ void agrepKernel32()
 			r0 = r2;
 			r1 = r3;
 			r2 = r[k];
-			r3 = ((r2 << 1) | mask_word) & ((r0 & r1) << 1) & r0;
+			r3 = advanceTable<H>(r0, r1, r2, mask_word);
 			r[k] = r3;
 		}
-		if (!(r3 & test_bit_32) && (match_count < max_match_count))
+		if (!(r3 & test_bit_32))
 		{
 			matching_character_index = ((outputting_scodon_base_index + scodon_index) << 4) + 0;
 			if (matching_character_index <= character_count)
-				match[atomicAdd((unsigned int *)&match_count, 1)] = matching_character_index;
+				saveMatch(matching_character_index);
 		}
 		mask_word = mask_array_32[(scodon_buffer >> 2) & 3];
 		r2 = r[0];
@@ -145,14 +173,14 @@ __global__ void agrepKernel32()
 			r0 = r2;
 			r1 = r3;
 			r2 = r[k];
-			r3 = ((r2 << 1) | mask_word) & ((r0 & r1) << 1) & r0;
+			r3 = advanceTable<H>(r0, r1, r2, mask_word);
 			r[k] = r3;
 		}
-		if (!(r3 & test_bit_32) && (match_count < max_match_count))
+		if (!(r3 & test_bit_32))
 		{
 			matching_character_index = ((outputting_scodon_base_index + scodon_index) << 4) + 1;
 			if (matching_character_index <= character_count)
-				match[atomicAdd((unsigned int *)&match_count, 1)] = matching_character_index;
+				saveMatch(matching_character_index);
 		}
 		mask_word = mask_array_32[(scodon_buffer >> 4) & 3];
 		r2 = r[0];
@@ -163,14 +191,14 @@ __global__ void agrepKernel32()
 			r0 = r2;
 			r1 = r3;
 			r2 = r[k];
-			r3 = ((r2 << 1) | mask_word) & ((r0 & r1) << 1) & r0;
+			r3 = advanceTable<H>(r0, r1, r2, mask_word);
 			r[k] = r3;
 		}
-		if (!(r3 & test_bit_32) && (match_count < max_match_count))
+		if (!(r3 & test_bit_32))
 		{
 			matching_character_index = ((outputting_scodon_base_index + scodon_index) << 4) + 2;
 			if (matching_character_index <= character_count)
-				match[atomicAdd((unsigned int *)&match_count, 1)] = matching_character_index;
+				saveMatch(matching_character_index);
 		}
 		mask_word = mask_array_32[(scodon_buffer >> 6) & 3];
 		r2 = r[0];
@@ -181,14 +209,14 @@ __global__ void agrepKernel32()
 			r0 = r2;
 			r1 = r3;
 			r2 = r[k];
-			r3 = ((r2 << 1) | mask_word) & ((r0 & r1) << 1) & r0;
+			r3 = advanceTable<H>(r0, r1, r2, mask_word);
 			r[k] = r3;
 		}
-		if (!(r3 & test_bit_32) && (match_count < max_match_count))
+		if (!(r3 & test_bit_32))
 		{
 			matching_character_index = ((outputting_scodon_base_index + scodon_index) << 4) + 3;
 			if (matching_character_index <= character_count)
-				match[atomicAdd((unsigned int *)&match_count, 1)] = matching_character_index;
+				saveMatch(matching_character_index);
 		}
 		mask_word = mask_array_32[(scodon_buffer >> 8) & 3];
 		r2 = r[0];
@@ -199,14 +227,14 @@ __global__ void agrepKernel32()
 			r0 = r2;
 			r1 = r3;
 			r2 = r[k];
-			r3 = ((r2 << 1) | mask_word) & ((r0 & r1) << 1) & r0;
+			r3 = advanceTable<H>(r0, r1, r2, mask_word);
 			r[k] = r3;
 		}
-		if (!(r3 & test_bit_32) && (match_count < max_match_count))
+		if (!(r3 & test_bit_32))
 		{
 			matching_character_index = ((outputting_scodon_base_index + scodon_index) << 4) + 4;
 			if (matching_character_index <= character_count)
-				match[atomicAdd((unsigned int *)&match_count, 1)] = matching_character_index;
+				saveMatch(matching_character_index);
 		}
 		mask_word = mask_array_32[(scodon_buffer >> 10) & 3];
 		r2 = r[0];
@@ -217,14 +245,14 @@ __global__ void agrepKernel32()
 			r0 = r2;
 			r1 = r3;
 			r2 = r[k];
-			r3 = ((r2 << 1) | mask_word) & ((r0 & r1) << 1) & r0;
+			r3 = advanceTable<H>(r0, r1, r2, mask_word);
 			r[k] = r3;
 		}
-		if (!(r3 & test_bit_32) && (match_count < max_match_count))
+		if (!(r3 & test_bit_32))
 		{
 			matching_character_index = ((outputting_scodon_base_index + scodon_index) << 4) + 5;
 			if (matching_character_index <= character_count)
-				match[atomicAdd((unsigned int *)&match_count, 1)] = matching_character_index;
+				saveMatch(matching_character_index);
 		}
 		mask_word = mask_array_32[(scodon_buffer >> 12) & 3];
 		r2 = r[0];
@@ -235,14 +263,14 @@ __global__ void agrepKernel32()
 			r0 = r2;
 			r1 = r3;
 			r2 = r[k];
-			r3 = ((r2 << 1) | mask_word) & ((r0 & r1) << 1) & r0;
+			r3 = advanceTable<H>(r0, r1, r2, mask_word);
 			r[k] = r3;
 		}
-		if (!(r3 & test_bit_32) && (match_count < max_match_count))
+		if (!(r3 & test_bit_32))
 		{
 			matching_character_index = ((outputting_scodon_base_index + scodon_index) << 4) + 6;
 			if (matching_character_index <= character_count)
-				match[atomicAdd((unsigned int *)&match_count, 1)] = matching_character_index;
+				saveMatch(matching_character_index);
 		}
 		mask_word = mask_array_32[(scodon_buffer >> 14) & 3];
 		r2 = r[0];
@@ -253,14 +281,14 @@ __global__ void agrepKernel32()
 			r0 = r2;
 			r1 = r3;
 			r2 = r[k];
-			r3 = ((r2 << 1) | mask_word) & ((r0 & r1) << 1) & r0;
+			r3 = advanceTable<H>(r0, r1, r2, mask_word);
 			r[k] = r3;
 		}
-		if (!(r3 & test_bit_32) && (match_count < max_match_count))
+		if (!(r3 & test_bit_32))
 		{
 			matching_character_index = ((outputting_scodon_base_index + scodon_index) << 4) + 7;
 			if (matching_character_index <= character_count)
-				match[atomicAdd((unsigned int *)&match_count, 1)] = matching_character_index;
+				saveMatch(matching_character_index);
 		}
 		mask_word = mask_array_32[(scodon_buffer >> 16) & 3];
 		r2 = r[0];
@@ -271,14 +299,14 @@ __global__ void agrepKernel32()
 			r0 = r2;
 			r1 = r3;
 			r2 = r[k];
-			r3 = ((r2 << 1) | mask_word) & ((r0 & r1) << 1) & r0;
+			r3 = advanceTable<H>(r0, r1, r2, mask_word);
 			r[k] = r3;
 		}
-		if (!(r3 & test_bit_32) && (match_count < max_match_count))
+		if (!(r3 & test_bit_32))
 		{
 			matching_character_index = ((outputting_scodon_base_index + scodon_index) << 4) + 8;
 			if (matching_character_index <= character_count)
-				match[atomicAdd((unsigned int *)&match_count, 1)] = matching_character_index;
+				saveMatch(matching_character_index);
 		}
 		mask_word = mask_array_32[(scodon_buffer >> 18) & 3];
 		r2 = r[0];
@@ -289,14 +317,14 @@ __global__ void agrepKernel32()
 			r0 = r2;
 			r1 = r3;
 			r2 = r[k];
-			r3 = ((r2 << 1) | mask_word) & ((r0 & r1) << 1) & r0;
+			r3 = advanceTable<H>(r0, r1, r2, mask_word);
 			r[k] = r3;
 		}
-		if (!(r3 & test_bit_32) && (match_count < max_match_count))
+		if (!(r3 & test_bit_32))
 		{
 			matching_character_index = ((outputting_scodon_base_index + scodon_index) << 4) + 9;
 			if (matching_character_index <= character_count)
-				match[atomicAdd((unsigned int *)&match_count, 1)] = matching_character_index;
+				saveMatch(matching_character_index);
 		}
 		mask_word = mask_array_32[(scodon_buffer >> 20) & 3];
 		r2 = r[0];
@@ -307,14 +335,14 @@ __global__ void agrepKernel32()
 			r0 = r2;
 			r1 = r3;
 			r2 = r[k];
-			r3 = ((r2 << 1) | mask_word) & ((r0 & r1) << 1) & r0;
+			r3 = advanceTable<H>(r0, r1, r2, mask_word);
 			r[k] = r3;
 		}
-		if (!(r3 & test_bit_32) && (match_count < max_match_count))
+		if (!(r3 & test_bit_32))
 		{
 			matching_character_index = ((outputting_scodon_base_index + scodon_index) << 4) + 10;
 			if (matching_character_index <= character_count)
-				match[atomicAdd((unsigned int *)&match_count, 1)] = matching_character_index;
+				saveMatch(matching_character_index);
 		}
 		mask_word = mask_array_32[(scodon_buffer >> 22) & 3];
 		r2 = r[0];
@@ -325,14 +353,14 @@ __global__ void agrepKernel32()
 			r0 = r2;
 			r1 = r3;
 			r2 = r[k];
-			r3 = ((r2 << 1) | mask_word) & ((r0 & r1) << 1) & r0;
+			r3 = advanceTable<H>(r0, r1, r2, mask_word);
 			r[k] = r3;
 		}
-		if (!(r3 & test_bit_32) && (match_count < max_match_count))
+		if (!(r3 & test_bit_32))
 		{
 			matching_character_index = ((outputting_scodon_base_index + scodon_index) << 4) + 11;
 			if (matching_character_index <= character_count)
-				match[atomicAdd((unsigned int *)&match_count, 1)] = matching_character_index;
+				saveMatch(matching_character_index);
 		}
 		mask_word = mask_array_32[(scodon_buffer >> 24) & 3];
 		r2 = r[0];
@@ -343,14 +371,14 @@ __global__ void agrepKernel32()
 			r0 = r2;
 			r1 = r3;
 			r2 = r[k];
-			r3 = ((r2 << 1) | mask_word) & ((r0 & r1) << 1) & r0;
+			r3 = advanceTable<H>(r0, r1, r2, mask_word);
 			r[k] = r3;
 		}
-		if (!(r3 & test_bit_32) && (match_count < max_match_count))
+		if (!(r3 & test_bit_32))
 		{
 			matching_character_index = ((outputting_scodon_base_index + scodon_index) << 4) + 12;
 			if (matching_character_index <= character_count)
-				match[atomicAdd((unsigned int *)&match_count, 1)] = matching_character_index;
+				saveMatch(matching_character_index);
 		}
 		mask_word = mask_array_32[(scodon_buffer >> 26) & 3];
 		r2 = r[0];
@@ -361,14 +389,14 @@ __global__ void agrepKernel32()
 			r0 = r2;
 			r1 = r3;
 			r2 = r[k];
-			r3 = ((r2 << 1) | mask_word) & ((r0 & r1) << 1) & r0;
+			r3 = advanceTable<H>(r0, r1, r2, mask_word);
 			r[k] = r3;
 		}
-		if (!(r3 & test_bit_32) && (match_count < max_match_count))
+		if (!(r3 & test_bit_32))
 		{
 			matching_character_index = ((outputting_scodon_base_index + scodon_index) << 4) + 13;
 			if (matching_character_index <= character_count)
-				match[atomicAdd((unsigned int *)&match_count, 1)] = matching_character_index;
+				saveMatch(matching_character_index);
 		}
 		mask_word = mask_array_32[(scodon_buffer >> 28) & 3];
 		r2 = r[0];
@@ -379,14 +407,14 @@ __global__ void agrepKernel32()
 			r0 = r2;
 			r1 = r3;
 			r2 = r[k];
-			r3 = ((r2 << 1) | mask_word) & ((r0 & r1) << 1) & r0;
+			r3 = advanceTable<H>(r0, r1, r2, mask_word);
 			r[k] = r3;
 		}
-		if (!(r3 & test_bit_32) && (match_count < max_match_count))
+		if (!(r3 & test_bit_32))
 		{
 			matching_character_index = ((outputting_scodon_base_index + scodon_index) << 4) + 14;
 			if (matching_character_index <= character_count)
-				match[atomicAdd((unsigned int *)&match_count, 1)] = matching_character_index;
+				saveMatch(matching_character_index);
 		}
 		mask_word = mask_array_32[(scodon_buffer >> 30) & 3];
 		r2 = r[0];
@@ -397,14 +425,14 @@ __global__ void agrepKernel32()
 			r0 = r2;
 			r1 = r3;
 			r2 = r[k];
-			r3 = ((r2 << 1) | mask_word) & ((r0 & r1) << 1) & r0;
+			r3 = advanceTable<H>(r0, r1, r2, mask_word);
 			r[k] = r3;
 		}
-		if (!(r3 & test_bit_32) && (match_count < max_match_count))
+		if (!(r3 & test_bit_32))
 		{
 			matching_character_index = ((outputting_scodon_base_index + scodon_index) << 4) + 15;
 			if (matching_character_index <= character_count)
-				match[atomicAdd((unsigned int *)&match_count, 1)] = matching_character_index;
+				saveMatch(matching_character_index);
 		}
 	}
 	for (scodon_index = 0; scodon_index < overlapping_scodon_count - 1; scodon_index++)
@@ -421,14 +449,14 @@ __global__ void agrepKernel32()
 				r0 = r2;
 				r1 = r3;
 				r2 = r[k];
-				r3 = ((r2 << 1) | mask_word) & ((r0 & r1) << 1) & r0;
+				r3 = advanceTable<H>(r0, r1, r2, mask_word);
 				r[k] = r3;
 			}
-			if (!(r3 & test_bit_32) && (match_count < max_match_count))
+			if (!(r3 & test_bit_32))
 			{
 				matching_character_index = ((outputting_scodon_base_index + (1 << L) + scodon_index) << 4) + character_index;
 				if (matching_character_index <= character_count)
-					match[atomicAdd((unsigned int *)&match_count, 1)] = matching_character_index;
+					saveMatch(matching_character_index);
 			}
 		}
 	}
@@ -444,14 +472,14 @@ __global__ void agrepKernel32()
 			r0 = r2;
 			r1 = r3;
 			r2 = r[k];
-			r3 = ((r2 << 1) | mask_word) & ((r0 & r1) << 1) & r0;
+			r3 = advanceTable<H>(r0, r1, r2, mask_word);
 			r[k] = r3;
 		}
-		if (!(r3 & test_bit_32) && (match_count < max_match_count))
+		if (!(r3 & test_bit_32))
 		{
 			matching_character_index = ((outputting_scodon_base_index + (1 << L) + scodon_index) << 4) + character_index;
 			if (matching_character_index <= character_count)
-				match[atomicAdd((unsigned int *)&match_count, 1)] = matching_character_index;
+				saveMatch(matching_character_index);
 		}
 	}
 }
@@ -460,7 +488,7 @@ __global__ void agrepKernel32()
  * The CUDA agrep kernel for matching tables of 64 bits.
  * All the necessary parameters are stored in constant memory.
  */
-template<unsigned int KI>
+template<unsigned int KI, bool H>
 __global__ void agrepKernel64()
 {
 	// About CUDA implementation.
@@ -484,6 +512,7 @@ __global__ void agrepKernel64()
 	unsigned int outputting_scodon_base_index;	// The base index into outputting special codon of current thread.
 	unsigned int matching_character_index;	// The output of the kernel. It stores the matching ending position.
 
+	if (gap_block[blockIdx.x]) return;	// The thread block cannot report valid matches. All its threads return before __syncthreads().
 	block_base_index = blockIdx.x << (L + B);	// The base index of current thread block.
 	inputting_scodon_base_index  = block_base_index + threadIdx.x;	// Coalesced global memory access is ensured.
 	outputting_scodon_base_index = block_base_index + (threadIdx.x << L);	// Original order of corpus.
@@ -504,7 +533,7 @@ __global__ void agrepKernel64()
 				r0 = r2;
 				r1 = r3;
 				r2 = r[k];
-				r3 = ((r2 << 1) | mask_word) & ((r0 & r1) << 1) & r0;
+				r3 = advanceTable<H>(r0, r1, r2, mask_word);
 				r[k] = r3;
 			}
 		}
@@ -522,7 +551,7 @@ __global__ void agrepKernel64()
 			r0 = r2;
 			r1 = r3;
 			r2 = r[k];
-			r3 = ((r2 << 1) | mask_word) & ((r0 & r1) << 1) & r0;
+			r3 = advanceTable<H>(r0, r1, r2, mask_word);
 			r[k] = r3;
 		}
 	}
@@ -537,19 +566,19 @@ __global__ void agrepKernel64()
 			r0 = r2;
 			r1 = r3;
 			r2 = r[k];
-			r3 = ((r2 << 1) | mask_word) & ((r0 & r1) << 1) & r0;
+			r3 = advanceTable<H>(r0, r1, r2, mask_word);
 			r[k] = r3;
 		}
-		if (!(r3 & test_bit_64) && (match_count < max_match_count))
+		if (!(r3 & test_bit_64))
 		{
 			/* A possible match is found.
 			 *   1) Calculate the matching character index, and ensure it does not exceed the corpus boundary.
 			 *   2) Atomically increase match_count by 1, whose original value points to the index that the current match should be saved at.
-			 *   3) Save the matching character index to the match array, if the max number of matches has not yet been exceeded.
+			 *   3) Save the matching character index to the match array, if the match array has room.
 			 */
 			matching_character_index = ((outputting_scodon_base_index + scodon_index) << 4) + character_index;
 			if (matching_character_index <= character_count)
-				match[atomicAdd((unsigned int *)&match_count, 1)] = matching_character_index;
+				saveMatch(matching_character_index);
 		}
 	}
 	scodon_header[scodon_index][threadIdx.x] = scodon_buffer;
@@ -566,14 +595,14 @@ __global__ void agrepKernel64()
 			r0 = r2;
 			r1 = r3;
 			r2 = r[k];
-			r3 = ((r2 << 1) | mask_word) & ((r0 & r1) << 1) & r0;
+			r3 = advanceTable<H>(r0, r1, r2, mask_word);
 			r[k] = r3;
 		}
-		if (!(r3 & test_bit_64) && (match_count < max_match_count))
+		if (!(r3 & test_bit_64))
 		{
 			matching_character_index = ((outputting_scodon_base_index + scodon_index) << 4) + 0;
 			if (matching_character_index <= character_count)
-				match[atomicAdd((unsigned int *)&match_count, 1)] = matching_character_index;
+				saveMatch(matching_character_index);
 		}
 		mask_word = mask_array_64[(scodon_buffer >> 2) & 3];
 		r2 = r[0];
@@ -584,14 +613,14 @@ __global__ void agrepKernel64()
 			r0 = r2;
 			r1 = r3;
 			r2 = r[k];
-			r3 = ((r2 << 1) | mask_word) & ((r0 & r1) << 1) & r0;
+			r3 = advanceTable<H>(r0, r1, r2, mask_word);
 			r[k] = r3;
 		}
-		if (!(r3 & test_bit_64) && (match_count < max_match_count))
+		if (!(r3 & test_bit_64))
 		{
 			matching_character_index = ((outputting_scodon_base_index + scodon_index) << 4) + 1;
 			if (matching_character_index <= character_count)
-				match[atomicAdd((unsigned int *)&match_count, 1)] = matching_character_index;
+				saveMatch(matching_character_index);
 		}
 		mask_word = mask_array_64[(scodon_buffer >> 4) & 3];
 		r2 = r[0];
@@ -602,14 +631,14 @@ __global__ void agrepKernel64()
 			r0 = r2;
 			r1 = r3;
 			r2 = r[k];
-			r3 = ((r2 << 1) | mask_word) & ((r0 & r1) << 1) & r0;
+			r3 = advanceTable<H>(r0, r1, r2, mask_word);
 			r[k] = r3;
 		}
-		if (!(r3 & test_bit_64) && (match_count < max_match_count))
+		if (!(r3 & test_bit_64))
 		{
 			matching_character_index = ((outputting_scodon_base_index + scodon_index) << 4) + 2;
 			if (matching_character_index <= character_count)
-				match[atomicAdd((unsigned int *)&match_count, 1)] = matching_character_index;
+				saveMatch(matching_character_index);
 		}
 		mask_word = mask_array_64[(scodon_buffer >> 6) & 3];
 		r2 = r[0];
@@ -620,14 +649,14 @@ __global__ void agrepKernel64()
 			r0 = r2;
 			r1 = r3;
 			r2 = r[k];
-			r3 = ((r2 << 1) | mask_word) & ((r0 & r1) << 1) & r0;
+			r3 = advanceTable<H>(r0, r1, r2, mask_word);
 			r[k] = r3;
 		}
-		if (!(r3 & test_bit_64) && (match_count < max_match_count))
+		if (!(r3 & test_bit_64))
 		{
 			matching_character_index = ((outputting_scodon_base_index + scodon_index) << 4) + 3;
 			if (matching_character_index <= character_count)
-				match[atomicAdd((unsigned int *)&match_count, 1)] = matching_character_index;
+				saveMatch(matching_character_index);
 		}
 		mask_word = mask_array_64[(scodon_buffer >> 8) & 3];
 		r2 = r[0];
@@ -638,14 +667,14 @@ __global__ void agrepKernel64()
 			r0 = r2;
 			r1 = r3;
 			r2 = r[k];
-			r3 = ((r2 << 1) | mask_word) & ((r0 & r1) << 1) & r0;
+			r3 = advanceTable<H>(r0, r1, r2, mask_word);
 			r[k] = r3;
 		}
-		if (!(r3 & test_bit_64) && (match_count < max_match_count))
+		if (!(r3 & test_bit_64))
 		{
 			matching_character_index = ((outputting_scodon_base_index + scodon_index) << 4) + 4;
 			if (matching_character_index <= character_count)
-				match[atomicAdd((unsigned int *)&match_count, 1)] = matching_character_index;
+				saveMatch(matching_character_index);
 		}
 		mask_word = mask_array_64[(scodon_buffer >> 10) & 3];
 		r2 = r[0];
@@ -656,14 +685,14 @@ __global__ void agrepKernel64()
 			r0 = r2;
 			r1 = r3;
 			r2 = r[k];
-			r3 = ((r2 << 1) | mask_word) & ((r0 & r1) << 1) & r0;
+			r3 = advanceTable<H>(r0, r1, r2, mask_word);
 			r[k] = r3;
 		}
-		if (!(r3 & test_bit_64) && (match_count < max_match_count))
+		if (!(r3 & test_bit_64))
 		{
 			matching_character_index = ((outputting_scodon_base_index + scodon_index) << 4) + 5;
 			if (matching_character_index <= character_count)
-				match[atomicAdd((unsigned int *)&match_count, 1)] = matching_character_index;
+				saveMatch(matching_character_index);
 		}
 		mask_word = mask_array_64[(scodon_buffer >> 12) & 3];
 		r2 = r[0];
@@ -674,14 +703,14 @@ __global__ void agrepKernel64()
 			r0 = r2;
 			r1 = r3;
 			r2 = r[k];
-			r3 = ((r2 << 1) | mask_word) & ((r0 & r1) << 1) & r0;
+			r3 = advanceTable<H>(r0, r1, r2, mask_word);
 			r[k] = r3;
 		}
-		if (!(r3 & test_bit_64) && (match_count < max_match_count))
+		if (!(r3 & test_bit_64))
 		{
 			matching_character_index = ((outputting_scodon_base_index + scodon_index) << 4) + 6;
 			if (matching_character_index <= character_count)
-				match[atomicAdd((unsigned int *)&match_count, 1)] = matching_character_index;
+				saveMatch(matching_character_index);
 		}
 		mask_word = mask_array_64[(scodon_buffer >> 14) & 3];
 		r2 = r[0];
@@ -692,14 +721,14 @@ __global__ void agrepKernel64()
 			r0 = r2;
 			r1 = r3;
 			r2 = r[k];
-			r3 = ((r2 << 1) | mask_word) & ((r0 & r1) << 1) & r0;
+			r3 = advanceTable<H>(r0, r1, r2, mask_word);
 			r[k] = r3;
 		}
-		if (!(r3 & test_bit_64) && (match_count < max_match_count))
+		if (!(r3 & test_bit_64))
 		{
 			matching_character_index = ((outputting_scodon_base_index + scodon_index) << 4) + 7;
 			if (matching_character_index <= character_count)
-				match[atomicAdd((unsigned int *)&match_count, 1)] = matching_character_index;
+				saveMatch(matching_character_index);
 		}
 		mask_word = mask_array_64[(scodon_buffer >> 16) & 3];
 		r2 = r[0];
@@ -710,14 +739,14 @@ __global__ void agrepKernel64()
 			r0 = r2;
 			r1 = r3;
 			r2 = r[k];
-			r3 = ((r2 << 1) | mask_word) & ((r0 & r1) << 1) & r0;
+			r3 = advanceTable<H>(r0, r1, r2, mask_word);
 			r[k] = r3;
 		}
-		if (!(r3 & test_bit_64) && (match_count < max_match_count))
+		if (!(r3 & test_bit_64))
 		{
 			matching_character_index = ((outputting_scodon_base_index + scodon_index) << 4) + 8;
 			if (matching_character_index <= character_count)
-				match[atomicAdd((unsigned int *)&match_count, 1)] = matching_character_index;
+				saveMatch(matching_character_index);
 		}
 		mask_word = mask_array_64[(scodon_buffer >> 18) & 3];
 		r2 = r[0];
@@ -728,14 +757,14 @@ __global__ void agrepKernel64()
 			r0 = r2;
 			r1 = r3;
 			r2 = r[k];
-			r3 = ((r2 << 1) | mask_word) & ((r0 & r1) << 1) & r0;
+			r3 = advanceTable<H>(r0, r1, r2, mask_word);
 			r[k] = r3;
 		}
-		if (!(r3 & test_bit_64) && (match_count < max_match_count))
+		if (!(r3 & test_bit_64))
 		{
 			matching_character_index = ((outputting_scodon_base_index + scodon_index) << 4) + 9;
 			if (matching_character_index <= character_count)
-				match[atomicAdd((unsigned int *)&match_count, 1)] = matching_character_index;
+				saveMatch(matching_character_index);
 		}
 		mask_word = mask_array_64[(scodon_buffer >> 20) & 3];
 		r2 = r[0];
@@ -746,14 +775,14 @@ __global__ void agrepKernel64()
 			r0 = r2;
 			r1 = r3;
 			r2 = r[k];
-			r3 = ((r2 << 1) | mask_word) & ((r0 & r1) << 1) & r0;
+			r3 = advanceTable<H>(r0, r1, r2, mask_word);
 			r[k] = r3;
 		}
-		if (!(r3 & test_bit_64) && (match_count < max_match_count))
+		if (!(r3 & test_bit_64))
 		{
 			matching_character_index = ((outputting_scodon_base_index + scodon_index) << 4) + 10;
 			if (matching_character_index <= character_count)
-				match[atomicAdd((unsigned int *)&match_count, 1)] = matching_character_index;
+				saveMatch(matching_character_index);
 		}
 		mask_word = mask_array_64[(scodon_buffer >> 22) & 3];
 		r2 = r[0];
@@ -764,14 +793,14 @@ __global__ void agrepKernel64()
 			r0 = r2;
 			r1 = r3;
 			r2 = r[k];
-			r3 = ((r2 << 1) | mask_word) & ((r0 & r1) << 1) & r0;
+			r3 = advanceTable<H>(r0, r1, r2, mask_word);
 			r[k] = r3;
 		}
-		if (!(r3 & test_bit_64) && (match_count < max_match_count))
+		if (!(r3 & test_bit_64))
 		{
 			matching_character_index = ((outputting_scodon_base_index + scodon_index) << 4) + 11;
 			if (matching_character_index <= character_count)
-				match[atomicAdd((unsigned int *)&match_count, 1)] = matching_character_index;
+				saveMatch(matching_character_index);
 		}
 		mask_word = mask_array_64[(scodon_buffer >> 24) & 3];
 		r2 = r[0];
@@ -782,14 +811,14 @@ __global__ void agrepKernel64()
 			r0 = r2;
 			r1 = r3;
 			r2 = r[k];
-			r3 = ((r2 << 1) | mask_word) & ((r0 & r1) << 1) & r0;
+			r3 = advanceTable<H>(r0, r1, r2, mask_word);
 			r[k] = r3;
 		}
-		if (!(r3 & test_bit_64) && (match_count < max_match_count))
+		if (!(r3 & test_bit_64))
 		{
 			matching_character_index = ((outputting_scodon_base_index + scodon_index) << 4) + 12;
 			if (matching_character_index <= character_count)
-				match[atomicAdd((unsigned int *)&match_count, 1)] = matching_character_index;
+				saveMatch(matching_character_index);
 		}
 		mask_word = mask_array_64[(scodon_buffer >> 26) & 3];
 		r2 = r[0];
@@ -800,14 +829,14 @@ __global__ void agrepKernel64()
 			r0 = r2;
 			r1 = r3;
 			r2 = r[k];
-			r3 = ((r2 << 1) | mask_word) & ((r0 & r1) << 1) & r0;
+			r3 = advanceTable<H>(r0, r1, r2, mask_word);
 			r[k] = r3;
 		}
-		if (!(r3 & test_bit_64) && (match_count < max_match_count))
+		if (!(r3 & test_bit_64))
 		{
 			matching_character_index = ((outputting_scodon_base_index + scodon_index) << 4) + 13;
 			if (matching_character_index <= character_count)
-				match[atomicAdd((unsigned int *)&match_count, 1)] = matching_character_index;
+				saveMatch(matching_character_index);
 		}
 		mask_word = mask_array_64[(scodon_buffer >> 28) & 3];
 		r2 = r[0];
@@ -818,14 +847,14 @@ __global__ void agrepKernel64()
 			r0 = r2;
 			r1 = r3;
 			r2 = r[k];
-			r3 = ((r2 << 1) | mask_word) & ((r0 & r1) << 1) & r0;
+			r3 = advanceTable<H>(r0, r1, r2, mask_word);
 			r[k] = r3;
 		}
-		if (!(r3 & test_bit_64) && (match_count < max_match_count))
+		if (!(r3 & test_bit_64))
 		{
 			matching_character_index = ((outputting_scodon_base_index + scodon_index) << 4) + 14;
 			if (matching_character_index <= character_count)
-				match[atomicAdd((unsigned int *)&match_count, 1)] = matching_character_index;
+				saveMatch(matching_character_index);
 		}
 		mask_word = mask_array_64[(scodon_buffer >> 30) & 3];
 		r2 = r[0];
@@ -836,14 +865,14 @@ __global__ void agrepKernel64()
 			r0 = r2;
 			r1 = r3;
 			r2 = r[k];
-			r3 = ((r2 << 1) | mask_word) & ((r0 & r1) << 1) & r0;
+			r3 = advanceTable<H>(r0, r1, r2, mask_word);
 			r[k] = r3;
 		}
-		if (!(r3 & test_bit_64) && (match_count < max_match_count))
+		if (!(r3 & test_bit_64))
 		{
 			matching_character_index = ((outputting_scodon_base_index + scodon_index) << 4) + 15;
 			if (matching_character_index <= character_count)
-				match[atomicAdd((unsigned int *)&match_count, 1)] = matching_character_index;
+				saveMatch(matching_character_index);
 		}
 	}
 	for (scodon_index = 0; scodon_index < overlapping_scodon_count - 1; scodon_index++)
@@ -860,14 +889,14 @@ __global__ void agrepKernel64()
 				r0 = r2;
 				r1 = r3;
 				r2 = r[k];
-				r3 = ((r2 << 1) | mask_word) & ((r0 & r1) << 1) & r0;
+				r3 = advanceTable<H>(r0, r1, r2, mask_word);
 				r[k] = r3;
 			}
-			if (!(r3 & test_bit_64) && (match_count < max_match_count))
+			if (!(r3 & test_bit_64))
 			{
 				matching_character_index = ((outputting_scodon_base_index + (1 << L) + scodon_index) << 4) + character_index;
 				if (matching_character_index <= character_count)
-					match[atomicAdd((unsigned int *)&match_count, 1)] = matching_character_index;
+					saveMatch(matching_character_index);
 			}
 		}
 	}
@@ -883,14 +912,14 @@ __global__ void agrepKernel64()
 			r0 = r2;
 			r1 = r3;
 			r2 = r[k];
-			r3 = ((r2 << 1) | mask_word) & ((r0 & r1) << 1) & r0;
+			r3 = advanceTable<H>(r0, r1, r2, mask_word);
 			r[k] = r3;
 		}
-		if (!(r3 & test_bit_64) && (match_count < max_match_count))
+		if (!(r3 & test_bit_64))
 		{
 			matching_character_index = ((outputting_scodon_base_index + (1 << L) + scodon_index) << 4) + character_index;
 			if (matching_character_index <= character_count)
-				match[atomicAdd((unsigned int *)&match_count, 1)] = matching_character_index;
+				saveMatch(matching_character_index);
 		}
 	}
 }
@@ -900,13 +929,15 @@ __global__ void agrepKernel64()
  * This agrep kernel initialization should be called only once for searching the same corpus.
  * @param[in] scodon_arg The special codon array.
  * @param[in] character_count_arg Actual number of characters.
+ * @param[in] gap_block_arg The gap flags of thread blocks.
  * @param[in] match_arg The match array.
- * @param[in] max_match_count_arg Maximum number of matches of one single query.
+ * @param[in] max_match_count_arg Capacity of the match array.
  */
-void initAgrepKernel(const unsigned int *scodon_arg, const unsigned int character_count_arg, const unsigned int *match_arg, const unsigned int max_match_count_arg)
+void initAgrepKernel(const unsigned int *scodon_arg, const unsigned int character_count_arg, const unsigned char *gap_block_arg, const unsigned int *match_arg, const unsigned int max_match_count_arg)
 {
 	cudaMemcpyToSymbol(scodon, &scodon_arg, sizeof(unsigned int *));
 	cudaMemcpyToSymbol(character_count, &character_count_arg, sizeof(unsigned int));
+	cudaMemcpyToSymbol(gap_block, &gap_block_arg, sizeof(unsigned char *));
 	cudaMemcpyToSymbol(match, &match_arg, sizeof(unsigned int *));
 	cudaMemcpyToSymbol(max_match_count, &max_match_count_arg, sizeof(unsigned int));
 }
@@ -934,55 +965,48 @@ void transferMaskArray64(const unsigned long long *mask_array_arg, const unsigne
 }
 
 /**
- * Invoke the cuda implementation of agrep kernel.
+ * Launch the agrep kernel of a pattern length, an edit distance and a distance type.
  * @param[in] m Pattern length.
  * @param[in] k Edit distance.
  * @param[in] block_count Number of thread blocks.
+ * @param[in] scodon_header_size Size of dynamic shared memory.
  */
-void invokeAgrepKernel(const unsigned int m, const unsigned int k, const unsigned int block_count)
+template<bool H>
+static void launchAgrepKernel(const unsigned int m, const unsigned int k, const unsigned int block_count, const unsigned int scodon_header_size)
 {
-	unsigned int overlapping_character_count_init = m + k - 1;
-	unsigned int overlapping_scodon_count_init = (overlapping_character_count_init + 16 - 1) >> 4;
-	unsigned int scodon_header_size = (sizeof(unsigned int) << B) * overlapping_scodon_count_init;	// Used to allocate dynamic shared memory. The first overlapping_scodon_count_init special codons of each thread will be saved into shared memory for the previous thread to continue processing.
-	unsigned int match_count_init = 0;
-
-	cudaMemcpyToSymbol(overlapping_character_count, &overlapping_character_count_init, sizeof(unsigned int));
-	cudaMemcpyToSymbol(overlapping_scodon_count, &overlapping_scodon_count_init, sizeof(unsigned int));
-	cudaMemcpyToSymbol(match_count, &match_count_init, sizeof(unsigned int));
-
 	if (m <= 32)
 	{
 		switch (k)
 		{
 			case 0:
-				agrepKernel32<0><<<block_count, 1 << B, scodon_header_size>>>();
+				agrepKernel32<0, H><<<block_count, 1 << B, scodon_header_size>>>();
 				break;
 			case 1:
-				agrepKernel32<1><<<block_count, 1 << B, scodon_header_size>>>();
+				agrepKernel32<1, H><<<block_count, 1 << B, scodon_header_size>>>();
 				break;
 			case 2:
-				agrepKernel32<2><<<block_count, 1 << B, scodon_header_size>>>();
+				agrepKernel32<2, H><<<block_count, 1 << B, scodon_header_size>>>();
 				break;
 			case 3:
-				agrepKernel32<3><<<block_count, 1 << B, scodon_header_size>>>();
+				agrepKernel32<3, H><<<block_count, 1 << B, scodon_header_size>>>();
 				break;
 			case 4:
-				agrepKernel32<4><<<block_count, 1 << B, scodon_header_size>>>();
+				agrepKernel32<4, H><<<block_count, 1 << B, scodon_header_size>>>();
 				break;
 			case 5:
-				agrepKernel32<5><<<block_count, 1 << B, scodon_header_size>>>();
+				agrepKernel32<5, H><<<block_count, 1 << B, scodon_header_size>>>();
 				break;
 			case 6:
-				agrepKernel32<6><<<block_count, 1 << B, scodon_header_size>>>();
+				agrepKernel32<6, H><<<block_count, 1 << B, scodon_header_size>>>();
 				break;
 			case 7:
-				agrepKernel32<7><<<block_count, 1 << B, scodon_header_size>>>();
+				agrepKernel32<7, H><<<block_count, 1 << B, scodon_header_size>>>();
 				break;
 			case 8:
-				agrepKernel32<8><<<block_count, 1 << B, scodon_header_size>>>();
+				agrepKernel32<8, H><<<block_count, 1 << B, scodon_header_size>>>();
 				break;
 			case 9:
-				agrepKernel32<9><<<block_count, 1 << B, scodon_header_size>>>();
+				agrepKernel32<9, H><<<block_count, 1 << B, scodon_header_size>>>();
 				break;
 		}
 	}
@@ -991,39 +1015,63 @@ void invokeAgrepKernel(const unsigned int m, const unsigned int k, const unsigne
 		switch (k)
 		{
 			case 0:
-				agrepKernel64<0><<<block_count, 1 << B, scodon_header_size>>>();
+				agrepKernel64<0, H><<<block_count, 1 << B, scodon_header_size>>>();
 				break;
 			case 1:
-				agrepKernel64<1><<<block_count, 1 << B, scodon_header_size>>>();
+				agrepKernel64<1, H><<<block_count, 1 << B, scodon_header_size>>>();
 				break;
 			case 2:
-				agrepKernel64<2><<<block_count, 1 << B, scodon_header_size>>>();
+				agrepKernel64<2, H><<<block_count, 1 << B, scodon_header_size>>>();
 				break;
 			case 3:
-				agrepKernel64<3><<<block_count, 1 << B, scodon_header_size>>>();
+				agrepKernel64<3, H><<<block_count, 1 << B, scodon_header_size>>>();
 				break;
 			case 4:
-				agrepKernel64<4><<<block_count, 1 << B, scodon_header_size>>>();
+				agrepKernel64<4, H><<<block_count, 1 << B, scodon_header_size>>>();
 				break;
 			case 5:
-				agrepKernel64<5><<<block_count, 1 << B, scodon_header_size>>>();
+				agrepKernel64<5, H><<<block_count, 1 << B, scodon_header_size>>>();
 				break;
 			case 6:
-				agrepKernel64<6><<<block_count, 1 << B, scodon_header_size>>>();
+				agrepKernel64<6, H><<<block_count, 1 << B, scodon_header_size>>>();
 				break;
 			case 7:
-				agrepKernel64<7><<<block_count, 1 << B, scodon_header_size>>>();
+				agrepKernel64<7, H><<<block_count, 1 << B, scodon_header_size>>>();
 				break;
 			case 8:
-				agrepKernel64<8><<<block_count, 1 << B, scodon_header_size>>>();
+				agrepKernel64<8, H><<<block_count, 1 << B, scodon_header_size>>>();
 				break;
 			case 9:
-				agrepKernel64<9><<<block_count, 1 << B, scodon_header_size>>>();
+				agrepKernel64<9, H><<<block_count, 1 << B, scodon_header_size>>>();
 				break;
 		}
 	}
 }
 
+/**
+ * Invoke the cuda implementation of agrep kernel.
+ * @param[in] m Pattern length.
+ * @param[in] k Edit distance.
+ * @param[in] hamming Whether substitutions are the only edits.
+ * @param[in] block_count Number of thread blocks.
+ */
+void invokeAgrepKernel(const unsigned int m, const unsigned int k, const bool hamming, const unsigned int block_count)
+{
+	unsigned int overlapping_character_count_init = m + k - 1;
+	unsigned int overlapping_scodon_count_init = (overlapping_character_count_init + 16 - 1) >> 4;
+	unsigned int scodon_header_size = (sizeof(unsigned int) << B) * overlapping_scodon_count_init;	// Used to allocate dynamic shared memory. The first overlapping_scodon_count_init special codons of each thread will be saved into shared memory for the previous thread to continue processing.
+	unsigned int match_count_init = 0;
+
+	cudaMemcpyToSymbol(overlapping_character_count, &overlapping_character_count_init, sizeof(unsigned int));
+	cudaMemcpyToSymbol(overlapping_scodon_count, &overlapping_scodon_count_init, sizeof(unsigned int));
+	cudaMemcpyToSymbol(match_count, &match_count_init, sizeof(unsigned int));
+
+	if (hamming)
+		launchAgrepKernel<true>(m, k, block_count, scodon_header_size);
+	else
+		launchAgrepKernel<false>(m, k, block_count, scodon_header_size);
+}
+
 /**
  * Get the number of matches from CUDA constant memory.
  * @param[out] match_count_arg Number of matches.
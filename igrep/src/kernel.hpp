@@ -17,10 +17,11 @@
  * This agrep kernel initialization should be called only once for searching the same corpus.
  * @param[in] scodon_arg The special codon array.
  * @param[in] character_count_arg Actual number of characters.
+ * @param[in] gap_block_arg The gap flags of thread blocks. Thread blocks that lie within gaps return at once.
  * @param[in] match_arg The match array.
- * @param[in] max_match_count_arg Maximum number of matches of one single query.
+ * @param[in] max_match_count_arg Capacity of the match array.
  */
-void initAgrepKernel(const unsigned int *scodon_arg, const unsigned int character_count_arg, const unsigned int *match_arg, const unsigned int max_match_count_arg);
+void initAgrepKernel(const unsigned int *scodon_arg, const unsigned int character_count_arg, const unsigned char *gap_block_arg, const unsigned int *match_arg, const unsigned int max_match_count_arg);
 
 /**
  * Transfer 32-bit mask array and test bit from host to CUDA constant memory.
@@ -40,13 +41,14 @@ void transferMaskArray64(const unsigned long long *mask_array_arg, const unsigne
  * Invoke the CUDA implementation of agrep kernel.
  * @param[in] m Pattern length.
  * @param[in] k Edit distance.
+ * @param[in] hamming Whether substitutions are the only edits, in which case the cheaper recurrence of Hamming distance is run.
  * @param[in] block_count Number of thread blocks.
  */
-void invokeAgrepKernel(const unsigned int m, const unsigned int k, const unsigned int block_count);
+void invokeAgrepKernel(const unsigned int m, const unsigned int k, const bool hamming, const unsigned int block_count);
 
 /**
  * Get the number of matches from CUDA constant memory.
- * @param[out] match_count_arg Number of matches.
+ * @param[out] match_count_arg Number of matches, which may exceed the capacity of the match array.
  */
 void getMatchCount(unsigned int *match_count_arg);
 
@@ -1,25 +1,34 @@
+#include <cstdio>
 #include <iostream>
 #include <sstream>
 #include <vector>
 #include <thread>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <numeric>
+#include <algorithm>
 #include <boost/filesystem/operations.hpp>
 #include <boost/filesystem/fstream.hpp>
-#include <boost/iostreams/filtering_stream.hpp>
-#include <boost/iostreams/filter/gzip.hpp>
 #include <boost/date_time/posix_time/posix_time.hpp>
-#include <cuda_runtime_api.h>
-#include <helper_cuda.h>
 #include <mongo/client/dbclient.h>
 #include <Poco/Net/MailMessage.h>
 #include <Poco/Net/MailRecipient.h>
 #include <Poco/Net/SMTPClientSession.h>
 #include <curl/curl.h>
-#include "kernel.hpp"
+#include "genome_cache.hpp"
+#include "genome_index.hpp"
+#include "cpu_backend.hpp"
+#include "alignment.hpp"
+#include "genome_stream.hpp"
+#include "match_cache.hpp"
+#ifndef IGREP_CPU_ONLY
+#include "gpu_backend.hpp"
+#endif
 
 using namespace std;
 using namespace std::chrono;
 using namespace boost::filesystem;
-using namespace boost::iostreams;
 using namespace boost::gregorian;
 using namespace boost::posix_time;
 using namespace mongo;
@@ -31,165 +40,133 @@ inline static string local_time()
 	return to_simple_string(microsec_clock::local_time()) + " ";
 }
 
-size_t read_from_stringstream(char *buffer, size_t size, size_t count, istringstream *ss)
-{
-	assert(size == 1);
-	if (ss->eof()) return 0;
-	ss->read(buffer, count);
-	return count;
-}
-
 /**
- * Encode a character to its 2-bit binary representation.
- * The last two but one bits are different for A, C, G, and T respectively.
- * Note that some genomes contain 'N', which will be treated as 'G' in this encoding function.
- *
- * 'A' = 65 = 01000<b>00</b>1
- *
- * 'C' = 67 = 01000<b>01</b>1
- *
- * 'G' = 71 = 01000<b>11</b>1
- *
- * 'N' = 78 = 01001<b>11</b>0
- *
- * 'T' = 84 = 01010<b>10</b>0
- * @param[in] character The character to be encoded.
- * @return The 2-bit binary representation of given character.
+ * Derive the mask arrays of a query, i.e. a pattern of up to 1,000 characters followed by a single-digit edit distance, and optionally by M to count mismatches only.
+ * @param[in] line The query line.
+ * @return The pattern.
  */
-inline unsigned int encode(char character)
+static agrep_pattern make_pattern(const string& line)
 {
-	return (toupper(character) >> 1) & 3;
-}
+	agrep_pattern p;
+	p.hamming = line.back() == 'M' || line.back() == 'm';	// Hamming distance.
+	p.m = line.size() - 1 - p.hamming;		// Pattern length.
+	p.k = line[p.m] - 48;	// Edit distance.
 
-/// Represents a genome in FASTA format.
-class genome
-{
-public:
-	const unsigned int taxid;	/**< taxidomy ID. */
-	string name;	/**< Genome name. */
-	const unsigned int sequence_count;	/**< Actual number of sequences. */
-	const unsigned int character_count;	/**< Actual number of characters. */
-	vector<unsigned int> sequence_length;	/**< Lengthes of sequences. */
-	vector<unsigned int> sequence_cumulative_length;	/**< Cumulative lengths of sequences, i.e. 1) sequence_cumulative_length[0] = 0; 2) sequence_cumulative_length[sequence_index + 1] = sequence_cumulative_length[sequence_index] + sequence_length[sequence_index]; */
-	const unsigned int scodon_count;	/**< Actual number of special codons. */
-	const unsigned int block_count;	/**< Actual number of thread blocks. */
-	vector<unsigned int> scodon;	/**< The entire genomic nucleotides are stored into this array, one element of which, i.e. one 32-bit unsigned int, can store up to 16 nucleotides because one nucleotide can be uniquely represented by two bits since it must be either A, C, G, or T. One unsigned int is called a special codon, or scodon for short, because it is similar to codon, in which three consecutive characters of mRNA determine one amino acid of resulting protein. */
-	vector<unsigned int> block_to_sequence;	/**< Mapping of thread blocks to sequences. */
-
-	/**
-	 * Construct a genome by loading its FASTA files.
-	 * @param[in] taxid taxidomy ID, e.g. 9606 for human.
-	 * @param[in] name Scientific name followed by common name in brackets, e.g. Homo sapiens (Human).
-	 * @param[in] sequence_count Number of sequences. For assembled genomes, it equals the number of FASTA files.
-	 * @param[in] character_count Number of characters.
-	 * @param[in] files Fasta files;
-	 */
-	explicit genome(const unsigned int taxid, const string name, const unsigned int character_count, const vector<string>&& files) :
-		taxid(taxid),
-		name(name),
-		sequence_count(files.size()),
-		character_count(character_count),
-		sequence_length(sequence_count),
-		sequence_cumulative_length(sequence_count + 1),
-		scodon_count((character_count + 16 - 1) >> 4),
-		block_count((scodon_count + (1 << (L + B)) - 1) >> (L + B)),
-		scodon(block_count << (L + B)),
-		block_to_sequence(block_count)
+	// Build the mask array of every 64 characters, and keep those of the first 64 characters in mask_array.
+	p.word_mask_arrays.resize((p.m + 63) >> 6);
+	for (auto& word_mask_array : p.word_mask_arrays) word_mask_array.fill(0);
+	for (unsigned int i = 0; i < p.m; ++i)
 	{
-		sequence_cumulative_length[0] = 0;
-
-		cout << local_time() << "Loading the genome of " << name << endl;
-		unsigned int scodon_buffer = 0;	// 16 consecutive characters will be accommodated into one 32-bit unsigned int.
-		unsigned int scodon_index;	// scodon[scodon_index] = scodon_buffer; In CUDA implementation, special codons need to be properly shuffled in order to satisfy coalesced global memory access.
-		int sequence_index = -1;	// Index of the current sequence.
-		unsigned int character_index = 0;	// Index of the current character across all the sequences of the entire genome.
-		string line;
-		line.reserve(1000);
-		const path genome_path = name;
-		for (const auto& file : files)
+		auto& word_mask_array = p.word_mask_arrays[i >> 6];
+		unsigned long long j = (unsigned long long)1 << (i & 63);
+		if ((line[i] == 'N') || (line[i] == 'n'))
 		{
-			boost::filesystem::ifstream ifs(genome_path / file);
-			filtering_istream fis;
-			fis.push(gzip_decompressor());
-			fis.push(ifs);
-			while (getline(fis, line))
-			{
-				if (line.front() == '>') // Header line.
-				{
-					if (++sequence_index) // Not the first sequence.
-					{
-						sequence_cumulative_length[sequence_index] = character_index;
-						sequence_length[sequence_index - 1] = character_index - sequence_cumulative_length[sequence_index - 1];
-					}
-				}
-				else
-				{
-					for (const auto c : line)
-					{
-						const unsigned int character_index_lowest_four_bits = character_index & 15;
-						scodon_buffer |= encode(c) << (character_index_lowest_four_bits << 1); // Earlier characters reside in lower bits, while later characters reside in higher bits.
-						if (character_index_lowest_four_bits == 15) // The buffer is full. Flush it to the special codon array. Note that there is no need to clear scodon_buffer.
-						{
-							scodon_index = character_index >> 4;
-							// scodon_index can be splitted into 3 parts:
-							// scodon_index = block_index << (L + B) | thread_index << L | scodon_index;
-							// because 1) each thread block processes 1 << (L + B) special codons,
-							//     and 2) each thread processes 1 << L special codons.
-							// The scodon_index is accommodated in the lowest L bits.
-							// The thread_index is accommodated in the middle B bits.
-							// The block_index  is accommodated in the highest 32 - (L + B) bits.
-							// This program uses 1D CUDA thread organization, so at most 65,536 threads can be specified, i.e. at least 16 bits should be reserved for block_index.
-							// Therefore, the inequation 32 - (L + B) >= 16 must hold. ==> L + B <= 16.
-							// In order to satisfy coalesced global memory access, thread_index should be rearranged to the lowest B bits.
-							// To achieve this goal,
-							//         1) block_index remains at the highest 32 - (L + B) bits,
-							//   while 2) thread_index should be rearranged to the lowest B bits,
-							//     and 3) scodon_index should be rearranged to the middle L bits.
-							// Finally, scodon_index = block_index << (L + B) | scodon_index << B | thread_index;
-							scodon_index = (scodon_index & (MAX_UNSIGNED_INT ^ ((1 << (L + B)) - 1)))
-										 | ((scodon_index & ((1 << L) - 1)) << B)
-										 | ((scodon_index >> L) & ((1 << B) - 1));
-							scodon[scodon_index] = scodon_buffer;
-							scodon_buffer = 0;
-						}
-						++character_index;
-					}
-				}
-			}
+			word_mask_array[0] |= j;
+			word_mask_array[1] |= j;
+			word_mask_array[2] |= j;
+			word_mask_array[3] |= j;
 		}
-		BOOST_ASSERT(character_count == character_index);
-		BOOST_ASSERT(sequence_count == sequence_index + 1);
-
-		// Calculate statistics.
-		sequence_cumulative_length[sequence_count] = character_count;
-		sequence_length[sequence_index] = character_count - sequence_cumulative_length[sequence_index];
-		scodon_index = character_index >> 4;
-		if (scodon_index < scodon_count)	// There are some nucleotides in the special codon buffer, flush it.
+		else
 		{
-			scodon_index = (scodon_index & (MAX_UNSIGNED_INT ^ ((1 << (L + B)) - 1)))
-						 | ((scodon_index & ((1 << L) - 1)) << B)
-						 | ((scodon_index >> L) & ((1 << B) - 1));
-			scodon[scodon_index] = scodon_buffer; // Now the last special codon might have zeros in its least significant bits. Don't treat such zeros as 'A's.
+			word_mask_array[encode(line[i])] |= j;
 		}
+	}
+	for (auto& word_mask_array : p.word_mask_arrays)
+	{
+		word_mask_array[0] ^= MAX_UNSIGNED_LONG_LONG;
+		word_mask_array[1] ^= MAX_UNSIGNED_LONG_LONG;
+		word_mask_array[2] ^= MAX_UNSIGNED_LONG_LONG;
+		word_mask_array[3] ^= MAX_UNSIGNED_LONG_LONG;
+	}
+	memcpy(p.mask_array, p.word_mask_arrays.front().data(), sizeof(unsigned long long) * CHARACTER_CARDINALITY);
+	if (p.m <= 64) p.word_mask_arrays.clear();
+	return p;
+}
 
-		// Calculate thread block to sequence index mapping.
-		for (unsigned int block = 0, character = 0, sequence = 0; block < block_count; ++block)
+/**
+ * Returns the reverse complement of a query, i.e. the pattern read on the reverse strand followed by the same edit distance and distance type.
+ * @param[in] line The query line.
+ */
+static string reverse_complement(const string& line)
+{
+	const size_t m = line.find_first_of("0123456789");
+	string rc(line.rend() - m, line.rend());
+	for (auto& c : rc)
+	{
+		switch (toupper(c))
 		{
-			while (character >= sequence_cumulative_length[sequence + 1]) ++sequence;
-			block_to_sequence[block] = sequence;
-			character += (1 << (L + B + 4)); // One thread block processes 1 << (L + B) special codons, and each special codon encodes 1 << 4 characters.
+			case 'A': c = 'T'; break;
+			case 'C': c = 'G'; break;
+			case 'G': c = 'C'; break;
+			case 'T': c = 'A'; break;
 		}
 	}
+	return rc + line.substr(m);
+}
 
-	/// Default copy constructor.
-	genome(const genome&) = default;
-	/// Default move constructor.
-	genome(genome&&) = default;
-	/// Default copy assignment operator.
-	genome& operator=(const genome&) = default;
-	/// Default move assignment operator.
-	genome& operator=(genome&&) = default;
-};
+/// Returns true if a job searches both strands of the genome, or false if it searches the forward strand only, which is the default.
+static bool searches_both_strands(const BSONObj& job)
+{
+	return job.hasField("strand") && job["strand"].String() == "both";
+}
+
+/**
+ * Parse the queries of a job, one per line, and derive the mask arrays of each pattern.
+ * @param[in] queries The queries of a job.
+ * @param[in] both_strands Whether the reverse complement of each pattern is searched too, so that both strands are searched in the same pass.
+ * @param[out] lines The query lines are appended.
+ * @param[out] patterns The patterns are appended, i.e. for each query its pattern followed by its reverse complement if both_strands is true.
+ */
+static void parse_queries(const string& queries, const bool both_strands, vector<string>& lines, vector<agrep_pattern>& patterns)
+{
+	istringstream in(queries);
+	for (string line; getline(in, line);)
+	{
+		if (line.empty()) continue;
+		lines.push_back(line);
+		patterns.push_back(make_pattern(line));
+		if (both_strands) patterns.push_back(make_pattern(reverse_complement(line)));
+	}
+}
+
+/**
+ * Count the queries of a job, i.e. the lines that parse_queries() parses, without deriving their patterns.
+ * @param[in] queries The queries of a job.
+ * @return The number of queries.
+ */
+static size_t count_queries(const string& queries)
+{
+	istringstream in(queries);
+	size_t count = 0;
+	for (string line; getline(in, line);) count += !line.empty();
+	return count;
+}
+
+/**
+ * Partition threads among concurrent searches in proportion to their estimated work, giving each search at least one thread, and the spare threads by the largest remainders.
+ * @param[in] works The estimated work of each search. There must be no more searches than threads.
+ * @param[in] num_threads Number of threads.
+ * @return The number of threads of each search.
+ */
+static vector<unsigned int> partition_threads(const vector<double>& works, const unsigned int num_threads)
+{
+	const double total = accumulate(works.begin(), works.end(), 0.0);
+	const unsigned int spare = num_threads - works.size();
+	vector<unsigned int> threads(works.size(), 1);
+	vector<pair<double, size_t>> remainders(works.size());
+	unsigned int assigned = 0;
+	for (size_t i = 0; i < works.size(); ++i)
+	{
+		const double share = total > 0 ? spare * works[i] / total : static_cast<double>(spare) / works.size();
+		const unsigned int whole = min(static_cast<unsigned int>(share), spare - assigned);
+		threads[i] += whole;
+		assigned += whole;
+		remainders[i] = make_pair(share - whole, i);
+	}
+	sort(remainders.begin(), remainders.end(), greater<pair<double, size_t>>());
+	for (size_t i = 0; assigned < spare; ++i, ++assigned) ++threads[remainders[i % remainders.size()].second];
+	return threads;
+}
 
 int main(int argc, char** argv)
 {
@@ -224,224 +201,453 @@ int main(int argc, char** argv)
 	const auto private_keyfile = string(getenv("HOME")) + "/.ssh/id_rsa";
 	const auto public_keyfile = private_keyfile + ".pub";
 
-	// Initialize genomes.
-	vector<genome> genomes;
-	genomes.reserve(26);
-	genomes.push_back(genome(13616, "Monodelphis domestica (opossum)", 3502390117, { "mdm_ref_MonDom5_chr1.fa.gz", "mdm_ref_MonDom5_chr2.fa.gz", "mdm_ref_MonDom5_chr3.fa.gz", "mdm_ref_MonDom5_chr4.fa.gz", "mdm_ref_MonDom5_chr5.fa.gz", "mdm_ref_MonDom5_chr6.fa.gz", "mdm_ref_MonDom5_chr7.fa.gz", "mdm_ref_MonDom5_chr8.fa.gz", "mdm_ref_MonDom5_chrX.fa.gz", "mdm_ref_MonDom5_chrMT.fa.gz" }));
-	genomes.push_back(genome(9598, "Pan troglodytes (chimpanzee)", 3160370125, { "ptr_ref_Pan_troglodytes-2.1.4_chr1.fa.gz", "ptr_ref_Pan_troglodytes-2.1.4_chr2A.fa.gz", "ptr_ref_Pan_troglodytes-2.1.4_chr2B.fa.gz", "ptr_ref_Pan_troglodytes-2.1.4_chr3.fa.gz", "ptr_ref_Pan_troglodytes-2.1.4_chr4.fa.gz", "ptr_ref_Pan_troglodytes-2.1.4_chr5.fa.gz", "ptr_ref_Pan_troglodytes-2.1.4_chr6.fa.gz", "ptr_ref_Pan_troglodytes-2.1.4_chr7.fa.gz", "ptr_ref_Pan_troglodytes-2.1.4_chr8.fa.gz", "ptr_ref_Pan_troglodytes-2.1.4_chr9.fa.gz", "ptr_ref_Pan_troglodytes-2.1.4_chr10.fa.gz", "ptr_ref_Pan_troglodytes-2.1.4_chr11.fa.gz", "ptr_ref_Pan_troglodytes-2.1.4_chr12.fa.gz", "ptr_ref_Pan_troglodytes-2.1.4_chr13.fa.gz", "ptr_ref_Pan_troglodytes-2.1.4_chr14.fa.gz", "ptr_ref_Pan_troglodytes-2.1.4_chr15.fa.gz", "ptr_ref_Pan_troglodytes-2.1.4_chr16.fa.gz", "ptr_ref_Pan_troglodytes-2.1.4_chr17.fa.gz", "ptr_ref_Pan_troglodytes-2.1.4_chr18.fa.gz", "ptr_ref_Pan_troglodytes-2.1.4_chr19.fa.gz", "ptr_ref_Pan_troglodytes-2.1.4_chr20.fa.gz", "ptr_ref_Pan_troglodytes-2.1.4_chr21.fa.gz", "ptr_ref_Pan_troglodytes-2.1.4_chr22.fa.gz", "ptr_ref_Pan_troglodytes-2.1.4_chrX.fa.gz", "ptr_ref_Pan_troglodytes-2.1.4_chrY.fa.gz", "ptr_ref_Pan_troglodytes-2.1.4_chrMT.fa.gz" }));
-	genomes.push_back(genome(9606, "Homo sapiens (human)", 3095693981, { "hs_ref_GRCh37.p5_chr1.fa.gz", "hs_ref_GRCh37.p5_chr2.fa.gz", "hs_ref_GRCh37.p5_chr3.fa.gz", "hs_ref_GRCh37.p5_chr4.fa.gz", "hs_ref_GRCh37.p5_chr5.fa.gz", "hs_ref_GRCh37.p5_chr6.fa.gz", "hs_ref_GRCh37.p5_chr7.fa.gz", "hs_ref_GRCh37.p5_chr8.fa.gz", "hs_ref_GRCh37.p5_chr9.fa.gz", "hs_ref_GRCh37.p5_chr10.fa.gz", "hs_ref_GRCh37.p5_chr11.fa.gz", "hs_ref_GRCh37.p5_chr12.fa.gz", "hs_ref_GRCh37.p5_chr13.fa.gz", "hs_ref_GRCh37.p5_chr14.fa.gz", "hs_ref_GRCh37.p5_chr15.fa.gz", "hs_ref_GRCh37.p5_chr16.fa.gz", "hs_ref_GRCh37.p5_chr17.fa.gz", "hs_ref_GRCh37.p5_chr18.fa.gz", "hs_ref_GRCh37.p5_chr19.fa.gz", "hs_ref_GRCh37.p5_chr20.fa.gz", "hs_ref_GRCh37.p5_chr21.fa.gz", "hs_ref_GRCh37.p5_chr22.fa.gz", "hs_ref_GRCh37.p5_chrX.fa.gz", "hs_ref_GRCh37.p5_chrY.fa.gz", "hs_ref_GRCh37.p5_chrMT.fa.gz" }));
-	genomes.push_back(genome(9601, "Pongo abelii (Sumatran orangutan)", 3029507528, { "pab_ref_P_pygmaeus_2.0.2_chr1.fa.gz", "pab_ref_P_pygmaeus_2.0.2_chr2A.fa.gz", "pab_ref_P_pygmaeus_2.0.2_chr2B.fa.gz", "pab_ref_P_pygmaeus_2.0.2_chr3.fa.gz", "pab_ref_P_pygmaeus_2.0.2_chr4.fa.gz", "pab_ref_P_pygmaeus_2.0.2_chr5.fa.gz", "pab_ref_P_pygmaeus_2.0.2_chr6.fa.gz", "pab_ref_P_pygmaeus_2.0.2_chr7.fa.gz", "pab_ref_P_pygmaeus_2.0.2_chr8.fa.gz", "pab_ref_P_pygmaeus_2.0.2_chr9.fa.gz", "pab_ref_P_pygmaeus_2.0.2_chr10.fa.gz", "pab_ref_P_pygmaeus_2.0.2_chr11.fa.gz", "pab_ref_P_pygmaeus_2.0.2_chr12.fa.gz", "pab_ref_P_pygmaeus_2.0.2_chr13.fa.gz", "pab_ref_P_pygmaeus_2.0.2_chr14.fa.gz", "pab_ref_P_pygmaeus_2.0.2_chr15.fa.gz", "pab_ref_P_pygmaeus_2.0.2_chr16.fa.gz", "pab_ref_P_pygmaeus_2.0.2_chr17.fa.gz", "pab_ref_P_pygmaeus_2.0.2_chr18.fa.gz", "pab_ref_P_pygmaeus_2.0.2_chr19.fa.gz", "pab_ref_P_pygmaeus_2.0.2_chr20.fa.gz", "pab_ref_P_pygmaeus_2.0.2_chr21.fa.gz", "pab_ref_P_pygmaeus_2.0.2_chr22.fa.gz", "pab_ref_P_pygmaeus_2.0.2_chrX.fa.gz", "pab_ref_P_pygmaeus_2.0.2_chrMT.fa.gz" }));
-	genomes.push_back(genome(10116, "Rattus norvegicus (rat)", 2902605281, { "rn_ref_Rnor_5.0_chr1.fa.gz", "rn_ref_Rnor_5.0_chr2.fa.gz", "rn_ref_Rnor_5.0_chr3.fa.gz", "rn_ref_Rnor_5.0_chr4.fa.gz", "rn_ref_Rnor_5.0_chr5.fa.gz", "rn_ref_Rnor_5.0_chr6.fa.gz", "rn_ref_Rnor_5.0_chr7.fa.gz", "rn_ref_Rnor_5.0_chr8.fa.gz", "rn_ref_Rnor_5.0_chr9.fa.gz", "rn_ref_Rnor_5.0_chr10.fa.gz", "rn_ref_Rnor_5.0_chr11.fa.gz", "rn_ref_Rnor_5.0_chr12.fa.gz", "rn_ref_Rnor_5.0_chr13.fa.gz", "rn_ref_Rnor_5.0_chr14.fa.gz", "rn_ref_Rnor_5.0_chr15.fa.gz", "rn_ref_Rnor_5.0_chr16.fa.gz", "rn_ref_Rnor_5.0_chr17.fa.gz", "rn_ref_Rnor_5.0_chr18.fa.gz", "rn_ref_Rnor_5.0_chr19.fa.gz", "rn_ref_Rnor_5.0_chr20.fa.gz", "rn_ref_Rnor_5.0_chrX.fa.gz", "rn_ref_Rnor_5.0_chrMT.fa.gz" }));
-	genomes.push_back(genome(9544, "Macaca mulatta (rhesus monkey)", 2863681749, { "mmu_ref_Mmul_051212_chr1.fa.gz", "mmu_ref_Mmul_051212_chr2.fa.gz", "mmu_ref_Mmul_051212_chr3.fa.gz", "mmu_ref_Mmul_051212_chr4.fa.gz", "mmu_ref_Mmul_051212_chr5.fa.gz", "mmu_ref_Mmul_051212_chr6.fa.gz", "mmu_ref_Mmul_051212_chr7.fa.gz", "mmu_ref_Mmul_051212_chr8.fa.gz", "mmu_ref_Mmul_051212_chr9.fa.gz", "mmu_ref_Mmul_051212_chr10.fa.gz", "mmu_ref_Mmul_051212_chr11.fa.gz", "mmu_ref_Mmul_051212_chr12.fa.gz", "mmu_ref_Mmul_051212_chr13.fa.gz", "mmu_ref_Mmul_051212_chr14.fa.gz", "mmu_ref_Mmul_051212_chr15.fa.gz", "mmu_ref_Mmul_051212_chr16.fa.gz", "mmu_ref_Mmul_051212_chr17.fa.gz", "mmu_ref_Mmul_051212_chr18.fa.gz", "mmu_ref_Mmul_051212_chr19.fa.gz", "mmu_ref_Mmul_051212_chr20.fa.gz", "mmu_ref_Mmul_051212_chrX.fa.gz", "mmu_chrMT.fa.gz" }));
-	genomes.push_back(genome(9483, "Callithrix jacchus (marmoset)", 2770219215, { "cja_ref_Callithrix_jacchus-3.2_chr1.fa.gz", "cja_ref_Callithrix_jacchus-3.2_chr2.fa.gz", "cja_ref_Callithrix_jacchus-3.2_chr3.fa.gz", "cja_ref_Callithrix_jacchus-3.2_chr4.fa.gz", "cja_ref_Callithrix_jacchus-3.2_chr5.fa.gz", "cja_ref_Callithrix_jacchus-3.2_chr6.fa.gz", "cja_ref_Callithrix_jacchus-3.2_chr7.fa.gz", "cja_ref_Callithrix_jacchus-3.2_chr8.fa.gz", "cja_ref_Callithrix_jacchus-3.2_chr9.fa.gz", "cja_ref_Callithrix_jacchus-3.2_chr10.fa.gz", "cja_ref_Callithrix_jacchus-3.2_chr11.fa.gz", "cja_ref_Callithrix_jacchus-3.2_chr12.fa.gz", "cja_ref_Callithrix_jacchus-3.2_chr13.fa.gz", "cja_ref_Callithrix_jacchus-3.2_chr14.fa.gz", "cja_ref_Callithrix_jacchus-3.2_chr15.fa.gz", "cja_ref_Callithrix_jacchus-3.2_chr16.fa.gz", "cja_ref_Callithrix_jacchus-3.2_chr17.fa.gz", "cja_ref_Callithrix_jacchus-3.2_chr18.fa.gz", "cja_ref_Callithrix_jacchus-3.2_chr19.fa.gz", "cja_ref_Callithrix_jacchus-3.2_chr20.fa.gz", "cja_ref_Callithrix_jacchus-3.2_chr21.fa.gz", "cja_ref_Callithrix_jacchus-3.2_chr22.fa.gz", "cja_ref_Callithrix_jacchus-3.2_chrX.fa.gz", "cja_ref_Callithrix_jacchus-3.2_chrY.fa.gz" }));
-	genomes.push_back(genome(10090, "Mus musculus (mouse)", 2725537669, { "mm_ref_GRCm38_chr1.fa.gz", "mm_ref_GRCm38_chr2.fa.gz", "mm_ref_GRCm38_chr3.fa.gz", "mm_ref_GRCm38_chr4.fa.gz", "mm_ref_GRCm38_chr5.fa.gz", "mm_ref_GRCm38_chr6.fa.gz", "mm_ref_GRCm38_chr7.fa.gz", "mm_ref_GRCm38_chr8.fa.gz", "mm_ref_GRCm38_chr9.fa.gz", "mm_ref_GRCm38_chr10.fa.gz", "mm_ref_GRCm38_chr11.fa.gz", "mm_ref_GRCm38_chr12.fa.gz", "mm_ref_GRCm38_chr13.fa.gz", "mm_ref_GRCm38_chr14.fa.gz", "mm_ref_GRCm38_chr15.fa.gz", "mm_ref_GRCm38_chr16.fa.gz", "mm_ref_GRCm38_chr17.fa.gz", "mm_ref_GRCm38_chr18.fa.gz", "mm_ref_GRCm38_chr19.fa.gz", "mm_ref_GRCm38_chrX.fa.gz", "mm_ref_GRCm38_chrY.fa.gz", "mm_ref_GRCm38_chrMT.fa.gz" }));
-	genomes.push_back(genome(9913, "Bos taurus (cow)", 2660922743, { "bt_ref_Bos_taurus_UMD_3.1_chr1.fa.gz", "bt_ref_Bos_taurus_UMD_3.1_chr2.fa.gz", "bt_ref_Bos_taurus_UMD_3.1_chr3.fa.gz", "bt_ref_Bos_taurus_UMD_3.1_chr4.fa.gz", "bt_ref_Bos_taurus_UMD_3.1_chr5.fa.gz", "bt_ref_Bos_taurus_UMD_3.1_chr6.fa.gz", "bt_ref_Bos_taurus_UMD_3.1_chr7.fa.gz", "bt_ref_Bos_taurus_UMD_3.1_chr8.fa.gz", "bt_ref_Bos_taurus_UMD_3.1_chr9.fa.gz", "bt_ref_Bos_taurus_UMD_3.1_chr10.fa.gz", "bt_ref_Bos_taurus_UMD_3.1_chr11.fa.gz", "bt_ref_Bos_taurus_UMD_3.1_chr12.fa.gz", "bt_ref_Bos_taurus_UMD_3.1_chr13.fa.gz", "bt_ref_Bos_taurus_UMD_3.1_chr14.fa.gz", "bt_ref_Bos_taurus_UMD_3.1_chr15.fa.gz", "bt_ref_Bos_taurus_UMD_3.1_chr16.fa.gz", "bt_ref_Bos_taurus_UMD_3.1_chr17.fa.gz", "bt_ref_Bos_taurus_UMD_3.1_chr18.fa.gz", "bt_ref_Bos_taurus_UMD_3.1_chr19.fa.gz", "bt_ref_Bos_taurus_UMD_3.1_chr20.fa.gz", "bt_ref_Bos_taurus_UMD_3.1_chr21.fa.gz", "bt_ref_Bos_taurus_UMD_3.1_chr22.fa.gz", "bt_ref_Bos_taurus_UMD_3.1_chr23.fa.gz", "bt_ref_Bos_taurus_UMD_3.1_chr24.fa.gz", "bt_ref_Bos_taurus_UMD_3.1_chr25.fa.gz", "bt_ref_Bos_taurus_UMD_3.1_chr26.fa.gz", "bt_ref_Bos_taurus_UMD_3.1_chr27.fa.gz", "bt_ref_Bos_taurus_UMD_3.1_chr28.fa.gz", "bt_ref_Bos_taurus_UMD_3.1_chr29.fa.gz", "bt_ref_Bos_taurus_UMD_3.1_chrX.fa.gz", "bt_ref_Bos_taurus_UMD_3.1_chrMT.fa.gz" }));
-	genomes.push_back(genome(9823, "Sus scrofa (pig)", 2596656069, { "ssc_ref_Sscrofa10.2_chr1.fa.gz", "ssc_ref_Sscrofa10.2_chr2.fa.gz", "ssc_ref_Sscrofa10.2_chr3.fa.gz", "ssc_ref_Sscrofa10.2_chr4.fa.gz", "ssc_ref_Sscrofa10.2_chr5.fa.gz", "ssc_ref_Sscrofa10.2_chr6.fa.gz", "ssc_ref_Sscrofa10.2_chr7.fa.gz", "ssc_ref_Sscrofa10.2_chr8.fa.gz", "ssc_ref_Sscrofa10.2_chr9.fa.gz", "ssc_ref_Sscrofa10.2_chr10.fa.gz", "ssc_ref_Sscrofa10.2_chr11.fa.gz", "ssc_ref_Sscrofa10.2_chr12.fa.gz", "ssc_ref_Sscrofa10.2_chr13.fa.gz", "ssc_ref_Sscrofa10.2_chr14.fa.gz", "ssc_ref_Sscrofa10.2_chr15.fa.gz", "ssc_ref_Sscrofa10.2_chr16.fa.gz", "ssc_ref_Sscrofa10.2_chr17.fa.gz", "ssc_ref_Sscrofa10.2_chr18.fa.gz", "ssc_ref_Sscrofa10.2_chrX.fa.gz", "ssc_ref_Sscrofa10.2_chrY.fa.gz", "ssc_ref_Sscrofa10.2_chrMT.fa.gz" }));
-	genomes.push_back(genome(9796, "Equus caballus (horse)", 2367070107, { "eca_ref_EquCab2.0_chr1.fa.gz", "eca_ref_EquCab2.0_chr2.fa.gz", "eca_ref_EquCab2.0_chr3.fa.gz", "eca_ref_EquCab2.0_chr4.fa.gz", "eca_ref_EquCab2.0_chr5.fa.gz", "eca_ref_EquCab2.0_chr6.fa.gz", "eca_ref_EquCab2.0_chr7.fa.gz", "eca_ref_EquCab2.0_chr8.fa.gz", "eca_ref_EquCab2.0_chr9.fa.gz", "eca_ref_EquCab2.0_chr10.fa.gz", "eca_ref_EquCab2.0_chr11.fa.gz", "eca_ref_EquCab2.0_chr12.fa.gz", "eca_ref_EquCab2.0_chr13.fa.gz", "eca_ref_EquCab2.0_chr14.fa.gz", "eca_ref_EquCab2.0_chr15.fa.gz", "eca_ref_EquCab2.0_chr16.fa.gz", "eca_ref_EquCab2.0_chr17.fa.gz", "eca_ref_EquCab2.0_chr18.fa.gz", "eca_ref_EquCab2.0_chr19.fa.gz", "eca_ref_EquCab2.0_chr20.fa.gz", "eca_ref_EquCab2.0_chr21.fa.gz", "eca_ref_EquCab2.0_chr22.fa.gz", "eca_ref_EquCab2.0_chr23.fa.gz", "eca_ref_EquCab2.0_chr24.fa.gz", "eca_ref_EquCab2.0_chr25.fa.gz", "eca_ref_EquCab2.0_chr26.fa.gz", "eca_ref_EquCab2.0_chr27.fa.gz", "eca_ref_EquCab2.0_chr28.fa.gz", "eca_ref_EquCab2.0_chr29.fa.gz", "eca_ref_EquCab2.0_chr30.fa.gz", "eca_ref_EquCab2.0_chr31.fa.gz", "eca_ref_EquCab2.0_chrX.fa.gz", "eca_ref_EquCab2.0_chrMT.fa.gz" }));
-	genomes.push_back(genome(9615, "Canis lupus familiaris (dog)", 2327650711, { "cfa_ref_CanFam3.1_chr1.fa.gz", "cfa_ref_CanFam3.1_chr2.fa.gz", "cfa_ref_CanFam3.1_chr3.fa.gz", "cfa_ref_CanFam3.1_chr4.fa.gz", "cfa_ref_CanFam3.1_chr5.fa.gz", "cfa_ref_CanFam3.1_chr6.fa.gz", "cfa_ref_CanFam3.1_chr7.fa.gz", "cfa_ref_CanFam3.1_chr8.fa.gz", "cfa_ref_CanFam3.1_chr9.fa.gz", "cfa_ref_CanFam3.1_chr10.fa.gz", "cfa_ref_CanFam3.1_chr11.fa.gz", "cfa_ref_CanFam3.1_chr12.fa.gz", "cfa_ref_CanFam3.1_chr13.fa.gz", "cfa_ref_CanFam3.1_chr14.fa.gz", "cfa_ref_CanFam3.1_chr15.fa.gz", "cfa_ref_CanFam3.1_chr16.fa.gz", "cfa_ref_CanFam3.1_chr17.fa.gz", "cfa_ref_CanFam3.1_chr18.fa.gz", "cfa_ref_CanFam3.1_chr19.fa.gz", "cfa_ref_CanFam3.1_chr20.fa.gz", "cfa_ref_CanFam3.1_chr21.fa.gz", "cfa_ref_CanFam3.1_chr22.fa.gz", "cfa_ref_CanFam3.1_chr23.fa.gz", "cfa_ref_CanFam3.1_chr24.fa.gz", "cfa_ref_CanFam3.1_chr25.fa.gz", "cfa_ref_CanFam3.1_chr26.fa.gz", "cfa_ref_CanFam3.1_chr27.fa.gz", "cfa_ref_CanFam3.1_chr28.fa.gz", "cfa_ref_CanFam3.1_chr29.fa.gz", "cfa_ref_CanFam3.1_chr30.fa.gz", "cfa_ref_CanFam3.1_chr31.fa.gz", "cfa_ref_CanFam3.1_chr32.fa.gz", "cfa_ref_CanFam3.1_chr33.fa.gz", "cfa_ref_CanFam3.1_chr34.fa.gz", "cfa_ref_CanFam3.1_chr35.fa.gz", "cfa_ref_CanFam3.1_chr36.fa.gz", "cfa_ref_CanFam3.1_chr37.fa.gz", "cfa_ref_CanFam3.1_chr38.fa.gz", "cfa_ref_CanFam3.1_chrX.fa.gz", "cfa_ref_CanFam3.1_chrMT.fa.gz" }));
-	genomes.push_back(genome(9986, "Oryctolagus cuniculus (rabbit)", 2247769349, { "ocu_ref_OryCun2.0_chr1.fa.gz", "ocu_ref_OryCun2.0_chr2.fa.gz", "ocu_ref_OryCun2.0_chr3.fa.gz", "ocu_ref_OryCun2.0_chr4.fa.gz", "ocu_ref_OryCun2.0_chr5.fa.gz", "ocu_ref_OryCun2.0_chr6.fa.gz", "ocu_ref_OryCun2.0_chr7.fa.gz", "ocu_ref_OryCun2.0_chr8.fa.gz", "ocu_ref_OryCun2.0_chr9.fa.gz", "ocu_ref_OryCun2.0_chr10.fa.gz", "ocu_ref_OryCun2.0_chr11.fa.gz", "ocu_ref_OryCun2.0_chr12.fa.gz", "ocu_ref_OryCun2.0_chr13.fa.gz", "ocu_ref_OryCun2.0_chr14.fa.gz", "ocu_ref_OryCun2.0_chr15.fa.gz", "ocu_ref_OryCun2.0_chr16.fa.gz", "ocu_ref_OryCun2.0_chr17.fa.gz", "ocu_ref_OryCun2.0_chr18.fa.gz", "ocu_ref_OryCun2.0_chr19.fa.gz", "ocu_ref_OryCun2.0_chr20.fa.gz", "ocu_ref_OryCun2.0_chr21.fa.gz", "ocu_ref_OryCun2.0_chrX.fa.gz", "ocu_chrMT.fa.gz" }));
-	genomes.push_back(genome(7955, "Danio rerio (zebrafish)", 1357051643, { "dr_ref_Zv9_chr1.fa.gz", "dr_ref_Zv9_chr2.fa.gz", "dr_ref_Zv9_chr3.fa.gz", "dr_ref_Zv9_chr4.fa.gz", "dr_ref_Zv9_chr5.fa.gz", "dr_ref_Zv9_chr6.fa.gz", "dr_ref_Zv9_chr7.fa.gz", "dr_ref_Zv9_chr8.fa.gz", "dr_ref_Zv9_chr9.fa.gz", "dr_ref_Zv9_chr10.fa.gz", "dr_ref_Zv9_chr11.fa.gz", "dr_ref_Zv9_chr12.fa.gz", "dr_ref_Zv9_chr13.fa.gz", "dr_ref_Zv9_chr14.fa.gz", "dr_ref_Zv9_chr15.fa.gz", "dr_ref_Zv9_chr16.fa.gz", "dr_ref_Zv9_chr17.fa.gz", "dr_ref_Zv9_chr18.fa.gz", "dr_ref_Zv9_chr19.fa.gz", "dr_ref_Zv9_chr20.fa.gz", "dr_ref_Zv9_chr21.fa.gz", "dr_ref_Zv9_chr22.fa.gz", "dr_ref_Zv9_chr23.fa.gz", "dr_ref_Zv9_chr24.fa.gz", "dr_ref_Zv9_chr25.fa.gz", "dr_ref_Zv9_chrMT.fa.gz" }));
-	genomes.push_back(genome(28377, "Anolis carolinensis (green anole)", 1081661814, { "acr_ref_AnoCar2.0_chr1.fa.gz", "acr_ref_AnoCar2.0_chr2.fa.gz", "acr_ref_AnoCar2.0_chr3.fa.gz", "acr_ref_AnoCar2.0_chr4.fa.gz", "acr_ref_AnoCar2.0_chr5.fa.gz", "acr_ref_AnoCar2.0_chr6.fa.gz", "acr_ref_AnoCar2.0_chra.fa.gz", "acr_ref_AnoCar2.0_chrb.fa.gz", "acr_ref_AnoCar2.0_chrc.fa.gz", "acr_ref_AnoCar2.0_chrd.fa.gz", "acr_ref_AnoCar2.0_chrf.fa.gz", "acr_ref_AnoCar2.0_chrg.fa.gz", "acr_ref_AnoCar2.0_chrh.fa.gz", "acr_ref_AnoCar2.0_chrMT.fa.gz" }));
-	genomes.push_back(genome(9103, "Meleagris gallopavo (turkey)", 1040303789, { "mga_ref_Turkey_2.01_chr1.fa.gz", "mga_ref_Turkey_2.01_chr2.fa.gz", "mga_ref_Turkey_2.01_chr3.fa.gz", "mga_ref_Turkey_2.01_chr4.fa.gz", "mga_ref_Turkey_2.01_chr5.fa.gz", "mga_ref_Turkey_2.01_chr6.fa.gz", "mga_ref_Turkey_2.01_chr7.fa.gz", "mga_ref_Turkey_2.01_chr8.fa.gz", "mga_ref_Turkey_2.01_chr9.fa.gz", "mga_ref_Turkey_2.01_chr10.fa.gz", "mga_ref_Turkey_2.01_chr11.fa.gz", "mga_ref_Turkey_2.01_chr12.fa.gz", "mga_ref_Turkey_2.01_chr13.fa.gz", "mga_ref_Turkey_2.01_chr14.fa.gz", "mga_ref_Turkey_2.01_chr15.fa.gz", "mga_ref_Turkey_2.01_chr16.fa.gz", "mga_ref_Turkey_2.01_chr17.fa.gz", "mga_ref_Turkey_2.01_chr18.fa.gz", "mga_ref_Turkey_2.01_chr19.fa.gz", "mga_ref_Turkey_2.01_chr20.fa.gz", "mga_ref_Turkey_2.01_chr21.fa.gz", "mga_ref_Turkey_2.01_chr22.fa.gz", "mga_ref_Turkey_2.01_chr23.fa.gz", "mga_ref_Turkey_2.01_chr24.fa.gz", "mga_ref_Turkey_2.01_chr25.fa.gz", "mga_ref_Turkey_2.01_chr26.fa.gz", "mga_ref_Turkey_2.01_chr27.fa.gz", "mga_ref_Turkey_2.01_chr28.fa.gz", "mga_ref_Turkey_2.01_chr29.fa.gz", "mga_ref_Turkey_2.01_chr30.fa.gz", "mga_ref_Turkey_2.01_chrW.fa.gz", "mga_ref_Turkey_2.01_chrZ.fa.gz", "mga_ref_Turkey_2.01_chrMT.fa.gz" }));
-	genomes.push_back(genome(59729, "Taeniopygia guttata (Zebra finch)", 1021462940, { "tgu_ref_chr1.fa.gz", "tgu_ref_chr1A.fa.gz", "tgu_ref_chr1B.fa.gz", "tgu_ref_chr2.fa.gz", "tgu_ref_chr3.fa.gz", "tgu_ref_chr4.fa.gz", "tgu_ref_chr4A.fa.gz", "tgu_ref_chr5.fa.gz", "tgu_ref_chr6.fa.gz", "tgu_ref_chr7.fa.gz", "tgu_ref_chr8.fa.gz", "tgu_ref_chr9.fa.gz", "tgu_ref_chr10.fa.gz", "tgu_ref_chr11.fa.gz", "tgu_ref_chr12.fa.gz", "tgu_ref_chr13.fa.gz", "tgu_ref_chr14.fa.gz", "tgu_ref_chr15.fa.gz", "tgu_ref_chr16.fa.gz", "tgu_ref_chr17.fa.gz", "tgu_ref_chr18.fa.gz", "tgu_ref_chr19.fa.gz", "tgu_ref_chr20.fa.gz", "tgu_ref_chr21.fa.gz", "tgu_ref_chr22.fa.gz", "tgu_ref_chr23.fa.gz", "tgu_ref_chr24.fa.gz", "tgu_ref_chr25.fa.gz", "tgu_ref_chr26.fa.gz", "tgu_ref_chr27.fa.gz", "tgu_ref_chr28.fa.gz", "tgu_ref_chrZ.fa.gz", "tgu_ref_chrLG2.fa.gz", "tgu_ref_chrLG5.fa.gz", "tgu_ref_chrLGE22.fa.gz" }));
-	genomes.push_back(genome(9031, "Gallus gallus (chicken)", 1004818361, { "gga_ref_Gallus_gallus-4.0_chr1.fa.gz", "gga_ref_Gallus_gallus-4.0_chr2.fa.gz", "gga_ref_Gallus_gallus-4.0_chr3.fa.gz", "gga_ref_Gallus_gallus-4.0_chr4.fa.gz", "gga_ref_Gallus_gallus-4.0_chr5.fa.gz", "gga_ref_Gallus_gallus-4.0_chr6.fa.gz", "gga_ref_Gallus_gallus-4.0_chr7.fa.gz", "gga_ref_Gallus_gallus-4.0_chr8.fa.gz", "gga_ref_Gallus_gallus-4.0_chr9.fa.gz", "gga_ref_Gallus_gallus-4.0_chr10.fa.gz", "gga_ref_Gallus_gallus-4.0_chr11.fa.gz", "gga_ref_Gallus_gallus-4.0_chr12.fa.gz", "gga_ref_Gallus_gallus-4.0_chr13.fa.gz", "gga_ref_Gallus_gallus-4.0_chr14.fa.gz", "gga_ref_Gallus_gallus-4.0_chr15.fa.gz", "gga_ref_Gallus_gallus-4.0_chr16.fa.gz", "gga_ref_Gallus_gallus-4.0_chr17.fa.gz", "gga_ref_Gallus_gallus-4.0_chr18.fa.gz", "gga_ref_Gallus_gallus-4.0_chr19.fa.gz", "gga_ref_Gallus_gallus-4.0_chr20.fa.gz", "gga_ref_Gallus_gallus-4.0_chr21.fa.gz", "gga_ref_Gallus_gallus-4.0_chr22.fa.gz", "gga_ref_Gallus_gallus-4.0_chr23.fa.gz", "gga_ref_Gallus_gallus-4.0_chr24.fa.gz", "gga_ref_Gallus_gallus-4.0_chr25.fa.gz", "gga_ref_Gallus_gallus-4.0_chr26.fa.gz", "gga_ref_Gallus_gallus-4.0_chr27.fa.gz", "gga_ref_Gallus_gallus-4.0_chr28.fa.gz", "gga_ref_Gallus_gallus-4.0_chr32.fa.gz", "gga_ref_Gallus_gallus-4.0_chrW.fa.gz", "gga_ref_Gallus_gallus-4.0_chrZ.fa.gz", "gga_ref_Gallus_gallus-4.0_chrLGE22C19W28_E50C23.fa.gz", "gga_ref_Gallus_gallus-4.0_chrLGE64.fa.gz", "gga_ref_Gallus_gallus-4.0_chrMT.fa.gz" }));
-	genomes.push_back(genome(3847, "Glycine max (soybean)", 950221025, { "gma_ref_V1.0_chr1.fa.gz", "gma_ref_V1.0_chr2.fa.gz", "gma_ref_V1.0_chr3.fa.gz", "gma_ref_V1.0_chr4.fa.gz", "gma_ref_V1.0_chr5.fa.gz", "gma_ref_V1.0_chr6.fa.gz", "gma_ref_V1.0_chr7.fa.gz", "gma_ref_V1.0_chr8.fa.gz", "gma_ref_V1.0_chr9.fa.gz", "gma_ref_V1.0_chr10.fa.gz", "gma_ref_V1.0_chr11.fa.gz", "gma_ref_V1.0_chr12.fa.gz", "gma_ref_V1.0_chr13.fa.gz", "gma_ref_V1.0_chr14.fa.gz", "gma_ref_V1.0_chr15.fa.gz", "gma_ref_V1.0_chr16.fa.gz", "gma_ref_V1.0_chr17.fa.gz", "gma_ref_V1.0_chr18.fa.gz", "gma_ref_V1.0_chr19.fa.gz", "gma_ref_V1.0_chr20.fa.gz", "gma_ref_V1.0_chrPltd.fa.gz" }));
-	genomes.push_back(genome(9258, "Ornithorhynchus anatinus (platypus)", 437097043, { "oan_ref_Ornithorhynchus_anatinus_5.0.1_chr1.fa.gz", "oan_ref_Ornithorhynchus_anatinus_5.0.1_chr2.fa.gz", "oan_ref_Ornithorhynchus_anatinus_5.0.1_chr3.fa.gz", "oan_ref_Ornithorhynchus_anatinus_5.0.1_chr4.fa.gz", "oan_ref_Ornithorhynchus_anatinus_5.0.1_chr5.fa.gz", "oan_ref_Ornithorhynchus_anatinus_5.0.1_chr6.fa.gz", "oan_ref_Ornithorhynchus_anatinus_5.0.1_chr7.fa.gz", "oan_ref_Ornithorhynchus_anatinus_5.0.1_chr10.fa.gz", "oan_ref_Ornithorhynchus_anatinus_5.0.1_chr11.fa.gz", "oan_ref_Ornithorhynchus_anatinus_5.0.1_chr12.fa.gz", "oan_ref_Ornithorhynchus_anatinus_5.0.1_chr14.fa.gz", "oan_ref_Ornithorhynchus_anatinus_5.0.1_chr15.fa.gz", "oan_ref_Ornithorhynchus_anatinus_5.0.1_chr17.fa.gz", "oan_ref_Ornithorhynchus_anatinus_5.0.1_chr18.fa.gz", "oan_ref_Ornithorhynchus_anatinus_5.0.1_chr20.fa.gz", "oan_ref_Ornithorhynchus_anatinus_5.0.1_chrX1.fa.gz", "oan_ref_Ornithorhynchus_anatinus_5.0.1_chrX2.fa.gz", "oan_ref_Ornithorhynchus_anatinus_5.0.1_chrX3.fa.gz", "oan_ref_Ornithorhynchus_anatinus_5.0.1_chrX5.fa.gz", "oan_ref_Ornithorhynchus_anatinus_5.0.1_chrMT.fa.gz" }));
-	genomes.push_back(genome(29760, "Vitis vinifera (wine grape)", 427110216, { "vvi_ref_12X_chr1.fa.gz", "vvi_ref_12X_chr2.fa.gz", "vvi_ref_12X_chr3.fa.gz", "vvi_ref_12X_chr4.fa.gz", "vvi_ref_12X_chr5.fa.gz", "vvi_ref_12X_chr6.fa.gz", "vvi_ref_12X_chr7.fa.gz", "vvi_ref_12X_chr8.fa.gz", "vvi_ref_12X_chr9.fa.gz", "vvi_ref_12X_chr10.fa.gz", "vvi_ref_12X_chr11.fa.gz", "vvi_ref_12X_chr12.fa.gz", "vvi_ref_12X_chr13.fa.gz", "vvi_ref_12X_chr14.fa.gz", "vvi_ref_12X_chr15.fa.gz", "vvi_ref_12X_chr16.fa.gz", "vvi_ref_12X_chr17.fa.gz", "vvi_ref_12X_chr18.fa.gz", "vvi_ref_12X_chr19.fa.gz", "vvi_ref_12X_chrMT.fa.gz", "vvi_ref_12X_chrPltd.fa.gz" }));
-	genomes.push_back(genome(15368, "Brachypodium distachyon", 271283624, { "bdi_ref_v1.0_chr1.fa.gz", "bdi_ref_v1.0_chr2.fa.gz", "bdi_ref_v1.0_chr3.fa.gz", "bdi_ref_v1.0_chr4.fa.gz", "bdi_ref_v1.0_chr5.fa.gz", "bdi_ref_v1.0_chrPltd.fa.gz" }));
-	genomes.push_back(genome(7460, "Apis mellifera (honey bee)", 219645955, { "ame_ref_Amel_4.5_chrLG1.fa.gz", "ame_ref_Amel_4.5_chrLG2.fa.gz", "ame_ref_Amel_4.5_chrLG3.fa.gz", "ame_ref_Amel_4.5_chrLG4.fa.gz", "ame_ref_Amel_4.5_chrLG5.fa.gz", "ame_ref_Amel_4.5_chrLG6.fa.gz", "ame_ref_Amel_4.5_chrLG7.fa.gz", "ame_ref_Amel_4.5_chrLG8.fa.gz", "ame_ref_Amel_4.5_chrLG9.fa.gz", "ame_ref_Amel_4.5_chrLG10.fa.gz", "ame_ref_Amel_4.5_chrLG11.fa.gz", "ame_ref_Amel_4.5_chrLG12.fa.gz", "ame_ref_Amel_4.5_chrLG13.fa.gz", "ame_ref_Amel_4.5_chrLG14.fa.gz", "ame_ref_Amel_4.5_chrLG15.fa.gz", "ame_ref_Amel_4.5_chrLG16.fa.gz", "ame_ref_Amel_4.5_chrMT.fa.gz" }));
-	genomes.push_back(genome(30195, "Bombus terrestris (buff-tailed bumblebee)", 216849342, { "bte_ref_Bter_1.0_chrLG_B01.fa.gz", "bte_ref_Bter_1.0_chrLG_B02.fa.gz", "bte_ref_Bter_1.0_chrLG_B03.fa.gz", "bte_ref_Bter_1.0_chrLG_B04.fa.gz", "bte_ref_Bter_1.0_chrLG_B05.fa.gz", "bte_ref_Bter_1.0_chrLG_B06.fa.gz", "bte_ref_Bter_1.0_chrLG_B07.fa.gz", "bte_ref_Bter_1.0_chrLG_B08.fa.gz", "bte_ref_Bter_1.0_chrLG_B09.fa.gz", "bte_ref_Bter_1.0_chrLG_B10.fa.gz", "bte_ref_Bter_1.0_chrLG_B11.fa.gz", "bte_ref_Bter_1.0_chrLG_B12.fa.gz", "bte_ref_Bter_1.0_chrLG_B13.fa.gz", "bte_ref_Bter_1.0_chrLG_B14.fa.gz", "bte_ref_Bter_1.0_chrLG_B15.fa.gz", "bte_ref_Bter_1.0_chrLG_B16.fa.gz", "bte_ref_Bter_1.0_chrLG_B17.fa.gz", "bte_ref_Bter_1.0_chrLG_B18.fa.gz" }));
-	genomes.push_back(genome(7425, "Nasonia vitripennis (jewel wasp)", 191717756, { "nvi_ref_Nvit_2.0_chr1.fa.gz", "nvi_ref_Nvit_2.0_chr2.fa.gz", "nvi_ref_Nvit_2.0_chr3.fa.gz", "nvi_ref_Nvit_2.0_chr4.fa.gz", "nvi_ref_Nvit_2.0_chr5.fa.gz" }));
-	genomes.push_back(genome(7070, "Tribolium castaneum (red flour beetle)", 187494969, { "tca_ref_chrLG1=X.fa.gz", "tca_ref_chrLG2.fa.gz", "tca_ref_chrLG3.fa.gz", "tca_ref_chrLG4.fa.gz", "tca_ref_chrLG5.fa.gz", "tca_ref_chrLG6.fa.gz", "tca_ref_chrLG7.fa.gz", "tca_ref_chrLG8.fa.gz", "tca_ref_chrLG9.fa.gz", "tca_ref_chrLG10.fa.gz" }));
-
-	// Declare kernel variables.
-	unsigned int       mask_array_32[CHARACTER_CARDINALITY];	// The 32-bit mask array of pattern.
-	unsigned long long mask_array_64[CHARACTER_CARDINALITY];	// The 64-bit mask array of pattern.
-	unsigned int       test_bit_32;	// The test bit for determining matches of patterns of length 32.
-	unsigned long long test_bit_64;	// The test bit for determining matches of patterns of length 64.
-	const unsigned int max_match_count = 1000;	// Maximum number of matches of one single query.
-	unsigned int match[max_match_count];	// The matches returned by the CUDA agrep kernel.
-	unsigned int match_count;	// Actual number of matches in the match array. match_count <= potential_match_count should always holds.
-	unsigned int *scodon_device;	// CUDA global memory pointer pointing to the special codon array.
-	unsigned int *match_device;	// CUDA global memory pointer pointing to the match array.
+	// Initialize genomes, which are loaded on first use and kept resident within a memory budget.
+	genome_cache genomes(genome_sources(), genome_cache::default_budget(), thread::hardware_concurrency(), [](const string& line)
+	{
+		cout << local_time() << line << endl;
+	});
+	cout << local_time() << "Keeping genomes resident within " << (genomes.budget() >> 20) << " MB of memory" << endl;
+
+	// Initialize the cache of matches, which persists across runs, so that patterns searched again against the same genome are answered without searching.
+	match_cache cache("cache", match_cache::default_budget(), [](const string& line)
+	{
+		cout << local_time() << line << endl;
+	});
+	cout << local_time() << "Keeping cached matches of " << (cache.stored_bytes() >> 20) << " MB within " << (cache.budget() >> 20) << " MB of storage" << endl;
+
+	// The threads of the CPU backend also align the matches of either backend.
+	const unsigned int num_threads = thread::hardware_concurrency();
+
+	// Select the backend of the agrep kernel, i.e. the CUDA device if there is one, or SIMD lanes on all the CPU threads otherwise.
+	// The IGREP_BACKEND environment variable, i.e. gpu or cpu, overrides the selection.
+	// With the CPU backend, the jobs of different genomes are searched concurrently, each with its own CPU backend of a share of the threads.
+	unique_ptr<agrep_backend> backend;
+	auto isa = requested_isa();
+#ifndef IGREP_CPU_ONLY
+	const char* const backend_name = getenv("IGREP_BACKEND");
+	if (backend_name ? string(backend_name) == "gpu" : gpu_backend::available()) backend.reset(new gpu_backend(num_threads));
+#endif
+	if (!backend)
+	{
+		// Validate the kernel variants against a naive scanner, falling back to lower instruction set levels if they fail.
+		while (!cpu_backend::self_test(isa, num_threads))
+		{
+			cerr << local_time() << "The " << isa_name(isa) << " kernels failed the self test" << endl;
+			if (isa == ISA_SSE2) return 1;
+			isa = static_cast<isa_t>(isa - 1);
+		}
+		backend.reset(new cpu_backend(num_threads, isa));
+	}
+	const bool concurrent = dynamic_cast<cpu_backend*>(backend.get()) != nullptr;
+	cout << local_time() << "Using the " << backend->name() << " backend" << endl;
 
 	// Initialize curl globally.
 	curl_global_init(CURL_GLOBAL_DEFAULT);
 
+	// Guards the database connection, which the concurrent searches of different genomes share. The cache of matches guards itself, so that reading large entries does not serialize the searches.
+	mutex resource_mutex;
+
+	// Mark a job completed, with an error if it has failed, e.g. when its uploaded genome cannot be downloaded, and notify its submitter.
+	const auto finish_job = [&](const BSONObj& job, const string& genome_name, const size_t query_count, const string& error)
+	{
+		// Update progress.
+		const auto _id = job["_id"].OID();
+		const auto millis_since_epoch = duration_cast<std::chrono::milliseconds>(system_clock::now().time_since_epoch()).count();
+		{
+			lock_guard<mutex> lock(resource_mutex);
+			conn.update(collection, BSON("_id" << _id), BSON("$set" << (error.empty() ? BSON("completed" << Date_t(millis_since_epoch)) : BSON("completed" << Date_t(millis_since_epoch) << "error" << error))));
+			const auto err = conn.getLastError();
+			if (!err.empty())
+			{
+				cerr << local_time() << err << endl;
+			}
+		}
+
+		// Send completion notification email.
+		const auto email = job["email"].String();
+		cout << local_time() << "Sending a completion notification email to " << email << endl;
+		MailMessage message;
+		message.setSender("igrep <noreply@cse.cuhk.edu.hk>");
+		message.setSubject(error.empty() ? "Your igrep job has completed" : "Your igrep job has failed");
+		message.setContent("Genome to search: " + genome_name + "\nPatterns to search for: " + to_string(query_count) + "\nSubmitted: " + to_simple_string(ptime(epoch, boost::posix_time::milliseconds(job["submitted"].Date().millis))) + " UTC\nCompleted: " + to_simple_string(ptime(epoch, boost::posix_time::milliseconds(millis_since_epoch))) + " UTC\n" + (error.empty() ? "" : "Error: " + error + "\n") + "Result: http://istar.cse.cuhk.edu.hk/igrep");
+		message.addRecipient(MailRecipient(MailRecipient::PRIMARY_RECIPIENT, email));
+		SMTPClientSession session("137.189.91.190");
+		session.login();
+		session.sendMessage(message);
+		session.close();
+	};
+
+	// Write the result files of a job, upload them, mark the job completed, and notify its submitter.
+	// The job has query_count queries, whose lines and patterns begin at lines and patterns, i.e. one pattern per query and strand. occurrences_of returns the occurrences of the i-th pattern in ascending order of their ending positions.
+	const auto complete_job = [&](const BSONObj& job, const string& genome_name, const vector<unsigned int>& sequence_cumulative_length, const string* const lines, const agrep_pattern* const patterns, const size_t query_count, const function<vector<occurrence>(const size_t)>& occurrences_of)
+	{
+		const auto _id = job["_id"].OID();
+		const unsigned int strand_count = searches_both_strands(job) ? 2 : 1;
+		cout << local_time() << "Completing job " << _id.str() << endl;
+
+		// Write the result files into temporary files, which are streamed rather than held in memory, as the number of matches is large, up to match_limit per pattern.
+		const path log_path = temp_directory_path() / unique_path();
+		const path pos_path = temp_directory_path() / unique_path();
+		{
+			boost::filesystem::ofstream log(log_path), pos(pos_path);
+			log << "Query Index,Pattern,Edit Distance,Number of Matches,Mismatches Only\n";
+			pos << "Query Index,Match Index,File Index,Starting Position,Ending Position,Strand,Edit Distance,CIGAR\n";
+			for (size_t qi = 0; qi < query_count; ++qi)
+			{
+				const auto& p = patterns[qi * strand_count];
+				const unsigned int m = p.m;
+				const unsigned int k = p.k;
+
+				// Obtain the occurrences of each strand, and merge those of the forward strand and those of the reverse complement in ascending order of their ending positions, so the sequence index only moves forward, and decoding takes time proportional to the number of occurrences plus the number of sequences.
+				// An occurrence on the reverse strand is reported at the position of the reverse complement on the forward strand, and its CIGAR string aligns the reverse complement to the forward strand.
+				const auto forward_occurrences = occurrences_of(qi * strand_count);
+				const auto reverse_occurrences = strand_count == 2 ? occurrences_of(qi * strand_count + 1) : vector<occurrence>();
+				size_t forward_index = 0, reverse_index = 0;
+				unsigned int sequence = 0;
+				while (true)
+				{
+					const occurrence* o;
+					char strand;
+					if (forward_index < forward_occurrences.size() && (reverse_index == reverse_occurrences.size() || forward_occurrences[forward_index].end <= reverse_occurrences[reverse_index].end))
+					{
+						o = &forward_occurrences[forward_index++];
+						strand = '+';
+					}
+					else if (reverse_index < reverse_occurrences.size())
+					{
+						o = &reverse_occurrences[reverse_index++];
+						strand = '-';
+					}
+					else break;
+					while (o->end >= sequence_cumulative_length[sequence + 1]) ++sequence; // Now sequence is the sequence index of the occurrence.
+					const unsigned int sequence_begin = sequence_cumulative_length[sequence];
+					pos << qi << ',' << forward_index + reverse_index - 1 << ',' << sequence << ',' << o->begin - sequence_begin << ',' << o->end - sequence_begin << ',' << strand << ',' << o->distance << ',' << o->cigar << '\n';
+				}
+				const size_t occurrence_count = forward_occurrences.size() + reverse_occurrences.size();
+				log << qi << ',' << lines[qi].substr(0, m) << ',' << k << ',' << occurrence_count << ',' << p.hamming << '\n';
+			}
+		}
+
+		// Write output files remotely via SSH SCP.
+		const path rmt_job_path = rmt_jobs_path / _id.str();
+		const auto curl = curl_easy_init();
+		curl_easy_setopt(curl, CURLOPT_SSH_AUTH_TYPES, CURLSSH_AUTH_PUBLICKEY);
+		curl_easy_setopt(curl, CURLOPT_SSH_PRIVATE_KEYFILE, private_keyfile.c_str());
+		curl_easy_setopt(curl, CURLOPT_SSH_PUBLIC_KEYFILE, public_keyfile.c_str());
+		curl_easy_setopt(curl, CURLOPT_UPLOAD, 1);
+		for (const auto& file : { make_pair(log_path, "log.csv"), make_pair(pos_path, "pos.csv") })
+		{
+			FILE* const fp = fopen(file.first.c_str(), "rb");
+			if (!fp)
+			{
+				cerr << local_time() << "Failed to open " << file.first.string() << ", so " << file.second << " is not uploaded" << endl;
+				remove(file.first);
+				continue;
+			}
+			curl_easy_setopt(curl, CURLOPT_URL, (rmt_job_path / file.second).c_str());
+			curl_easy_setopt(curl, CURLOPT_INFILESIZE_LARGE, static_cast<curl_off_t>(file_size(file.first)));
+			curl_easy_setopt(curl, CURLOPT_READDATA, fp);
+			const auto code = curl_easy_perform(curl);
+			if (code != CURLE_OK)
+			{
+				cerr << local_time() << "Failed to upload " << file.second << ": " << curl_easy_strerror(code) << endl;
+			}
+			fclose(fp);
+			remove(file.first);
+		}
+		curl_easy_cleanup(curl);
+
+		finish_job(job, genome_name, query_count, string());
+	};
+
+	// Fail the jobs of a group from the first one not yet completed, e.g. when searching their genome has thrown, so that their submitters are still notified.
+	const auto fail_jobs = [&](const vector<BSONObj>& jobs, const size_t first_job, const string& genome_name, const string& error)
+	{
+		for (size_t ji = first_job; ji < jobs.size(); ++ji)
+		{
+			cerr << local_time() << "Job " << jobs[ji]["_id"].OID().str() << " failed: " << error << endl;
+			try
+			{
+				finish_job(jobs[ji], genome_name, count_queries(jobs[ji]["queries"].String()), error);
+			}
+			catch (const exception& e)
+			{
+				cerr << local_time() << "Failed to finish job " << jobs[ji]["_id"].OID().str() << ": " << e.what() << endl;
+			}
+		}
+	};
+
+	// Search a genome for the queries of a group of jobs in one batch, and complete the jobs.
+	// The backend and the threads are dedicated to the group, so that the groups of different genomes can be searched concurrently.
+	// An exception fails the jobs not yet completed rather than escaping, as it would otherwise terminate the daemon when the group is searched on a thread of its own.
+	const auto search_group = [&](const genome& g, const vector<BSONObj>& jobs, agrep_backend& group_backend, const unsigned int group_threads)
+	{
+		size_t ji = 0;
+		try
+		{
+			cout << local_time() << "Searching the genome of " << g.name << " for " << jobs.size() << " jobs" << endl;
+			// Parse the queries of all the jobs, and search the genome for all their patterns in one batch. All the matches of every pattern are saved into the result files.
+			vector<string> lines;
+			vector<size_t> query_offsets(1, 0);	// The queries of job i are [query_offsets[i], query_offsets[i + 1]).
+			vector<size_t> pattern_offsets(1, 0);	// The patterns of job i are [pattern_offsets[i], pattern_offsets[i + 1]), i.e. one per query and strand.
+			vector<agrep_pattern> patterns;
+			for (const auto& job : jobs)
+			{
+				parse_queries(job["queries"].String(), searches_both_strands(job), lines, patterns);
+				query_offsets.push_back(lines.size());
+				pattern_offsets.push_back(patterns.size());
+			}
+
+			// Look up the patterns in the cache of matches, search the FM-index of the genome, if it has one, for the missed patterns planned for it, and scan the genome with the agrep kernel for the rest.
+			// A pattern with more than match_limit matches, wherever they come from, overflows, and fails its job rather than exhausting memory.
+			vector<vector<unsigned int>> matches(patterns.size());
+			vector<bool> overflows(patterns.size(), false);
+			vector<unsigned int> missed;	// Indices of the patterns missed by the cache.
+			vector<unsigned int> scanned;	// Indices of the patterns to scan for.
+			vector<agrep_pattern> scanned_patterns;
+			for (unsigned int i = 0; i < patterns.size(); ++i)
+			{
+				if (cache.find(g, patterns[i], matches[i])) continue;
+				missed.push_back(i);
+				if (g.index && genome_index::plan(patterns[i]) && g.index->search(g, patterns[i], matches[i])) continue;
+				scanned.push_back(i);
+				scanned_patterns.push_back(patterns[i]);
+			}
+			cout << local_time() << "Searching for " << patterns.size() << " patterns, " << patterns.size() - missed.size() << " of which in the cache, and " << missed.size() - scanned.size() << " of which with the index" << endl;
+			if (!scanned.empty())
+			{
+				vector<vector<unsigned int>> scanned_matches;
+				vector<bool> scanned_overflows;
+				group_backend.load(g.scodon, g.scodon_size(), g.character_count, g.block_count, g.gap_blocks.data());
+				try
+				{
+					group_backend.search(scanned_patterns, scanned_matches, scanned_overflows);
+				}
+				catch (...)
+				{
+					group_backend.unload();
+					throw;
+				}
+				group_backend.unload();
+				for (unsigned int i = 0; i < scanned.size(); ++i)
+				{
+					matches[scanned[i]] = move(scanned_matches[i]);
+					overflows[scanned[i]] = scanned_overflows[i];
+				}
+			}
+			for (size_t i = 0; i < patterns.size(); ++i)
+			{
+				if (matches[i].size() <= match_limit) continue;
+				overflows[i] = true;
+				vector<unsigned int>().swap(matches[i]);
+			}
+			for (const auto i : missed)
+			{
+				if (!overflows[i]) cache.insert(g, patterns[i], matches[i]);
+			}
+
+			for (; ji < jobs.size(); ++ji)
+			{
+				const size_t pattern_offset = pattern_offsets[ji];
+				const size_t query_count = query_offsets[ji + 1] - query_offsets[ji];
+				const auto overflow = find(overflows.begin() + pattern_offset, overflows.begin() + pattern_offsets[ji + 1], true);
+				if (overflow != overflows.begin() + pattern_offsets[ji + 1])
+				{
+					const size_t qi = (overflow - overflows.begin() - pattern_offset) / (searches_both_strands(jobs[ji]) ? 2 : 1);
+					const string error = "Query " + to_string(qi) + " has more than " + to_string(match_limit) + " matches";
+					cerr << local_time() << "Job " << jobs[ji]["_id"].OID().str() << " failed: " << error << endl;
+					for (size_t i = pattern_offset; i < pattern_offsets[ji + 1]; ++i) vector<unsigned int>().swap(matches[i]);
+					finish_job(jobs[ji], g.name, query_count, error);
+					continue;
+				}
+				complete_job(jobs[ji], g.name, g.sequence_cumulative_length, &lines[query_offsets[ji]], &patterns[pattern_offset], query_count, [&](const size_t i)
+				{
+					// Verify the matches of the pattern and collapse them into occurrences with alignments, releasing the matches as soon as they have been aligned.
+					auto& pattern_matches = matches[pattern_offset + i];
+					auto occurrences = align_matches(g, patterns[pattern_offset + i], pattern_matches, group_threads);
+					vector<unsigned int>().swap(pattern_matches);
+					return occurrences;
+				});
+			}
+		}
+		catch (const exception& e)
+		{
+			cerr << local_time() << "Failed to search the genome of " << g.name << ": " << e.what() << endl;
+			fail_jobs(jobs, ji, g.name, e.what());
+		}
+	};
+
 	while (true)
 	{
-		// Fetch jobs.
+		// Fetch jobs, and group them by genome in the order of their earliest submission, so that a genome is loaded once for all the jobs that search it.
+		// A job of taxid 0 searches the genome uploaded with it instead, which is searched on its own.
+		vector<pair<unsigned int, vector<BSONObj>>> job_groups;
+		vector<BSONObj> upload_jobs;
 		auto cursor = conn.query(collection, QUERY("completed" << BSON("$exists" << false)).sort("submitted"), 100); // Each batch processes 100 jobs.
 		while (cursor->more())
 		{
-			const auto job = cursor->next();
-			const auto _id = job["_id"].OID();
-			cout << local_time() << "Executing job " << _id.str() << endl;
-
-			// Obtain the target genome via taxid.
-			const auto taxid = job["taxid"].Int();
-			unsigned int i;
-			for (i = 0; i < genomes.size(); ++i)
+			const auto job = cursor->next().getOwned();
+			const unsigned int taxid = job["taxid"].Int();
+			if (!taxid)
 			{
-				if (taxid == genomes[i].taxid) break;
+				upload_jobs.push_back(job);
+				continue;
 			}
-			BOOST_ASSERT(i < genomes.size());
-			const auto& g = genomes[i];
-			cout << local_time() << "Searching the genome of " << g.name << endl;
-
-			// Set up CUDA kernel.
-			checkCudaErrors(cudaMalloc((void**)&scodon_device, sizeof(unsigned int) * g.scodon.size()));
-			checkCudaErrors(cudaMemcpy(scodon_device, &g.scodon.front(), sizeof(unsigned int) * g.scodon.size(), cudaMemcpyHostToDevice));
-			checkCudaErrors(cudaMalloc((void**)&match_device, sizeof(unsigned int) * max_match_count));
-			initAgrepKernel(scodon_device, g.character_count, match_device, max_match_count);
-
-			// Create output string streams.
-			stringstream log, pos;
-			log << "Query Index,Pattern,Edit Distance,Number of Matches\n";
-			pos << "Query Index,Match Index,File Index,Ending Position\n";
-
-			// Parse and execute queries.
-			istringstream in(job["queries"].String());
-			string line;
-			size_t qi;
-			for (qi = 0; getline(in, line); ++qi)
+			BOOST_ASSERT(genomes.find(taxid));
+			auto group = job_groups.begin();
+			while (group != job_groups.end() && group->first != taxid) ++group;
+			if (group == job_groups.end()) group = job_groups.insert(group, make_pair(taxid, vector<BSONObj>()));
+			group->second.push_back(job);
+		}
+		if (!concurrent)
+		{
+			for (const auto& job_group : job_groups)
 			{
-				BOOST_ASSERT(line.size() <= 65);
-				const unsigned int m = line.size() - 1;		// Pattern length.
-				const unsigned int k = line.back() - 48;	// Edit distance.
-				if (m <= 32)
+				// Obtain the target genome via taxid.
+				const auto g = genomes.acquire(job_group.first);
+				search_group(*g, job_group.second, *backend, num_threads);
+			}
+		}
+		if (concurrent)
+		{
+			// Search the groups concurrently in the order of their earliest submission, each with its own CPU backend of a share of the threads.
+			// Whenever groups finish, their threads are handed to the next groups, as many as there are free threads and as their genomes fit within the memory budget together with those being searched.
+			vector<shared_ptr<const genome>> group_genomes(job_groups.size());
+			vector<unsigned int> group_threads(job_groups.size());
+			vector<size_t> group_bytes(job_groups.size());
+			vector<thread> searches(job_groups.size());
+			vector<size_t> finished;	// Indices of the groups that have finished but have not been joined.
+			mutex finished_mutex;
+			condition_variable finished_cv;
+			unsigned int free_threads = max(num_threads, 1u);
+			size_t running = 0, running_bytes = 0;
+			for (size_t next = 0; next < job_groups.size() || running;)
+			{
+				// Select the next groups. A group is started alone if nothing else is running, even if its genome alone exceeds the budget.
+				const size_t begin = next;
+				for (size_t bytes = running_bytes; next < job_groups.size() && next - begin < free_threads; ++next)
 				{
-					memset(mask_array_32, 0, sizeof(unsigned int) * CHARACTER_CARDINALITY);
-					for (unsigned int i = 0; i < m; ++i)
-					{
-						unsigned int j = (unsigned int)1 << i;
-						if ((line[i] == 'N') || (line[i] == 'n'))
-						{
-							mask_array_32[0] |= j;
-							mask_array_32[1] |= j;
-							mask_array_32[2] |= j;
-							mask_array_32[3] |= j;
-						}
-						else
-						{
-							mask_array_32[encode(line[i])] |= j;
-						}
-					}
-					mask_array_32[0] ^= MAX_UNSIGNED_INT;
-					mask_array_32[1] ^= MAX_UNSIGNED_INT;
-					mask_array_32[2] ^= MAX_UNSIGNED_INT;
-					mask_array_32[3] ^= MAX_UNSIGNED_INT;
-					test_bit_32 = (unsigned int)1 << (m - 1);
-					transferMaskArray32(mask_array_32, test_bit_32);
+					group_bytes[next] = genome_cache::footprint(*genomes.find(job_groups[next].first));
+					if ((running || next > begin) && bytes + group_bytes[next] > genomes.budget()) break;
+					bytes += group_bytes[next];
 				}
-				else // m > 32
+
+				// Obtain their genomes, estimate the work of each group as the number of characters of its genome times the number of its patterns, and partition the free threads, and thus the memory bandwidth, in proportion to their work.
+				if (next > begin)
 				{
-					memset(mask_array_64, 0, sizeof(unsigned long long) * CHARACTER_CARDINALITY);
-					for (unsigned int i = 0; i < m; ++i)	// Derive the mask array of current pattern.
+					vector<double> works;
+					for (size_t i = begin; i < next; ++i)
 					{
-						unsigned long long j = (unsigned long long)1 << i;
-						if ((line[i] == 'N') || (line[i] == 'n'))
+						group_genomes[i] = genomes.acquire(job_groups[i].first);
+						size_t pattern_count = 0;
+						for (const auto& job : job_groups[i].second)
 						{
-							mask_array_64[0] |= j;
-							mask_array_64[1] |= j;
-							mask_array_64[2] |= j;
-							mask_array_64[3] |= j;
+							pattern_count += count_queries(job["queries"].String()) * (searches_both_strands(job) ? 2 : 1);
 						}
-						else
+						works.push_back(static_cast<double>(group_genomes[i]->character_count) * pattern_count);
+					}
+					const auto shares = partition_threads(works, free_threads);
+					for (size_t i = begin; i < next; ++i)
+					{
+						group_threads[i] = shares[i - begin];
+						cout << local_time() << "Dedicating " << group_threads[i] << " threads to the genome of " << group_genomes[i]->name << endl;
+						searches[i] = thread([&, i]()
 						{
-							mask_array_64[encode(line[i])] |= j;
-						}
+							// The group is reclaimed even if its backend cannot be constructed, in which case all its jobs fail.
+							try
+							{
+								cpu_backend group_backend(group_threads[i], isa);
+								search_group(*group_genomes[i], job_groups[i].second, group_backend, group_threads[i]);
+							}
+							catch (const exception& e)
+							{
+								cerr << local_time() << "Failed to search the genome of " << group_genomes[i]->name << ": " << e.what() << endl;
+								fail_jobs(job_groups[i].second, 0, group_genomes[i]->name, e.what());
+							}
+							lock_guard<mutex> lock(finished_mutex);
+							finished.push_back(i);
+							finished_cv.notify_one();
+						});
+						running_bytes += group_bytes[i];
+						++running;
 					}
-					mask_array_64[0] ^= MAX_UNSIGNED_LONG_LONG;
-					mask_array_64[1] ^= MAX_UNSIGNED_LONG_LONG;
-					mask_array_64[2] ^= MAX_UNSIGNED_LONG_LONG;
-					mask_array_64[3] ^= MAX_UNSIGNED_LONG_LONG;
-					test_bit_64 = (unsigned long long)1 << (m - 1);
-					transferMaskArray64(mask_array_64, test_bit_64);
+					free_threads = 0;
 				}
 
-				// Invoke kernel.
-				invokeAgrepKernel(m, k, g.block_count);
-				checkCudaErrors(cudaGetLastError());
-				// Don't waste the CPU time before waiting for the CUDA agrep kernel to exit.
-				const unsigned int m_minus_k = m - k;	// Used to determine whether a match is across two consecutive sequences.
-//				const unsigned int m_plus_k = m + k;	// Used to determine whether a match is across two consecutive sequences.
-				checkCudaErrors(cudaDeviceSynchronize());	// Block until the CUDA agrep kernel completes.
-
-				// Retrieve matches from device.
-				getMatchCount(&match_count);
-				if (match_count > max_match_count) match_count = max_match_count;	// If the number of matches exceeds max_match_count, only the first max_match_count matches will be saved into the result file.
-				checkCudaErrors(cudaMemcpy(match, match_device, sizeof(unsigned int) * match_count, cudaMemcpyDeviceToHost));
-
-				// Decompose absolute matches into sequences and positions within sequence.
-				vector<unsigned int> match_sequences, match_positions;
-				match_sequences.reserve(match_count);
-				match_positions.reserve(match_count);
-				for (unsigned int i = 0; i < match_count; i++)
+				// Wait for groups to finish, and reclaim their threads and genomes.
+				vector<size_t> reclaimed;
 				{
-					unsigned int position = match[i];	// The absolute ending position of current match.
-					unsigned int sequence = g.block_to_sequence[position >> (L + B + 4)];	// Use block-to-sequence mapping to get the nearest sequence index.
-					while (position >= g.sequence_cumulative_length[sequence + 1]) sequence++; // Now sequence is the sequence index of match[i].
-					position -= g.sequence_cumulative_length[sequence];	// Now position is the character index within sequence.
-					if (position + 1 < m_minus_k) continue; // The current match must be across two consecutive sequences. It is thus an invalid matching.
-					match_sequences.push_back(sequence);
-					match_positions.push_back(position);
+					unique_lock<mutex> lock(finished_mutex);
+					finished_cv.wait(lock, [&]() { return !finished.empty(); });
+					reclaimed.swap(finished);
 				}
-
-				// Output filtered matches.
-				const auto filtered_match_count = match_sequences.size();
-				log << qi << ',' << line.substr(0, m) << ',' << k << ',' << filtered_match_count << '\n';
-				for (auto i = 0; i < filtered_match_count; ++i)
+				for (const auto i : reclaimed)
 				{
-					pos << qi << ',' << i << ',' << match_sequences[i] << ',' << match_positions[i] << '\n';
-//					if (match_sequences[i] && (match_positions[i] + 1 < m_plus_k)); // This match may possibly be across two consecutive sequences.
+					searches[i].join();
+					group_genomes[i].reset();
+					free_threads += group_threads[i];
+					running_bytes -= group_bytes[i];
+					--running;
 				}
 			}
+		}
 
-			// Release resources.
-			checkCudaErrors(cudaFree(match_device));
-			checkCudaErrors(cudaFree(scodon_device));
-			checkCudaErrors(cudaDeviceReset());
-
-			// Write output files remotely via SSH SCP.
-			const path rmt_job_path = rmt_jobs_path / _id.str();
-			const auto curl = curl_easy_init();
-			curl_easy_setopt(curl, CURLOPT_SSH_AUTH_TYPES, CURLSSH_AUTH_PUBLICKEY);
-			curl_easy_setopt(curl, CURLOPT_SSH_PRIVATE_KEYFILE, private_keyfile.c_str());
-			curl_easy_setopt(curl, CURLOPT_SSH_PUBLIC_KEYFILE, public_keyfile.c_str());
-			curl_easy_setopt(curl, CURLOPT_UPLOAD, 1);
-			curl_easy_setopt(curl, CURLOPT_READFUNCTION, read_from_stringstream);
-			curl_easy_setopt(curl, CURLOPT_URL, (rmt_job_path / "log.csv").c_str());
-			curl_easy_setopt(curl, CURLOPT_INFILESIZE, log.tellp());
-			curl_easy_setopt(curl, CURLOPT_READDATA, &log);
-			curl_easy_perform(curl);
-			curl_easy_setopt(curl, CURLOPT_URL, (rmt_job_path / "pos.csv").c_str());
-			curl_easy_setopt(curl, CURLOPT_INFILESIZE, pos.tellp());
-			curl_easy_setopt(curl, CURLOPT_READDATA, &pos);
-			curl_easy_perform(curl);
-			curl_easy_cleanup(curl);
-
-			// Update progress.
-			const auto millis_since_epoch = duration_cast<std::chrono::milliseconds>(system_clock::now().time_since_epoch()).count();
-			conn.update(collection, BSON("_id" << _id), BSON("$set" << BSON("completed" << Date_t(millis_since_epoch))));
-			const auto err = conn.getLastError();
-			if (!err.empty())
+		for (const auto& job : upload_jobs)
+		{
+			// Parse the queries of the job.
+			const auto _id = job["_id"].OID();
+			vector<string> lines;
+			vector<agrep_pattern> job_patterns;
+			parse_queries(job["queries"].String(), searches_both_strands(job), lines, job_patterns);
+
+			// Download the uploaded genome, i.e. a gzipped FASTA file, via SSH SCP. A genome that fails to be downloaded completes the job with an error rather than being searched partially.
+			const path fasta_path = temp_directory_path() / unique_path("%%%%-%%%%-%%%%-%%%%.fa.gz");
+			genome_stream gs("the uploaded genome", fasta_path);
+			string error;
+			if (FILE* const fp = fopen(fasta_path.c_str(), "wb"))
 			{
-				cerr << local_time() << err << endl;
+				const auto curl = curl_easy_init();
+				curl_easy_setopt(curl, CURLOPT_SSH_AUTH_TYPES, CURLSSH_AUTH_PUBLICKEY);
+				curl_easy_setopt(curl, CURLOPT_SSH_PRIVATE_KEYFILE, private_keyfile.c_str());
+				curl_easy_setopt(curl, CURLOPT_SSH_PUBLIC_KEYFILE, public_keyfile.c_str());
+				curl_easy_setopt(curl, CURLOPT_URL, (rmt_jobs_path / _id.str() / "genome.fa.gz").c_str());
+				curl_easy_setopt(curl, CURLOPT_WRITEDATA, fp);
+				const auto code = curl_easy_perform(curl);
+				curl_easy_cleanup(curl);
+				if (code != CURLE_OK) error = string("Failed to download the uploaded genome: ") + curl_easy_strerror(code);
+				if (fclose(fp) && error.empty()) error = "Failed to save the uploaded genome";
+			}
+			else
+			{
+				error = "Failed to create a temporary file for the uploaded genome";
 			}
 
-			// Send completion notification email.
-			const auto email = job["email"].String();
-			cout << local_time() << "Sending a completion notification email to " << email << endl;
-			MailMessage message;
-			message.setSender("igrep <noreply@cse.cuhk.edu.hk>");
-			message.setSubject("Your igrep job has completed");
-			message.setContent("Genome to search: " + g.name + "\nPatterns to search for: " + to_string(qi) + "\nSubmitted: " + to_simple_string(ptime(epoch, boost::posix_time::milliseconds(job["submitted"].Date().millis))) + " UTC\nCompleted: " + to_simple_string(ptime(epoch, boost::posix_time::milliseconds(millis_since_epoch))) + " UTC\nResult: http://istar.cse.cuhk.edu.hk/igrep");
-			message.addRecipient(MailRecipient(MailRecipient::PRIMARY_RECIPIENT, email));
-			SMTPClientSession session("137.189.91.190");
-			session.login();
-			session.sendMessage(message);
-			session.close();
+			// Search the genome as it is decompressed, without packing it beforehand. A genome that fails to be read, e.g. a malformed one, completes the job with an error too, so that it is not retried forever.
+			vector<vector<occurrence>> occurrences(job_patterns.size());
+			if (error.empty())
+			{
+				cout << local_time() << "Searching " << gs.name << " of job " << _id.str() << " for " << job_patterns.size() << " patterns" << endl;
+				try
+				{
+					gs.search(job_patterns, *backend, num_threads, occurrences);
+				}
+				catch (const exception& e)
+				{
+					error = e.what();
+				}
+			}
+			boost::system::error_code ec;
+			remove(fasta_path, ec);
+			if (!error.empty())
+			{
+				cerr << local_time() << "Job " << _id.str() << " failed: " << error << endl;
+				finish_job(job, gs.name, lines.size(), error);
+				continue;
+			}
+			complete_job(job, gs.name, gs.sequence_cumulative_length, lines.data(), job_patterns.data(), lines.size(), [&](const size_t i)
+			{
+				return move(occurrences[i]);
+			});
 		}
 
 		// Sleep for a second.
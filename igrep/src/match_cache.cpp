@@ -0,0 +1,241 @@
+#include <cstdlib>
+#include <ctime>
+#include <sstream>
+#include <iomanip>
+#include <tuple>
+#include <algorithm>
+#include <boost/filesystem/operations.hpp>
+#include <boost/filesystem/fstream.hpp>
+#include "match_cache.hpp"
+
+using namespace boost::filesystem;
+
+/// Magic bytes at the beginning of an entry file.
+static const char entry_magic[8] = { 'I', 'G', 'R', 'E', 'P', 'M', 'C', 'H' };
+
+/// Version of the entry file format.
+static const unsigned int entry_version = 2;
+
+/// Header of an entry file, which is followed by the key, and then by the matches, i.e. the first ending position and the differences between consecutive ones, each in 7-bit groups from the lowest, with the high bit set on all but the last group.
+struct entry_header
+{
+	char magic[8];	/**< Magic bytes, i.e. IGREPMCH. */
+	unsigned int version;	/**< Version of the file format. */
+	unsigned int taxid;	/**< taxidomy ID of the genome. */
+	unsigned int key_size;	/**< Number of bytes of the key. */
+	unsigned int match_count;	/**< Number of matches. */
+	unsigned long long build;	/**< Fingerprint of the genome. */
+};
+
+/// Returns the key of a pattern, i.e. the bytes of its length, edit distance, distance type and mask arrays.
+static string make_key(const agrep_pattern& p)
+{
+	string key;
+	const unsigned int fields[3] = { p.m, p.k, p.hamming };
+	key.append(reinterpret_cast<const char*>(fields), sizeof(fields));
+	if (p.word_mask_arrays.empty())
+	{
+		key.append(reinterpret_cast<const char*>(p.mask_array), sizeof(p.mask_array));
+	}
+	for (const auto& word_mask_array : p.word_mask_arrays)
+	{
+		key.append(reinterpret_cast<const char*>(word_mask_array.data()), sizeof(unsigned long long) * CHARACTER_CARDINALITY);
+	}
+	return key;
+}
+
+/// Returns the file name of the entry of a key in a genome, i.e. the taxid followed by the 64-bit FNV-1a hash of the fingerprint of the genome and the key.
+static string make_filename(const genome& g, const string& key)
+{
+	unsigned long long hash = 14695981039346656037ULL;
+	const auto mix = [&](const char* const data, const size_t size)
+	{
+		for (size_t i = 0; i < size; ++i)
+		{
+			hash ^= static_cast<unsigned char>(data[i]);
+			hash *= 1099511628211ULL;
+		}
+	};
+	mix(reinterpret_cast<const char*>(&g.build), sizeof(g.build));
+	mix(key.data(), key.size());
+	ostringstream oss;
+	oss << g.taxid << '-' << hex << setw(16) << setfill('0') << hash << ".mch";
+	return oss.str();
+}
+
+size_t match_cache::default_budget()
+{
+	if (const char* const budget_mb = getenv("IGREP_CACHE_BUDGET"))
+	{
+		return static_cast<size_t>(atof(budget_mb) * (1 << 20));
+	}
+	return static_cast<size_t>(4) << 30;
+}
+
+match_cache::match_cache(const path& directory, const size_t budget_bytes, const function<void(const string&)>& log) : directory(directory), budget_bytes(budget_bytes), log(log), stored(0)
+{
+	// Order the existing entries by their last use, which is recorded as their modification time.
+	create_directories(directory);
+	vector<tuple<time_t, string, size_t>> existing;
+	for (directory_iterator it(directory), end; it != end; ++it)
+	{
+		if (!is_regular_file(it->status()) || it->path().extension() != ".mch") continue;
+		existing.emplace_back(last_write_time(it->path()), it->path().filename().string(), file_size(it->path()));
+	}
+	sort(existing.begin(), existing.end(), greater<tuple<time_t, string, size_t>>());
+	for (const auto& entry : existing)
+	{
+		lru.emplace_back(get<1>(entry), get<2>(entry));
+		entries[get<1>(entry)] = prev(lru.end());
+		stored += get<2>(entry);
+	}
+	while (stored > budget_bytes) erase(lru.back().first);
+}
+
+bool match_cache::find(const genome& g, const agrep_pattern& p, vector<unsigned int>& matches)
+{
+	const string key = make_key(p);
+	const string filename = make_filename(g, key);
+	size_t size;
+	{
+		lock_guard<mutex> guard(m);
+		const auto entry = entries.find(filename);
+		if (entry == entries.end()) return false;
+		size = entry->second->second;
+	}
+
+	// Read the whole entry without holding the lock, so that a large entry does not block other searches, and verify that it is of the genome and the pattern, which a hash collision or a truncated file would violate.
+	// A file deleted meanwhile by another search making room for its entry fails to be read, and is not in the entries any more.
+	const path entry_path = directory / filename;
+	string data(size, 0);
+	{
+		boost::filesystem::ifstream ifs(entry_path, ios::binary);
+		ifs.read(&data[0], data.size());
+		if (!ifs) data.clear();
+	}
+	const entry_header* const header = reinterpret_cast<const entry_header*>(data.data());
+	if (data.size() < sizeof(entry_header) || !equal(entry_magic, entry_magic + sizeof(entry_magic), header->magic) || header->version != entry_version || header->taxid != g.taxid || header->build != g.build || header->key_size != key.size() || data.compare(sizeof(entry_header), key.size(), key))
+	{
+		lock_guard<mutex> guard(m);
+		if (!entries.count(filename)) return false;
+		log("Deleting the mismatched cache entry " + filename);
+		erase(filename);
+		return false;
+	}
+
+	// Decode the matches.
+	matches.clear();
+	matches.reserve(header->match_count);
+	unsigned int match = 0;
+	for (size_t i = sizeof(entry_header) + key.size(); i < data.size();)
+	{
+		unsigned int delta = 0;
+		for (unsigned int shift = 0; i < data.size(); shift += 7)
+		{
+			const unsigned char byte = data[i++];
+			delta |= static_cast<unsigned int>(byte & 127) << shift;
+			if (!(byte & 128)) break;
+		}
+		match += delta;
+		matches.push_back(match);
+	}
+	if (matches.size() != header->match_count)
+	{
+		lock_guard<mutex> guard(m);
+		if (!entries.count(filename)) return false;
+		log("Deleting the truncated cache entry " + filename);
+		erase(filename);
+		return false;
+	}
+
+	// Mark the entry as the most recently used, in memory and on disk, unless it has been deleted meanwhile. Failing to touch the file only loses its recency across runs.
+	{
+		lock_guard<mutex> guard(m);
+		const auto entry = entries.find(filename);
+		if (entry != entries.end()) lru.splice(lru.begin(), lru, entry->second);
+	}
+	boost::system::error_code ec;
+	last_write_time(entry_path, time(nullptr), ec);
+	return true;
+}
+
+void match_cache::insert(const genome& g, const agrep_pattern& p, const vector<unsigned int>& matches)
+{
+	const string key = make_key(p);
+	const string filename = make_filename(g, key);
+
+	// Encode the entry.
+	entry_header header;
+	copy(entry_magic, entry_magic + sizeof(entry_magic), header.magic);
+	header.version = entry_version;
+	header.taxid = g.taxid;
+	header.build = g.build;
+	header.key_size = key.size();
+	header.match_count = matches.size();
+	string data(reinterpret_cast<const char*>(&header), sizeof(header));
+	data += key;
+	unsigned int previous = 0;
+	for (const auto match : matches)
+	{
+		for (unsigned int delta = match - previous; true; delta >>= 7)
+		{
+			if (delta < 128)
+			{
+				data.push_back(static_cast<char>(delta));
+				break;
+			}
+			data.push_back(static_cast<char>((delta & 127) | 128));
+		}
+		previous = match;
+	}
+	if (data.size() > budget_bytes / 8)
+	{
+		log("Not caching " + to_string(matches.size()) + " matches of " + to_string(data.size()) + " bytes, which exceed an eighth of the budget");
+		return;
+	}
+
+	// Write the entry into a temporary file of its own first without holding the lock, then delete the least recently used entries until the new one fits, and rename the file,
+	// so that a partially written entry is never read. An existing entry of the same file name is replaced by the rename, so that it can be read until then.
+	const path entry_path = directory / filename;
+	const path tmp_path = entry_path.string() + "." + unique_path().string() + ".tmp";
+	boost::system::error_code ec;
+	{
+		boost::filesystem::ofstream ofs(tmp_path, ios::binary);
+		ofs.write(data.data(), data.size());
+		ofs.close();
+		if (!ofs)
+		{
+			log("Failed to write " + tmp_path.string());
+			remove(tmp_path, ec);
+			return;
+		}
+	}
+	lock_guard<mutex> guard(m);
+	if (entries.count(filename)) forget(filename);
+	while (!lru.empty() && stored + data.size() > budget_bytes) erase(lru.back().first);
+	rename(tmp_path, entry_path, ec);
+	if (ec)
+	{
+		log("Failed to rename " + tmp_path.string() + ": " + ec.message());
+		remove(tmp_path, ec);
+		return;
+	}
+	lru.emplace_front(filename, data.size());
+	entries[filename] = lru.begin();
+	stored += data.size();
+}
+
+void match_cache::erase(const string& filename)
+{
+	boost::system::error_code ec;
+	remove(directory / filename, ec);
+	forget(filename);
+}
+
+void match_cache::forget(const string& filename)
+{
+	const auto entry = entries.find(filename);
+	stored -= entry->second->second;
+	lru.erase(entry->second);
+	entries.erase(entry);
+}
@@ -0,0 +1,76 @@
+#pragma once
+#ifndef IGREP_MATCH_CACHE_HPP
+#define IGREP_MATCH_CACHE_HPP
+
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <functional>
+#include "genome.hpp"
+#include "backend.hpp"
+
+/// Keeps the matches of searched patterns on disk within a storage budget, so that a pattern searched again against the same genome is answered without searching.
+/// An entry is keyed by the genome, i.e. its taxid and its fingerprint, which changes with its build, including its gaps, and by the pattern, i.e. its length, edit distance, distance type and mask arrays, so that patterns differing only in case share an entry.
+/// An entry is a file holding the matching ending positions delta-encoded into variable-length bytes, and the least recently used entries are deleted to make room for new ones.
+/// The cache may be used by concurrent searches. Entry files are read, decoded, encoded and written without holding its lock, which guards the bookkeeping of the entries only.
+class match_cache
+{
+public:
+	/// Returns the default storage budget, i.e. the IGREP_CACHE_BUDGET environment variable in MB if set, or 4 GB otherwise.
+	static size_t default_budget();
+
+	/**
+	 * Constructs a cache of the entries already in a directory, which is created if it does not exist.
+	 * @param[in] directory The directory of the entries.
+	 * @param[in] budget_bytes Storage budget of the entries in bytes. An entry larger than an eighth of it is not stored, so that a single pattern of excessive matches cannot evict the others.
+	 * @param[in] log Receives a line for every entry deleted or rejected.
+	 */
+	explicit match_cache(const path& directory, const size_t budget_bytes, const function<void(const string&)>& log);
+
+	/**
+	 * Look up the matches of a pattern in a genome, and mark the entry as the most recently used.
+	 * @param[in] g The genome.
+	 * @param[in] p The pattern.
+	 * @param[out] matches The ending positions of all the matches in ascending order, if the entry exists.
+	 * @return True if the entry exists.
+	 */
+	bool find(const genome& g, const agrep_pattern& p, vector<unsigned int>& matches);
+
+	/**
+	 * Store the matches of a pattern in a genome, deleting the least recently used entries to make room for them.
+	 * @param[in] g The genome.
+	 * @param[in] p The pattern.
+	 * @param[in] matches The ending positions of all the matches in ascending order.
+	 */
+	void insert(const genome& g, const agrep_pattern& p, const vector<unsigned int>& matches);
+
+	/// Returns the total size of the entries in bytes.
+	size_t stored_bytes() const
+	{
+		lock_guard<mutex> guard(m);
+		return stored;
+	}
+
+	/// Returns the storage budget in bytes.
+	size_t budget() const
+	{
+		return budget_bytes;
+	}
+
+private:
+	const path directory;	/**< The directory of the entries. */
+	const size_t budget_bytes;	/**< Storage budget of the entries in bytes. */
+	const function<void(const string&)> log;	/**< Receives a line for every entry deleted or rejected. */
+	list<pair<string, size_t>> lru;	/**< File names and sizes of the entries, the most recently used first. */
+	unordered_map<string, list<pair<string, size_t>>::iterator> entries;	/**< The entries by file name. */
+	size_t stored;	/**< Total size of the entries in bytes. */
+	mutable mutex m;	/**< Guards lru, entries and stored. */
+
+	/// Deletes an entry and its file. The lock must be held.
+	void erase(const string& filename);
+
+	/// Forgets an entry, but keeps its file, e.g. one about to be replaced. The lock must be held.
+	void forget(const string& filename);
+};
+
+#endif
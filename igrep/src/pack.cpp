@@ -0,0 +1,22 @@
+#include <iostream>
+#include <thread>
+#include <chrono>
+#include <boost/filesystem/operations.hpp>
+#include "genome.hpp"
+
+/// Packs the genomes that igrep searches into files that the daemon maps at startup, so that their FASTA files are decompressed and encoded only once.
+/// The FASTA files of a genome are decompressed in parallel. Only the genomes of the given taxids are packed if any are given.
+int main(int argc, char* argv[])
+{
+	using std::chrono::steady_clock;
+	const unsigned int num_threads = thread::hardware_concurrency();
+	for (const auto& source : genome_sources())
+	{
+		if (argc > 1 && find_if(argv + 1, argv + argc, [&](const char* taxid) { return to_string(source.taxid) == taxid; }) == argv + argc) continue;
+		cout << "Packing the genome of " << source.name << " into " << source.packed_path() << endl;
+		const auto begin = steady_clock::now();
+		const genome g(source, num_threads);
+		g.save(source.packed_path());
+		cout << "Packed " << g.character_count << " characters of " << g.sequence_count << " sequences in " << std::chrono::duration<double>(steady_clock::now() - begin).count() << " seconds" << endl;
+	}
+}
@@ -4,7 +4,10 @@ $(function() {
 	var pager = $('#pager');
 	pager.pager('init', [ 'Description', 'Compounds', 'Submitted', 'Status', 'Progress', 'Result' ], function(job) {
 		var status, progress, result = '<a href="iview/?' + job._id + '"><img src="/iview/logo.png" alt="iview"></a>';
-		if (!job.scheduled) {
+		if (job.failed) {
+			status = 'Failed ' + $.format.date(new Date(job.failed), 'yyyy/MM/dd HH:mm:ss') + ' because ' + job.error;
+			progress = 0;
+		} else if (!job.scheduled) {
 			status = 'Queued for execution';
 			progress = 0;
 		} else if (!job.completed) {
@@ -38,6 +41,8 @@ $(function() {
 					var job = res[i - skip];
 					jobs[i].scheduled = job.scheduled;
 					jobs[i].completed = job.completed;
+					jobs[i].failed = job.failed;
+					jobs[i].error = job.error;
 					for (var s = 0; s < job.scheduled; ++s) {
 						jobs[i][s] = job[s];
 					}
@@ -55,7 +60,7 @@ $(function() {
 					pager.pager('source', jobs);
 					pager.pager('refresh', len, jobs.length, 0, 6, true);
 				}
-				for (; skip < jobs.length && jobs[skip].completed; ++skip);
+				for (; skip < jobs.length && (jobs[skip].completed || jobs[skip].failed); ++skip);
 			}
 			setTimeout(tick, 1000);
 		});
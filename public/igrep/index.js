@@ -2552,7 +2552,11 @@ $(function() {
 	genomes.forEach(function(g, i) {
 		options[i] = '<option value="' + g.taxid + '"' + (g.taxid === 9606 ? ' selected' : '') + '>' + g.name + ' ' + (g.nucleotides / (1000 * 1000 * 1000)).toFixed(2) + 'Gnt</option>';
 	});
+	options.push('<option value="0">Upload a genome in FASTA format</option>');
 	$('#taxid').html(options.join(''));
+	$('#taxid').change(function() {
+		$('#genome_group').toggle($(this).val() === '0');
+	});
 
 	// Initialize tooltips
 	$('.form-group a').tooltip();
@@ -2566,11 +2570,11 @@ $(function() {
 	var pager = $('#pager');
 	pager.pager('init', [ 'Genome', 'Submitted', 'Status', 'Log', 'Pos' ], function(job) {
 		return [
-			getGenome(job.taxid).name,
+			job.taxid ? getGenome(job.taxid).name : 'Uploaded genome',
 			$.format.date(new Date(job.submitted), 'yyyy/MM/dd HH:mm:ss'),
-			job.completed ? 'Completed ' + $.format.date(new Date(job.completed), 'yyyy/MM/dd HH:mm:ss') : 'Queued for execution',
-			job.completed ? '<a href="jobs/' + job._id + '/log.csv"><img src="/excel.png" alt="log.csv"></a>' : null,
-			job.completed ? '<a href="jobs/' + job._id + '/pos.csv"><img src="/excel.png" alt="pos.csv"></a>' : null
+			job.completed ? (job.error ? 'Failed ' : 'Completed ') + $.format.date(new Date(job.completed), 'yyyy/MM/dd HH:mm:ss') + (job.error ? ' because ' + job.error : '') : 'Queued for execution',
+			job.completed && !job.error ? '<a href="jobs/' + job._id + '/log.csv"><img src="/excel.png" alt="log.csv"></a>' : null,
+			job.completed && !job.error ? '<a href="jobs/' + job._id + '/pos.csv"><img src="/excel.png" alt="pos.csv"></a>' : null
 		];
 	});
 
@@ -2583,6 +2587,7 @@ $(function() {
 				for (var i = skip; i < jobs.length; ++i) {
 					var job = res[i - skip];
 					jobs[i].completed = job.completed;
+					jobs[i].error = job.error;
 					if (job.completed) ++nUpdate;
 				}
 				pager.pager('refresh', skip, skip + nUpdate, 2, 6, true);
@@ -2604,15 +2609,32 @@ $(function() {
 	submit.click(function() {
 		// Hide tooltips
 		$('.form-group a').tooltip('hide');
+		// Read the uploaded genome, if any, before validation
+		var file = $('#taxid').val() === '0' ? $('#genome')[0].files[0] : undefined;
+		if (file) {
+			var reader = new FileReader();
+			reader.onload = function() {
+				post(reader.result);
+			};
+			reader.readAsText(file);
+		} else {
+			post();
+		}
+	});
+	function post(genome) {
 		// Do client side validation
 		var v = new validator({
 			email: $('#email').val(),
 			taxid: $('#taxid').val(),
-			queries: $('#queries').val()
+			queries: $('#queries').val(),
+			strand: $('#strand').val()
 		});
+		if ($('#taxid').val() === '0') v.obj.genome = genome;
 		if (v
 			.field('email').message('must be valid').email()
-			.field('queries').message('must conform to the specifications').length(2, 66000).queries()
+			.field('queries').message('must conform to the specifications').length(2, 10030000).queries()
+			.failed() || $('#taxid').val() === '0' && v
+			.field('genome').message('must be in FASTA format and must not exceed 50M nucleotides').length(1, 52428800).fasta()
 			.failed()) {
 			var keys = Object.keys(v.err);
 			keys.forEach(function(key) {
@@ -2637,7 +2659,7 @@ $(function() {
 		}, 'json').always(function() {
 			submit.prop('disabled', false);
 		});
-	});
+	}
 
 	// Construct the accordion section of a genome
 	function section(g) {
@@ -41,8 +41,45 @@
 		receptor: function() {
 			return this.regex(/^(((ATOM  |HETATM).{24}(.{3}\d\.\d{3}){3}.{26}(\r|\n|\r\n)){1,39999}TER   .{74}(\r|\n|\r\n)){1,26}(HETATM.{24}(.{3}\d\.\d{3}){3}.{26}(\r|\n|\r\n)){0,99}(CONECT(.{4}\d){2}.{64}(\r|\n|\r\n)){0,999}$/g);
 		},
+		ligand: function() {
+			// Scan the lines once as idock parses them up to TORSDOF, so that the check is linear in the length and rejects whatever idock would throw on.
+			if (this.val === '') return this; // An optional ligand, e.g. the reference ligand, may be omitted.
+			if (typeof this.val !== 'string') {
+				this.error();
+				return this;
+			}
+			var types = ['H', 'HD', 'C', 'A', 'N', 'NA', 'OA', 'S', 'SA', 'Se', 'P', 'F', 'Cl', 'Br', 'I', 'Zn', 'Fe', 'Mg', 'Ca', 'Mn', 'Cu', 'Na', 'K', 'Hg', 'Ni', 'Co', 'Cd', 'As', 'Sr'];
+			var serial = /^ *\d+$/, coordinate = /^ *-?\d+\.\d+$/;
+			var lines = this.val.split(/\r\n|\r|\n/), heavy = [], frames = [{ begin: 0 }];
+			for (var i = 0; i < lines.length; ++i) {
+				var line = lines[i], frame = frames[frames.length - 1];
+				if (line.indexOf('ATOM') === 0 || line.indexOf('HETATM') === 0) {
+					var type = line.substr(77, /\s/.test(line.charAt(78)) ? 1 : 2);
+					if (line.length < 78 || types.indexOf(type) === -1 || !serial.test(line.substr(6, 5)) || !coordinate.test(line.substr(30, 8)) || !coordinate.test(line.substr(38, 8)) || !coordinate.test(line.substr(46, 8))) break;
+					if (type === 'H' || type === 'HD') continue;
+					var number = parseInt(line.substr(6, 5), 10);
+					heavy.push(number);
+					if (number === frame.y) frame.ySeen = true;
+				} else if (line.indexOf('ENDBRANCH') === 0) {
+					if (frames.length === 1 || frame.begin === heavy.length || !frame.ySeen) break;
+					frames.pop();
+				} else if (line.indexOf('BRANCH') === 0) {
+					if (!serial.test(line.substr(6, 4)) || !serial.test(line.substr(10, 4)) || heavy.indexOf(parseInt(line.substr(6, 4), 10), frame.begin) === -1) break;
+					frames.push({ begin: heavy.length, y: parseInt(line.substr(10, 4), 10) });
+				} else if (line.indexOf('TORSDOF') === 0) {
+					if (frames.length === 1 && heavy.length) return this;
+					break;
+				}
+			}
+			this.error();
+			return this;
+		},
 		queries: function() {
-			return this.regex(/^([ACGTN]{1,64}\d\n){0,9999}[ACGTN]{1,64}\d\n?$/ig);
+			return this.regex(/^([ACGTN]{1,1000}\dM?\n){0,9999}[ACGTN]{1,1000}\dM?\n?$/ig);
+		},
+		fasta: function() {
+			if (typeof this.val !== 'string' || /[^ACGTN\r\n]/i.test(this.val.replace(/^>.*$/gm, ''))) this.error();
+			return this;
 		},
 		objectid: function() {
 			return this.regex(/^[0-9a-fA-F]{24}$/);
@@ -58,6 +95,10 @@
 			if (isNaN(this.val)) this.error();
 			return this;
 		},
+		string: function(def) {
+			this.val = this.val === undefined ? def : String(this.val);
+			return this;
+		},
 		float: function(def) {
 			this.val = this.val === undefined ? def : parseFloat(this.val);
 			if (isNaN(this.val)) this.error();
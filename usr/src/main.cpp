@@ -10,6 +10,7 @@
 #include <cassert>
 #include <chrono>
 #include <thread>
+#include <random>
 #include <openbabel/obconversion.h>
 #include <openbabel/mol.h>
 #include <boost/filesystem/operations.hpp>
@@ -57,6 +58,89 @@ inline vector<T> read_to_vector(const path& p)
 	return buf;
 }
 
+// The scoring kernel is compiled for several instruction set levels by wrapping the generic body in functions targeting them.
+// The flatten attribute inlines the body into the wrapper, so that it is compiled for the target as well.
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define USR_CPU_DISPATCH
+#define USR_TARGET_AVX2 __attribute__((target("avx2,fma"), flatten))
+#define USR_TARGET_AVX512 __attribute__((target("avx512f,avx512dq,avx512vl,avx2,fma"), flatten))
+#else
+#define USR_TARGET_AVX2
+#define USR_TARGET_AVX512
+#endif
+
+/// Computes the USR score s0 over the first 12 features and the USRCAT score s1 over all the 60 features, i.e. the Manhattan distances between query q and ligand l.
+/// Four partial sums are kept, so that the loops vectorize without reassociating floating point additions and all the variants return identical scores.
+inline static void score_generic(const double* const q, const double* const l, double& s0, double& s1)
+{
+	double a[4] = { 0, 0, 0, 0 };
+	for (size_t i = 0; i < 12; i += 4)
+	for (size_t j = 0; j < 4; ++j)
+	{
+		a[j] += fabs(q[i + j] - l[i + j]);
+	}
+	s0 = (a[0] + a[1]) + (a[2] + a[3]);
+	for (size_t i = 12; i < 60; i += 4)
+	for (size_t j = 0; j < 4; ++j)
+	{
+		a[j] += fabs(q[i + j] - l[i + j]);
+	}
+	s1 = (a[0] + a[1]) + (a[2] + a[3]);
+}
+
+static USR_TARGET_AVX2 void score_avx2(const double* const q, const double* const l, double& s0, double& s1)
+{
+	score_generic(q, l, s0, s1);
+}
+
+static USR_TARGET_AVX512 void score_avx512(const double* const q, const double* const l, double& s0, double& s1)
+{
+	score_generic(q, l, s0, s1);
+}
+
+typedef void (*score_kernel)(const double* const q, const double* const l, double& s0, double& s1);
+
+/// Scoring kernel variants in the ascending order of instruction set levels, i.e. sse2, avx2 and avx512.
+static const std::array<score_kernel, 3> score_kernels = {{ score_generic, score_avx2, score_avx512 }};
+static const std::array<const char*, 3> isa_names = {{ "sse2", "avx2", "avx512" }};
+
+/// Returns the index to the highest instruction set level supported by both the CPU and the operating system.
+inline static size_t supported_isa()
+{
+#ifdef USR_CPU_DISPATCH
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512dq") && __builtin_cpu_supports("avx512vl")) return 2;
+	if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) return 1;
+#endif
+	return 0;
+}
+
+/// Returns true if a scoring kernel variant agrees with the sequential scalar reference on random features.
+inline static bool score_self_test(const score_kernel score)
+{
+	mt19937_64 eng(1);
+	uniform_real_distribution<double> dist(-10, 10);
+	std::array<double, 60> q, l;
+	for (size_t t = 0; t < 1000; ++t)
+	{
+		for (size_t i = 0; i < 60; ++i)
+		{
+			q[i] = dist(eng);
+			l[i] = dist(eng);
+		}
+		std::array<double, 2> e = {{ 0, 0 }};
+		for (size_t i = 0; i < 60; ++i)
+		{
+			e[i >= 12] += fabs(q[i] - l[i]);
+		}
+		e[1] += e[0];
+		double s0, s1;
+		score(q.data(), l.data(), s0, s1);
+		if (fabs(s0 - e[0]) > 1e-12 * e[0] || fabs(s1 - e[1]) > 1e-12 * e[1]) return false;
+	}
+	return true;
+}
+
 template <typename size_type>
 class header_array
 {
@@ -271,6 +355,29 @@ int main(int argc, char* argv[])
 	std::array<vector<double>, num_references> dista;
 	alignas(32) std::array<double, qn.back()> q;
 	alignas(32) std::array<double, qn.back()> l;
+	static_assert(qn[0] == 12 && qn[1] == 60, "score_generic() assumes 12 USR and 60 USRCAT features");
+
+	// Select the scoring kernel of the highest instruction set level that is supported, requested by the USR_ISA environment variable, and agrees with the scalar reference.
+	size_t max_isa = supported_isa();
+	if (const char* const name = getenv("USR_ISA"))
+	{
+		const auto it = find(isa_names.cbegin(), isa_names.cend(), string(name));
+		if (it != isa_names.cend()) max_isa = min<size_t>(max_isa, it - isa_names.cbegin());
+	}
+	size_t isa = 0;
+	for (size_t i = 0; i <= max_isa; ++i)
+	{
+		if (score_self_test(score_kernels[i]))
+		{
+			isa = i;
+		}
+		else
+		{
+			cerr << local_time() << "[warning] " << isa_names[i] << " scoring kernel disagrees with the scalar reference" << endl;
+		}
+	}
+	const score_kernel score = score_kernels[isa];
+	cout << local_time() << "Using " << isa_names[isa] << " scoring kernel" << endl;
 
 	// Enter event loop.
 	cout << local_time() << "Entering event loop" << endl;
@@ -482,17 +589,7 @@ int main(int argc, char* argv[])
 		for (size_t k = 0; k < num_ligands; ++k)
 		{
 			usrcat_bin.read(reinterpret_cast<char*>(l.data()), sizeof(l));
-			double s = 0;
-			#pragma unroll
-			for (size_t i = 0, u = 0; u < num_usrs; ++u)
-			{
-				#pragma unroll
-				for (const auto qnu = qn[u]; i < qnu; ++i)
-				{
-					s += fabs(q[i] - l[i]);
-				}
-				scores[u][k] = s;
-			}
+			score(q.data(), l.data(), scores[0][k], scores[1][k]);
 		}
 		assert(usrcat_bin.tellg() == sizeof(l) * num_ligands);
 
@@ -72,7 +72,7 @@ if (cluster.isMaster) {
 			var errorHandler = require('errorhandler');
 			var app = express();
 			app.use(compress());
-			app.use(bodyParser.urlencoded({ limit: '12mb', extended: false }));
+			app.use(bodyParser.urlencoded({ limit: '64mb', extended: false }));
 			app.use(errorHandler({ dumpExceptions: true, showStack: true }));
 			var env = process.env.NODE_ENV || 'development';
 			if (env == 'development') {
@@ -153,11 +153,15 @@ if (cluster.isMaster) {
 				'submitted': 1,
 				'scheduled': 1,
 				'completed': 1,
+				'failed': 1,
+				'error': 1,
 			};
 			var idockProgressFields = {
 				'_id': 0,
 				'scheduled': 1,
 				'completed': 1,
+				'failed': 1,
+				'error': 1,
 			};
 			for (var i = 0; i < 10; ++i) {
 				idockJobFields[i] = 1;
@@ -195,6 +199,11 @@ if (cluster.isMaster) {
 					.field('chg_ub').message('must be an integer within [-5, 5]').int(0).min(-5).max(5).copy()
 					.field('nrb_lb').message('must be an integer within [0, 35]').int(4).min(0).max(35).copy()
 					.field('nrb_ub').message('must be an integer within [0, 35]').int(6).min(0).max(35).copy()
+					.field('cooperative').message('must be either 0 or 1').int(0).in([0, 1]).copy()
+					.field('tuning').message('must be one of fixed, quality and time').string('fixed').in(['fixed', 'quality', 'time']).copy()
+					.field('thoroughness').message('must be a decimal within [0.25, 4]').float(1).min(0.25).max(4).copy()
+					.field('target_seconds').message('must be a decimal within [1, 3600]').float(60).min(1).max(3600).copy()
+					.field('reference').message('must conform to PDBQT specification, at most 1 MB').string('').length(0, 1048576).ligand()
 					.failed() || v
 					.range('mwt_lb', 'mwt_ub')
 					.range('lgp_lb', 'lgp_ub')
@@ -245,6 +254,7 @@ if (cluster.isMaster) {
 					for (var i = 0; i < 10; ++i) {
 						v.res[i] = 0;
 					}
+					if (req.body['reference']) v.res.reference = 1; // The daemon docks ligands in the order of USRCAT similarity to the reference ligand.
 					v.res.submitted = new Date();
 					v.res._id = new mongodb.ObjectID();
 					var dir = __dirname + '/public/idock/jobs/' + v.res._id;
@@ -266,8 +276,11 @@ if (cluster.isMaster) {
 										return key + '=' + req.body[key] + '\n';
 									}).join(''), function(err) {
 										if (err) throw err;
-										idock.insert(v.res, { w: 0 });
-										res.json({});
+										fs.writeFile(dir + '/reference.pdbqt', req.body['reference'] || '', function(err) {
+											if (err) throw err;
+											idock.insert(v.res, { w: 0 });
+											res.json({});
+										});
 									});
 								}
 							});
@@ -433,14 +446,18 @@ if (cluster.isMaster) {
 					'taxid': 1,
 					'submitted': 1,
 					'completed': 1,
+					'error': 1,
 				});
 			}).post(function(req, res) {
 				var v = new validator(req.body);
 				if (v
 					.field('email').message('must be valid').email().copy()
-					.field('taxid').message('must be the taxonomy id of one of the 26 genomes').int().in([13616, 9598, 9606, 9601, 10116, 9544, 9483, 10090, 9913, 9823, 9796, 9615, 9986, 7955, 28377, 9103, 59729, 9031, 3847, 9258, 29760, 15368, 7460, 30195, 7425, 7070]).copy()
-					.field('queries').message('must conform to the specifications').length(2, 66000).queries().copy()
-					.failed()) {
+					.field('taxid').message('must be the taxonomy id of one of the 26 genomes, or 0 to upload a genome').int().in([0, 13616, 9598, 9606, 9601, 10116, 9544, 9483, 10090, 9913, 9823, 9796, 9615, 9986, 7955, 28377, 9103, 59729, 9031, 3847, 9258, 29760, 15368, 7460, 30195, 7425, 7070]).copy()
+					.field('queries').message('must conform to the specifications').length(2, 10030000).queries().copy()
+					.field('strand').message('must be either forward or both').string('forward').in(['forward', 'both']).copy()
+					.failed() || (v.res.taxid === 0 && v
+					.field('genome').message('must be in FASTA format and must not exceed 50M nucleotides').length(1, 52428800).fasta()
+					.failed())) {
 					res.json(v.err);
 					return;
 				}
@@ -449,8 +466,20 @@ if (cluster.isMaster) {
 				var dir = __dirname + '/public/igrep/jobs/' + v.res._id;
 				fs.mkdir(dir, function (err) {
 					if (err) throw err;
-					igrep.insert(v.res, {w: 0});
-					res.json({});
+					if (v.res.taxid) {
+						igrep.insert(v.res, {w: 0});
+						res.json({});
+						return;
+					}
+					// Save the uploaded genome gzipped, which the daemon decompresses as it searches.
+					require('zlib').gzip(req.body['genome'], function(err, buf) {
+						if (err) throw err;
+						fs.writeFile(dir + '/genome.fa.gz', buf, function(err) {
+							if (err) throw err;
+							igrep.insert(v.res, {w: 0});
+							res.json({});
+						});
+					});
 				});
 			});
 			// Start listening